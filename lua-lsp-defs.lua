@@ -9,14 +9,28 @@ LT_SIG_DELIVER = 5
 LT_GROUP_STOP = 6
 LT_PTRACE_EVENT = 7
 LT_EXEC_OCCURED = 8
+LT_BREAKPOINT = 9
+LT_WATCHPOINT = 10
 
 -- Initialize lua trace
--- @param func The callback function
+-- @param func The callback function, called as
+-- func(ev, pid, uregs, ts, dur, tls, proc, weight) where `ts` is the
+-- monotonic time of the stop in nanoseconds, `dur` is the nanoseconds since
+-- the matching syscall enter for LT_SYSCALL_EXIT events and 0 for every other
+-- event, `tls` is a table private to the thread `pid` that lives until the
+-- thread exits and `proc` is the id of the process the thread belongs to,
+-- which differs between the target and any children followed with
+-- --follow-forks.
+-- `weight` is the number of syscalls each syscall event stands for while
+-- sampling (see LT_sample and LT_duty), and 1 otherwise; counts scaled by it
+-- estimate those of a full trace.
+-- Addresses passed to the LT_read/LT_fmt functions during the callback are
+-- read from the address space of `pid`
 function LT_init(func) end
 
 -- Read a cstr at given address
 -- @param address of the cstr
--- @return the string
+-- @return the string, or nil if the address can't be read
 function LT_read_cstr(addr) end
 
 -- Format buffer at address as printable string
@@ -31,3 +45,221 @@ function LT_fmt_buffer(buf, buf_size, print_size) end
 -- @param print_size max size of printable string
 -- @return a printable string representing the buffer
 function LT_fmt_cstr(buf, print_size) end
+
+-- Describe a system call from the built in syscall table
+-- @param no the syscall number
+-- @return nil for unknown numbers, otherwise a table with fields `name`,
+-- `ret` (return kind) and `args`, a list of tables each with a `kind` field
+-- and for "buf" arguments a zero based `len_arg` index of the length argument
+function LT_syscall_info(no) end
+
+-- Format a completed system call the same way as the built in strace
+-- @param uregs register table as passed to the LT_init callback
+-- @param print_size max size of each printed string or buffer argument
+-- @return a string of the form "name(args...) = ret"
+function LT_fmt_syscall(uregs, print_size) end
+
+-- Read the monotonic clock used to stamp trace events
+-- @return nanoseconds, comparable with the `ts` callback argument
+function LT_now() end
+
+-- Only hand on average one in `rate` syscalls to the callback, the others
+-- still run traced but aren't reported. Every syscall still stops the target,
+-- an untraced thread can't be made to count its syscalls, so this saves
+-- callback time but not ptrace time (see LT_duty). Takes effect immediately
+-- @param rate 0 or 1 report every syscall
+function LT_sample(rate) end
+
+-- Only trace for the first `on` milliseconds out of every `period`, the
+-- target runs untraced (and at full speed) for the rest of it
+-- @param on milliseconds of every period that are traced
+-- @param period length of the cycle in milliseconds, 0 stops duty cycling
+-- @return false if the values are out of range or no timer could be made
+function LT_duty(on, period) end
+
+-- Look up a symbol of the target, exported or (when the module isn't
+-- stripped) local, from the ELF files mapped into it
+-- @param name the symbol name
+-- @param module optional, only search modules whose path contains it
+-- @return the runtime address and size of the symbol, or nil
+function LT_sym(name, module) end
+
+-- Find the symbol containing an address of the target
+-- @param addr the address
+-- @return the symbol name (nil if the address is in a module but not in any
+-- symbol), the offset of addr from the symbol (or the module's load address)
+-- and the path of the module; nil if addr isn't in a mapped file
+function LT_addr2sym(addr) end
+
+-- Set or remove a breakpoint in the target. Threads that reach it stop and
+-- func is called with the same arguments as the LT_init callback, with ev
+-- LT_BREAKPOINT and uregs.rip the breakpoint address; the thread then runs
+-- the instruction as usual. A breakpoint stays in the address space it was
+-- set in, it goes on an exec and forked children don't inherit it.
+-- @param addr an address, or a symbol name as for LT_sym
+-- @param func the function to call, nil to remove the breakpoint
+-- @return the address, or nil and an error message
+function LT_break(addr, func) end
+
+-- Hook a function of the target. A jmp over its entry leads calls to func,
+-- run on the calling thread itself, without stopping it, as
+-- func(regs, timestamp): regs holds the argument registers rdi, rsi, rdx,
+-- rcx, r8 and r9 along with rax, rsp, rip (the function) and ret (the return
+-- address). If func returns an integer the function is skipped and the
+-- caller gets that value instead, otherwise the function runs as usual.
+-- Hooks and the LT_init callback take turns with the Lua state, events seen
+-- while a hook has it (such as system calls made from within the hook) are
+-- not passed to LT_init. Exits, breakpoints and watchpoints are the
+-- exception, they are passed on late, in order, once the hook returns. With
+-- --lua-states=N hooks run in N more copies of the script instead, several at
+-- a time, and leave the LT_init state alone; each copy has globals of its
+-- own, see LT_shared_counter. Traced events, breakpoints and watchpoints
+-- included, are still only handled by the LT_init state. Only works in the
+-- process ghost-patch was loaded into, for functions whose first few
+-- instructions can be moved elsewhere.
+-- @param addr an address, or a symbol name as for LT_sym
+-- @param func the function to call, nil to remove the hook
+-- @return the address, or nil and an error message
+function LT_hook(addr, func) end
+
+-- Set or remove a hardware watchpoint, one of the four debug registers of
+-- every thread of the target. Threads that touch it stop and func is called
+-- with the same arguments as the LT_init callback, with ev LT_WATCHPOINT.
+-- "w" and "rw" watches stop the thread after the instruction that wrote (or
+-- read or wrote) the watched bytes, so uregs.rip is already past it; "x"
+-- watches stop before the instruction at addr runs, as a breakpoint would,
+-- without changing the target's code. A watch stays in the address space it
+-- was set in, it goes on an exec and forked children don't inherit it.
+-- LT_watch(addr, nil) removes the watch at addr.
+-- @param addr an address, or a symbol name as for LT_sym
+-- @param len 1, 2, 4 or 8 bytes, addr must be aligned to it; 1 for "x"
+-- @param kind "w", "rw" or "x"
+-- @param func the function to call
+-- @return the address, or nil and an error message
+function LT_watch(addr, len, kind, func) end
+
+-- Run func when the trace ends. With --lua-states every copy of the script
+-- runs its own, the hook copies first, so they can add what they kept in
+-- their globals to shared objects before the main copy reports on them.
+-- A later call replaces the function.
+-- @param func the function to call, with no arguments
+function LT_exit(func) end
+
+-- Get the counter called name, made at 0 on first use. It lives outside of
+-- Lua, so every copy of the script (see --lua-states) that asks for the same
+-- name shares it, and updates from hooks on different threads are atomic.
+-- Methods: add([n]) adds n (default 1) and returns the new value, get().
+-- @param name up to 31 characters, not used by a shared histogram
+-- @return the counter, or nil and an error message
+function LT_shared_counter(name) end
+
+-- Get the log2 histogram called name, shared like LT_shared_counter.
+-- Methods: add(v, [n]) counts v n times (default 1, must be positive),
+-- count(), sum(), which stops at the ends of the integer range rather than
+-- wrapping around, and snapshot() which returns {{lo, hi, count}, ...} for
+-- each bucket in use, lowest first, holding the values lo <= v < hi; the
+-- first bucket holds everything below 1.
+-- @param name up to 31 characters, not used by a shared counter
+-- @return the histogram, or nil and an error message
+function LT_shared_hist(name) end
+
+-- Make a counter keyed by integers or strings of up to 54 bytes, a longer
+-- one is an error rather than being cut short and sharing a count with
+-- every other key that starts the same way. It is a fixed size table in C
+-- that never grows, so it is cheap to update from every event; keys that
+-- turn up once it is full are only added to a count of what was dropped.
+-- Each copy of the script has its own.
+-- Methods: add(key, [n]) adds n (default 1) and returns the new count, or
+-- nil if the key was dropped; get(key); dropped(); snapshot() which returns
+-- {[key] = count, ...}; print([limit]) which writes the limit (default all)
+-- largest counts to stdout, largest first; clear().
+-- @param capacity the most keys held, default 1024, at most 1048576
+-- @return the counter
+function LT_counter(capacity) end
+
+-- Make a histogram of integers, in fixed buckets kept in C.
+-- LT_hist() or LT_hist("log2") has the buckets of LT_shared_hist;
+-- LT_hist("linear", min, max, step) has one bucket for each step from min
+-- up to max and one each for everything below and above that, at most
+-- 4096 in all.
+-- Methods: add(v, [n]), count(), sum() and snapshot() as for
+-- LT_shared_hist; print() which draws the buckets from the first used to
+-- the last on stdout; clear().
+-- @param kind "log2" or "linear"
+-- @return the histogram
+function LT_hist(kind, min, max, step) end
+
+-- Make a top-k sketch, which follows the k keys (integers, or strings of
+-- up to 54 bytes as for LT_counter) with the largest counts out of any number of keys in fixed
+-- memory. A new key takes over from the one with the smallest count, so
+-- counts may be overestimated by up to their error, and any key with more
+-- than a k-th of the total added is certain to be held.
+-- Methods: add(key, [n]) adds n (default 1, must be positive) and returns
+-- the new count; get(key) returns the count and error, 0 if not held;
+-- snapshot() which returns {{key, count, err}, ...}, largest first;
+-- print([limit]) as for LT_counter; clear().
+-- @param k the number of keys held, at most 65536
+-- @return the sketch
+function LT_topk(k) end
+
+-- Change how the script's own memory is collected, as --lua-gc does.
+-- "inc" and "gen" are Lua's incremental and generational collectors; "idle"
+-- puts collection off until the tracer has no stop from the target to deal
+-- with, except where the script outgrows twice its limit. Copies of the
+-- script run by --lua-states are never idle and use "inc" instead.
+-- @param mode "default", "inc", "gen" or "idle"
+-- @param a pause for "inc" and "idle", minor multiplier for "gen"; 0 keeps
+-- Lua's own, at most 1000
+-- @param b step multiplier for "inc", major multiplier for "gen"
+-- @return the mode that was in use before
+function LT_gc_config(mode, a, b) end
+
+-- Get the collector's statistics for this copy of the script
+-- @param reset true to start counting again from zero afterwards
+-- @return a table of mode, kb (memory in use), steps, full (collections
+-- run all at once), ns and max_ns (total and longest time spent
+-- collecting) and hist, the times in the form of LT_shared_hist's
+function LT_gc_stats(reset) end
+
+-- Read an integer or float from the target, there is one of these for each
+-- of u8, u16, u32, u64, i8, i16, i32, i64 and f64 (u64 values above the
+-- largest Lua integer wrap around to negative ones)
+-- @param addr address of the value
+-- @return the value, or nil if the address can't be read
+function LT_peek_u32(addr) end
+
+-- Read bytes from the target into a string
+-- @param addr address of the first byte
+-- @param len number of bytes to read
+-- @return a string of up to len bytes, shorter if the memory ends early, or
+-- nil if nothing can be read
+function LT_peek(addr, len) end
+
+-- Make a view of target memory which is read in place rather than copied
+-- (views of followed children, which don't share our address space, hold a
+-- snapshot). Fields are read with the methods u8 ... f64(off) and
+-- str(off, len), where off counts bytes from the start of the view, and
+-- addr() returns the address the view starts at; #view is its length.
+-- Methods return nil if the memory has been unmapped since
+-- @param addr address of the first byte
+-- @param len length of the view in bytes
+-- @return the view, or nil if the memory can't be read
+function LT_view(addr, len) end
+
+-- Compile a struct layout, once, for decoding target memory in a single call
+-- @param fields a list of {name, type, offset[, length]} where type is one
+-- of u8 ... u64, i8 ... i64, f64, ptr, be16, be32, be64 (big endian, as in
+-- network addresses), or bytes and cstr which take a length
+-- @param size optional size of the struct, by default where the last field
+-- ends; matters when decoding arrays
+-- @return a layout with methods decode(addr[, tab]), which returns a table of
+-- the fields (filling in `tab` when given) or nil if the memory can't be
+-- read, array(addr, count[, list]), which does the same for count structs in
+-- a row, and size(); #layout is its size as well
+function LT_struct(fields, size) end
+
+-- Layouts made with LT_struct for kernel structs that system calls take:
+-- stat, timespec, timeval, iovec, msghdr, pollfd, epoll_event, sockaddr,
+-- sockaddr_in, sockaddr_in6 and sockaddr_un. Field names follow the C
+-- headers, with st_atime_nsec and friends for the parts of the stat times
+LT_structs = {}
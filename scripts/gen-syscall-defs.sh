@@ -0,0 +1,153 @@
+#!/bin/sh
+###############################################################################
+# Copyright (C) 2023  Billy Kozak                                             #
+#                                                                             #
+# This file is part of the ghost-patch program                                #
+#                                                                             #
+# This program is free software: you can redistribute it and/or modify        #
+# it under the terms of the GNU Lesser General Public License as published by #
+# the Free Software Foundation, either version 3 of the License, or           #
+# (at your option) any later version.                                         #
+#                                                                             #
+# This program is distributed in the hope that it will be useful,             #
+# but WITHOUT ANY WARRANTY; without even the implied warranty of              #
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               #
+# GNU Lesser General Public License for more details.                         #
+#                                                                             #
+# You should have received a copy of the GNU Lesser General Public License    #
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.       #
+###############################################################################
+# Brings the numbers and names in syscall-defs.h in step with the kernel's
+# list of x86-64 system calls, which is read from either asm/unistd_64.h or
+# arch/x86/entry/syscalls/syscall_64.tbl out of a kernel tree.
+#
+#     gen-syscall-defs.sh <unistd_64.h|syscall_64.tbl> <syscall-defs.h>
+#
+# Argument kinds aren't in either file, so each entry's signature is kept as
+# it is and calls new to the list get a placeholder which shows six raw
+# arguments; they are named on stderr to be filled in by hand. Entries the
+# list doesn't have are kept when they are numbered past its end, as an
+# older list simply predates them, and named on stderr otherwise.
+###############################################################################
+set -eu
+
+if [ $# -ne 2 ]; then
+	echo "usage: $0 <unistd_64.h|syscall_64.tbl> <syscall-defs.h>" >&2
+	exit 2
+fi
+
+src=$1
+defs=$2
+tmp="$defs.tmp"
+
+awk -v src="$src" '
+function flush_entry() {
+	if(cur_name == "") {
+		return
+	}
+	raw[cur_name] = cur_raw
+	old_nr[cur_name] = cur_nr
+	cur_name = ""
+}
+function placeholder(nr, name,    line) {
+	line = sprintf("SYSCALL_DEF(%d, %s, INT,", nr, name)
+	line = line " A_HEX, A_HEX, A_HEX, A_HEX, A_HEX, A_HEX)"
+	if(length(line) <= 80) {
+		return line
+	}
+	return sprintf("SYSCALL_DEF(%d, %s, INT,\n\t%s)", nr, name, \
+		"A_HEX, A_HEX, A_HEX, A_HEX, A_HEX, A_HEX")
+}
+BEGIN {
+	src_max = -1
+	while((getline line < src) > 0) {
+		n = split(line, f, /[ \t]+/)
+		if((f[1] == "#define") && (f[2] ~ /^__NR_/) && \
+				(f[3] ~ /^[0-9]+$/)) {
+			name = substr(f[2], 6)
+			nr = f[3] + 0
+		} else if((f[1] ~ /^[0-9]+$/) && \
+				((f[2] == "common") || (f[2] == "64"))) {
+			name = f[3]
+			nr = f[1] + 0
+		} else {
+			continue
+		}
+		src_nr[name] = nr
+		src_max = (nr > src_max) ? nr : src_max
+	}
+	if(src_max < 0) {
+		print "no system calls found in " src > "/dev/stderr"
+		exit 1
+	}
+	in_preamble = 1
+}
+/^SYSCALL_DEF\(/ {
+	flush_entry()
+	in_preamble = 0
+	split(substr($0, 13), f, /, */)
+	cur_nr = f[1] + 0
+	cur_name = f[2]
+	cur_raw = $0
+	next
+}
+in_preamble {
+	preamble = preamble $0 "\n"
+	next
+}
+{
+	cur_raw = cur_raw "\n" $0
+}
+END {
+	if(src_max < 0) {
+		exit 1
+	}
+	flush_entry()
+
+	for(name in raw) {
+		nr = old_nr[name]
+		if(name in src_nr) {
+			if(src_nr[name] != nr) {
+				printf("renumbered: %s %d -> %d\n", name, nr, \
+					src_nr[name]) > "/dev/stderr"
+				sub(/^SYSCALL_DEF\([0-9]+,/, \
+					"SYSCALL_DEF(" src_nr[name] ",", raw[name])
+				nr = src_nr[name]
+			}
+		} else if(nr <= src_max) {
+			printf("not in %s: %s\n", src, name) > "/dev/stderr"
+		}
+		if(nr in by_nr) {
+			printf("two calls numbered %d: %s and %s\n", nr, \
+				by_nr[nr], name) > "/dev/stderr"
+			exit 1
+		}
+		by_nr[nr] = name
+		max = (nr > max) ? nr : max
+	}
+	for(name in src_nr) {
+		if(name in raw) {
+			continue
+		}
+		nr = src_nr[name]
+		if(nr in by_nr) {
+			printf("two calls numbered %d: %s and %s\n", nr, \
+				by_nr[nr], name) > "/dev/stderr"
+			exit 1
+		}
+		printf("new, fill in its arguments: %s\n", name) > "/dev/stderr"
+		raw[name] = placeholder(nr, name)
+		by_nr[nr] = name
+		max = (nr > max) ? nr : max
+	}
+
+	printf("%s", preamble)
+	for(nr = 0; nr <= max; nr++) {
+		if(nr in by_nr) {
+			print raw[by_nr[nr]]
+		}
+	}
+}
+' "$defs" > "$tmp" || { rm -f "$tmp"; exit 1; }
+
+mv "$tmp" "$defs"
@@ -0,0 +1,64 @@
+-------------------------------------------------------------------------------
+-- Copyright (C) 2023  Billy Kozak                                           --
+--                                                                           --
+-- This file is part of the ghost-patch program                              --
+--                                                                           --
+-- This program is free software: you can redistribute it and/or modify      --
+-- it under the terms of the GNU Lesser General Public License as published  --
+-- by the Free Software Foundation, either version 3 of the License, or      --
+-- (at your option) any later version.                                       --
+--                                                                           --
+-- This program is distributed in the hope that it will be useful,           --
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of            --
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             --
+-- GNU Lesser General Public License for more details.                       --
+--                                                                           --
+-- You should have received a copy of the GNU Lesser General Public License  --
+-- along with this program.  If not, see <http://www.gnu.org/licenses/>.     --
+-------------------------------------------------------------------------------
+-- Count syscalls per process and report an estimate of the totals when the
+-- target exits. Meant to be run with --sample and/or --duty-cycle, each
+-- event is scaled by the weight the tracer hands over.
+
+local counts = {}
+
+local function syscall_name(no)
+	local info = LT_syscall_info(no)
+
+	if info == nil then
+		return "syscall_" .. no
+	end
+
+	return info.name
+end
+
+local function report(proc)
+	local rows = {}
+
+	for no, n in pairs(counts[proc] or {}) do
+		table.insert(rows, {name = syscall_name(no), n = n})
+	end
+
+	table.sort(rows, function(a, b) return a.n > b.n end)
+
+	print(string.format("[ID: %d] estimated syscall counts:", proc))
+
+	for _, row in ipairs(rows) do
+		print(string.format("%12.0f %s", row.n, row.name))
+	end
+end
+
+local function handle_ev(ev, pid, uregs, ts, dur, tls, proc, weight)
+	if ev == LT_SYSCALL_ENTER then
+		local tab = counts[proc] or {}
+		local no = uregs.orig_rax
+
+		tab[no] = (tab[no] or 0) + weight
+		counts[proc] = tab
+	elseif ev == LT_EXIT_NORMAL and pid == proc then
+		report(proc)
+		counts[proc] = nil
+	end
+end
+
+LT_init(handle_ev)
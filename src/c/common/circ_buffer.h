@@ -132,14 +132,14 @@ static inline size_t circ_buffer_write(
 
 	if(contig >= size) {
 		memcpy(cb->p, src, size);
-		cb->p += size;
-		cb->used += size;
+		circ_buffer_increment_used(cb, size);
 
 		return size;
 	} else {
+		/* contig may stop short at the read pointer rather than at the
+		 * end of the memory space, so only wrap when we got there */
 		memcpy(cb->p, src, contig);
-		cb->used += contig;
-		cb->p = cb->buf;
+		circ_buffer_increment_used(cb, contig);
 		return contig + circ_buffer_write(
 			cb,
 			src + contig,
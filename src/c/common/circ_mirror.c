@@ -0,0 +1,118 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#define _GNU_SOURCE
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <circ_mirror.h>
+
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const char MEMFD_NAME[] = "circ_mirror";
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+size_t circ_mirror_round_size(size_t size)
+{
+	size_t rounded = getpagesize();
+
+	while(rounded < size) {
+		rounded *= 2;
+	}
+
+	return rounded;
+}
+/*****************************************************************************/
+void *circ_mirror_map(size_t size)
+{
+	uint8_t *ret = NULL;
+
+	/* call through syscall() so we don't depend on a libc new enough to
+	 * wrap memfd_create */
+	int fd = syscall(SYS_memfd_create, MEMFD_NAME, MFD_CLOEXEC);
+
+	if(fd < 0) {
+		return NULL;
+	}
+	if(ftruncate(fd, size) != 0) {
+		goto exit;
+	}
+
+	/* reserve both halves first so that nothing else can land in the
+	 * gap between the two fixed mappings */
+	uint8_t *base = mmap(
+		NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+	);
+
+	if(base == MAP_FAILED) {
+		goto exit;
+	}
+
+	for(int i = 0; i < 2; i++) {
+		void *half = mmap(
+			base + i * size,
+			size,
+			PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_FIXED,
+			fd,
+			0
+		);
+
+		if(half == MAP_FAILED) {
+			munmap(base, 2 * size);
+			goto exit;
+		}
+	}
+
+	ret = base;
+exit:
+	close(fd);
+	return ret;
+}
+/*****************************************************************************/
+int circ_mirror_unmap(void *buf, size_t size)
+{
+	return munmap(buf, 2 * size);
+}
+/*****************************************************************************/
+int circ_mirror_init(struct circ_mirror *cb, size_t size)
+{
+	cb->size = circ_mirror_round_size(size);
+	cb->buf = circ_mirror_map(cb->size);
+	cb->head = 0;
+	cb->tail = 0;
+
+	return cb->buf == NULL ? -1 : 0;
+}
+/*****************************************************************************/
+int circ_mirror_destroy(struct circ_mirror *cb)
+{
+	int ret = circ_mirror_unmap(cb->buf, cb->size);
+
+	cb->buf = NULL;
+	cb->size = 0;
+
+	return ret;
+}
+/*****************************************************************************/
@@ -0,0 +1,170 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef CIRC_MIRROR_H
+#define CIRC_MIRROR_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utl/math-utl.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+/* A circular buffer whose size is a power of two and whose pages are mapped
+ * twice, back to back. Any span of up to size bytes starting anywhere in the
+ * first copy is contiguous in memory, so reads and writes never have to be
+ * split at the wrap point. head and tail are free running counters; the
+ * buffer index of a counter is (counter & mask). */
+struct circ_mirror {
+	uint64_t head;
+	uint64_t tail;
+	size_t size;
+	uint8_t *buf;
+};
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+static inline size_t circ_mirror_mask(const struct circ_mirror *cb)
+{
+	return cb->size - 1;
+}
+/*****************************************************************************/
+static inline uint8_t *circ_mirror_rptr(const struct circ_mirror *cb)
+{
+	return cb->buf + (cb->tail & circ_mirror_mask(cb));
+}
+/*****************************************************************************/
+static inline uint8_t *circ_mirror_wptr(const struct circ_mirror *cb)
+{
+	return cb->buf + (cb->head & circ_mirror_mask(cb));
+}
+/*****************************************************************************/
+static inline size_t circ_mirror_used(const struct circ_mirror *cb)
+{
+	return cb->head - cb->tail;
+}
+/*****************************************************************************/
+static inline size_t circ_mirror_capacity(const struct circ_mirror *cb)
+{
+	return cb->size - circ_mirror_used(cb);
+}
+/*****************************************************************************/
+static inline int circ_mirror_increment_used(
+	struct circ_mirror *cb,
+	size_t used
+) {
+	if(used > circ_mirror_capacity(cb)) {
+		return -1;
+	}
+
+	cb->head += used;
+
+	return 0;
+}
+/*****************************************************************************/
+static inline int circ_mirror_decrement_used(
+	struct circ_mirror *cb,
+	size_t used
+) {
+	if(used > circ_mirror_used(cb)) {
+		return -1;
+	}
+
+	cb->tail += used;
+
+	return 0;
+}
+/*****************************************************************************/
+static inline size_t circ_mirror_write(
+	struct circ_mirror *cb,
+	const void *restrict src,
+	size_t size
+) {
+	size_t n = min_u64(size, circ_mirror_capacity(cb));
+
+	memcpy(circ_mirror_wptr(cb), src, n);
+	cb->head += n;
+
+	return n;
+}
+/*****************************************************************************/
+static inline size_t circ_mirror_read(
+	struct circ_mirror *cb,
+	void *restrict dest,
+	size_t size
+) {
+	size_t n = min_u64(size, circ_mirror_used(cb));
+
+	memcpy(dest, circ_mirror_rptr(cb), n);
+	cb->tail += n;
+
+	return n;
+}
+/*****************************************************************************/
+static inline int circ_mirror_prepend(struct circ_mirror *cb, char c)
+{
+	if(circ_mirror_capacity(cb) == 0) {
+		return -1;
+	}
+
+	cb->tail -= 1;
+	circ_mirror_rptr(cb)[0] = c;
+
+	return 0;
+}
+/*****************************************************************************/
+static inline int circ_mirror_pop(struct circ_mirror *cb)
+{
+	if(circ_mirror_used(cb) == 0) {
+		return -1;
+	}
+
+	int c = circ_mirror_rptr(cb)[0];
+	cb->tail += 1;
+
+	return c;
+}
+/*****************************************************************************/
+static inline int circ_mirror_get(const struct circ_mirror *cb, size_t i)
+{
+	if(circ_mirror_used(cb) <= i) {
+		return -1;
+	}
+
+	return circ_mirror_rptr(cb)[i];
+}
+/*****************************************************************************/
+static inline void circ_mirror_clear(struct circ_mirror *cb)
+{
+	cb->head = 0;
+	cb->tail = 0;
+}
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+void *circ_mirror_map(size_t size);
+int circ_mirror_unmap(void *buf, size_t size);
+size_t circ_mirror_round_size(size_t size);
+int circ_mirror_init(struct circ_mirror *cb, size_t size);
+int circ_mirror_destroy(struct circ_mirror *cb);
+/*****************************************************************************/
+#endif /* CIRC_MIRROR_H */
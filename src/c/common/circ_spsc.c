@@ -0,0 +1,48 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <circ_spsc.h>
+#include <circ_mirror.h>
+
+#include <string.h>
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+int circ_spsc_init(struct circ_spsc *cb, size_t size)
+{
+	memset(cb, 0, sizeof(*cb));
+
+	cb->size = circ_mirror_round_size(size);
+	cb->buf = circ_mirror_map(cb->size);
+
+	return cb->buf == NULL ? -1 : 0;
+}
+/*****************************************************************************/
+int circ_spsc_destroy(struct circ_spsc *cb)
+{
+	int ret = circ_mirror_unmap(cb->buf, cb->size);
+
+	cb->buf = NULL;
+	cb->size = 0;
+
+	return ret;
+}
+/*****************************************************************************/
@@ -0,0 +1,156 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef CIRC_SPSC_H
+#define CIRC_SPSC_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utl/math-utl.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+#define CIRC_SPSC_CACHE_LINE 64
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+/* A single producer, single consumer ring over a circ_mirror mapping.
+ *
+ * head is only stored by the producer and tail only by the consumer, each on
+ * its own cache line along with a cached copy of the other side's counter, so
+ * neither side touches the other's line until its cached view runs out.
+ * Producers reserve and commit spans privately and make them visible to the
+ * consumer with a single release store in circ_spsc_publish(), which lets
+ * several records be handed over in one batch. */
+struct circ_spsc {
+	uint8_t *buf;
+	size_t size;
+
+	/* producer owned */
+	uint64_t head __attribute__((aligned(CIRC_SPSC_CACHE_LINE)));
+	uint64_t pending;
+	uint64_t tail_cache;
+
+	/* consumer owned */
+	uint64_t tail __attribute__((aligned(CIRC_SPSC_CACHE_LINE)));
+	uint64_t head_cache;
+};
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+static inline size_t circ_spsc_mask(const struct circ_spsc *cb)
+{
+	return cb->size - 1;
+}
+/*****************************************************************************/
+/* producer side: free space, refreshing the cached tail */
+static inline size_t circ_spsc_capacity(struct circ_spsc *cb)
+{
+	cb->tail_cache = __atomic_load_n(&cb->tail, __ATOMIC_ACQUIRE);
+
+	return cb->size - (cb->pending - cb->tail_cache);
+}
+/*****************************************************************************/
+/* producer side: bytes not yet consumed, including unpublished ones */
+static inline size_t circ_spsc_used(struct circ_spsc *cb)
+{
+	return cb->size - circ_spsc_capacity(cb);
+}
+/*****************************************************************************/
+static inline void *circ_spsc_reserve(struct circ_spsc *cb, size_t len)
+{
+	size_t cached = cb->size - (cb->pending - cb->tail_cache);
+
+	if((len > cached) && (len > circ_spsc_capacity(cb))) {
+		return NULL;
+	}
+
+	return cb->buf + (cb->pending & circ_spsc_mask(cb));
+}
+/*****************************************************************************/
+static inline void circ_spsc_commit(struct circ_spsc *cb, size_t len)
+{
+	cb->pending += len;
+}
+/*****************************************************************************/
+static inline void circ_spsc_publish(struct circ_spsc *cb)
+{
+	__atomic_store_n(&cb->head, cb->pending, __ATOMIC_RELEASE);
+}
+/*****************************************************************************/
+/* copy as much of src as fits and commit it, the caller still has to
+ * publish */
+static inline size_t circ_spsc_write(
+	struct circ_spsc *cb,
+	const void *restrict src,
+	size_t len
+) {
+	size_t n = min_u64(len, circ_spsc_capacity(cb));
+
+	memcpy(cb->buf + (cb->pending & circ_spsc_mask(cb)), src, n);
+	circ_spsc_commit(cb, n);
+
+	return n;
+}
+/*****************************************************************************/
+/* consumer side: the contiguous span of published bytes */
+static inline const void *circ_spsc_peek(struct circ_spsc *cb, size_t *len)
+{
+	uint64_t tail = __atomic_load_n(&cb->tail, __ATOMIC_RELAXED);
+
+	if(cb->head_cache == tail) {
+		cb->head_cache = __atomic_load_n(&cb->head, __ATOMIC_ACQUIRE);
+	}
+
+	*len = cb->head_cache - tail;
+
+	return cb->buf + (tail & circ_spsc_mask(cb));
+}
+/*****************************************************************************/
+static inline void circ_spsc_consume(struct circ_spsc *cb, size_t len)
+{
+	uint64_t tail = __atomic_load_n(&cb->tail, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&cb->tail, tail + len, __ATOMIC_RELEASE);
+}
+/*****************************************************************************/
+static inline size_t circ_spsc_read(
+	struct circ_spsc *cb,
+	void *restrict dest,
+	size_t len
+) {
+	size_t avail;
+	const void *src = circ_spsc_peek(cb, &avail);
+	size_t n = min_u64(len, avail);
+
+	memcpy(dest, src, n);
+	circ_spsc_consume(cb, n);
+
+	return n;
+}
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+int circ_spsc_init(struct circ_spsc *cb, size_t size);
+int circ_spsc_destroy(struct circ_spsc *cb);
+/*****************************************************************************/
+#endif /* CIRC_SPSC_H */
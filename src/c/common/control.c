@@ -0,0 +1,61 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <control.h>
+
+#include <stddef.h>
+#include <string.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const char SOCK_PREFIX[] = "ghost-patch/";
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+socklen_t control_sock_addr(struct sockaddr_un *addr, pid_t pid)
+{
+	/* the monitor calls this from a bare thread, so no snprintf */
+	char digits[16];
+	size_t ndigits = 0;
+	size_t len = 1;
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+
+	/* an abstract name, there is no file to clean up if the target dies
+	 * and the peer's credentials are checked on every connection */
+	addr->sun_path[0] = '\0';
+
+	memcpy(addr->sun_path + len, SOCK_PREFIX, sizeof(SOCK_PREFIX) - 1);
+	len += sizeof(SOCK_PREFIX) - 1;
+
+	do {
+		digits[ndigits++] = '0' + (pid % 10);
+		pid /= 10;
+	} while(pid > 0);
+
+	while(ndigits > 0) {
+		addr->sun_path[len++] = digits[--ndigits];
+	}
+
+	return offsetof(struct sockaddr_un, sun_path) + len;
+}
+/*****************************************************************************/
@@ -0,0 +1,37 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef CONTROL_H
+#define CONTROL_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+/* longest command or reply, including the terminating newline */
+#define CONTROL_MSG_MAX 4096
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+socklen_t control_sock_addr(struct sockaddr_un *addr, pid_t pid);
+/*****************************************************************************/
+#endif /* CONTROL_H */
@@ -24,6 +24,7 @@
 #include <utl/str-utl.h>
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -33,4 +34,127 @@
 const char *OPTION_ENV_VAR = "GHOST_PATCH_OPTS";
 const char *FAKE_PID_FIELD = "fake_pid";
 const char *LUA_ENT_FIELD = "lua_ent";
+const char *ASYNC_OUT_FIELD = "async_out";
+const char *FOLLOW_FORK_FIELD = "follow_fork";
+const char *FOLLOW_EXEC_FIELD = "follow_exec";
+const char *SAMPLE_FIELD = "sample";
+const char *DUTY_FIELD = "duty";
+const char *CONTROL_FIELD = "control";
+const char *IDLE_FIELD = "idle";
+const char *LUA_CACHE_FIELD = "lua_cache";
+const char *LUA_BUDGET_FIELD = "lua_budget";
+const char *LUA_TIMEOUT_FIELD = "lua_timeout";
+const char *LUA_PROFILE_FIELD = "lua_profile";
+const char *LUA_STATES_FIELD = "lua_states";
+const char *LUA_GC_FIELD = "lua_gc";
+
+const char *ASYNC_OUT_NAMES[] = {
+	[ASYNC_OUT_OFF] = "off",
+	[ASYNC_OUT_BLOCK] = "block",
+	[ASYNC_OUT_DROP] = "drop",
+	[ASYNC_OUT_SPILL] = "spill"
+};
+
+/* NULL terminated, for luaL_checkoption() */
+const char *LUA_GC_NAMES[] = {
+	[LUA_GC_DEFAULT] = "default",
+	[LUA_GC_INC] = "inc",
+	[LUA_GC_GEN] = "gen",
+	[LUA_GC_IDLE] = "idle",
+	[_LUA_GC_TOP] = NULL
+};
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+int async_out_from_name(const char *name, char delim)
+{
+	for(int i = 0; i < _ASYNC_OUT_TOP; i++) {
+		if(strdcmp(name, ASYNC_OUT_NAMES[i], delim) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+/*****************************************************************************/
+const char *parse_u32(const char *s, uint32_t *val)
+{
+	uint64_t acc = 0;
+	const char *start = s;
+
+	while((*s >= '0') && (*s <= '9')) {
+		acc = acc * 10 + (*s - '0');
+
+		if(acc > UINT32_MAX) {
+			return NULL;
+		}
+		s++;
+	}
+
+	if(s == start) {
+		return NULL;
+	}
+
+	*val = acc;
+
+	return s;
+}
+/*****************************************************************************/
+const char *parse_duty(const char *s, uint32_t *on, uint32_t *period)
+{
+	s = parse_u32(s, on);
+
+	if((s == NULL) || (*s != '/')) {
+		return NULL;
+	}
+
+	s = parse_u32(s + 1, period);
+
+	if((s == NULL) || (*on == 0) || (*on > *period)) {
+		return NULL;
+	}
+
+	return s;
+}
+/*****************************************************************************/
+const char *parse_lua_gc(
+	const char *s, enum lua_gc_mode *mode, uint32_t *a, uint32_t *b
+) {
+	int found = -1;
+	size_t len = 0;
+
+	for(int i = 0; i < _LUA_GC_TOP; i++) {
+		len = strlen(LUA_GC_NAMES[i]);
+
+		if(
+			(strncmp(s, LUA_GC_NAMES[i], len) == 0) &&
+			((s[len] == ',') || (s[len] == ';') || (s[len] == '\0'))
+		) {
+			found = i;
+			break;
+		}
+	}
+
+	if(found < 0) {
+		return NULL;
+	}
+
+	s += len;
+	*mode = found;
+	*a = 0;
+	*b = 0;
+
+	if(*s == ',') {
+		s = parse_u32(s + 1, a);
+	}
+	if((s != NULL) && (*s == ',')) {
+		s = parse_u32(s + 1, b);
+	}
+
+	if((s == NULL) || (*a > LUA_GC_PARAM_MAX) || (*b > LUA_GC_PARAM_MAX)) {
+		return NULL;
+	}
+
+	return s;
+}
 /*****************************************************************************/
@@ -22,12 +22,61 @@
 *                                  INCLUDES                                   *
 ******************************************************************************/
 #include <stdbool.h>
+#include <stdint.h>
 /******************************************************************************
 *                                    TYPES                                    *
 ******************************************************************************/
+enum async_out_policy {
+	ASYNC_OUT_OFF,
+	ASYNC_OUT_BLOCK,
+	ASYNC_OUT_DROP,
+	ASYNC_OUT_SPILL,
+	_ASYNC_OUT_TOP
+};
+/*****************************************************************************/
+enum lua_gc_mode {
+	LUA_GC_DEFAULT,
+	LUA_GC_INC,
+	LUA_GC_GEN,
+	/* incremental, with the steps put off until the tracer is idle */
+	LUA_GC_IDLE,
+	_LUA_GC_TOP
+};
+/*****************************************************************************/
 struct prog_opts {
 	bool fake_pid;
 	const char *lua_ent;
+	enum async_out_policy async_out;
+	bool follow_fork;
+	bool follow_exec;
+	/* hand one in sample_rate syscalls to the trace handler */
+	uint32_t sample_rate;
+	/* only trace for duty_on_ms out of every duty_period_ms, a period
+	 * of 0 traces all the time */
+	uint32_t duty_on_ms;
+	uint32_t duty_period_ms;
+	/* serve the control socket */
+	bool control;
+	/* start with the target detached, tracing is switched on later
+	 * through the control socket */
+	bool idle;
+	/* directory for compiled Lua chunks, NULL for no cache */
+	const char *lua_cache;
+	/* limits on a single call of the Lua trace callback, in VM
+	 * instructions and in microseconds, 0 for no limit */
+	uint32_t lua_budget;
+	uint32_t lua_timeout_us;
+	/* where to write the Lua callback profile, NULL for no profiling */
+	const char *lua_profile;
+	/* Lua states hooks run in besides the main one, 0 to run them in
+	 * the main state */
+	uint32_t lua_states;
+	/* how the Lua states collect garbage. lua_gc_a and lua_gc_b are
+	 * the pause and step multiplier for the incremental modes, or the
+	 * minor and major multiplier for LUA_GC_GEN, 0 for Lua's own */
+	enum lua_gc_mode lua_gc;
+	uint32_t lua_gc_a;
+	uint32_t lua_gc_b;
 };
 /******************************************************************************
 *                                    DATA                                     *
@@ -35,9 +84,39 @@ struct prog_opts {
 extern const char *OPTION_ENV_VAR;
 extern const char *FAKE_PID_FIELD;
 extern const char *LUA_ENT_FIELD;
+extern const char *ASYNC_OUT_FIELD;
+extern const char *FOLLOW_FORK_FIELD;
+extern const char *FOLLOW_EXEC_FIELD;
+extern const char *SAMPLE_FIELD;
+extern const char *DUTY_FIELD;
+extern const char *CONTROL_FIELD;
+extern const char *IDLE_FIELD;
+extern const char *LUA_CACHE_FIELD;
+extern const char *LUA_BUDGET_FIELD;
+extern const char *LUA_TIMEOUT_FIELD;
+extern const char *LUA_PROFILE_FIELD;
+extern const char *LUA_STATES_FIELD;
+extern const char *LUA_GC_FIELD;
+extern const char *ASYNC_OUT_NAMES[];
+extern const char *LUA_GC_NAMES[];
 /******************************************************************************
 *                                   DEFINES                                   *
 ******************************************************************************/
-#define DEFAULT_PROG_ARGS {true, NULL}
+#define DEFAULT_PROG_ARGS { \
+		true, NULL, ASYNC_OUT_OFF, false, false, 1, 0, 0, false, \
+		false, NULL, 0, 0, NULL, 0, LUA_GC_DEFAULT, 0, 0 \
+	}
+/* most a --lua-gc parameter may be, in percent */
+#define LUA_GC_PARAM_MAX 1000
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+int async_out_from_name(const char *name, char delim);
+const char *parse_u32(const char *s, uint32_t *val);
+const char *parse_duty(const char *s, uint32_t *on, uint32_t *period);
+/* parses <MODE>[,<A>[,<B>]] as for --lua-gc, leaving out A or B gives 0 */
+const char *parse_lua_gc(
+	const char *s, enum lua_gc_mode *mode, uint32_t *a, uint32_t *b
+);
 /*****************************************************************************/
 #endif /* OPTIONS_H */
@@ -65,7 +65,7 @@ int file_utl_read_line(struct file_utl_reader_state *state)
 
 	if(eol == NULL) {
 		if(state->buf_used != 0) {
-			memmove(state->buf, state->data, len_of_used);
+			memmove(state->buf, start_of_used, len_of_used);
 		}
 		char *start_of_unused = state->buf + len_of_used;
 		size_t remaining = state->buf_size - len_of_used;
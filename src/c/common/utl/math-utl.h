@@ -111,5 +111,20 @@ static inline uint64_t min_u64(uint64_t x, uint64_t y)
 	return x < y ? x : y;
 }
 /*****************************************************************************/
+/* x + y * n, held at INT64_MIN or INT64_MAX instead of overflowing */
+static inline int64_t sat_add_mul_i64(int64_t x, int64_t y, int64_t n)
+{
+	int64_t prod;
+	int64_t sum;
+
+	if(__builtin_mul_overflow(y, n, &prod)) {
+		return ((y < 0) != (n < 0)) ? INT64_MIN : INT64_MAX;
+	} else if(__builtin_add_overflow(x, prod, &sum)) {
+		return (prod < 0) ? INT64_MIN : INT64_MAX;
+	}
+
+	return sum;
+}
+/*****************************************************************************/
 #endif /* MATH_UTL_H */
 
@@ -0,0 +1,132 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <control-client.h>
+#include <control.h>
+
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const char ERROR_REPLY[] = "error";
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+static int join_command(char *buf, size_t size, int argc, char **argv);
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static int join_command(char *buf, size_t size, int argc, char **argv)
+{
+	size_t len = 0;
+
+	for(int i = 0; i < argc; i++) {
+		size_t arg_len = strlen(argv[i]);
+
+		/* room for the separator, the newline and the terminator */
+		if((len + arg_len + 2) >= size) {
+			return -1;
+		}
+
+		if(i != 0) {
+			buf[len++] = ' ';
+		}
+
+		memcpy(buf + len, argv[i], arg_len);
+		len += arg_len;
+	}
+
+	buf[len++] = '\n';
+	buf[len] = '\0';
+
+	return len;
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+int control_client(pid_t pid, int argc, char **argv)
+{
+	char buf[CONTROL_MSG_MAX];
+	struct sockaddr_un addr;
+	socklen_t addr_len = control_sock_addr(&addr, pid);
+	int ret = -1;
+	size_t got = 0;
+
+	int len = join_command(buf, sizeof(buf), argc, argv);
+
+	if(len <= 1) {
+		fprintf(stderr, "Expected a command\n");
+		return -1;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if(fd < 0) {
+		perror(NULL);
+		return -1;
+	}
+
+	if(connect(fd, (struct sockaddr*)&addr, addr_len) != 0) {
+		fprintf(stderr, "No control socket for %d: ", pid);
+		perror(NULL);
+		goto exit;
+	}
+
+	if(write(fd, buf, len) != len) {
+		perror(NULL);
+		goto exit;
+	}
+
+	/* the monitor closes the connection once it has replied */
+	while(got < (sizeof(buf) - 1)) {
+		ssize_t n = read(fd, buf + got, sizeof(buf) - 1 - got);
+
+		if((n < 0) && (errno == EINTR)) {
+			continue;
+		} else if(n <= 0) {
+			break;
+		}
+
+		got += n;
+	}
+
+	buf[got] = '\0';
+
+	if(got == 0) {
+		fprintf(stderr, "No reply from %d\n", pid);
+		goto exit;
+	}
+
+	fputs(buf, stdout);
+
+	if(strncmp(buf, ERROR_REPLY, sizeof(ERROR_REPLY) - 1) != 0) {
+		ret = 0;
+	}
+exit:
+	close(fd);
+	return ret;
+}
+/*****************************************************************************/
@@ -0,0 +1,30 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef CONTROL_CLIENT_H
+#define CONTROL_CLIENT_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <sys/types.h>
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+int control_client(pid_t pid, int argc, char **argv);
+/*****************************************************************************/
+#endif /* CONTROL_CLIENT_H */
@@ -22,6 +22,7 @@
 #include <proc-utl.h>
 #include <debug-modes.h>
 #include <set-options.h>
+#include <control-client.h>
 #include <str-utl-libc.h>
 #include <utl/str-utl.h>
 #include <str-utl-libc.h>
@@ -34,21 +35,128 @@
 #include <stdbool.h>
 #include <assert.h>
 /******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+/* long only options, out of the range of the short ones */
+#define OPT_LUA_CACHE 256
+#define OPT_LUA_BUDGET 257
+#define OPT_LUA_TIMEOUT 258
+#define OPT_LUA_PROFILE 259
+#define OPT_LUA_STATES 260
+#define OPT_LUA_GC 261
+/******************************************************************************
 *                                  CONSTANTS                                  *
 ******************************************************************************/
 static const struct option GETOPT_OPTIONS[] = {
 	{"real-pid", no_argument, NULL, 'p'},
 	{"lua", required_argument, NULL, 'l'},
+	{"lua-cache", required_argument, NULL, OPT_LUA_CACHE},
+	{"lua-budget", required_argument, NULL, OPT_LUA_BUDGET},
+	{"lua-timeout", required_argument, NULL, OPT_LUA_TIMEOUT},
+	{"lua-profile", required_argument, NULL, OPT_LUA_PROFILE},
+	{"lua-states", required_argument, NULL, OPT_LUA_STATES},
+	{"lua-gc", required_argument, NULL, OPT_LUA_GC},
+	{"async-output", required_argument, NULL, 'a'},
+	{"follow-forks", no_argument, NULL, 'f'},
+	{"follow-exec", no_argument, NULL, 'e'},
+	{"sample", required_argument, NULL, 's'},
+	{"duty-cycle", required_argument, NULL, 'd'},
+	{"control", no_argument, NULL, 'c'},
+	{"idle", no_argument, NULL, 'i'},
+	{"ctl", required_argument, NULL, 'C'},
 	{"help", no_argument, NULL, 'h'},
 	{NULL, 0, 0, 0}
 };
-static const char OPT_STRING[] = "+hpl:";
+static const char OPT_STRING[] = "+hpl:a:fes:d:ciC:";
 static const char HELP_TEXT[] =
 	"Start a thread in the target program to ptrace the target.\n"
 	"\n"
 	"Options:\n"
 	"-h,  --help      Display this help text.\n"
 	"--lua=<LUA_PATH> Path to lua script to run for trace.\n"
+	"--lua-cache=<DIR>\n"
+	"                 Keep compiled Lua scripts and modules in DIR and\n"
+	"                 load them from there while the source is\n"
+	"                 unchanged.\n"
+	"--lua-budget=<N> Abort a call of the Lua trace callback once it has\n"
+	"                 run N VM instructions.\n"
+	"--lua-timeout=<USEC>\n"
+	"                 Abort a call of the Lua trace callback once it has\n"
+	"                 run for USEC microseconds. Time spent inside a\n"
+	"                 single C function isn't interrupted. With either\n"
+	"                 limit the callback is dropped after it overruns\n"
+	"                 several calls in a row.\n"
+	"--lua-profile=<FILE>\n"
+	"                 Time the Lua trace callback and count what it\n"
+	"                 allocates, per handler and per system call, and\n"
+	"                 write the totals to FILE when the trace ends.\n"
+	"                 Stacks sampled while it runs go to FILE.folded,\n"
+	"                 ready for flamegraph.pl.\n"
+	"--lua-states=<N> Run LT_hook functions in N more copies of the Lua\n"
+	"                 script (64 at most) so that hooks on different\n"
+	"                 threads run at the same time instead of taking\n"
+	"                 turns with each other and the trace callback.\n"
+	"                 Copies only share data through LT_shared_*\n"
+	"                 objects. Output, files, symbol lookups and most\n"
+	"                 other LT_* functions still take turns. Traced\n"
+	"                 events (syscalls, signals, exits, breakpoints\n"
+	"                 and watchpoints) are all still handled in the\n"
+	"                 main copy, one at a time.\n"
+	"--lua-gc=<MODE>[,<A>[,<B>]]\n"
+	"                 Run the Lua garbage collector in MODE, 'inc'\n"
+	"                 (incremental, Lua's default) or 'gen'\n"
+	"                 (generational). A and B are the pause and step\n"
+	"                 multiplier for 'inc' and the minor and major\n"
+	"                 multiplier for 'gen', as for collectgarbage().\n"
+	"                 'idle' is 'inc' with the steps put off until no\n"
+	"                 thread is stopped waiting on the tracer, except\n"
+	"                 where the script outgrows twice its limit.\n"
+	"--async-output=<POLICY>\n"
+	"                 Hand trace output to a writer thread instead of\n"
+	"                 writing it while the target is stopped. POLICY\n"
+	"                 decides what happens when the output buffer is\n"
+	"                 full: 'block' waits for the writer, 'drop'\n"
+	"                 discards the output (the byte count is reported\n"
+	"                 on stderr at exit) and 'spill' queues it in\n"
+	"                 memory. 'off' (the default) writes synchronously.\n"
+	"-f, --follow-forks\n"
+	"                 Also trace processes created by fork() and vfork()\n"
+	"                 in the same session.\n"
+	"-e, --follow-exec\n"
+	"                 Keep tracing a process across execve() with the\n"
+	"                 trace handler's state preserved. By default the\n"
+	"                 process is released on exec and starts a fresh\n"
+	"                 trace of the new program.\n"
+	"-s, --sample=<N> Only hand one in N system calls (picked at random)\n"
+	"                 to the trace handler. This only saves handler\n"
+	"                 time, the target still stops on every system\n"
+	"                 call so they can be counted. Use --duty-cycle to\n"
+	"                 cut the cost of the stops themselves.\n"
+	"-d, --duty-cycle=<ON>/<PERIOD>\n"
+	"                 Only trace the target for the first ON\n"
+	"                 milliseconds out of every PERIOD, it runs\n"
+	"                 untraced, and at full speed, for the rest. While\n"
+	"                 untraced getpid() isn't faked (see --real-pid)\n"
+	"                 and blocking calls may be interrupted when tracing\n"
+	"                 resumes, much like when strace attaches.\n"
+	"-c, --control    Listen for commands from --ctl while the target\n"
+	"                 runs.\n"
+	"-i, --idle       Start the target untraced and wait for an 'attach'\n"
+	"                 command, implies --control.\n"
+	"-C, --ctl=<PID> <COMMAND>...\n"
+	"                 Send a command to the target with process ID PID\n"
+	"                 and print its reply. The commands are:\n"
+	"                   status           what the tracer is doing\n"
+	"                   pause, resume    stop and restart tracing, but\n"
+	"                                    stay attached\n"
+	"                   detach, attach   let go of the target and pick\n"
+	"                                    it up again (not after it has\n"
+	"                                    exec'd), getpid() isn't faked\n"
+	"                                    in between\n"
+	"                   load <LUA_PATH>  replace the Lua script\n"
+	"                   sample <N>       as --sample\n"
+	"                   duty <ON>/<PERIOD> | off\n"
+	"                                    as --duty-cycle\n"
 	"-p, --real-pid   Don't fake the process ID of the target process.\n"
 	"                 This programs runs the target in a child process\n"
 	"                 means that the output of the getpid() system call\n"
@@ -63,15 +171,20 @@ static const char HELP_TEXT[] =
 *                            FUNCTION DECLARATIONS                            *
 ******************************************************************************/
 static void setup_ld_preload(void);
-static int target_args_pos(int argc, char **argv);
-static int parse_arguments(int argc, char **argv, struct prog_opts *aptr);
+static int parse_arguments(
+	int argc, char **argv, struct prog_opts *aptr, pid_t *ctl_pid
+);
 /******************************************************************************
 *                              STATIC FUNCTIONS                               *
 ******************************************************************************/
-static int parse_arguments(int argc, char **argv, struct prog_opts *aptr)
-{
+static int parse_arguments(
+	int argc, char **argv, struct prog_opts *aptr, pid_t *ctl_pid
+) {
 	struct prog_opts defaults = DEFAULT_PROG_ARGS;
 	int opt_ind = 0;
+	int policy = 0;
+	const char *end = NULL;
+	uint32_t pid = 0;
 	bool flag = true;
 
 	memcpy(aptr, &defaults, sizeof(*aptr));
@@ -94,6 +207,106 @@ static int parse_arguments(int argc, char **argv, struct prog_opts *aptr)
 		case 'l':
 			aptr->lua_ent = optarg;
 			break;
+		case OPT_LUA_CACHE:
+			aptr->lua_cache = optarg;
+			break;
+		case OPT_LUA_PROFILE:
+			aptr->lua_profile = optarg;
+			break;
+		case OPT_LUA_BUDGET:
+			end = parse_u32(optarg, &aptr->lua_budget);
+			if((end == NULL) || (*end != '\0')) {
+				fprintf(
+					stderr, "Bad Lua budget: %s\n", optarg
+				);
+				return -1;
+			}
+			break;
+		case OPT_LUA_TIMEOUT:
+			end = parse_u32(optarg, &aptr->lua_timeout_us);
+			if((end == NULL) || (*end != '\0')) {
+				fprintf(
+					stderr, "Bad Lua timeout: %s\n", optarg
+				);
+				return -1;
+			}
+			break;
+		case OPT_LUA_STATES:
+			end = parse_u32(optarg, &aptr->lua_states);
+			if((end == NULL) || (*end != '\0')) {
+				fprintf(
+					stderr,
+					"Bad Lua state count: %s\n",
+					optarg
+				);
+				return -1;
+			}
+			break;
+		case OPT_LUA_GC:
+			end = parse_lua_gc(
+				optarg,
+				&aptr->lua_gc,
+				&aptr->lua_gc_a,
+				&aptr->lua_gc_b
+			);
+			if((end == NULL) || (*end != '\0')) {
+				fprintf(
+					stderr,
+					"Bad Lua collector setting: %s\n",
+					optarg
+				);
+				return -1;
+			}
+			break;
+		case 'f':
+			aptr->follow_fork = true;
+			break;
+		case 'e':
+			aptr->follow_exec = true;
+			break;
+		case 's':
+			end = parse_u32(optarg, &aptr->sample_rate);
+			if((end == NULL) || (*end != '\0')) {
+				fprintf(
+					stderr, "Bad sample rate: %s\n", optarg
+				);
+				return -1;
+			}
+			break;
+		case 'd':
+			end = parse_duty(
+				optarg, &aptr->duty_on_ms, &aptr->duty_period_ms
+			);
+			if((end == NULL) || (*end != '\0')) {
+				fprintf(
+					stderr, "Bad duty cycle: %s\n", optarg
+				);
+				return -1;
+			}
+			break;
+		case 'c':
+			aptr->control = true;
+			break;
+		case 'i':
+			aptr->idle = true;
+			aptr->control = true;
+			break;
+		case 'C':
+			end = parse_u32(optarg, &pid);
+			if((end == NULL) || (*end != '\0') || (pid == 0)) {
+				fprintf(stderr, "Bad process ID: %s\n", optarg);
+				return -1;
+			}
+			*ctl_pid = pid;
+			break;
+		case 'a':
+			policy = async_out_from_name(optarg, '\0');
+			if(policy < 0) {
+				fprintf(stderr, "Bad output policy: %s\n", optarg);
+				return -1;
+			}
+			aptr->async_out = policy;
+			break;
 		case '?':
 			flag = false;
 			return -1;
@@ -107,20 +320,6 @@ static int parse_arguments(int argc, char **argv, struct prog_opts *aptr)
 	return 0;
 }
 /*****************************************************************************/
-static int target_args_pos(int argc, char **argv)
-{
-
-	for(int i = 1; i < argc; i++) {
-		if(argv[i][0] != '-') {
-			return i;
-		} else if(strcmp(argv[i], "--") == 0) {
-			return i != argc ? i + 1 : -1;
-		}
-	}
-
-	return -1;
-}
-/*****************************************************************************/
 static char *shared_object(void)
 {
 	char *executable = this_executable();
@@ -159,13 +358,22 @@ static void setup_ld_preload(void)
 int main(int argc, char **argv)
 {
 	struct prog_opts parsed_args;
-	int targ_arg_index = target_args_pos(argc, argv);
+	pid_t ctl_pid = 0;
 
-	if(parse_arguments(argc, argv, &parsed_args)) {
+	if(parse_arguments(argc, argv, &parsed_args, &ctl_pid)) {
 		return -1;
 	}
 
-	if(targ_arg_index < 0) {
+	if(ctl_pid != 0) {
+		return control_client(ctl_pid, argc - optind, argv + optind);
+	}
+
+	/* getopt stops at the first non-option ("+" in OPT_STRING) so what
+	 * is left is the target and its arguments, this also keeps the
+	 * arguments of short options like "-s 10" out of the way */
+	int targ_arg_index = optind;
+
+	if(targ_arg_index >= argc) {
 		return 0;
 	}
 
@@ -26,6 +26,7 @@
 #include <utl/str-utl.h>
 
 #include <string.h>
+#include <stdlib.h>
 /******************************************************************************
 *                                    DATA                                     *
 ******************************************************************************/
@@ -66,6 +67,261 @@ int set_options(const struct prog_opts *opts)
 		env_str = tmp;
 	}
 
+	if(opts->lua_cache != NULL) {
+		char *tmp = append_to_dyn_str(
+			NULL,
+			env_str,
+			LUA_CACHE_FIELD,
+			"=",
+			opts->lua_cache,
+			";"
+		);
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
+	if(opts->lua_profile != NULL) {
+		char *tmp = append_to_dyn_str(
+			NULL,
+			env_str,
+			LUA_PROFILE_FIELD,
+			"=",
+			opts->lua_profile,
+			";"
+		);
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
+	if(opts->async_out != ASYNC_OUT_OFF) {
+		char *tmp = append_to_dyn_str(
+			NULL,
+			env_str,
+			ASYNC_OUT_FIELD,
+			"=",
+			ASYNC_OUT_NAMES[opts->async_out],
+			";"
+		);
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
+	if(opts->follow_fork) {
+		char *tmp = append_to_dyn_str(
+			NULL,
+			env_str,
+			FOLLOW_FORK_FIELD,
+			"=",
+			bool_to_string(opts->follow_fork),
+			";"
+		);
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
+	if(opts->follow_exec) {
+		char *tmp = append_to_dyn_str(
+			NULL,
+			env_str,
+			FOLLOW_EXEC_FIELD,
+			"=",
+			bool_to_string(opts->follow_exec),
+			";"
+		);
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
+	if(opts->control) {
+		char *tmp = append_to_dyn_str(
+			NULL,
+			env_str,
+			CONTROL_FIELD,
+			"=",
+			bool_to_string(opts->control),
+			";"
+		);
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
+	if(opts->idle) {
+		char *tmp = append_to_dyn_str(
+			NULL,
+			env_str,
+			IDLE_FIELD,
+			"=",
+			bool_to_string(opts->idle),
+			";"
+		);
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
+	if(opts->sample_rate > 1) {
+		char *rate = int_to_string(opts->sample_rate);
+		char *tmp = NULL;
+
+		if(rate != NULL) {
+			tmp = append_to_dyn_str(
+				NULL, env_str, SAMPLE_FIELD, "=", rate, ";"
+			);
+		}
+		free(rate);
+
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
+	if(opts->duty_period_ms != 0) {
+		char *on = int_to_string(opts->duty_on_ms);
+		char *period = int_to_string(opts->duty_period_ms);
+		char *tmp = NULL;
+
+		if((on != NULL) && (period != NULL)) {
+			tmp = append_to_dyn_str(
+				NULL,
+				env_str,
+				DUTY_FIELD,
+				"=",
+				on,
+				"/",
+				period,
+				";"
+			);
+		}
+		free(on);
+		free(period);
+
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
+	if(opts->lua_budget != 0) {
+		char *budget = int_to_string(opts->lua_budget);
+		char *tmp = NULL;
+
+		if(budget != NULL) {
+			tmp = append_to_dyn_str(
+				NULL,
+				env_str,
+				LUA_BUDGET_FIELD,
+				"=",
+				budget,
+				";"
+			);
+		}
+		free(budget);
+
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
+	if(opts->lua_timeout_us != 0) {
+		char *timeout = int_to_string(opts->lua_timeout_us);
+		char *tmp = NULL;
+
+		if(timeout != NULL) {
+			tmp = append_to_dyn_str(
+				NULL,
+				env_str,
+				LUA_TIMEOUT_FIELD,
+				"=",
+				timeout,
+				";"
+			);
+		}
+		free(timeout);
+
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
+	if(opts->lua_states != 0) {
+		char *states = int_to_string(opts->lua_states);
+		char *tmp = NULL;
+
+		if(states != NULL) {
+			tmp = append_to_dyn_str(
+				NULL,
+				env_str,
+				LUA_STATES_FIELD,
+				"=",
+				states,
+				";"
+			);
+		}
+		free(states);
+
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
+	if(opts->lua_gc != LUA_GC_DEFAULT) {
+		char *a = int_to_string(opts->lua_gc_a);
+		char *b = int_to_string(opts->lua_gc_b);
+		char *tmp = NULL;
+
+		if((a != NULL) && (b != NULL)) {
+			tmp = append_to_dyn_str(
+				NULL,
+				env_str,
+				LUA_GC_FIELD,
+				"=",
+				LUA_GC_NAMES[opts->lua_gc],
+				",",
+				a,
+				",",
+				b,
+				";"
+			);
+		}
+		free(a);
+		free(b);
+
+		if(tmp == NULL) {
+			ret = -1;
+			goto exit;
+		}
+		env_str = tmp;
+	}
+
 	if(setenv(OPTION_ENV_VAR, env_str, 1)) {
 		ret = -1;
 		goto exit;
@@ -0,0 +1,494 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "elf-syms.h"
+
+#include "secret-heap.h"
+#include <gio/ghost-stdio.h>
+
+#include <elf.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const size_t SYMS_INITIAL = 256;
+static const uint64_t PAGE_MASK = 4096 - 1;
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+static bool in_file(const struct elf_syms *es, uint64_t off, uint64_t len);
+static const Elf64_Shdr *section(const struct elf_syms *es, size_t i);
+static int find_vaddr_base(struct elf_syms *es);
+static int load_table(
+	struct elf_syms *es, const Elf64_Shdr *sh, struct elf_table *tab
+);
+static bool sym_wanted(const Elf64_Sym *sym);
+static int collect(struct elf_syms *es, const struct elf_table *tab);
+static void sift_down(struct elf_sym *syms, size_t root, size_t n);
+static void sort_syms(struct elf_sym *syms, size_t n);
+static void dedupe(struct elf_syms *es);
+static int load_gnu_hash(struct elf_syms *es, const Elf64_Shdr *sh);
+static uint32_t gnu_hash(const char *name);
+static const Elf64_Sym *hash_lookup(
+	const struct elf_syms *es, const char *name
+);
+static const Elf64_Sym *scan_lookup(
+	const struct elf_table *tab, const char *name
+);
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static bool in_file(const struct elf_syms *es, uint64_t off, uint64_t len)
+{
+	return (off <= es->len) && (len <= (es->len - off));
+}
+/*****************************************************************************/
+static const Elf64_Shdr *section(const struct elf_syms *es, size_t i)
+{
+	const Elf64_Ehdr *eh = (const Elf64_Ehdr*)es->data;
+
+	return (const Elf64_Shdr*)(es->data + eh->e_shoff) + i;
+}
+/*****************************************************************************/
+static int find_vaddr_base(struct elf_syms *es)
+{
+	const Elf64_Ehdr *eh = (const Elf64_Ehdr*)es->data;
+	uint64_t phdrs_len = (uint64_t)eh->e_phnum * sizeof(Elf64_Phdr);
+
+	if(eh->e_phentsize != sizeof(Elf64_Phdr)) {
+		return -1;
+	} else if(!in_file(es, eh->e_phoff, phdrs_len)) {
+		return -1;
+	}
+
+	const Elf64_Phdr *ph = (const Elf64_Phdr*)(es->data + eh->e_phoff);
+
+	for(size_t i = 0; i < eh->e_phnum; i++) {
+		if(ph[i].p_type != PT_LOAD) {
+			continue;
+		}
+
+		/* the loader maps whole pages, so file offset 0 lands on the
+		 * page holding the start of the first segment */
+		es->vaddr_base = (ph[i].p_vaddr - ph[i].p_offset) & ~PAGE_MASK;
+		return 0;
+	}
+
+	return -1;
+}
+/*****************************************************************************/
+static int load_table(
+	struct elf_syms *es, const Elf64_Shdr *sh, struct elf_table *tab
+) {
+	const Elf64_Ehdr *eh = (const Elf64_Ehdr*)es->data;
+
+	if(sh->sh_link >= eh->e_shnum) {
+		return -1;
+	} else if(sh->sh_entsize != sizeof(Elf64_Sym)) {
+		return -1;
+	} else if(!in_file(es, sh->sh_offset, sh->sh_size)) {
+		return -1;
+	}
+
+	const Elf64_Shdr *str = section(es, sh->sh_link);
+
+	if((str->sh_type != SHT_STRTAB) || (str->sh_size == 0)) {
+		return -1;
+	} else if(!in_file(es, str->sh_offset, str->sh_size)) {
+		return -1;
+	}
+
+	tab->syms = es->data + sh->sh_offset;
+	tab->n = sh->sh_size / sizeof(Elf64_Sym);
+	tab->str = (const char*)es->data + str->sh_offset;
+	tab->str_len = str->sh_size;
+
+	/* names are only ever handed out when they start inside the table,
+	 * this makes sure that they also end inside it */
+	if(tab->str[tab->str_len - 1] != '\0') {
+		return -1;
+	}
+
+	return 0;
+}
+/*****************************************************************************/
+static bool sym_wanted(const Elf64_Sym *sym)
+{
+	int type = ELF64_ST_TYPE(sym->st_info);
+
+	if((sym->st_shndx == SHN_UNDEF) || (sym->st_shndx == SHN_ABS)) {
+		return false;
+	} else if((sym->st_value == 0) || (sym->st_name == 0)) {
+		return false;
+	}
+
+	return (type == STT_FUNC) || (type == STT_OBJECT) ||
+		(type == STT_GNU_IFUNC);
+}
+/*****************************************************************************/
+static int collect(struct elf_syms *es, const struct elf_table *tab)
+{
+	const Elf64_Sym *syms = tab->syms;
+	size_t cap = es->n_syms;
+
+	for(size_t i = 0; i < tab->n; i++) {
+		if(!sym_wanted(syms + i) || (syms[i].st_name >= tab->str_len)) {
+			continue;
+		}
+
+		if(es->n_syms == cap) {
+			cap = (cap == 0) ? SYMS_INITIAL : (2 * cap);
+
+			void *tmp = ghost_realloc(
+				sheap, es->syms, cap * sizeof(*es->syms)
+			);
+
+			if(tmp == NULL) {
+				return -1;
+			}
+			es->syms = tmp;
+		}
+
+		struct elf_sym *s = es->syms + es->n_syms;
+
+		s->value = syms[i].st_value;
+		s->size = syms[i].st_size;
+		s->name = tab->str + syms[i].st_name;
+		es->n_syms += 1;
+	}
+
+	return 0;
+}
+/*****************************************************************************/
+static void sift_down(struct elf_sym *syms, size_t root, size_t n)
+{
+	while((2 * root + 1) < n) {
+		size_t child = 2 * root + 1;
+
+		if(((child + 1) < n) &&
+			(syms[child].value < syms[child + 1].value)
+		) {
+			child += 1;
+		}
+
+		if(syms[root].value >= syms[child].value) {
+			return;
+		}
+
+		struct elf_sym tmp = syms[root];
+		syms[root] = syms[child];
+		syms[child] = tmp;
+		root = child;
+	}
+}
+/*****************************************************************************/
+static void sort_syms(struct elf_sym *syms, size_t n)
+{
+	/* qsort() may allocate, which isn't safe while the target could be
+	 * stopped holding the malloc lock */
+	for(size_t i = n / 2; i > 0; i--) {
+		sift_down(syms, i - 1, n);
+	}
+
+	for(size_t end = n; end > 1; end--) {
+		struct elf_sym tmp = syms[0];
+		syms[0] = syms[end - 1];
+		syms[end - 1] = tmp;
+		sift_down(syms, 0, end - 1);
+	}
+}
+/*****************************************************************************/
+static void dedupe(struct elf_syms *es)
+{
+	size_t out = 0;
+
+	for(size_t i = 0; i < es->n_syms; i++) {
+		struct elf_sym *prev = (out == 0) ? NULL : es->syms + out - 1;
+
+		if((prev == NULL) || (prev->value != es->syms[i].value)) {
+			es->syms[out++] = es->syms[i];
+		} else if((prev->size == 0) && (es->syms[i].size != 0)) {
+			/* aliases share an address, keep one with a size */
+			*prev = es->syms[i];
+		}
+	}
+
+	es->n_syms = out;
+}
+/*****************************************************************************/
+static int load_gnu_hash(struct elf_syms *es, const Elf64_Shdr *sh)
+{
+	if(!in_file(es, sh->sh_offset, sh->sh_size)) {
+		return -1;
+	} else if((sh->sh_offset % sizeof(uint64_t)) != 0) {
+		return -1;
+	}
+
+	const uint32_t *words = (const uint32_t*)(es->data + sh->sh_offset);
+	size_t n_words = sh->sh_size / sizeof(uint32_t);
+
+	if(n_words < 4) {
+		return -1;
+	}
+
+	uint64_t n_buckets = words[0];
+	uint64_t bloom_size = words[2];
+	uint64_t chain_start = 4 + 2 * bloom_size + n_buckets;
+
+	if((n_buckets == 0) || (bloom_size == 0)) {
+		return -1;
+	} else if(chain_start > n_words) {
+		return -1;
+	}
+
+	es->gnu_hash = words;
+	es->gnu_hash_words = n_words;
+
+	return 0;
+}
+/*****************************************************************************/
+static uint32_t gnu_hash(const char *name)
+{
+	uint32_t h = 5381;
+
+	for(const uint8_t *c = (const uint8_t*)name; *c != '\0'; c++) {
+		h = (h << 5) + h + *c;
+	}
+
+	return h;
+}
+/*****************************************************************************/
+static const Elf64_Sym *hash_lookup(
+	const struct elf_syms *es, const char *name
+) {
+	const uint32_t *words = es->gnu_hash;
+	const Elf64_Sym *syms = es->dynsym.syms;
+
+	uint32_t n_buckets = words[0];
+	uint32_t sym_off = words[1];
+	uint32_t bloom_size = words[2];
+	uint32_t bloom_shift = words[3];
+
+	const uint64_t *bloom = (const uint64_t*)(words + 4);
+	const uint32_t *buckets = words + 4 + 2 * bloom_size;
+	const uint32_t *chain = buckets + n_buckets;
+	size_t chain_len = es->gnu_hash_words - (chain - words);
+
+	uint32_t h = gnu_hash(name);
+	uint64_t word = bloom[(h / 64) % bloom_size];
+	uint64_t mask = (1ULL << (h % 64)) |
+		(1ULL << ((h >> bloom_shift) % 64));
+
+	if((word & mask) != mask) {
+		return NULL;
+	}
+
+	size_t i = buckets[h % n_buckets];
+
+	if((i == 0) || (i < sym_off)) {
+		return NULL;
+	}
+
+	for(; (i < es->dynsym.n) && ((i - sym_off) < chain_len); i++) {
+		uint32_t h2 = chain[i - sym_off];
+		const Elf64_Sym *sym = syms + i;
+
+		if(((h | 1) == (h2 | 1)) && sym_wanted(sym) &&
+			(sym->st_name < es->dynsym.str_len) &&
+			(strcmp(es->dynsym.str + sym->st_name, name) == 0)
+		) {
+			return sym;
+		}
+
+		if(h2 & 1) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+/*****************************************************************************/
+static const Elf64_Sym *scan_lookup(
+	const struct elf_table *tab, const char *name
+) {
+	const Elf64_Sym *syms = tab->syms;
+
+	for(size_t i = 0; i < tab->n; i++) {
+		if(!sym_wanted(syms + i) || (syms[i].st_name >= tab->str_len)) {
+			continue;
+		}
+
+		if(strcmp(tab->str + syms[i].st_name, name) == 0) {
+			return syms + i;
+		}
+	}
+
+	return NULL;
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+struct elf_syms *elf_syms_open(const char *path)
+{
+	struct elf_syms *es = ghost_malloc(sheap, sizeof(*es));
+
+	if(es == NULL) {
+		return NULL;
+	}
+
+	memset(es, 0, sizeof(*es));
+
+	es->f = ghost_fopen(path, "rm");
+
+	if(es->f == NULL) {
+		goto fail;
+	}
+
+	es->data = ghost_fview(es->f, SIZE_MAX, &es->len);
+
+	if((es->data == NULL) || (es->len < sizeof(Elf64_Ehdr))) {
+		goto fail;
+	}
+
+	const Elf64_Ehdr *eh = (const Elf64_Ehdr*)es->data;
+	uint64_t shdrs_len = (uint64_t)eh->e_shnum * sizeof(Elf64_Shdr);
+
+	if(memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0) {
+		goto fail;
+	} else if(eh->e_ident[EI_CLASS] != ELFCLASS64) {
+		goto fail;
+	} else if(eh->e_shentsize != sizeof(Elf64_Shdr)) {
+		goto fail;
+	} else if(!in_file(es, eh->e_shoff, shdrs_len)) {
+		goto fail;
+	} else if(find_vaddr_base(es) != 0) {
+		goto fail;
+	}
+
+	const Elf64_Shdr *hash_sh = NULL;
+
+	for(size_t i = 0; i < eh->e_shnum; i++) {
+		const Elf64_Shdr *sh = section(es, i);
+
+		/* a broken table only costs us its symbols */
+		if(sh->sh_type == SHT_SYMTAB) {
+			load_table(es, sh, &es->symtab);
+		} else if(sh->sh_type == SHT_DYNSYM) {
+			load_table(es, sh, &es->dynsym);
+		} else if(sh->sh_type == SHT_GNU_HASH) {
+			hash_sh = sh;
+		}
+	}
+
+	if((hash_sh != NULL) && (es->dynsym.syms != NULL)) {
+		load_gnu_hash(es, hash_sh);
+	}
+
+	if(collect(es, &es->symtab) != 0) {
+		goto fail;
+	} else if(collect(es, &es->dynsym) != 0) {
+		goto fail;
+	}
+
+	sort_syms(es->syms, es->n_syms);
+	dedupe(es);
+
+	return es;
+fail:
+	elf_syms_close(es);
+	return NULL;
+}
+/*****************************************************************************/
+void elf_syms_close(struct elf_syms *es)
+{
+	if(es == NULL) {
+		return;
+	}
+
+	if(es->f != NULL) {
+		ghost_fclose(es->f);
+	}
+
+	ghost_free(sheap, es->syms);
+	ghost_free(sheap, es);
+}
+/*****************************************************************************/
+const struct elf_sym *elf_syms_by_value(
+	const struct elf_syms *es, uint64_t value
+) {
+	size_t lo = 0;
+	size_t hi = es->n_syms;
+
+	/* find the first symbol past value, the one before it is the only
+	 * candidate */
+	while(lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if(es->syms[mid].value <= value) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if(lo == 0) {
+		return NULL;
+	}
+
+	const struct elf_sym *sym = es->syms + lo - 1;
+
+	if((sym->size == 0) || ((value - sym->value) < sym->size)) {
+		return sym;
+	}
+
+	return NULL;
+}
+/*****************************************************************************/
+int elf_syms_by_name(
+	const struct elf_syms *es, const char *name, struct elf_sym *sym
+) {
+	const struct elf_table *tab = &es->dynsym;
+	const Elf64_Sym *found = NULL;
+
+	if(es->gnu_hash != NULL) {
+		found = hash_lookup(es, name);
+	} else {
+		found = scan_lookup(&es->dynsym, name);
+	}
+
+	if(found == NULL) {
+		tab = &es->symtab;
+		found = scan_lookup(&es->symtab, name);
+	}
+
+	if(found == NULL) {
+		return -1;
+	}
+
+	sym->value = found->st_value;
+	sym->size = found->st_size;
+	sym->name = tab->str + found->st_name;
+
+	return 0;
+}
+/*****************************************************************************/
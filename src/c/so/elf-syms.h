@@ -0,0 +1,83 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef ELF_SYMS_H
+#define ELF_SYMS_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct elf_sym {
+	/* link time address, add the load bias for the runtime one */
+	uint64_t value;
+	uint64_t size;
+	const char *name;
+};
+/*****************************************************************************/
+struct elf_table {
+	const void *syms;
+	size_t n;
+	const char *str;
+	size_t str_len;
+};
+/*****************************************************************************/
+/* The function and object symbols of one ELF file, from .symtab when it
+ * hasn't been stripped and from .dynsym. The file stays mapped for as long
+ * as this is open and names point into the mapping. */
+struct elf_syms {
+	struct ghost_file *f;
+	const uint8_t *data;
+	size_t len;
+
+	/* link time address of the first loadable page, a mapping of file
+	 * offset 0 at address a has a load bias of a - vaddr_base */
+	uint64_t vaddr_base;
+
+	/* sorted by value, one entry per address */
+	struct elf_sym *syms;
+	size_t n_syms;
+
+	/* the raw tables, for lookups by name */
+	struct elf_table symtab;
+	struct elf_table dynsym;
+
+	/* hash table over dynsym, NULL when there is no .gnu.hash */
+	const uint32_t *gnu_hash;
+	size_t gnu_hash_words;
+};
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+struct elf_syms *elf_syms_open(const char *path);
+void elf_syms_close(struct elf_syms *es);
+/* The symbol covering the link time address value, or failing that the
+ * closest one before it that has no size. NULL when there is neither. */
+const struct elf_sym *elf_syms_by_value(
+	const struct elf_syms *es, uint64_t value
+);
+/* Looks name up through the GNU hash table of exported symbols first and
+ * then, for local symbols, in the full table. Returns 0 on success. */
+int elf_syms_by_name(
+	const struct elf_syms *es, const char *name, struct elf_sym *sym
+);
+/*****************************************************************************/
+#endif /* ELF_SYMS_H */
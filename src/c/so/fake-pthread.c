@@ -37,7 +37,8 @@
 *                                    TYPES                                    *
 ******************************************************************************/
 struct thread_arg {
-	volatile long flag;
+	/* a futex word, raised once the clone has taken over */
+	volatile uint32_t flag;
 
 	int(*target)(void*);
 	int(*target_arg)(void*);
@@ -48,11 +49,13 @@ struct thread_arg {
 *                                  CONSTANTS                                  *
 ******************************************************************************/
 static const size_t TEMP_STACK_SIZE = 2 * 1024 * 1024;
+static const size_t FAKE_THREAD_STACK_SIZE = 256 * 1024;
 /******************************************************************************
 *                            FUNCTION DECLARATIONS                            *
 ******************************************************************************/
 static void* pthread_target(void *arg);
 static int clone_target(void *arg);
+static int fake_thread_target(void *arg);
 /******************************************************************************
 *                            FUNCTION DEFINITIONS                             *
 ******************************************************************************/
@@ -63,12 +66,29 @@ static int clone_target(void *arg)
 
 	tj = (struct thread_jump *)&(aptr->tj);
 
-	tj_spinwait(tj);
+	tj_wait(tj);
 	tj_jump(tj, 1);
 
 	return 0;
 }
 /*****************************************************************************/
+static int fake_thread_target(void *arg)
+{
+	struct fake_thread *t = arg;
+	uint64_t all_signals = ~0ULL;
+
+	/* leave signal handling to the thread that created us */
+	_syscall4(
+		SYS_rt_sigprocmask,
+		SIG_BLOCK,
+		(int64_t)&all_signals,
+		0,
+		sizeof(all_signals)
+	);
+
+	return t->target(t->target_arg);
+}
+/*****************************************************************************/
 static void* pthread_target(void *arg)
 {
 	long targ_ret;
@@ -82,9 +102,12 @@ static void* pthread_target(void *arg)
 	tj = (struct thread_jump *)&(aptr->tj);
 
 	tj_set_and_exit(tj);
-	aptr->flag = 1;
 
-	/* aptr is now inavlid, but we can still access the copy in t_arg */
+	/* once the flag is up aptr is invalid, but it is still mapped stack
+	 * memory and a stray wake is harmless; after this we can only access
+	 * the copy in t_arg */
+	__atomic_store_n(&aptr->flag, 1, __ATOMIC_RELEASE);
+	safe_futex_wake(&aptr->flag, 1);
 
 	targ_ret = t_arg.target(t_arg.target_arg);
 	return (void*) targ_ret;
@@ -143,7 +166,7 @@ int fake_pthread(int(*target)(void* arg), void *arg)
 		goto cleanup_2;
 	}
 
-	while(t_arg.flag == 0);
+	safe_await_change(&t_arg.flag, 0);
 
 cleanup_2:
 	pthread_attr_destroy(&attr);
@@ -153,3 +176,64 @@ exit:
 	return ret;
 }
 /*****************************************************************************/
+int fake_thread_start(
+	struct fake_thread *t, int(*target)(void* arg), void *arg
+) {
+	int clone_flags =
+		CLONE_VM |
+		CLONE_FS |
+		CLONE_FILES |
+		CLONE_SIGHAND |
+		CLONE_THREAD |
+		CLONE_SYSVSEM |
+		CLONE_PARENT_SETTID |
+		CLONE_CHILD_SETTID |
+		CLONE_CHILD_CLEARTID;
+
+	t->target = target;
+	t->target_arg = arg;
+	t->stack_size = FAKE_THREAD_STACK_SIZE;
+	t->ctid = 1;
+
+	t->stack = safe_mmap(
+		NULL,
+		t->stack_size,
+		PROT_READ | PROT_WRITE,
+		MAP_STACK | MAP_PRIVATE | MAP_ANONYMOUS,
+		-1,
+		0
+	);
+	if(t->stack == MAP_FAILED) {
+		return 1;
+	}
+
+	int r = clone(
+		fake_thread_target,
+		t->stack + t->stack_size,
+		clone_flags,
+		t,
+		&t->tid,
+		NULL,
+		&t->ctid
+	);
+
+	if(r == -1) {
+		safe_munmap(t->stack, t->stack_size);
+		return 1;
+	}
+
+	return 0;
+}
+/*****************************************************************************/
+int fake_thread_join(struct fake_thread *t)
+{
+	uint32_t ctid;
+
+	/* the kernel zeroes ctid and wakes us once the thread is gone */
+	while((ctid = __atomic_load_n(&t->ctid, __ATOMIC_ACQUIRE)) != 0) {
+		safe_futex_wait(&t->ctid, ctid);
+	}
+
+	return safe_munmap(t->stack, t->stack_size);
+}
+/*****************************************************************************/
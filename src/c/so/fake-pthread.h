@@ -19,8 +19,34 @@
 #ifndef FAKE_PTHREAD_H
 #define FAKE_PTHREAD_H
 /******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+/* A bare clone()'d thread sharing the VM, files and thread group of its
+ * creator. It has no TLS of its own, so the target must stick to
+ * safe_syscalls and must not touch libc state such as errno. */
+struct fake_thread {
+	pid_t tid;
+	volatile uint32_t ctid;
+
+	int(*target)(void*);
+	void *target_arg;
+
+	uint8_t *stack;
+	size_t stack_size;
+};
+/******************************************************************************
 *                            FUNCTION DECLARATIONS                            *
 ******************************************************************************/
 int fake_pthread(int(*target)(void* arg), void *arg);
+int fake_thread_start(
+	struct fake_thread *t, int(*target)(void* arg), void *arg
+);
+int fake_thread_join(struct fake_thread *t);
 /*****************************************************************************/
 #endif /* FAKE_PTHREAD_H */
\ No newline at end of file
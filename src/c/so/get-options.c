@@ -33,6 +33,25 @@
 ******************************************************************************/
 static struct prog_opts cached_opts = DEFAULT_PROG_ARGS;
 static char lua_ent_opt[PATH_MAX + 1];
+static char lua_cache_opt[PATH_MAX + 1];
+static char lua_profile_opt[PATH_MAX + 1];
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static int parse_bool(const char **sptr, bool *val)
+{
+	if(strdcmp(*sptr, "true", ';') == 0) {
+		*val = true;
+		*sptr += sizeof("true");
+	} else if(strdcmp(*sptr, "false", ';') == 0) {
+		*val = false;
+		*sptr += sizeof("false");
+	} else {
+		return -1;
+	}
+
+	return 0;
+}
 /******************************************************************************
 *                            FUNCTION DEFINITIONS                             *
 ******************************************************************************/
@@ -50,6 +69,7 @@ int get_options(struct prog_opts *opts)
 	}
 
 	memset(opts, 0, sizeof(*opts));
+	opts->sample_rate = 1;
 
 	size_t flen = 0;
 
@@ -57,13 +77,7 @@ int get_options(struct prog_opts *opts)
 		if(strdcmp(sptr, FAKE_PID_FIELD, '=') == 0) {
 			sptr += strlen(FAKE_PID_FIELD) + 1;
 
-			if(strdcmp(sptr, "true", ';') == 0) {
-				opts->fake_pid = true;
-				sptr += sizeof("true");
-			} else if(strdcmp(sptr, "false", ';') == 0) {
-				opts->fake_pid = false;
-				sptr += sizeof("false");
-			} else {
+			if(parse_bool(&sptr, &opts->fake_pid) != 0) {
 				return -1;
 			}
 		} else if(strdcmp(sptr, LUA_ENT_FIELD, '=') == 0) {
@@ -75,6 +89,115 @@ int get_options(struct prog_opts *opts)
 			}
 			opts->lua_ent = lua_ent_opt;
 			sptr += flen + 1;
+		} else if(strdcmp(sptr, LUA_CACHE_FIELD, '=') == 0) {
+			sptr += strlen(LUA_CACHE_FIELD) + 1;
+			flen = strdcpy(lua_cache_opt, sptr, ';', PATH_MAX + 1);
+
+			if(sptr[flen] != ';') {
+				return -1;
+			}
+			opts->lua_cache = lua_cache_opt;
+			sptr += flen + 1;
+		} else if(strdcmp(sptr, LUA_PROFILE_FIELD, '=') == 0) {
+			sptr += strlen(LUA_PROFILE_FIELD) + 1;
+			flen = strdcpy(
+				lua_profile_opt, sptr, ';', PATH_MAX + 1
+			);
+
+			if(sptr[flen] != ';') {
+				return -1;
+			}
+			opts->lua_profile = lua_profile_opt;
+			sptr += flen + 1;
+		} else if(strdcmp(sptr, ASYNC_OUT_FIELD, '=') == 0) {
+			sptr += strlen(ASYNC_OUT_FIELD) + 1;
+
+			int policy = async_out_from_name(sptr, ';');
+
+			if(policy < 0) {
+				return -1;
+			}
+			opts->async_out = policy;
+			sptr += strlen(ASYNC_OUT_NAMES[policy]) + 1;
+		} else if(strdcmp(sptr, FOLLOW_FORK_FIELD, '=') == 0) {
+			sptr += strlen(FOLLOW_FORK_FIELD) + 1;
+
+			if(parse_bool(&sptr, &opts->follow_fork) != 0) {
+				return -1;
+			}
+		} else if(strdcmp(sptr, FOLLOW_EXEC_FIELD, '=') == 0) {
+			sptr += strlen(FOLLOW_EXEC_FIELD) + 1;
+
+			if(parse_bool(&sptr, &opts->follow_exec) != 0) {
+				return -1;
+			}
+		} else if(strdcmp(sptr, CONTROL_FIELD, '=') == 0) {
+			sptr += strlen(CONTROL_FIELD) + 1;
+
+			if(parse_bool(&sptr, &opts->control) != 0) {
+				return -1;
+			}
+		} else if(strdcmp(sptr, IDLE_FIELD, '=') == 0) {
+			sptr += strlen(IDLE_FIELD) + 1;
+
+			if(parse_bool(&sptr, &opts->idle) != 0) {
+				return -1;
+			}
+		} else if(strdcmp(sptr, SAMPLE_FIELD, '=') == 0) {
+			sptr += strlen(SAMPLE_FIELD) + 1;
+			sptr = parse_u32(sptr, &opts->sample_rate);
+
+			if((sptr == NULL) || (*sptr != ';')) {
+				return -1;
+			}
+			sptr += 1;
+		} else if(strdcmp(sptr, LUA_BUDGET_FIELD, '=') == 0) {
+			sptr += strlen(LUA_BUDGET_FIELD) + 1;
+			sptr = parse_u32(sptr, &opts->lua_budget);
+
+			if((sptr == NULL) || (*sptr != ';')) {
+				return -1;
+			}
+			sptr += 1;
+		} else if(strdcmp(sptr, LUA_TIMEOUT_FIELD, '=') == 0) {
+			sptr += strlen(LUA_TIMEOUT_FIELD) + 1;
+			sptr = parse_u32(sptr, &opts->lua_timeout_us);
+
+			if((sptr == NULL) || (*sptr != ';')) {
+				return -1;
+			}
+			sptr += 1;
+		} else if(strdcmp(sptr, LUA_STATES_FIELD, '=') == 0) {
+			sptr += strlen(LUA_STATES_FIELD) + 1;
+			sptr = parse_u32(sptr, &opts->lua_states);
+
+			if((sptr == NULL) || (*sptr != ';')) {
+				return -1;
+			}
+			sptr += 1;
+		} else if(strdcmp(sptr, LUA_GC_FIELD, '=') == 0) {
+			sptr += strlen(LUA_GC_FIELD) + 1;
+			sptr = parse_lua_gc(
+				sptr,
+				&opts->lua_gc,
+				&opts->lua_gc_a,
+				&opts->lua_gc_b
+			);
+
+			if((sptr == NULL) || (*sptr != ';')) {
+				return -1;
+			}
+			sptr += 1;
+		} else if(strdcmp(sptr, DUTY_FIELD, '=') == 0) {
+			sptr += strlen(DUTY_FIELD) + 1;
+			sptr = parse_duty(
+				sptr, &opts->duty_on_ms, &opts->duty_period_ms
+			);
+
+			if((sptr == NULL) || (*sptr != ';')) {
+				return -1;
+			}
+			sptr += 1;
 		} else {
 			return -1;
 		}
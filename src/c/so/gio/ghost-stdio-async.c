@@ -0,0 +1,340 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "ghost-stdio.h"
+#include "ghost-stdio-internal.h"
+
+#include <circ_spsc.h>
+#include <fake-pthread.h>
+#include <secret-heap.h>
+#include <safe_syscalls.h>
+#include <utl/math-utl.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct gio_async {
+	int fd;
+	int policy;
+
+	/* the monitor is the only producer and the writer thread the only
+	 * consumer */
+	struct circ_spsc ring;
+
+	uint32_t data_seq __attribute__((aligned(CIRC_SPSC_CACHE_LINE)));
+	uint32_t space_seq;
+	uint32_t writer_waiting;
+	uint32_t producer_waiting;
+	uint32_t stop;
+	uint32_t werr;
+
+	/* producer private state */
+	size_t dropped;
+
+	uint8_t *spill;
+	size_t spill_off;
+	size_t spill_len;
+	size_t spill_cap;
+
+	struct fake_thread thread;
+};
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static size_t ring_put(struct gio_async *a, const uint8_t *src, size_t len)
+{
+	size_t n = circ_spsc_write(&a->ring, src, len);
+
+	circ_spsc_publish(&a->ring);
+
+	return n;
+}
+/*****************************************************************************/
+static void wake_writer(struct gio_async *a)
+{
+	/* pairs with the fence in writer_sleep(), either the writer sees the
+	 * published head or we see that it is waiting */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if(__atomic_load_n(&a->writer_waiting, __ATOMIC_RELAXED)) {
+		__atomic_add_fetch(&a->data_seq, 1, __ATOMIC_SEQ_CST);
+		safe_futex_wake(&a->data_seq, 1);
+	}
+}
+/*****************************************************************************/
+static void wake_producer(struct gio_async *a)
+{
+	/* pairs with the fence in producer_sleep() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if(__atomic_load_n(&a->producer_waiting, __ATOMIC_RELAXED)) {
+		__atomic_add_fetch(&a->space_seq, 1, __ATOMIC_SEQ_CST);
+		safe_futex_wake(&a->space_seq, 1);
+	}
+}
+/*****************************************************************************/
+static void producer_sleep(struct gio_async *a)
+{
+	uint32_t seq = __atomic_load_n(&a->space_seq, __ATOMIC_ACQUIRE);
+
+	__atomic_store_n(&a->producer_waiting, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if(circ_spsc_capacity(&a->ring) == 0) {
+		safe_futex_wait(&a->space_seq, seq);
+	}
+
+	__atomic_store_n(&a->producer_waiting, 0, __ATOMIC_RELAXED);
+}
+/*****************************************************************************/
+static void writer_sleep(struct gio_async *a)
+{
+	size_t avail;
+	uint32_t seq = __atomic_load_n(&a->data_seq, __ATOMIC_ACQUIRE);
+
+	__atomic_store_n(&a->writer_waiting, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	circ_spsc_peek(&a->ring, &avail);
+
+	bool idle = (avail == 0) && !__atomic_load_n(&a->stop, __ATOMIC_ACQUIRE);
+
+	if(idle) {
+		safe_futex_wait(&a->data_seq, seq);
+	}
+
+	__atomic_store_n(&a->writer_waiting, 0, __ATOMIC_RELAXED);
+}
+/*****************************************************************************/
+static void writer_drain(struct gio_async *a, const void *rptr, size_t avail)
+{
+	/* everything published so far goes out in a single syscall, even
+	 * when it straddles the end of the ring */
+	ssize_t w = safe_write(a->fd, rptr, avail);
+
+	if(w == -EINTR) {
+		return;
+	} else if(w < 0) {
+		/* nothing sensible can be done with the bytes, so drop them
+		 * rather than wedging the producer */
+		__atomic_store_n(&a->werr, 1, __ATOMIC_RELAXED);
+		w = avail;
+	}
+
+	circ_spsc_consume(&a->ring, w);
+	wake_producer(a);
+}
+/*****************************************************************************/
+static int writer_main(void *arg)
+{
+	struct gio_async *a = arg;
+
+	while(1) {
+		size_t avail;
+		const void *rptr = circ_spsc_peek(&a->ring, &avail);
+
+		if(avail != 0) {
+			writer_drain(a, rptr, avail);
+		} else if(__atomic_load_n(&a->stop, __ATOMIC_ACQUIRE)) {
+			break;
+		} else {
+			writer_sleep(a);
+		}
+	}
+
+	return 0;
+}
+/*****************************************************************************/
+static void write_blocking(struct gio_async *a, const uint8_t *src, size_t len)
+{
+	while(len > 0) {
+		size_t n = ring_put(a, src, len);
+
+		src += n;
+		len -= n;
+
+		wake_writer(a);
+
+		if(len > 0) {
+			producer_sleep(a);
+		}
+	}
+}
+/*****************************************************************************/
+static void spill_drain(struct gio_async *a)
+{
+	if(a->spill_len == 0) {
+		return;
+	}
+
+	size_t n = ring_put(a, a->spill + a->spill_off, a->spill_len);
+
+	a->spill_off += n;
+	a->spill_len -= n;
+
+	if(a->spill_len == 0) {
+		a->spill_off = 0;
+	}
+}
+/*****************************************************************************/
+static int spill_append(struct gio_async *a, const uint8_t *src, size_t len)
+{
+	if((a->spill_off + a->spill_len + len) > a->spill_cap) {
+		memmove(a->spill, a->spill + a->spill_off, a->spill_len);
+		a->spill_off = 0;
+	}
+
+	if((a->spill_len + len) > a->spill_cap) {
+		size_t new_cap = max_u64(a->spill_cap * 2, a->spill_len + len);
+		uint8_t *tmp = ghost_realloc(sheap, a->spill, new_cap);
+
+		if(tmp == NULL) {
+			return -1;
+		}
+
+		a->spill = tmp;
+		a->spill_cap = new_cap;
+	}
+
+	memcpy(a->spill + a->spill_off + a->spill_len, src, len);
+	a->spill_len += len;
+
+	return 0;
+}
+/*****************************************************************************/
+static int write_spill(struct gio_async *a, const uint8_t *src, size_t len)
+{
+	spill_drain(a);
+
+	/* once anything is spilled, new bytes queue up behind it so that
+	 * output order is preserved */
+	if(a->spill_len == 0) {
+		size_t n = ring_put(a, src, len);
+		src += n;
+		len -= n;
+	}
+
+	wake_writer(a);
+
+	if(len == 0) {
+		return 0;
+	} else if(spill_append(a, src, len) != 0) {
+		a->dropped += len;
+		return -1;
+	}
+
+	return 0;
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+struct gio_async *gio_async_start(int fd, int policy, size_t size)
+{
+	struct gio_async *a = ghost_malloc(sheap, sizeof(*a));
+
+	if(a == NULL) {
+		return NULL;
+	}
+
+	memset(a, 0, sizeof(*a));
+
+	a->fd = fd;
+	a->policy = policy;
+
+	if(circ_spsc_init(&a->ring, size) != 0) {
+		goto fail_1;
+	}
+
+	if(fake_thread_start(&a->thread, writer_main, a)) {
+		goto fail_2;
+	}
+
+	return a;
+fail_2:
+	circ_spsc_destroy(&a->ring);
+fail_1:
+	ghost_free(sheap, a);
+	return NULL;
+}
+/*****************************************************************************/
+ssize_t gio_async_write(struct gio_async *a, const void *src, size_t len)
+{
+	const uint8_t *bsrc = src;
+
+	if(__atomic_load_n(&a->werr, __ATOMIC_RELAXED)) {
+		return -1;
+	}
+
+	if(a->policy == GHOST_ASYNC_DROP) {
+		if(circ_spsc_capacity(&a->ring) < len) {
+			a->dropped += len;
+		} else {
+			ring_put(a, bsrc, len);
+			wake_writer(a);
+		}
+	} else if(a->policy == GHOST_ASYNC_SPILL) {
+		if(write_spill(a, bsrc, len) != 0) {
+			return -1;
+		}
+	} else {
+		write_blocking(a, bsrc, len);
+	}
+
+	return len;
+}
+/*****************************************************************************/
+size_t gio_async_dropped(const struct gio_async *a)
+{
+	return a->dropped;
+}
+/*****************************************************************************/
+int gio_async_stop(struct gio_async *a)
+{
+	int ret = 0;
+
+	while(a->spill_len != 0) {
+		write_blocking(a, a->spill + a->spill_off, a->spill_len);
+		a->spill_len = 0;
+	}
+
+	__atomic_store_n(&a->stop, 1, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&a->data_seq, 1, __ATOMIC_SEQ_CST);
+	safe_futex_wake(&a->data_seq, 1);
+
+	if(fake_thread_join(&a->thread) != 0) {
+		ret = -1;
+	}
+	if(a->werr) {
+		ret = -1;
+	}
+
+	circ_spsc_destroy(&a->ring);
+	ghost_free(sheap, a->spill);
+	ghost_free(sheap, a);
+
+	return ret;
+}
+/*****************************************************************************/
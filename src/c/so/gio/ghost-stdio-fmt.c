@@ -863,6 +863,8 @@ static int emit_uint(
 	temp[idx] = '\0';
 
 	if(val == 0) {
+		idx -= 1;
+		temp[idx] = '0';
 	} else {
 		while(val != 0) {
 			idx -= 1;
@@ -1257,7 +1259,7 @@ int ghost_sdprintf(
 	int ret = 0;
 
 	if(size == 0) {
-		assert(str == NULL);
+		assert(*str == NULL);
 
 		size = DYN_STR_INIT_LEN;
 		*str = ghost_malloc(sheap, size);
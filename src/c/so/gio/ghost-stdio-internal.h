@@ -22,6 +22,9 @@
 *                                  INCLUDES                                   *
 ******************************************************************************/
 #include <stdlib.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 #include <circ_buffer.h>
 /******************************************************************************
@@ -33,6 +36,7 @@
 #define GIO_FLAG_READ  (1 << 4)
 #define GIO_FLAG_WRITE (1 << 5)
 #define GIO_FLAG_OPEN  (1 << 6)
+#define GIO_FLAG_MMAP  (1 << 7)
 
 #define GIO_ERR_EOF      (1 << 1)
 #define GIO_ERR_BUFSIZ   (1 << 2)
@@ -41,11 +45,21 @@
 /******************************************************************************
 *                                    TYPES                                    *
 ******************************************************************************/
+struct gio_async;
+
 struct ghost_file {
 	int fd;
 	int flags;
 	int err;
 
+	struct gio_async *async;
+	/* bytes dropped by writer threads that have since been stopped */
+	size_t async_dropped;
+
+	const uint8_t *map;
+	size_t map_size;
+	size_t map_pos;
+
 	struct circ_buffer wb;
 	struct circ_buffer rb;
 
@@ -55,6 +69,14 @@ struct ghost_file {
 struct fmode {
 	int flags;
 	mode_t mode;
+	bool mmap;
 };
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+struct gio_async *gio_async_start(int fd, int policy, size_t size);
+ssize_t gio_async_write(struct gio_async *a, const void *src, size_t len);
+size_t gio_async_dropped(const struct gio_async *a);
+int gio_async_stop(struct gio_async *a);
 /*****************************************************************************/
 #endif /* GHOST_STDIO_INTERNAL_H */
@@ -34,6 +34,7 @@
 
 #include <limits.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
@@ -77,51 +78,55 @@ int rename(const char *old_path, const char *new_path);
 ******************************************************************************/
 static int interp_mode(const char *restrict mode, struct fmode *p)
 {
-	size_t len = 0;
-	while(mode[len] != '\0') {
-		if(len > 3) {
-			return -1;
-		}
-		len += 1;
-	}
+	bool plus = false;
+	bool binary = false;
 
-	char ch0 = mode[0];
-	char ch1 = len >= 2 ? mode[1] : '\0';
-	char ch2 = len >= 3 ? mode[2] : '\0';
+	p->mmap = false;
 
-	if((ch1 == 'b') && (ch2 == 'b')) {
+	if(mode[0] == '\0') {
 		return -1;
 	}
-	if(ch1 != 'b' && ch1 != '+' && ch1 != '\0') {
-		return -1;
+
+	/* 'm' is an extension: map regular files opened read only */
+	for(size_t i = 1; mode[i] != '\0'; i++) {
+		if(i > 3) {
+			return -1;
+		} else if(mode[i] == '+' && !plus) {
+			plus = true;
+		} else if(mode[i] == 'b' && !binary) {
+			binary = true;
+		} else if(mode[i] == 'm' && !p->mmap) {
+			p->mmap = true;
+		} else {
+			return -1;
+		}
 	}
-	if(ch2 != 'b' && ch2 != '+' && ch2 != '\0') {
+
+	if(p->mmap && (mode[0] != 'r' || plus)) {
 		return -1;
 	}
 
-	if(ch0 == 'r') {
-		if(ch1 == '+' || ch2 == '+') {
+	/* mode is the permission of a file created by the open(), as with
+	 * fopen() subject to the umask */
+	p->mode = 0666;
+
+	if(mode[0] == 'r') {
+		if(plus) {
 			p->flags = O_RDWR;
-			p->mode = 0;
 		} else {
 			p->flags = O_RDONLY;
-			p->mode = 0;
 		}
-	} else if(ch0 == 'w') {
-		if(ch1 == '+' || ch2 == '+') {
-			p->flags = O_RDWR;
-			p->mode = O_CREAT;
+	} else if(mode[0] == 'w') {
+		if(plus) {
+			p->flags = O_RDWR | O_CREAT | O_TRUNC;
 		} else {
-			p->flags = O_WRONLY;
-			p->mode = O_CREAT;
+			p->flags = O_WRONLY | O_CREAT | O_TRUNC;
 		}
-	} else if(ch0 == 'a') {
-		if(ch1 == '+' || ch2 == '+') {
-			p->flags = O_RDWR;
-			p->mode = O_CREAT | O_APPEND;
+	} else if(mode[0] == 'a') {
+		if(plus) {
+			p->flags = O_RDWR | O_CREAT | O_APPEND;
 		} else {
-			p->flags = O_WRONLY;
-			p->mode = O_CREAT | O_APPEND;
+			p->flags = O_WRONLY | O_CREAT | O_APPEND;
 		}
 	} else {
 		return -1;
@@ -143,6 +148,78 @@ static int get_rw_flags(struct fmode *mode)
 	}
 }
 /*****************************************************************************/
+static void map_file(struct ghost_file *file)
+{
+	struct stat sb;
+
+	/* anything which can't be mapped (pipes, ttys, empty files, ...)
+	 * quietly falls back to the buffered read path */
+	if(fstat(file->fd, &sb) != 0) {
+		return;
+	}
+	if(!S_ISREG(sb.st_mode) || sb.st_size == 0) {
+		return;
+	}
+
+	void *map = safe_mmap(
+		NULL, sb.st_size, PROT_READ, MAP_PRIVATE, file->fd, 0
+	);
+
+	if(map == MAP_FAILED) {
+		return;
+	}
+
+	file->map = map;
+	file->map_size = sb.st_size;
+	file->map_pos = 0;
+	file->flags |= GIO_FLAG_MMAP;
+}
+/*****************************************************************************/
+static void unmap_file(struct ghost_file *file)
+{
+	if(!(file->flags & GIO_FLAG_MMAP)) {
+		return;
+	}
+
+	safe_munmap((void*)file->map, file->map_size);
+
+	file->map = NULL;
+	file->map_size = 0;
+	file->flags &= ~GIO_FLAG_MMAP;
+}
+/*****************************************************************************/
+static size_t map_remaining(const struct ghost_file *f)
+{
+	return f->map_size - f->map_pos;
+}
+/*****************************************************************************/
+static size_t map_read(struct ghost_file *f, void *dst, size_t size)
+{
+	size_t n = min_u64(size, map_remaining(f));
+
+	memcpy(dst, f->map + f->map_pos, n);
+	f->map_pos += n;
+
+	if(n < size) {
+		f->err |= GIO_ERR_EOF;
+	}
+
+	return n;
+}
+/*****************************************************************************/
+static size_t map_read_line(struct ghost_file *f, char *dst, size_t size)
+{
+	const uint8_t *src = f->map + f->map_pos;
+	size_t n = min_u64(size, map_remaining(f));
+	const uint8_t *nl = memchr(src, '\n', n);
+
+	if(nl != NULL) {
+		n = (nl - src) + 1;
+	}
+
+	return map_read(f, dst, n);
+}
+/*****************************************************************************/
 static struct ghost_file *internal_ghost_fdopen_into(
 	int fd, struct fmode fmode, struct ghost_file *file
 ) {
@@ -188,6 +265,15 @@ static struct ghost_file *internal_ghost_fdopen_into(
 	}
 
 	file->err = 0;
+	file->async = NULL;
+	file->async_dropped = 0;
+	file->map = NULL;
+	file->map_size = 0;
+	file->map_pos = 0;
+
+	if(fmode.mmap) {
+		map_file(file);
+	}
 
 	if(safe_isatty(fd)) {
 		file->flags |= GIO_FLAG_LF;
@@ -223,6 +309,12 @@ static int read_to_fill_buffer(struct ghost_file *f)
 	uint8_t *wptr = circ_buffer_wptr(rb);
 	size_t wcount = circ_buffer_contig_wsize(rb);
 
+	if(f->flags & GIO_FLAG_MMAP) {
+		int r = map_read(f, wptr, wcount);
+		circ_buffer_increment_used(rb, r);
+		return r;
+	}
+
 	int r = read(f->fd, wptr, wcount);
 
 	if(r < 0) {
@@ -260,6 +352,15 @@ static int read_to_fill_buffer(struct ghost_file *f)
 	return total_read;
 }
 /*****************************************************************************/
+static ssize_t write_out(struct ghost_file *f, const void *src, size_t len)
+{
+	if(f->async != NULL) {
+		return gio_async_write(f->async, src, len);
+	} else {
+		return write(f->fd, src, len);
+	}
+}
+/*****************************************************************************/
 static int path_of_fd(int fd, char *path)
 {
 	size_t link_size = MAX_PROCID_STRLEN + sizeof(fd_link_prefix) + 1;
@@ -350,9 +451,11 @@ struct ghost_file *ghost_freopen(
 		if(new_fd < 0) {
 			return NULL;
 		}
+		unmap_file(f);
 		close(f->fd);
 		return internal_ghost_fdopen_into(new_fd, fmode, f);
 	} else {
+		unmap_file(f);
 		close(f->fd);
 		int new_fd = open(path, fmode.flags, fmode.mode);
 		if(new_fd < 0) {
@@ -369,6 +472,8 @@ int ghost_fclose(struct ghost_file *file)
 	}
 
 	ghost_fflush(file);
+	ghost_fasync(file, GHOST_ASYNC_OFF, 0);
+	unmap_file(file);
 
 	int ret = close(file->fd);
 
@@ -390,7 +495,7 @@ int ghost_fflush(struct ghost_file *file)
 		return 0;
 	}
 
-	int w = write(file->fd, rptr, w_len);
+	int w = write_out(file, rptr, w_len);
 
 	if(w < 0) {
 		return -1;
@@ -411,7 +516,7 @@ int ghost_fflush(struct ghost_file *file)
 
 	assert(rptr == file->wb.buf);
 
-	w = write(file->fd, rptr, w_len);
+	w = write_out(file, rptr, w_len);
 
 	if(w < 0) {
 		return -1;
@@ -492,13 +597,23 @@ int ghost_fgetc(struct ghost_file *f)
 		return -1;
 	}
 
-	char c;
+	uint8_t c;
 
 	if(circ_buffer_used(&f->rb) != 0) {
 		circ_buffer_read(&f->rb, &c, 1);
 		return c;
 	}
 
+	if(f->flags & GIO_FLAG_MMAP) {
+		if(map_remaining(f) == 0) {
+			f->err |= GIO_ERR_EOF;
+			return GHOST_EOF;
+		}
+		c = f->map[f->map_pos];
+		f->map_pos += 1;
+		return c;
+	}
+
 	uint8_t *wptr = circ_buffer_wptr(&f->rb);
 	size_t rcount = circ_buffer_contig_wsize(&f->rb);
 
@@ -526,6 +641,9 @@ void ghost_stdio_cleanup(void)
 {
 	ghost_fflush(ghost_stdout);
 	ghost_fflush(ghost_stderr);
+
+	ghost_fasync(ghost_stdout, GHOST_ASYNC_OFF, 0);
+	ghost_fasync(ghost_stderr, GHOST_ASYNC_OFF, 0);
 }
 /*****************************************************************************/
 size_t ghost_fread(
@@ -547,6 +665,26 @@ size_t ghost_fread(
 		return circ_buffer_read(&f->rb, dst, total);
 	}
 
+	if(f->flags & GIO_FLAG_MMAP) {
+		size_t avail = pre_buffed + map_remaining(f);
+		size_t n = align_down_unsigned(min_u64(total, avail), size);
+
+		if(n < total) {
+			f->err |= GIO_ERR_EOF;
+		}
+		if(n == 0) {
+			return 0;
+		}
+
+		/* pushed back bytes beyond the last whole item stay buffered */
+		size_t from_rb = min_u64(n, pre_buffed);
+
+		circ_buffer_read(&f->rb, dst, from_rb);
+		map_read(f, ((uint8_t*)dst) + from_rb, n - from_rb);
+
+		return n / size;
+	}
+
 	if(f->rb.buf_size < (size - 1)) {
 		f->err |= GIO_ERR_BUFSIZ;
 		return 0;
@@ -624,7 +762,7 @@ size_t ghost_fwrite(
 	uint8_t *bsrc = (uint8_t*)src;
 
 	if(!(f->flags & GIO_FLAG_BUF)) {
-		int w = write(f->fd, src, total);
+		int w = write_out(f, src, total);
 		if(w < 0) {
 			f->err |= GIO_ERR_IOERR;
 			return 0;
@@ -670,7 +808,7 @@ size_t ghost_fwrite(
 			flush_count,
 			circ_buffer_contig_rsize(&f->wb)
 		);
-		int w = write(f->fd, circ_buffer_rptr(&f->wb), wcount);
+		int w = write_out(f, circ_buffer_rptr(&f->wb), wcount);
 
 		if(w < 0) {
 			f->err |= GIO_ERR_IOERR;
@@ -710,6 +848,28 @@ int ghost_fseek(struct ghost_file *f, long offset, int whence)
 
 	off_t ret;
 
+	if(f->flags & GIO_FLAG_MMAP) {
+		if(whence == GHOST_SEEK_SET || whence == SEEK_SET) {
+			ret = offset;
+		} else if(whence == GHOST_SEEK_CUR || whence == SEEK_CUR) {
+			ret = ghost_ftell(f) + offset;
+		} else if(whence == GHOST_SEEK_END || whence == SEEK_END) {
+			ret = f->map_size + offset;
+		} else {
+			return -1;
+		}
+
+		if(ret < 0) {
+			return -1;
+		}
+
+		f->map_pos = min_u64(ret, f->map_size);
+		f->err &= ~GIO_ERR_EOF;
+		circ_buffer_clear(&f->rb);
+
+		return 0;
+	}
+
 	if(whence == GHOST_SEEK_SET) {
 		ret = lseek(f->fd, offset, SEEK_SET);
 	} else if(whence == GHOST_SEEK_CUR) {
@@ -733,6 +893,10 @@ long ghost_ftell(struct ghost_file *f)
 	size_t rbuf = circ_buffer_used(&f->rb);
 	size_t wbuf = circ_buffer_used(&f->wb);
 
+	if(f->flags & GIO_FLAG_MMAP) {
+		return f->map_pos - rbuf;
+	}
+
 	assert((rbuf != 0) && (wbuf != 0));
 
 	off_t off = lseek(f->fd, 0, SEEK_CUR);
@@ -765,6 +929,10 @@ char *ghost_fgets(char *restrict s, int size, struct ghost_file *restrict f)
 				goto end;
 			}
 		}
+		if(f->flags & GIO_FLAG_MMAP) {
+			idx += map_read_line(f, s + idx, size - 1 - idx);
+			goto end;
+		}
 		int r = read_to_fill_buffer(f);
 		if(r <= 0) {
 			goto end;
@@ -775,6 +943,26 @@ end:
 	return idx == 0 ? NULL : s;
 }
 /*****************************************************************************/
+const void *ghost_fview(struct ghost_file *f, size_t max, size_t *len)
+{
+	/* bytes pushed back with ungetc() live in the read buffer, so the
+	 * caller has to pick those up with ghost_fread() first */
+	if(!(f->flags & GIO_FLAG_MMAP) || circ_buffer_used(&f->rb) != 0) {
+		return NULL;
+	}
+
+	const void *view = f->map + f->map_pos;
+
+	*len = min_u64(max, map_remaining(f));
+	f->map_pos += *len;
+
+	if(*len == 0) {
+		f->err |= GIO_ERR_EOF;
+	}
+
+	return view;
+}
+/*****************************************************************************/
 char *ghost_tmpnam(char *s)
 {
 	struct drand48_data rng;
@@ -820,6 +1008,42 @@ int ghost_rename(const char *old, const char *new)
 	return rename(old, new);
 }
 /*****************************************************************************/
+int ghost_fasync(struct ghost_file *f, int policy, size_t size)
+{
+	if(f->async != NULL) {
+		struct gio_async *old = f->async;
+
+		ghost_fflush(f);
+		f->async = NULL;
+		f->async_dropped += gio_async_dropped(old);
+
+		if(gio_async_stop(old) != 0) {
+			f->err |= GIO_ERR_IOERR;
+		}
+	}
+
+	if(policy == GHOST_ASYNC_OFF) {
+		return 0;
+	}
+	if(!(f->flags & GIO_FLAG_WRITE)) {
+		f->err |= GIO_ERR_BAD_MODE;
+		return -1;
+	}
+
+	ghost_fflush(f);
+
+	f->async = gio_async_start(f->fd, policy, size);
+
+	return f->async == NULL ? -1 : 0;
+}
+/*****************************************************************************/
+size_t ghost_fasync_dropped(struct ghost_file *f)
+{
+	size_t live = f->async == NULL ? 0 : gio_async_dropped(f->async);
+
+	return f->async_dropped + live;
+}
+/*****************************************************************************/
 void ghost_stdio_init(void)
 {
 	ghost_stdin = ghost_fdopen(0, "r");
@@ -36,6 +36,13 @@
 #define GHOST_SEEK_END -3
 
 #define GHOST_IO_BUF_SIZE 2048
+
+#define GHOST_ASYNC_OFF   0
+#define GHOST_ASYNC_BLOCK 1
+#define GHOST_ASYNC_DROP  2
+#define GHOST_ASYNC_SPILL 3
+
+#define GHOST_ASYNC_BUF_SIZE (1 << 20)
 /******************************************************************************
 *                                    TYPES                                    *
 ******************************************************************************/
@@ -108,7 +115,10 @@ int ghost_ferror(struct ghost_file *restrict f);
 int ghost_fseek(struct ghost_file *f, long offset, int whence);
 long ghost_ftell(struct ghost_file *f);
 char *ghost_fgets(char *restrict s, int size, struct ghost_file *restrict f);
+const void *ghost_fview(struct ghost_file *f, size_t max, size_t *len);
 char *ghost_tmpnam(char *s);
+int ghost_fasync(struct ghost_file *f, int policy, size_t size);
+size_t ghost_fasync_dropped(struct ghost_file *f);
 int ghost_remove(const char *path);
 int ghost_rename(const char *old, const char *new);
 /*****************************************************************************/
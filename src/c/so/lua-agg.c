@@ -0,0 +1,948 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "lua-agg.h"
+
+#include <lua-shared.h>
+#include <gio/ghost-stdio.h>
+#include <lua/lua.h>
+#include <lua/lauxlib.h>
+#include <utl/math-utl.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+/* columns of '@' for the fullest bucket of a printed histogram */
+#define HIST_BAR_WIDTH 40
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+enum key_kind {
+	KEY_EMPTY,
+	KEY_INT,
+	KEY_STR
+};
+/*****************************************************************************/
+/* An integer or string key, kept inline so that slots can live in one flat
+ * array. Integers are kept as their 8 bytes. */
+struct agg_key {
+	uint64_t hash;
+	uint8_t kind;
+	uint8_t len;
+	char bytes[LUA_AGG_KEY_MAX];
+};
+/*****************************************************************************/
+struct counter_slot {
+	struct agg_key key;
+	int64_t count;
+};
+/*****************************************************************************/
+/* An open addressed table at most half full, keys that turn up once it
+ * holds cap of them are only counted as dropped. */
+struct agg_counter {
+	uint32_t cap;
+	uint32_t mask;
+	uint32_t used;
+	uint64_t dropped;
+	struct counter_slot slots[];
+};
+/*****************************************************************************/
+struct topk_slot {
+	struct agg_key key;
+	int64_t count;
+	/* how much of count may have belonged to keys evicted before it */
+	int64_t err;
+};
+/*****************************************************************************/
+/* The space saving sketch: k keys with their counts, a key that is not among
+ * them takes over the one with the smallest count and carries that count on
+ * as its error. Any key seen more than total / k times is always held. */
+struct agg_topk {
+	uint32_t k;
+	uint32_t used;
+	uint32_t mask;
+	struct topk_slot *slots;
+	/* slot numbers, a min heap on their counts */
+	uint32_t *heap;
+	/* where each slot is in the heap */
+	uint32_t *pos;
+	/* slot number + 1 by the key's hash, 0 where free */
+	uint32_t *index;
+};
+/*****************************************************************************/
+enum hist_kind {
+	HIST_LOG2,
+	HIST_LINEAR
+};
+/*****************************************************************************/
+struct agg_hist {
+	enum hist_kind kind;
+	/* for linear histograms, bucket 0 is below min and the last bucket
+	 * everything from min + (nbuckets - 2) * step on */
+	int64_t min;
+	int64_t step;
+	uint32_t nbuckets;
+	uint64_t count;
+	int64_t sum;
+	uint64_t buckets[];
+};
+/*****************************************************************************/
+/* a key and its count, gathered up for sorting */
+struct agg_entry {
+	const struct agg_key *key;
+	int64_t count;
+	int64_t err;
+};
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const char LUA_COUNTER_F[] = "LT_counter";
+static const char LUA_HIST_F[] = "LT_hist";
+static const char LUA_TOPK_F[] = "LT_topk";
+
+static const char COUNTER_MT[] = "LT_counter";
+static const char HIST_MT[] = "LT_hist";
+static const char TOPK_MT[] = "LT_topk";
+
+static const char *const HIST_KINDS[] = {"log2", "linear", NULL};
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static uint64_t hash_key(const struct agg_key *key)
+{
+	uint64_t h = 0xCBF29CE484222325ULL ^ key->kind;
+
+	for(unsigned i = 0; i < key->len; i++) {
+		h ^= (uint8_t)key->bytes[i];
+		h *= 0x100000001B3ULL;
+	}
+
+	/* fnv spreads the low bits poorly, and those pick the slot */
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+
+	return h;
+}
+/*****************************************************************************/
+static void check_key(lua_State *ls, int arg, struct agg_key *key)
+{
+	if(lua_isinteger(ls, arg)) {
+		lua_Integer i = lua_tointeger(ls, arg);
+
+		key->kind = KEY_INT;
+		key->len = sizeof(i);
+		memcpy(key->bytes, &i, sizeof(i));
+	} else if(lua_type(ls, arg) == LUA_TSTRING) {
+		size_t len = 0;
+		const char *s = lua_tolstring(ls, arg, &len);
+
+		/* cut short, distinct keys would be counted as one */
+		luaL_argcheck(ls, len <= LUA_AGG_KEY_MAX, arg, "key too long");
+
+		key->kind = KEY_STR;
+		key->len = len;
+		memcpy(key->bytes, s, len);
+	} else {
+		luaL_typeerror(ls, arg, "integer or string");
+	}
+
+	key->hash = hash_key(key);
+}
+/*****************************************************************************/
+static bool key_eq(const struct agg_key *a, const struct agg_key *b)
+{
+	return (a->hash == b->hash) && (a->kind == b->kind) &&
+		(a->len == b->len) && (memcmp(a->bytes, b->bytes, a->len) == 0);
+}
+/*****************************************************************************/
+static void push_key(lua_State *ls, const struct agg_key *key)
+{
+	if(key->kind == KEY_INT) {
+		lua_Integer i;
+
+		memcpy(&i, key->bytes, sizeof(i));
+		lua_pushinteger(ls, i);
+	} else {
+		lua_pushlstring(ls, key->bytes, key->len);
+	}
+}
+/*****************************************************************************/
+/* a power of two at least twice n, so a table of that many slots holding n
+ * keys always has a free one to stop a probe */
+static uint32_t table_size(uint32_t n)
+{
+	uint32_t size = 1;
+
+	while(size < 2 * n) {
+		size <<= 1;
+	}
+
+	return size;
+}
+/*****************************************************************************/
+static void sort_entries(struct agg_entry *e, size_t n)
+{
+	/* shell sort, libc's qsort may allocate from the target's heap */
+	static const size_t GAPS[] = {
+		19930, 8858, 3937, 1750, 701, 301, 132, 57, 23, 10, 4, 1
+	};
+
+	for(size_t g = 0; g < sizeof(GAPS) / sizeof(GAPS[0]); g++) {
+		size_t gap = GAPS[g];
+
+		for(size_t i = gap; i < n; i++) {
+			struct agg_entry tmp = e[i];
+			size_t j = i;
+
+			while((j >= gap) && (e[j - gap].count < tmp.count)) {
+				e[j] = e[j - gap];
+				j -= gap;
+			}
+
+			e[j] = tmp;
+		}
+	}
+}
+/*****************************************************************************/
+static struct agg_entry *push_entries(lua_State *ls, size_t n)
+{
+	/* scratch space from the state's heap, left on the stack until the
+	 * caller returns */
+	return lua_newuserdatauv(ls, n * sizeof(struct agg_entry), 0);
+}
+/*****************************************************************************/
+static void print_entries(const struct agg_entry *e, size_t n, size_t limit)
+{
+	for(size_t i = 0; i < min_u64(n, limit); i++) {
+		const struct agg_key *key = e[i].key;
+
+		if(key->kind == KEY_INT) {
+			int64_t k;
+
+			memcpy(&k, key->bytes, sizeof(k));
+			ghost_fprintf(ghost_stdout, "%lld", (long long)k);
+		} else {
+			ghost_fwrite(key->bytes, 1, key->len, ghost_stdout);
+		}
+
+		ghost_fprintf(
+			ghost_stdout, ": %lld\n", (long long)e[i].count
+		);
+	}
+}
+/*****************************************************************************/
+static size_t opt_limit(lua_State *ls, int arg)
+{
+	lua_Integer limit = luaL_optinteger(ls, arg, LUA_MAXINTEGER);
+
+	luaL_argcheck(ls, limit >= 0, arg, "negative limit");
+
+	return limit;
+}
+/*****************************************************************************/
+static struct counter_slot *counter_find(
+	struct agg_counter *c, const struct agg_key *key
+) {
+	uint32_t i = key->hash & c->mask;
+
+	for(;;) {
+		struct counter_slot *s = c->slots + i;
+
+		if((s->key.kind == KEY_EMPTY) || key_eq(&s->key, key)) {
+			return s;
+		}
+
+		i = (i + 1) & c->mask;
+	}
+}
+/*****************************************************************************/
+static int luaf_lt_counter(lua_State *ls)
+{
+	lua_Integer cap = luaL_optinteger(ls, 1, LUA_AGG_COUNTER_DEFAULT);
+
+	luaL_argcheck(
+		ls, (cap > 0) && (cap <= LUA_AGG_COUNTER_MAX), 1, "bad capacity"
+	);
+
+	uint32_t size = table_size(cap);
+	struct agg_counter *c = lua_newuserdatauv(
+		ls, sizeof(*c) + size * sizeof(c->slots[0]), 0
+	);
+
+	memset(c, 0, sizeof(*c) + size * sizeof(c->slots[0]));
+	c->cap = cap;
+	c->mask = size - 1;
+	luaL_setmetatable(ls, COUNTER_MT);
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_counter_add(lua_State *ls)
+{
+	struct agg_counter *c = luaL_checkudata(ls, 1, COUNTER_MT);
+	lua_Integer n = luaL_optinteger(ls, 3, 1);
+	struct agg_key key;
+
+	check_key(ls, 2, &key);
+
+	struct counter_slot *s = counter_find(c, &key);
+
+	if((s->key.kind == KEY_EMPTY) && (c->used == c->cap)) {
+		c->dropped += n;
+		lua_pushnil(ls);
+		return 1;
+	} else if(s->key.kind == KEY_EMPTY) {
+		s->key = key;
+		c->used += 1;
+	}
+
+	s->count += n;
+	lua_pushinteger(ls, s->count);
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_counter_get(lua_State *ls)
+{
+	struct agg_counter *c = luaL_checkudata(ls, 1, COUNTER_MT);
+	struct agg_key key;
+
+	check_key(ls, 2, &key);
+	lua_pushinteger(ls, counter_find(c, &key)->count);
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_counter_dropped(lua_State *ls)
+{
+	struct agg_counter *c = luaL_checkudata(ls, 1, COUNTER_MT);
+
+	lua_pushinteger(ls, c->dropped);
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_counter_snapshot(lua_State *ls)
+{
+	struct agg_counter *c = luaL_checkudata(ls, 1, COUNTER_MT);
+
+	lua_createtable(ls, 0, c->used);
+
+	for(uint32_t i = 0; i <= c->mask; i++) {
+		const struct counter_slot *s = c->slots + i;
+
+		if(s->key.kind != KEY_EMPTY) {
+			push_key(ls, &s->key);
+			lua_pushinteger(ls, s->count);
+			lua_rawset(ls, -3);
+		}
+	}
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_counter_print(lua_State *ls)
+{
+	struct agg_counter *c = luaL_checkudata(ls, 1, COUNTER_MT);
+	size_t limit = opt_limit(ls, 2);
+	struct agg_entry *e = push_entries(ls, c->used);
+	size_t n = 0;
+
+	for(uint32_t i = 0; i <= c->mask; i++) {
+		const struct counter_slot *s = c->slots + i;
+
+		if(s->key.kind != KEY_EMPTY) {
+			e[n].key = &s->key;
+			e[n].count = s->count;
+			n += 1;
+		}
+	}
+
+	sort_entries(e, n);
+	print_entries(e, n, limit);
+
+	if(c->dropped != 0) {
+		ghost_fprintf(
+			ghost_stdout,
+			"(%llu dropped)\n",
+			(unsigned long long)c->dropped
+		);
+	}
+
+	lua_writeline();
+
+	return 0;
+}
+/*****************************************************************************/
+static int luaf_counter_clear(lua_State *ls)
+{
+	struct agg_counter *c = luaL_checkudata(ls, 1, COUNTER_MT);
+
+	memset(c->slots, 0, (c->mask + 1) * sizeof(c->slots[0]));
+	c->used = 0;
+	c->dropped = 0;
+
+	return 0;
+}
+/*****************************************************************************/
+static bool heap_less(const struct agg_topk *t, uint32_t a, uint32_t b)
+{
+	return t->slots[t->heap[a]].count < t->slots[t->heap[b]].count;
+}
+/*****************************************************************************/
+static void heap_swap(struct agg_topk *t, uint32_t a, uint32_t b)
+{
+	uint32_t tmp = t->heap[a];
+
+	t->heap[a] = t->heap[b];
+	t->heap[b] = tmp;
+	t->pos[t->heap[a]] = a;
+	t->pos[t->heap[b]] = b;
+}
+/*****************************************************************************/
+static void heap_up(struct agg_topk *t, uint32_t i)
+{
+	while(i > 0) {
+		uint32_t parent = (i - 1) / 2;
+
+		if(!heap_less(t, i, parent)) {
+			return;
+		}
+
+		heap_swap(t, i, parent);
+		i = parent;
+	}
+}
+/*****************************************************************************/
+static void heap_down(struct agg_topk *t, uint32_t i)
+{
+	for(;;) {
+		uint32_t l = 2 * i + 1;
+		uint32_t r = l + 1;
+		uint32_t m = i;
+
+		if((l < t->used) && heap_less(t, l, m)) {
+			m = l;
+		}
+		if((r < t->used) && heap_less(t, r, m)) {
+			m = r;
+		}
+		if(m == i) {
+			return;
+		}
+
+		heap_swap(t, i, m);
+		i = m;
+	}
+}
+/*****************************************************************************/
+/* where key is in the index, or the free entry it would go into */
+static uint32_t topk_find(const struct agg_topk *t, const struct agg_key *key)
+{
+	uint32_t i = key->hash & t->mask;
+
+	while(t->index[i] != 0) {
+		if(key_eq(&t->slots[t->index[i] - 1].key, key)) {
+			break;
+		}
+
+		i = (i + 1) & t->mask;
+	}
+
+	return i;
+}
+/*****************************************************************************/
+static void topk_unindex(struct agg_topk *t, uint32_t i)
+{
+	uint32_t j = i;
+
+	/* shifts back whatever probed past i, so no probe stops early */
+	for(;;) {
+		j = (j + 1) & t->mask;
+
+		if(t->index[j] == 0) {
+			break;
+		}
+
+		uint32_t home = t->slots[t->index[j] - 1].key.hash & t->mask;
+
+		if(((j - home) & t->mask) >= ((j - i) & t->mask)) {
+			t->index[i] = t->index[j];
+			i = j;
+		}
+	}
+
+	t->index[i] = 0;
+}
+/*****************************************************************************/
+static int luaf_lt_topk(lua_State *ls)
+{
+	lua_Integer k = luaL_checkinteger(ls, 1);
+
+	luaL_argcheck(ls, (k > 0) && (k <= LUA_AGG_TOPK_MAX), 1, "bad k");
+
+	uint32_t size = table_size(k);
+	size_t slots_size = k * sizeof(struct topk_slot);
+	size_t total = sizeof(struct agg_topk) + slots_size +
+		(2 * k + size) * sizeof(uint32_t);
+	struct agg_topk *t = lua_newuserdatauv(ls, total, 0);
+
+	memset(t, 0, total);
+	t->k = k;
+	t->mask = size - 1;
+	t->slots = (struct topk_slot*)(t + 1);
+	t->heap = (uint32_t*)((char*)t->slots + slots_size);
+	t->pos = t->heap + k;
+	t->index = t->pos + k;
+	luaL_setmetatable(ls, TOPK_MT);
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_topk_add(lua_State *ls)
+{
+	struct agg_topk *t = luaL_checkudata(ls, 1, TOPK_MT);
+	lua_Integer n = luaL_optinteger(ls, 3, 1);
+	struct agg_key key;
+	struct topk_slot *s;
+
+	check_key(ls, 2, &key);
+	luaL_argcheck(ls, n > 0, 3, "must be positive");
+
+	uint32_t i = topk_find(t, &key);
+
+	if(t->index[i] != 0) {
+		uint32_t sn = t->index[i] - 1;
+
+		s = t->slots + sn;
+		s->count += n;
+		heap_down(t, t->pos[sn]);
+	} else if(t->used < t->k) {
+		uint32_t sn = t->used++;
+
+		s = t->slots + sn;
+		s->key = key;
+		s->count = n;
+		s->err = 0;
+		t->index[i] = sn + 1;
+		t->heap[sn] = sn;
+		t->pos[sn] = sn;
+		heap_up(t, sn);
+	} else {
+		uint32_t sn = t->heap[0];
+
+		s = t->slots + sn;
+		topk_unindex(t, topk_find(t, &s->key));
+		s->key = key;
+		s->err = s->count;
+		s->count += n;
+		t->index[topk_find(t, &key)] = sn + 1;
+		heap_down(t, 0);
+	}
+
+	lua_pushinteger(ls, s->count);
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_topk_get(lua_State *ls)
+{
+	struct agg_topk *t = luaL_checkudata(ls, 1, TOPK_MT);
+	struct agg_key key;
+
+	check_key(ls, 2, &key);
+
+	uint32_t i = topk_find(t, &key);
+
+	if(t->index[i] == 0) {
+		lua_pushinteger(ls, 0);
+		lua_pushinteger(ls, 0);
+	} else {
+		const struct topk_slot *s = t->slots + t->index[i] - 1;
+
+		lua_pushinteger(ls, s->count);
+		lua_pushinteger(ls, s->err);
+	}
+
+	return 2;
+}
+/*****************************************************************************/
+static struct agg_entry *topk_entries(lua_State *ls, struct agg_topk *t)
+{
+	struct agg_entry *e = push_entries(ls, t->used);
+
+	for(uint32_t i = 0; i < t->used; i++) {
+		e[i].key = &t->slots[i].key;
+		e[i].count = t->slots[i].count;
+		e[i].err = t->slots[i].err;
+	}
+
+	sort_entries(e, t->used);
+
+	return e;
+}
+/*****************************************************************************/
+static int luaf_topk_snapshot(lua_State *ls)
+{
+	struct agg_topk *t = luaL_checkudata(ls, 1, TOPK_MT);
+	struct agg_entry *e = topk_entries(ls, t);
+
+	/* { {key, count, err}, ... } with the largest count first */
+	lua_createtable(ls, t->used, 0);
+
+	for(uint32_t i = 0; i < t->used; i++) {
+		lua_createtable(ls, 3, 0);
+		push_key(ls, e[i].key);
+		lua_rawseti(ls, -2, 1);
+		lua_pushinteger(ls, e[i].count);
+		lua_rawseti(ls, -2, 2);
+		lua_pushinteger(ls, e[i].err);
+		lua_rawseti(ls, -2, 3);
+		lua_rawseti(ls, -2, i + 1);
+	}
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_topk_print(lua_State *ls)
+{
+	struct agg_topk *t = luaL_checkudata(ls, 1, TOPK_MT);
+	size_t limit = opt_limit(ls, 2);
+	struct agg_entry *e = topk_entries(ls, t);
+
+	print_entries(e, t->used, limit);
+	lua_writeline();
+
+	return 0;
+}
+/*****************************************************************************/
+static int luaf_topk_clear(lua_State *ls)
+{
+	struct agg_topk *t = luaL_checkudata(ls, 1, TOPK_MT);
+
+	memset(t->index, 0, (t->mask + 1) * sizeof(t->index[0]));
+	t->used = 0;
+
+	return 0;
+}
+/*****************************************************************************/
+/* min + n * step, held at the largest integer rather than wrapping */
+static int64_t linear_edge(const struct agg_hist *h, uint64_t n)
+{
+	int64_t off;
+	int64_t edge;
+
+	if(
+		__builtin_mul_overflow(n, h->step, &off) ||
+		__builtin_add_overflow(h->min, off, &edge)
+	) {
+		return INT64_MAX;
+	}
+
+	return edge;
+}
+/*****************************************************************************/
+static unsigned hist_bucket(const struct agg_hist *h, int64_t v)
+{
+	if(h->kind == HIST_LOG2) {
+		return lua_shared_bucket(v);
+	} else if(v < h->min) {
+		return 0;
+	}
+
+	uint64_t i = ((uint64_t)v - (uint64_t)h->min) / h->step;
+
+	return (i >= h->nbuckets - 2) ? h->nbuckets - 1 : i + 1;
+}
+/*****************************************************************************/
+/* lo is inclusive and hi exclusive, open ends are the smallest and largest
+ * integers */
+static void hist_range(
+	const struct agg_hist *h, unsigned i, int64_t *lo, int64_t *hi
+) {
+	if(h->kind == HIST_LOG2) {
+		*lo = (i == 0) ? INT64_MIN : (int64_t)1 << (i - 1);
+		*hi = (i == 0) ? 1 : (i == h->nbuckets - 1) ?
+			INT64_MAX : (int64_t)1 << i;
+	} else if(i == 0) {
+		*lo = INT64_MIN;
+		*hi = h->min;
+	} else {
+		*lo = linear_edge(h, i - 1);
+		*hi = (i == h->nbuckets - 1) ? INT64_MAX : linear_edge(h, i);
+	}
+}
+/*****************************************************************************/
+static int hist_label(char *buf, size_t size, int64_t lo, int64_t hi)
+{
+	if(lo == INT64_MIN) {
+		return ghost_snprintf(buf, size, "(..., %lld)", (long long)hi);
+	} else if(hi == INT64_MAX) {
+		return ghost_snprintf(buf, size, "[%lld, ...)", (long long)lo);
+	}
+
+	return ghost_snprintf(
+		buf, size, "[%lld, %lld)", (long long)lo, (long long)hi
+	);
+}
+/*****************************************************************************/
+static int luaf_lt_hist(lua_State *ls)
+{
+	int kind = luaL_checkoption(ls, 1, "log2", HIST_KINDS);
+	int64_t min = 0;
+	int64_t step = 1;
+	uint32_t nbuckets = LUA_SHARED_BUCKETS;
+
+	if(kind == HIST_LINEAR) {
+		int64_t max = luaL_checkinteger(ls, 3);
+
+		min = luaL_checkinteger(ls, 2);
+		step = luaL_checkinteger(ls, 4);
+
+		luaL_argcheck(ls, max > min, 3, "must be above min");
+		luaL_argcheck(ls, step > 0, 4, "must be positive");
+
+		uint64_t span = (uint64_t)max - (uint64_t)min;
+		uint64_t n = DIV_ROUND_UP(span, (uint64_t)step);
+
+		luaL_argcheck(
+			ls, n <= LUA_AGG_LINEAR_MAX, 4, "too many buckets"
+		);
+
+		/* and one each for below and above the range */
+		nbuckets = n + 2;
+	}
+
+	size_t size = sizeof(struct agg_hist) + nbuckets * sizeof(uint64_t);
+	struct agg_hist *h = lua_newuserdatauv(ls, size, 0);
+
+	memset(h, 0, size);
+	h->kind = kind;
+	h->min = min;
+	h->step = step;
+	h->nbuckets = nbuckets;
+	luaL_setmetatable(ls, HIST_MT);
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_hist_add(lua_State *ls)
+{
+	struct agg_hist *h = luaL_checkudata(ls, 1, HIST_MT);
+	lua_Integer v = luaL_checkinteger(ls, 2);
+	lua_Integer n = luaL_optinteger(ls, 3, 1);
+
+	luaL_argcheck(ls, n > 0, 3, "must be positive");
+
+	h->buckets[hist_bucket(h, v)] += n;
+	h->count += n;
+	h->sum = sat_add_mul_i64(h->sum, v, n);
+
+	return 0;
+}
+/*****************************************************************************/
+static int luaf_hist_count(lua_State *ls)
+{
+	struct agg_hist *h = luaL_checkudata(ls, 1, HIST_MT);
+
+	lua_pushinteger(ls, h->count);
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_hist_sum(lua_State *ls)
+{
+	struct agg_hist *h = luaL_checkudata(ls, 1, HIST_MT);
+
+	lua_pushinteger(ls, h->sum);
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_hist_snapshot(lua_State *ls)
+{
+	struct agg_hist *h = luaL_checkudata(ls, 1, HIST_MT);
+	lua_Integer n = 0;
+
+	/* the same { {lo, hi, count}, ... } as LT_shared_hist */
+	lua_newtable(ls);
+
+	for(unsigned i = 0; i < h->nbuckets; i++) {
+		int64_t lo;
+		int64_t hi;
+
+		if(h->buckets[i] == 0) {
+			continue;
+		}
+
+		hist_range(h, i, &lo, &hi);
+
+		lua_createtable(ls, 3, 0);
+		lua_pushinteger(ls, lo);
+		lua_rawseti(ls, -2, 1);
+		lua_pushinteger(ls, hi);
+		lua_rawseti(ls, -2, 2);
+		lua_pushinteger(ls, h->buckets[i]);
+		lua_rawseti(ls, -2, 3);
+		lua_rawseti(ls, -2, ++n);
+	}
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_hist_print(lua_State *ls)
+{
+	struct agg_hist *h = luaL_checkudata(ls, 1, HIST_MT);
+	unsigned first = h->nbuckets;
+	unsigned last = 0;
+	uint64_t most = 0;
+	int width = 0;
+	char label[64];
+	char bar[HIST_BAR_WIDTH + 1];
+
+	for(unsigned i = 0; i < h->nbuckets; i++) {
+		if(h->buckets[i] != 0) {
+			first = (first == h->nbuckets) ? i : first;
+			last = i;
+			most = max_u64(most, h->buckets[i]);
+		}
+	}
+
+	/* every bucket from the first used to the last, empty or not, so
+	 * the shape shows */
+	for(unsigned i = first; i <= last && first != h->nbuckets; i++) {
+		int64_t lo;
+		int64_t hi;
+
+		hist_range(h, i, &lo, &hi);
+		width = max_u64(
+			width, hist_label(label, sizeof(label), lo, hi)
+		);
+	}
+
+	for(unsigned i = first; i <= last && first != h->nbuckets; i++) {
+		int64_t lo;
+		int64_t hi;
+		uint64_t c = h->buckets[i];
+		size_t ats = (c * HIST_BAR_WIDTH) / most;
+
+		hist_range(h, i, &lo, &hi);
+
+		/* padded here, ghost_fprintf mishandles '*' widths */
+		int len = hist_label(label, sizeof(label), lo, hi);
+
+		memset(label + len, ' ', width - len);
+		label[width] = '\0';
+
+		memset(bar, '@', ats);
+		memset(bar + ats, ' ', HIST_BAR_WIDTH - ats);
+		bar[HIST_BAR_WIDTH] = '\0';
+
+		ghost_fprintf(
+			ghost_stdout,
+			"%s %10llu |%s|\n",
+			label,
+			(unsigned long long)c,
+			bar
+		);
+	}
+
+	lua_writeline();
+
+	return 0;
+}
+/*****************************************************************************/
+static int luaf_hist_clear(lua_State *ls)
+{
+	struct agg_hist *h = luaL_checkudata(ls, 1, HIST_MT);
+
+	memset(h->buckets, 0, h->nbuckets * sizeof(h->buckets[0]));
+	h->count = 0;
+	h->sum = 0;
+
+	return 0;
+}
+/*****************************************************************************/
+static void setup_mt(lua_State *ls, const char *mt, const luaL_Reg *methods)
+{
+	luaL_newmetatable(ls, mt);
+	lua_newtable(ls);
+	luaL_setfuncs(ls, methods, 0);
+	lua_setfield(ls, -2, "__index");
+	lua_pop(ls, 1);
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+void lua_agg_setup(lua_State *ls)
+{
+	static const luaL_Reg counter_methods[] = {
+		{"add", luaf_counter_add},
+		{"get", luaf_counter_get},
+		{"dropped", luaf_counter_dropped},
+		{"snapshot", luaf_counter_snapshot},
+		{"print", luaf_counter_print},
+		{"clear", luaf_counter_clear},
+		{NULL, NULL}
+	};
+	static const luaL_Reg hist_methods[] = {
+		{"add", luaf_hist_add},
+		{"count", luaf_hist_count},
+		{"sum", luaf_hist_sum},
+		{"snapshot", luaf_hist_snapshot},
+		{"print", luaf_hist_print},
+		{"clear", luaf_hist_clear},
+		{NULL, NULL}
+	};
+	static const luaL_Reg topk_methods[] = {
+		{"add", luaf_topk_add},
+		{"get", luaf_topk_get},
+		{"snapshot", luaf_topk_snapshot},
+		{"print", luaf_topk_print},
+		{"clear", luaf_topk_clear},
+		{NULL, NULL}
+	};
+
+	setup_mt(ls, COUNTER_MT, counter_methods);
+	setup_mt(ls, HIST_MT, hist_methods);
+	setup_mt(ls, TOPK_MT, topk_methods);
+
+	lua_register(ls, LUA_COUNTER_F, luaf_lt_counter);
+	lua_register(ls, LUA_HIST_F, luaf_lt_hist);
+	lua_register(ls, LUA_TOPK_F, luaf_lt_topk);
+}
+/*****************************************************************************/
+void lua_agg_wrap_print(lua_State *ls, lua_CFunction wrap)
+{
+	static const char *const MTS[] = {COUNTER_MT, HIST_MT, TOPK_MT};
+
+	for(size_t i = 0; i < sizeof(MTS) / sizeof(MTS[0]); i++) {
+		luaL_getmetatable(ls, MTS[i]);
+		lua_getfield(ls, -1, "__index");
+		lua_getfield(ls, -1, "print");
+		lua_pushcclosure(ls, wrap, 1);
+		lua_setfield(ls, -2, "print");
+		lua_pop(ls, 2);
+	}
+}
+/*****************************************************************************/
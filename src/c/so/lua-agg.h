@@ -0,0 +1,45 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef LUA_AGG_H
+#define LUA_AGG_H
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+/* string keys are cut to this many bytes */
+#define LUA_AGG_KEY_MAX 54
+#define LUA_AGG_COUNTER_DEFAULT 1024
+#define LUA_AGG_COUNTER_MAX (1 << 20)
+#define LUA_AGG_TOPK_MAX (1 << 16)
+#define LUA_AGG_LINEAR_MAX 4096
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+struct lua_State;
+
+/* Registers LT_counter, LT_hist and LT_topk. Each hands out an aggregation
+ * whose memory is sized once, when it is made, and allocated from the
+ * state's own heap, so adding to one never allocates and a script can count
+ * events at any rate without its memory growing. They belong to the state
+ * that made them and are collected along with everything else in it. */
+void lua_agg_setup(struct lua_State *ls);
+/* Swaps the print method of each, the only one that writes to the ghost
+ * files, for a C closure of wrap that has the method as its upvalue. */
+void lua_agg_wrap_print(struct lua_State *ls, int (*wrap)(struct lua_State*));
+/*****************************************************************************/
+#endif /* LUA_AGG_H */
@@ -0,0 +1,356 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "lua-cache.h"
+
+#include "secret-heap.h"
+#include <gio/ghost-stdio.h>
+#include <lua/lua.h>
+#include <lua/lauxlib.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+/* Start of every cache file. It is followed by the source path and then
+ * the lua_dump() output. Cache files never leave the machine that wrote
+ * them, so everything is in native byte order. */
+struct cache_header {
+	char magic[8];
+	uint64_t src_size;
+	int64_t src_mtime_sec;
+	int64_t src_mtime_nsec;
+	uint64_t src_hash;
+	uint64_t path_len;
+};
+/*****************************************************************************/
+struct dump_state {
+	bool init;
+	luaL_Buffer b;
+};
+/*****************************************************************************/
+struct source_info {
+	char path[PATH_MAX];
+	size_t path_len;
+	struct stat sb;
+	uint64_t hash;
+};
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const char CACHE_MAGIC[8] = "GPLUAC1";
+static const char CACHE_SUFFIX[] = ".luac";
+
+static const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+#define CACHE_PATH_MAX (PATH_MAX + 64)
+/******************************************************************************
+*                                    DATA                                     *
+******************************************************************************/
+static char cache_dir[PATH_MAX];
+static bool cache_on;
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len);
+static int hash_source(struct source_info *src);
+static int source_info(struct source_info *src, const char *path);
+static void cache_path(char *out, const struct source_info *src);
+static bool header_matches(
+	const struct cache_header *hdr,
+	const struct source_info *src,
+	const char *path
+);
+static int load_cached(lua_State *ls, const struct source_info *src);
+static int dump_writer(lua_State *ls, const void *p, size_t sz, void *ud);
+static void store_cached(lua_State *ls, const struct source_info *src);
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len)
+{
+	const uint8_t *bytes = data;
+
+	for(size_t i = 0; i < len; i++) {
+		hash = (hash ^ bytes[i]) * FNV_PRIME;
+	}
+
+	return hash;
+}
+/*****************************************************************************/
+static int hash_source(struct source_info *src)
+{
+	size_t len = 0;
+	int ret = -1;
+	struct ghost_file *f = ghost_fopen(src->path, "rm");
+
+	if(f == NULL) {
+		return -1;
+	}
+
+	const uint8_t *data = ghost_fview(f, src->sb.st_size, &len);
+
+	/* precompiled scripts have nothing to gain from the cache */
+	if((data == NULL) || (len != (size_t)src->sb.st_size)) {
+		goto exit;
+	} else if((len != 0) && (data[0] == LUA_SIGNATURE[0])) {
+		goto exit;
+	}
+
+	src->hash = fnv1a(FNV_OFFSET, data, len);
+	ret = 0;
+exit:
+	ghost_fclose(f);
+	return ret;
+}
+/*****************************************************************************/
+static int source_info(struct source_info *src, const char *path)
+{
+	if(realpath(path, src->path) == NULL) {
+		return -1;
+	}
+
+	if(stat(src->path, &src->sb) != 0) {
+		return -1;
+	}
+
+	if(!S_ISREG(src->sb.st_mode)) {
+		return -1;
+	}
+
+	src->path_len = strlen(src->path);
+
+	return hash_source(src);
+}
+/*****************************************************************************/
+static void cache_path(char *out, const struct source_info *src)
+{
+	uint64_t key = fnv1a(FNV_OFFSET, src->path, src->path_len);
+	size_t len = strlen(cache_dir);
+
+	/* the entry is named after a hash of the full path of the script */
+	memcpy(out, cache_dir, len);
+	out[len++] = '/';
+
+	for(int shift = 60; shift >= 0; shift -= 4) {
+		out[len++] = "0123456789abcdef"[(key >> shift) & 0xf];
+	}
+
+	memcpy(out + len, CACHE_SUFFIX, sizeof(CACHE_SUFFIX));
+}
+/*****************************************************************************/
+static bool header_matches(
+	const struct cache_header *hdr,
+	const struct source_info *src,
+	const char *path
+) {
+	if(memcmp(hdr->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) {
+		return false;
+	}
+
+	return
+		(hdr->src_size == (uint64_t)src->sb.st_size) &&
+		(hdr->src_mtime_sec == src->sb.st_mtim.tv_sec) &&
+		(hdr->src_mtime_nsec == src->sb.st_mtim.tv_nsec) &&
+		(hdr->src_hash == src->hash) &&
+		(hdr->path_len == src->path_len) &&
+		(memcmp(path, src->path, src->path_len) == 0);
+}
+/*****************************************************************************/
+static int load_cached(lua_State *ls, const struct source_info *src)
+{
+	char path[CACHE_PATH_MAX];
+	struct cache_header hdr;
+	size_t len = 0;
+	int ret = -1;
+
+	cache_path(path, src);
+
+	struct ghost_file *f = ghost_fopen(path, "rbm");
+
+	if(f == NULL) {
+		return -1;
+	}
+
+	if(ghost_fread(&hdr, 1, sizeof(hdr), f) != sizeof(hdr)) {
+		goto exit;
+	}
+
+	const char *data = ghost_fview(f, SIZE_MAX, &len);
+
+	if((data == NULL) || (len < hdr.path_len)) {
+		goto exit;
+	} else if(!header_matches(&hdr, src, data)) {
+		goto exit;
+	}
+
+	data += hdr.path_len;
+	len -= hdr.path_len;
+
+	/* the chunk keeps the name it was compiled with, lundump checks the
+	 * Lua version and number formats for us */
+	if(luaL_loadbufferx(ls, data, len, src->path, "b") != LUA_OK) {
+		lua_pop(ls, 1);
+		goto exit;
+	}
+
+	ret = 0;
+exit:
+	ghost_fclose(f);
+	return ret;
+}
+/*****************************************************************************/
+static int dump_writer(lua_State *ls, const void *p, size_t sz, void *ud)
+{
+	struct dump_state *st = ud;
+
+	/* the buffer goes on the stack above the function being dumped, so
+	 * it can only be set up once lua_dump() has taken hold of that */
+	if(!st->init) {
+		luaL_buffinit(ls, &st->b);
+		st->init = true;
+	}
+
+	luaL_addlstring(&st->b, p, sz);
+
+	return 0;
+}
+/*****************************************************************************/
+static void store_cached(lua_State *ls, const struct source_info *src)
+{
+	char path[CACHE_PATH_MAX];
+	char tmp[CACHE_PATH_MAX + 16];
+	struct cache_header hdr;
+	struct dump_state st = {.init = false};
+	size_t len;
+
+	/* keep the debug information, errors should still name lines, and
+	 * collect the dump first so that the file sees a single write */
+	if((lua_dump(ls, dump_writer, &st, 0) != 0) || !st.init) {
+		return;
+	}
+
+	luaL_pushresult(&st.b);
+
+	const char *chunk = lua_tolstring(ls, -1, &len);
+
+	cache_path(path, src);
+
+	/* written aside and renamed into place, so a concurrent load only
+	 * ever sees a complete entry */
+	ghost_snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+
+	struct ghost_file *f = ghost_fopen(tmp, "w");
+
+	if(f == NULL) {
+		goto exit;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	hdr.src_size = src->sb.st_size;
+	hdr.src_mtime_sec = src->sb.st_mtim.tv_sec;
+	hdr.src_mtime_nsec = src->sb.st_mtim.tv_nsec;
+	hdr.src_hash = src->hash;
+	hdr.path_len = src->path_len;
+
+	size_t plen = src->path_len;
+	bool ok =
+		(ghost_fwrite(&hdr, 1, sizeof(hdr), f) == sizeof(hdr)) &&
+		(ghost_fwrite(src->path, 1, plen, f) == plen) &&
+		(ghost_fwrite(chunk, 1, len, f) == len);
+
+	if(ghost_fclose(f) != 0) {
+		ok = false;
+	}
+
+	if(!ok || (ghost_rename(tmp, path) != 0)) {
+		ghost_remove(tmp);
+	}
+exit:
+	lua_pop(ls, 1);
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+void lua_cache_set_dir(const char *dir)
+{
+	size_t len = (dir == NULL) ? 0 : strlen(dir);
+
+	cache_on = false;
+
+	if((len == 0) || (len >= sizeof(cache_dir))) {
+		return;
+	}
+
+	memcpy(cache_dir, dir, len + 1);
+
+	/* only the last component is created, like mkdir without -p */
+	mkdir(cache_dir, 0700);
+	cache_on = (access(cache_dir, W_OK | X_OK) == 0);
+}
+/*****************************************************************************/
+bool lua_cache_enabled(void)
+{
+	return cache_on;
+}
+/*****************************************************************************/
+int lua_cache_loadfile(
+	lua_State *ls,
+	const char *path,
+	const char *mode,
+	lua_cache_compile_f compile
+) {
+	struct source_info *src;
+	int ret;
+
+	/* a caller that refuses text chunks gets exactly what it asked for */
+	if(!cache_on || ((mode != NULL) && (strchr(mode, 't') == NULL))) {
+		return compile(ls, path, mode);
+	}
+
+	src = ghost_malloc(sheap, sizeof(*src));
+
+	if((src == NULL) || (source_info(src, path) != 0)) {
+		ret = compile(ls, path, mode);
+		goto exit;
+	}
+
+	if(load_cached(ls, src) == 0) {
+		ret = LUA_OK;
+		goto exit;
+	}
+
+	ret = compile(ls, path, mode);
+
+	if(ret == LUA_OK) {
+		store_cached(ls, src);
+	}
+exit:
+	ghost_free(sheap, src);
+	return ret;
+}
+/*****************************************************************************/
@@ -0,0 +1,51 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef LUA_CACHE_H
+#define LUA_CACHE_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdbool.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct lua_State;
+
+/* loads a script from its source, with the contract of luaL_loadfilex */
+typedef int (*lua_cache_compile_f)(
+	struct lua_State *ls, const char *path, const char *mode
+);
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+/* Compiled chunks are kept in dir, NULL (the default) turns the cache off.
+ * The directory is created if it doesn't exist. */
+void lua_cache_set_dir(const char *dir);
+bool lua_cache_enabled(void);
+/* Pushes the chunk for the script at path, from the cache when there is a
+ * valid entry for it and from compile otherwise, in which case the result
+ * is stored for next time. Returns as luaL_loadfilex does. */
+int lua_cache_loadfile(
+	struct lua_State *ls,
+	const char *path,
+	const char *mode,
+	lua_cache_compile_f compile
+);
+/*****************************************************************************/
+#endif /* LUA_CACHE_H */
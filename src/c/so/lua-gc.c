@@ -0,0 +1,216 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "lua-gc.h"
+
+#include <lua/lua.h>
+#include <lua/lauxlib.h>
+#include <utl/math-utl.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const char LUA_GC_CONFIG_F[] = "LT_gc_config";
+static const char LUA_GC_STATS_F[] = "LT_gc_stats";
+
+/* Lua's LUAI_GCPAUSE, what LUA_GC_IDLE uses when not given a pause */
+static const uint32_t DEFAULT_PAUSE = 200;
+/* the smallest size LUA_GC_IDLE works a pause out from, so that a nearly
+ * empty state doesn't collect after every event */
+static const uint32_t MIN_BASE_KB = 256;
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static void set_limit(lua_State *ls, struct lua_gc_ctx *ctx)
+{
+	uint64_t kb = max_u64(lua_gc(ls, LUA_GCCOUNT), MIN_BASE_KB);
+
+	ctx->limit_kb = (kb * ctx->pause) / 100;
+}
+/*****************************************************************************/
+static void gc_apply(
+	lua_State *ls,
+	struct lua_gc_ctx *ctx,
+	enum lua_gc_mode mode,
+	uint32_t a,
+	uint32_t b
+) {
+	if((mode == LUA_GC_IDLE) && !ctx->can_idle) {
+		mode = LUA_GC_INC;
+	}
+
+	if(mode == LUA_GC_GEN) {
+		lua_gc(ls, LUA_GCGEN, (int)a, (int)b);
+	} else {
+		lua_gc(ls, LUA_GCINC, (int)a, (int)b, 0);
+	}
+
+	if(mode == LUA_GC_IDLE) {
+		/* LUA_GCSTEP still runs while stopped, and an allocation
+		 * that fails still gets an emergency collection */
+		lua_gc(ls, LUA_GCSTOP);
+		ctx->pause = (a == 0) ? DEFAULT_PAUSE : a;
+		ctx->cycle = false;
+		set_limit(ls, ctx);
+	} else {
+		lua_gc(ls, LUA_GCRESTART);
+	}
+
+	ctx->mode = mode;
+}
+/*****************************************************************************/
+static void gc_step(lua_State *ls, struct lua_gc_ctx *ctx)
+{
+	if(lua_gc(ls, LUA_GCSTEP, 0) == 0) {
+		return;
+	}
+
+	/* that finished the cycle, wait for the state to grow again */
+	ctx->cycle = false;
+	set_limit(ls, ctx);
+}
+/*****************************************************************************/
+static int luaf_lt_gc_config(lua_State *ls)
+{
+	struct lua_gc_ctx *ctx = lua_touserdata(ls, lua_upvalueindex(1));
+	int mode = luaL_checkoption(ls, 1, NULL, LUA_GC_NAMES);
+	lua_Integer a = luaL_optinteger(ls, 2, 0);
+	lua_Integer b = luaL_optinteger(ls, 3, 0);
+	enum lua_gc_mode old = ctx->mode;
+
+	luaL_argcheck(
+		ls, (a >= 0) && (a <= LUA_GC_PARAM_MAX), 2, "out of range"
+	);
+	luaL_argcheck(
+		ls, (b >= 0) && (b <= LUA_GC_PARAM_MAX), 3, "out of range"
+	);
+
+	gc_apply(ls, ctx, mode, a, b);
+	lua_pushstring(ls, LUA_GC_NAMES[old]);
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_lt_gc_stats(lua_State *ls)
+{
+	struct lua_gc_ctx *ctx = lua_touserdata(ls, lua_upvalueindex(1));
+	lua_GCStats stats;
+	lua_Integer n = 0;
+
+	lua_gcstats(ls, &stats, lua_toboolean(ls, 1));
+
+	lua_createtable(ls, 0, 7);
+	lua_pushstring(ls, LUA_GC_NAMES[ctx->mode]);
+	lua_setfield(ls, -2, "mode");
+	lua_pushinteger(ls, lua_gc(ls, LUA_GCCOUNT));
+	lua_setfield(ls, -2, "kb");
+	lua_pushinteger(ls, stats.steps);
+	lua_setfield(ls, -2, "steps");
+	lua_pushinteger(ls, stats.full);
+	lua_setfield(ls, -2, "full");
+	lua_pushinteger(ls, stats.time);
+	lua_setfield(ls, -2, "ns");
+	lua_pushinteger(ls, stats.maxtime);
+	lua_setfield(ls, -2, "max_ns");
+
+	/* { {lo, hi, count}, ... } of step times, as LT_shared_hist */
+	lua_newtable(ls);
+
+	for(unsigned i = 0; i < LUA_GCSTATS_BUCKETS; i++) {
+		if(stats.hist[i] == 0) {
+			continue;
+		}
+
+		lua_createtable(ls, 3, 0);
+		lua_pushinteger(ls, (i == 0) ? 0 : (lua_Integer)1 << (i - 1));
+		lua_rawseti(ls, -2, 1);
+		lua_pushinteger(
+			ls,
+			(i == LUA_GCSTATS_BUCKETS - 1) ?
+				LUA_MAXINTEGER : (lua_Integer)1 << i
+		);
+		lua_rawseti(ls, -2, 2);
+		lua_pushinteger(ls, stats.hist[i]);
+		lua_rawseti(ls, -2, 3);
+		lua_rawseti(ls, -2, ++n);
+	}
+
+	lua_setfield(ls, -2, "hist");
+
+	return 1;
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+void lua_gc_setup(
+	lua_State *ls,
+	struct lua_gc_ctx *ctx,
+	enum lua_gc_mode mode,
+	uint32_t a,
+	uint32_t b
+) {
+	gc_apply(ls, ctx, mode, a, b);
+
+	lua_pushlightuserdata(ls, ctx);
+	lua_pushcclosure(ls, luaf_lt_gc_config, 1);
+	lua_setglobal(ls, LUA_GC_CONFIG_F);
+
+	lua_pushlightuserdata(ls, ctx);
+	lua_pushcclosure(ls, luaf_lt_gc_stats, 1);
+	lua_setglobal(ls, LUA_GC_STATS_F);
+}
+/*****************************************************************************/
+bool lua_gc_pending(lua_State *ls, struct lua_gc_ctx *ctx)
+{
+	if(ctx->mode != LUA_GC_IDLE) {
+		return false;
+	}
+
+	uint32_t kb = lua_gc(ls, LUA_GCCOUNT);
+
+	if(!ctx->cycle && (kb < ctx->limit_kb)) {
+		return false;
+	}
+
+	ctx->cycle = true;
+
+	/* a target that never leaves the tracer idle must not leave the
+	 * state to grow without bound either */
+	if(kb >= 2 * (uint64_t)ctx->limit_kb) {
+		gc_step(ls, ctx);
+	}
+
+	return ctx->cycle;
+}
+/*****************************************************************************/
+bool lua_gc_idle(lua_State *ls, struct lua_gc_ctx *ctx)
+{
+	if((ctx->mode != LUA_GC_IDLE) || !ctx->cycle) {
+		return false;
+	}
+
+	gc_step(ls, ctx);
+
+	return ctx->cycle;
+}
+/*****************************************************************************/
@@ -0,0 +1,65 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef LUA_GC_H
+#define LUA_GC_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <options.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct lua_gc_ctx {
+	enum lua_gc_mode mode;
+	/* states that are never idle, those hooks run in, can't put off
+	 * collection and run LUA_GC_IDLE as LUA_GC_INC */
+	bool can_idle;
+	/* the rest is for LUA_GC_IDLE: a cycle starts once the state holds
+	 * limit_kb, a pause after the size the last one left it at */
+	uint32_t pause;
+	uint32_t limit_kb;
+	/* a cycle was started and hasn't finished */
+	bool cycle;
+};
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+struct lua_State;
+
+/* Sets up the collector of ls as mode with the parameters a and b, as for
+ * --lua-gc, and registers LT_gc_config and LT_gc_stats. The caller sets
+ * ctx->can_idle beforehand. */
+void lua_gc_setup(
+	struct lua_State *ls,
+	struct lua_gc_ctx *ctx,
+	enum lua_gc_mode mode,
+	uint32_t a,
+	uint32_t b
+);
+/* Called after each event handled in ls. In LUA_GC_IDLE mode returns true
+ * while collection has been put off, for lua_gc_idle() to do. Only if the
+ * state has run a long way past its limit does it step the collector here. */
+bool lua_gc_pending(struct lua_State *ls, struct lua_gc_ctx *ctx);
+/* one step of collection put off until now, true while more remains */
+bool lua_gc_idle(struct lua_State *ls, struct lua_gc_ctx *ctx);
+/*****************************************************************************/
+#endif /* LUA_GC_H */
@@ -0,0 +1,826 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "lua-mem.h"
+
+#include <tracee-mem.h>
+#include <gio/ghost-stdio.h>
+#include <lua/lua.h>
+#include <lua/lauxlib.h>
+#include <utl/math-utl.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+enum peek_kind {
+	PEEK_UNSIGNED,
+	PEEK_SIGNED,
+	PEEK_FLOAT,
+	/* the rest only appear in struct layouts */
+	PEEK_BIG_ENDIAN,
+	PEEK_BYTES,
+	PEEK_CSTR
+};
+/*****************************************************************************/
+struct peek_type {
+	const char *name;
+	size_t size;
+	enum peek_kind kind;
+};
+/*****************************************************************************/
+struct lua_view {
+	uint64_t addr;
+	size_t len;
+	/* shared memory is read in place, anything else from copy */
+	bool local;
+	uint64_t epoch;
+	const uint8_t *p;
+	uint8_t copy[];
+};
+/*****************************************************************************/
+struct struct_field {
+	const struct peek_type *type;
+	uint32_t off;
+	uint32_t len;
+};
+/*****************************************************************************/
+/* A compiled LT_struct() layout. The field names live in the first user
+ * value of the userdata, a sequence in the same order as fields. */
+struct struct_layout {
+	size_t size;
+	size_t n;
+	struct struct_field fields[];
+};
+/*****************************************************************************/
+struct struct_def_field {
+	const char *name;
+	const char *type;
+	size_t off;
+	size_t len;
+};
+/*****************************************************************************/
+struct struct_def {
+	const char *name;
+	size_t size;
+	const struct struct_def_field *fields;
+	size_t n;
+};
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const char LUA_PEEK_F[] = "LT_peek";
+static const char LUA_VIEW_F[] = "LT_view";
+static const char VIEW_MT[] = "LT_view";
+
+static const lua_Integer PEEK_MAX = 1 << 24;
+
+static const struct peek_type PEEK_TYPES[] = {
+	{"u8", 1, PEEK_UNSIGNED},
+	{"u16", 2, PEEK_UNSIGNED},
+	{"u32", 4, PEEK_UNSIGNED},
+	{"u64", 8, PEEK_UNSIGNED},
+	{"i8", 1, PEEK_SIGNED},
+	{"i16", 2, PEEK_SIGNED},
+	{"i32", 4, PEEK_SIGNED},
+	{"i64", 8, PEEK_SIGNED},
+	{"f64", 8, PEEK_FLOAT},
+};
+
+static const struct peek_type FIELD_TYPES[] = {
+	{"ptr", 8, PEEK_UNSIGNED},
+	{"be16", 2, PEEK_BIG_ENDIAN},
+	{"be32", 4, PEEK_BIG_ENDIAN},
+	{"be64", 8, PEEK_BIG_ENDIAN},
+	{"bytes", 0, PEEK_BYTES},
+	{"cstr", 0, PEEK_CSTR},
+};
+
+#define N_PEEK_TYPES (sizeof(PEEK_TYPES) / sizeof(PEEK_TYPES[0]))
+#define N_FIELD_TYPES (sizeof(FIELD_TYPES) / sizeof(FIELD_TYPES[0]))
+#define PEEK_NAME_MAX 32
+#define N_ELEMS(a) (sizeof(a) / sizeof((a)[0]))
+
+static const char LUA_STRUCT_F[] = "LT_struct";
+static const char LUA_STRUCTS_G[] = "LT_structs";
+static const char STRUCT_MT[] = "LT_struct";
+
+/* bigger than any kernel struct we decode, the whole struct is read in
+ * one go into a buffer of this size */
+static const size_t STRUCT_MAX = 4096;
+
+#define FIELD(s, f, t) {#f, t, offsetof(struct s, f), 0}
+#define ARRAY_FIELD(s, f, t) \
+	{#f, t, offsetof(struct s, f), sizeof(((struct s*)0)->f)}
+
+static const struct struct_def_field STAT_FIELDS[] = {
+	FIELD(stat, st_dev, "u64"),
+	FIELD(stat, st_ino, "u64"),
+	FIELD(stat, st_nlink, "u64"),
+	FIELD(stat, st_mode, "u32"),
+	FIELD(stat, st_uid, "u32"),
+	FIELD(stat, st_gid, "u32"),
+	FIELD(stat, st_rdev, "u64"),
+	FIELD(stat, st_size, "i64"),
+	FIELD(stat, st_blksize, "i64"),
+	FIELD(stat, st_blocks, "i64"),
+	{"st_atime", "i64", offsetof(struct stat, st_atim.tv_sec), 0},
+	{"st_atime_nsec", "i64", offsetof(struct stat, st_atim.tv_nsec), 0},
+	{"st_mtime", "i64", offsetof(struct stat, st_mtim.tv_sec), 0},
+	{"st_mtime_nsec", "i64", offsetof(struct stat, st_mtim.tv_nsec), 0},
+	{"st_ctime", "i64", offsetof(struct stat, st_ctim.tv_sec), 0},
+	{"st_ctime_nsec", "i64", offsetof(struct stat, st_ctim.tv_nsec), 0},
+};
+
+static const struct struct_def_field TIMESPEC_FIELDS[] = {
+	FIELD(timespec, tv_sec, "i64"),
+	FIELD(timespec, tv_nsec, "i64"),
+};
+
+static const struct struct_def_field TIMEVAL_FIELDS[] = {
+	FIELD(timeval, tv_sec, "i64"),
+	FIELD(timeval, tv_usec, "i64"),
+};
+
+static const struct struct_def_field IOVEC_FIELDS[] = {
+	FIELD(iovec, iov_base, "ptr"),
+	FIELD(iovec, iov_len, "u64"),
+};
+
+static const struct struct_def_field MSGHDR_FIELDS[] = {
+	FIELD(msghdr, msg_name, "ptr"),
+	FIELD(msghdr, msg_namelen, "u32"),
+	FIELD(msghdr, msg_iov, "ptr"),
+	FIELD(msghdr, msg_iovlen, "u64"),
+	FIELD(msghdr, msg_control, "ptr"),
+	FIELD(msghdr, msg_controllen, "u64"),
+	FIELD(msghdr, msg_flags, "i32"),
+};
+
+static const struct struct_def_field POLLFD_FIELDS[] = {
+	FIELD(pollfd, fd, "i32"),
+	FIELD(pollfd, events, "u16"),
+	FIELD(pollfd, revents, "u16"),
+};
+
+static const struct struct_def_field EPOLL_EVENT_FIELDS[] = {
+	FIELD(epoll_event, events, "u32"),
+	FIELD(epoll_event, data, "u64"),
+};
+
+static const struct struct_def_field SOCKADDR_FIELDS[] = {
+	FIELD(sockaddr, sa_family, "u16"),
+};
+
+static const struct struct_def_field SOCKADDR_IN_FIELDS[] = {
+	FIELD(sockaddr_in, sin_family, "u16"),
+	FIELD(sockaddr_in, sin_port, "be16"),
+	{"sin_addr", "be32", offsetof(struct sockaddr_in, sin_addr), 0},
+};
+
+static const struct struct_def_field SOCKADDR_IN6_FIELDS[] = {
+	FIELD(sockaddr_in6, sin6_family, "u16"),
+	FIELD(sockaddr_in6, sin6_port, "be16"),
+	FIELD(sockaddr_in6, sin6_flowinfo, "be32"),
+	ARRAY_FIELD(sockaddr_in6, sin6_addr, "bytes"),
+	FIELD(sockaddr_in6, sin6_scope_id, "u32"),
+};
+
+static const struct struct_def_field SOCKADDR_UN_FIELDS[] = {
+	FIELD(sockaddr_un, sun_family, "u16"),
+	ARRAY_FIELD(sockaddr_un, sun_path, "cstr"),
+};
+
+#define STRUCT_DEF(name, s, fields) \
+	{name, sizeof(struct s), fields, N_ELEMS(fields)}
+
+static const struct struct_def STRUCT_DEFS[] = {
+	STRUCT_DEF("stat", stat, STAT_FIELDS),
+	STRUCT_DEF("timespec", timespec, TIMESPEC_FIELDS),
+	STRUCT_DEF("timeval", timeval, TIMEVAL_FIELDS),
+	STRUCT_DEF("iovec", iovec, IOVEC_FIELDS),
+	STRUCT_DEF("msghdr", msghdr, MSGHDR_FIELDS),
+	STRUCT_DEF("pollfd", pollfd, POLLFD_FIELDS),
+	STRUCT_DEF("epoll_event", epoll_event, EPOLL_EVENT_FIELDS),
+	STRUCT_DEF("sockaddr", sockaddr, SOCKADDR_FIELDS),
+	STRUCT_DEF("sockaddr_in", sockaddr_in, SOCKADDR_IN_FIELDS),
+	STRUCT_DEF("sockaddr_in6", sockaddr_in6, SOCKADDR_IN6_FIELDS),
+	STRUCT_DEF("sockaddr_un", sockaddr_un, SOCKADDR_UN_FIELDS),
+};
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static void push_value(
+	lua_State *ls, const struct peek_type *type, const uint8_t *src
+) {
+	uint64_t u = 0;
+
+	/* targets are little endian, so the low bytes come first */
+	memcpy(&u, src, type->size);
+
+	if(type->kind == PEEK_FLOAT) {
+		double d;
+		memcpy(&d, &u, sizeof(d));
+		lua_pushnumber(ls, d);
+	} else if((type->kind == PEEK_SIGNED) && (type->size < 8)) {
+		unsigned shift = 64 - 8 * type->size;
+		lua_pushinteger(ls, (int64_t)(u << shift) >> shift);
+	} else {
+		lua_pushinteger(ls, (lua_Integer)u);
+	}
+}
+/*****************************************************************************/
+static int luaf_lt_peek_type(lua_State *ls)
+{
+	struct lua_mem_ctx *ctx = lua_touserdata(ls, lua_upvalueindex(1));
+	const struct peek_type *type = PEEK_TYPES +
+		lua_tointeger(ls, lua_upvalueindex(2));
+
+	uint64_t addr = luaL_checkinteger(ls, 1);
+	uint8_t buf[sizeof(uint64_t)];
+
+	ssize_t n = tracee_mem_read_safe(ctx->cur, buf, addr, type->size);
+
+	if(n != (ssize_t)type->size) {
+		lua_pushnil(ls);
+	} else {
+		push_value(ls, type, buf);
+	}
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_lt_peek(lua_State *ls)
+{
+	struct lua_mem_ctx *ctx = lua_touserdata(ls, lua_upvalueindex(1));
+	luaL_Buffer b;
+
+	uint64_t addr = luaL_checkinteger(ls, 1);
+	lua_Integer len = luaL_checkinteger(ls, 2);
+
+	luaL_argcheck(ls, (len >= 0) && (len <= PEEK_MAX), 2, "bad length");
+
+	/* read straight into the memory the string is made from */
+	char *dst = luaL_buffinitsize(ls, &b, len);
+	ssize_t n = tracee_mem_read_safe(ctx->cur, dst, addr, len);
+
+	if((n < 0) || ((n == 0) && (len != 0))) {
+		lua_pushnil(ls);
+		return 1;
+	}
+
+	luaL_pushresultsize(&b, n);
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_lt_view(lua_State *ls)
+{
+	struct lua_mem_ctx *ctx = lua_touserdata(ls, lua_upvalueindex(1));
+	struct lua_view *v;
+
+	uint64_t addr = luaL_checkinteger(ls, 1);
+	lua_Integer len = luaL_checkinteger(ls, 2);
+
+	luaL_argcheck(ls, (len >= 0) && (len <= PEEK_MAX), 2, "bad length");
+
+	if(tracee_mem_is_local(ctx->cur)) {
+		if(!tracee_mem_readable(ctx->cur, addr, len)) {
+			lua_pushnil(ls);
+			return 1;
+		}
+
+		v = lua_newuserdatauv(ls, sizeof(*v), 0);
+		v->local = true;
+		v->p = (const uint8_t*)addr;
+	} else {
+		/* there is nothing to point at in another address space, so
+		 * take a snapshot instead */
+		v = lua_newuserdatauv(ls, sizeof(*v) + len, 0);
+
+		ssize_t n = tracee_mem_read_safe(ctx->cur, v->copy, addr, len);
+
+		if(n != len) {
+			lua_pushnil(ls);
+			return 1;
+		}
+
+		v->local = false;
+		v->p = v->copy;
+	}
+
+	v->addr = addr;
+	v->len = len;
+	v->epoch = ctx->epoch;
+
+	luaL_setmetatable(ls, VIEW_MT);
+	return 1;
+}
+/*****************************************************************************/
+static const uint8_t *view_at(
+	lua_State *ls, struct lua_mem_ctx *ctx, size_t size
+) {
+	struct lua_view *v = luaL_checkudata(ls, 1, VIEW_MT);
+	lua_Integer off = luaL_checkinteger(ls, 2);
+
+	bool fits = (off >= 0) && ((size_t)off <= v->len) &&
+		(size <= (v->len - off));
+
+	luaL_argcheck(ls, fits, 2, "out of the view");
+
+	/* the target may have unmapped the memory since it was checked */
+	if(v->local && (v->epoch != ctx->epoch)) {
+		if(!tracee_mem_readable(NULL, v->addr, v->len)) {
+			return NULL;
+		}
+		v->epoch = ctx->epoch;
+	}
+
+	return v->p + off;
+}
+/*****************************************************************************/
+static int luaf_view_type(lua_State *ls)
+{
+	struct lua_mem_ctx *ctx = lua_touserdata(ls, lua_upvalueindex(1));
+	const struct peek_type *type = PEEK_TYPES +
+		lua_tointeger(ls, lua_upvalueindex(2));
+
+	const uint8_t *src = view_at(ls, ctx, type->size);
+
+	if(src == NULL) {
+		lua_pushnil(ls);
+	} else {
+		push_value(ls, type, src);
+	}
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_view_str(lua_State *ls)
+{
+	struct lua_mem_ctx *ctx = lua_touserdata(ls, lua_upvalueindex(1));
+	lua_Integer len = luaL_checkinteger(ls, 3);
+
+	luaL_argcheck(ls, len >= 0, 3, "bad length");
+
+	const uint8_t *src = view_at(ls, ctx, len);
+
+	if(src == NULL) {
+		lua_pushnil(ls);
+	} else {
+		lua_pushlstring(ls, (const char*)src, len);
+	}
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_view_addr(lua_State *ls)
+{
+	struct lua_view *v = luaL_checkudata(ls, 1, VIEW_MT);
+
+	lua_pushinteger(ls, v->addr);
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_view_len(lua_State *ls)
+{
+	struct lua_view *v = luaL_checkudata(ls, 1, VIEW_MT);
+
+	lua_pushinteger(ls, v->len);
+	return 1;
+}
+/*****************************************************************************/
+static void push_ctx_closure(
+	lua_State *ls, struct lua_mem_ctx *ctx, lua_CFunction f, int type
+) {
+	lua_pushlightuserdata(ls, ctx);
+
+	if(type < 0) {
+		lua_pushcclosure(ls, f, 1);
+	} else {
+		lua_pushinteger(ls, type);
+		lua_pushcclosure(ls, f, 2);
+	}
+}
+/*****************************************************************************/
+static void setup_view_mt(lua_State *ls, struct lua_mem_ctx *ctx)
+{
+	luaL_newmetatable(ls, VIEW_MT);
+
+	lua_pushcfunction(ls, luaf_view_len);
+	lua_setfield(ls, -2, "__len");
+
+	/* methods take offsets from the start of the view, like the
+	 * offsetof() of the struct being decoded */
+	lua_newtable(ls);
+
+	for(size_t i = 0; i < N_PEEK_TYPES; i++) {
+		push_ctx_closure(ls, ctx, luaf_view_type, i);
+		lua_setfield(ls, -2, PEEK_TYPES[i].name);
+	}
+
+	push_ctx_closure(ls, ctx, luaf_view_str, -1);
+	lua_setfield(ls, -2, "str");
+
+	lua_pushcfunction(ls, luaf_view_addr);
+	lua_setfield(ls, -2, "addr");
+
+	lua_setfield(ls, -2, "__index");
+	lua_pop(ls, 1);
+}
+/*****************************************************************************/
+static const struct peek_type *find_type(const char *name)
+{
+	for(size_t i = 0; i < N_PEEK_TYPES; i++) {
+		if(strcmp(PEEK_TYPES[i].name, name) == 0) {
+			return PEEK_TYPES + i;
+		}
+	}
+	for(size_t i = 0; i < N_FIELD_TYPES; i++) {
+		if(strcmp(FIELD_TYPES[i].name, name) == 0) {
+			return FIELD_TYPES + i;
+		}
+	}
+
+	return NULL;
+}
+/*****************************************************************************/
+static void push_field(
+	lua_State *ls, const struct struct_field *f, const uint8_t *src
+) {
+	const struct peek_type *type = f->type;
+	uint64_t u = 0;
+
+	switch(type->kind) {
+	case PEEK_BYTES:
+		lua_pushlstring(ls, (const char*)src, f->len);
+		break;
+	case PEEK_CSTR:
+		u = strnlen((const char*)src, f->len);
+		lua_pushlstring(ls, (const char*)src, u);
+		break;
+	case PEEK_BIG_ENDIAN:
+		for(size_t i = 0; i < type->size; i++) {
+			u = (u << 8) | src[i];
+		}
+		lua_pushinteger(ls, (lua_Integer)u);
+		break;
+	default:
+		push_value(ls, type, src);
+		break;
+	}
+}
+/*****************************************************************************/
+static struct struct_layout *new_layout(lua_State *ls, size_t n)
+{
+	size_t size = sizeof(struct struct_layout) +
+		n * sizeof(struct struct_field);
+	struct struct_layout *layout = lua_newuserdatauv(ls, size, 1);
+
+	layout->size = 0;
+	layout->n = n;
+
+	return layout;
+}
+/*****************************************************************************/
+static const char *set_field(
+	struct struct_layout *layout,
+	size_t i,
+	const char *type_name,
+	lua_Integer off,
+	lua_Integer len
+) {
+	struct struct_field *f = layout->fields + i;
+	const struct peek_type *type = find_type(type_name);
+
+	if(type == NULL) {
+		return "unknown type";
+	} else if(type->size != 0) {
+		len = type->size;
+	} else if(len <= 0) {
+		return "bytes and cstr fields need a length";
+	}
+
+	if((off < 0) || (off > (lua_Integer)STRUCT_MAX)) {
+		return "bad offset";
+	} else if(len > ((lua_Integer)STRUCT_MAX - off)) {
+		return "field ends past the largest struct size";
+	}
+
+	f->type = type;
+	f->off = off;
+	f->len = len;
+
+	if((f->off + f->len) > layout->size) {
+		layout->size = f->off + f->len;
+	}
+
+	return NULL;
+}
+/*****************************************************************************/
+static void finish_layout(lua_State *ls, int names_idx, lua_Integer size)
+{
+	struct struct_layout *layout = lua_touserdata(ls, -1);
+
+	if(size != 0) {
+		if((size < (lua_Integer)layout->size) ||
+			(size > (lua_Integer)STRUCT_MAX)
+		) {
+			luaL_error(ls, "%s: bad struct size", LUA_STRUCT_F);
+		}
+		layout->size = size;
+	}
+
+	lua_pushvalue(ls, names_idx);
+	lua_setiuservalue(ls, -2, 1);
+	luaL_setmetatable(ls, STRUCT_MT);
+}
+/*****************************************************************************/
+static int luaf_lt_struct(lua_State *ls)
+{
+	luaL_checktype(ls, 1, LUA_TTABLE);
+	lua_Integer size = luaL_optinteger(ls, 2, 0);
+	size_t n = lua_rawlen(ls, 1);
+
+	lua_createtable(ls, n, 0);
+	int names_idx = lua_gettop(ls);
+	struct struct_layout *layout = new_layout(ls, n);
+
+	for(size_t i = 0; i < n; i++) {
+		if(lua_rawgeti(ls, 1, i + 1) != LUA_TTABLE) {
+			luaL_error(
+				ls,
+				"%s: field %d isn't a table",
+				LUA_STRUCT_F,
+				(int)(i + 1)
+			);
+		}
+
+		lua_rawgeti(ls, -1, 1);
+		lua_rawgeti(ls, -2, 2);
+		lua_rawgeti(ls, -3, 3);
+		lua_rawgeti(ls, -4, 4);
+
+		const char *type = lua_tostring(ls, -3);
+		int off_ok = 0;
+		lua_Integer off = lua_tointegerx(ls, -2, &off_ok);
+		lua_Integer len = lua_tointegerx(ls, -1, NULL);
+
+		if(!lua_isstring(ls, -4) || (type == NULL) || !off_ok) {
+			luaL_error(
+				ls,
+				"%s: field %d must be {name, type, offset}",
+				LUA_STRUCT_F,
+				(int)(i + 1)
+			);
+		}
+
+		const char *err = set_field(layout, i, type, off, len);
+
+		if(err != NULL) {
+			luaL_error(
+				ls,
+				"%s: field %d: %s",
+				LUA_STRUCT_F,
+				(int)(i + 1),
+				err
+			);
+		}
+
+		lua_pop(ls, 3);
+		lua_rawseti(ls, names_idx, i + 1);
+		lua_pop(ls, 1);
+	}
+
+	finish_layout(ls, names_idx, size);
+	return 1;
+}
+/*****************************************************************************/
+static void push_struct_def(lua_State *ls, const struct struct_def *def)
+{
+	lua_createtable(ls, def->n, 0);
+	int names_idx = lua_gettop(ls);
+	struct struct_layout *layout = new_layout(ls, def->n);
+
+	for(size_t i = 0; i < def->n; i++) {
+		const struct struct_def_field *f = def->fields + i;
+		const char *err = set_field(layout, i, f->type, f->off, f->len);
+
+		/* the built in layouts are fixed at compile time */
+		assert(err == NULL);
+		(void)err;
+
+		lua_pushstring(ls, f->name);
+		lua_rawseti(ls, names_idx, i + 1);
+	}
+
+	finish_layout(ls, names_idx, def->size);
+	lua_remove(ls, names_idx);
+}
+/*****************************************************************************/
+static void decode_into(
+	lua_State *ls,
+	const struct struct_layout *layout,
+	int names_idx,
+	const uint8_t *src
+) {
+	/* names are interned strings already, so each field costs a table
+	 * insert and no hashing of C strings */
+	for(size_t i = 0; i < layout->n; i++) {
+		const struct struct_field *f = layout->fields + i;
+
+		lua_rawgeti(ls, names_idx, i + 1);
+		push_field(ls, f, src + f->off);
+		lua_rawset(ls, -3);
+	}
+}
+/*****************************************************************************/
+static int luaf_struct_decode(lua_State *ls)
+{
+	struct lua_mem_ctx *ctx = lua_touserdata(ls, lua_upvalueindex(1));
+	struct struct_layout *layout = luaL_checkudata(ls, 1, STRUCT_MT);
+	uint64_t addr = luaL_checkinteger(ls, 2);
+	bool reuse = lua_istable(ls, 3);
+	luaL_Buffer b;
+
+	lua_getiuservalue(ls, 1, 1);
+	int names_idx = lua_gettop(ls);
+
+	uint8_t *buf = (uint8_t*)luaL_buffinitsize(ls, &b, layout->size);
+	ssize_t n = tracee_mem_read_safe(ctx->cur, buf, addr, layout->size);
+
+	if(n != (ssize_t)layout->size) {
+		lua_pushnil(ls);
+		return 1;
+	}
+
+	if(reuse) {
+		lua_pushvalue(ls, 3);
+	} else {
+		lua_createtable(ls, 0, layout->n);
+	}
+
+	decode_into(ls, layout, names_idx, buf);
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_struct_array(lua_State *ls)
+{
+	struct lua_mem_ctx *ctx = lua_touserdata(ls, lua_upvalueindex(1));
+	struct struct_layout *layout = luaL_checkudata(ls, 1, STRUCT_MT);
+	uint64_t addr = luaL_checkinteger(ls, 2);
+	lua_Integer count = luaL_checkinteger(ls, 3);
+	bool reuse = lua_istable(ls, 4);
+	luaL_Buffer b;
+
+	bool fits = (count >= 0) &&
+		(count <= (PEEK_MAX / (lua_Integer)max_u64(layout->size, 1)));
+
+	luaL_argcheck(ls, fits, 3, "bad count");
+
+	lua_getiuservalue(ls, 1, 1);
+	int names_idx = lua_gettop(ls);
+
+	size_t len = count * layout->size;
+	uint8_t *buf = (uint8_t*)luaL_buffinitsize(ls, &b, len);
+	ssize_t n = tracee_mem_read_safe(ctx->cur, buf, addr, len);
+
+	if(n != (ssize_t)len) {
+		lua_pushnil(ls);
+		return 1;
+	}
+
+	if(reuse) {
+		lua_pushvalue(ls, 4);
+	} else {
+		lua_createtable(ls, count, 0);
+	}
+
+	for(lua_Integer i = 0; i < count; i++) {
+		if(!reuse || (lua_rawgeti(ls, -1, i + 1) != LUA_TTABLE)) {
+			if(reuse) {
+				lua_pop(ls, 1);
+			}
+			lua_createtable(ls, 0, layout->n);
+		}
+
+		decode_into(ls, layout, names_idx, buf + i * layout->size);
+		lua_rawseti(ls, -2, i + 1);
+	}
+
+	/* a reused sequence may have been longer last time */
+	for(lua_Integer i = count + 1; reuse; i++) {
+		if(lua_rawgeti(ls, -1, i) == LUA_TNIL) {
+			lua_pop(ls, 1);
+			break;
+		}
+
+		lua_pop(ls, 1);
+		lua_pushnil(ls);
+		lua_rawseti(ls, -2, i);
+	}
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_struct_size(lua_State *ls)
+{
+	struct struct_layout *layout = luaL_checkudata(ls, 1, STRUCT_MT);
+
+	lua_pushinteger(ls, layout->size);
+	return 1;
+}
+/*****************************************************************************/
+static void setup_struct_mt(lua_State *ls, struct lua_mem_ctx *ctx)
+{
+	luaL_newmetatable(ls, STRUCT_MT);
+
+	lua_pushcfunction(ls, luaf_struct_size);
+	lua_setfield(ls, -2, "__len");
+
+	lua_newtable(ls);
+
+	push_ctx_closure(ls, ctx, luaf_struct_decode, -1);
+	lua_setfield(ls, -2, "decode");
+
+	push_ctx_closure(ls, ctx, luaf_struct_array, -1);
+	lua_setfield(ls, -2, "array");
+
+	lua_pushcfunction(ls, luaf_struct_size);
+	lua_setfield(ls, -2, "size");
+
+	lua_setfield(ls, -2, "__index");
+	lua_pop(ls, 1);
+}
+/*****************************************************************************/
+static void setup_structs(lua_State *ls)
+{
+	lua_createtable(ls, 0, N_ELEMS(STRUCT_DEFS));
+
+	for(size_t i = 0; i < N_ELEMS(STRUCT_DEFS); i++) {
+		push_struct_def(ls, STRUCT_DEFS + i);
+		lua_setfield(ls, -2, STRUCT_DEFS[i].name);
+	}
+
+	lua_setglobal(ls, LUA_STRUCTS_G);
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+void lua_mem_setup(lua_State *ls, struct lua_mem_ctx *ctx)
+{
+	char name[PEEK_NAME_MAX];
+
+	for(size_t i = 0; i < N_PEEK_TYPES; i++) {
+		const char *type = PEEK_TYPES[i].name;
+
+		ghost_snprintf(name, sizeof(name), "%s_%s", LUA_PEEK_F, type);
+		push_ctx_closure(ls, ctx, luaf_lt_peek_type, i);
+		lua_setglobal(ls, name);
+	}
+
+	push_ctx_closure(ls, ctx, luaf_lt_peek, -1);
+	lua_setglobal(ls, LUA_PEEK_F);
+
+	push_ctx_closure(ls, ctx, luaf_lt_view, -1);
+	lua_setglobal(ls, LUA_VIEW_F);
+
+	setup_view_mt(ls, ctx);
+
+	push_ctx_closure(ls, ctx, luaf_lt_struct, -1);
+	lua_setglobal(ls, LUA_STRUCT_F);
+
+	setup_struct_mt(ls, ctx);
+	setup_structs(ls);
+}
+/*****************************************************************************/
@@ -0,0 +1,46 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef LUA_MEM_H
+#define LUA_MEM_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct lua_State;
+struct tracee_record;
+
+struct lua_mem_ctx {
+	/* thread whose event is being handled, memory reads made from the
+	 * callback go to its address space */
+	const struct tracee_record *cur;
+	/* bumped for every event, views of memory we share with the target
+	 * check that it is still mapped when first used after a change */
+	uint64_t epoch;
+};
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+/* Registers LT_peek, LT_peek_<type>, LT_view and LT_struct, which read
+ * through ctx, and the built in layouts in LT_structs */
+void lua_mem_setup(struct lua_State *ls, struct lua_mem_ctx *ctx);
+/*****************************************************************************/
+#endif /* LUA_MEM_H */
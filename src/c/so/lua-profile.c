@@ -0,0 +1,553 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "lua-profile.h"
+
+#include "secret-heap.h"
+#include <syscall-table.h>
+#include <gio/ghost-stdio.h>
+#include <lua/lua.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+/* x86_64 system call numbers stay well below this, anything above it is
+ * accounted with the other events */
+#define PROFILE_SYSCALLS 512
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct profile_stat {
+	uint64_t calls;
+	uint64_t ns;
+	uint64_t max_ns;
+	uint64_t bytes;
+};
+/*****************************************************************************/
+struct profile_handler {
+	char *name;
+	struct profile_stat stat;
+};
+/*****************************************************************************/
+struct folded_stack {
+	/* 0 marks an empty slot */
+	uint64_t hash;
+	char *stack;
+	uint64_t weight;
+};
+/*****************************************************************************/
+struct lua_profile {
+	struct profile_handler *handlers;
+	size_t n_handlers;
+
+	struct profile_stat syscalls[PROFILE_SYSCALLS];
+	struct profile_stat other;
+
+	/* open addressing with linear probing, keyed by the hash of the
+	 * folded stack string */
+	struct folded_stack *stacks;
+	size_t n_stacks;
+	unsigned stack_bits;
+};
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const unsigned MIN_STACK_BITS = 8;
+/* frames beyond this depth are left off the root end of a sample */
+static const int MAX_DEPTH = 64;
+static const size_t FOLDED_MAX = 1024;
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+static const char FOLDED_SUFFIX[] = ".folded";
+/* lines up with print_stat(), names go last as ghost_fprintf() doesn't pad
+ * strings */
+static const char STAT_HEADER[] =
+	"     calls     total_us    mean_us     max_us    alloc_bytes";
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+static uint64_t hash_str(const char *s);
+static void stat_add(struct profile_stat *st, uint64_t ns, uint64_t bytes);
+static int grow_stacks(struct lua_profile *prof);
+static struct folded_stack *find_stack(
+	struct lua_profile *prof, const char *stack
+);
+static size_t append_frame(
+	char *buf, size_t pos, size_t size, const lua_Debug *ar
+);
+static void print_stat(
+	struct ghost_file *f, const char *name, const struct profile_stat *st
+);
+static const struct profile_stat *stat_at(
+	const void *stats, size_t stride, size_t i
+);
+static void sort_by_time(
+	size_t *idx, size_t n, const void *stats, size_t stride
+);
+static int write_handlers(
+	const struct lua_profile *prof, struct ghost_file *f
+);
+static int write_folded(const struct lua_profile *prof, const char *path);
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static uint64_t hash_str(const char *s)
+{
+	uint64_t hash = FNV_OFFSET;
+
+	for(; *s != '\0'; s++) {
+		hash = (hash ^ (uint8_t)*s) * FNV_PRIME;
+	}
+
+	return (hash == 0) ? 1 : hash;
+}
+/*****************************************************************************/
+static void stat_add(struct profile_stat *st, uint64_t ns, uint64_t bytes)
+{
+	st->calls += 1;
+	st->ns += ns;
+	st->bytes += bytes;
+
+	if(ns > st->max_ns) {
+		st->max_ns = ns;
+	}
+}
+/*****************************************************************************/
+static int grow_stacks(struct lua_profile *prof)
+{
+	unsigned bits = (prof->stacks == NULL) ?
+		MIN_STACK_BITS : prof->stack_bits + 1;
+	size_t capacity = (size_t)1 << bits;
+	size_t old_capacity = (size_t)1 << prof->stack_bits;
+	struct folded_stack *old = prof->stacks;
+
+	struct folded_stack *slots = ghost_malloc(
+		sheap, capacity * sizeof(*slots)
+	);
+
+	if(slots == NULL) {
+		return -1;
+	}
+
+	memset(slots, 0, capacity * sizeof(*slots));
+
+	for(size_t i = 0; (old != NULL) && (i < old_capacity); i++) {
+		if(old[i].hash == 0) {
+			continue;
+		}
+
+		size_t j = old[i].hash & (capacity - 1);
+
+		while(slots[j].hash != 0) {
+			j = (j + 1) & (capacity - 1);
+		}
+
+		slots[j] = old[i];
+	}
+
+	ghost_free(sheap, old);
+
+	prof->stacks = slots;
+	prof->stack_bits = bits;
+
+	return 0;
+}
+/*****************************************************************************/
+static struct folded_stack *find_stack(
+	struct lua_profile *prof, const char *stack
+) {
+	/* kept at most half full */
+	if((prof->stacks == NULL) ||
+		(2 * (prof->n_stacks + 1) > ((size_t)1 << prof->stack_bits))
+	) {
+		if(grow_stacks(prof) != 0) {
+			return NULL;
+		}
+	}
+
+	uint64_t hash = hash_str(stack);
+	size_t mask = ((size_t)1 << prof->stack_bits) - 1;
+	size_t i = hash & mask;
+
+	for(; prof->stacks[i].hash != 0; i = (i + 1) & mask) {
+		struct folded_stack *s = &prof->stacks[i];
+
+		if((s->hash == hash) && (strcmp(s->stack, stack) == 0)) {
+			return s;
+		}
+	}
+
+	size_t len = strlen(stack) + 1;
+	char *copy = ghost_malloc(sheap, len);
+
+	if(copy == NULL) {
+		return NULL;
+	}
+
+	memcpy(copy, stack, len);
+
+	prof->stacks[i].hash = hash;
+	prof->stacks[i].stack = copy;
+	prof->stacks[i].weight = 0;
+	prof->n_stacks += 1;
+
+	return &prof->stacks[i];
+}
+/*****************************************************************************/
+static size_t append_frame(
+	char *buf, size_t pos, size_t size, const lua_Debug *ar
+) {
+	const char *sep = (pos == 0) ? "" : ";";
+	const char *name = (ar->name != NULL) ? ar->name : "function";
+	int n;
+
+	if(*ar->what == 'C') {
+		n = ghost_snprintf(
+			buf + pos, size - pos, "%s%s@[C]", sep, name
+		);
+	} else if(*ar->what == 'm') {
+		n = ghost_snprintf(
+			buf + pos, size - pos, "%smain@%s", sep, ar->short_src
+		);
+	} else {
+		n = ghost_snprintf(
+			buf + pos,
+			size - pos,
+			"%s%s@%s:%d",
+			sep,
+			name,
+			ar->short_src,
+			ar->linedefined
+		);
+	}
+
+	/* a stack that doesn't fit is cut off at its leaf end */
+	if((n < 0) || ((pos + n) >= size)) {
+		return size;
+	}
+
+	return pos + n;
+}
+/*****************************************************************************/
+static void print_stat(
+	struct ghost_file *f, const char *name, const struct profile_stat *st
+) {
+	uint64_t mean = (st->calls == 0) ? 0 : st->ns / st->calls;
+
+	ghost_fprintf(
+		f,
+		"%10llu %12llu %10llu %10llu %14llu  %s\n",
+		(unsigned long long)st->calls,
+		(unsigned long long)(st->ns / 1000),
+		(unsigned long long)(mean / 1000),
+		(unsigned long long)(st->max_ns / 1000),
+		(unsigned long long)st->bytes,
+		name
+	);
+}
+/*****************************************************************************/
+static const struct profile_stat *stat_at(
+	const void *stats, size_t stride, size_t i
+) {
+	return (const struct profile_stat*)((const char*)stats + i * stride);
+}
+/*****************************************************************************/
+static void sort_by_time(
+	size_t *idx, size_t n, const void *stats, size_t stride
+) {
+	/* stats are stride bytes apart, so this sorts the stats embedded in
+	 * the handler table as well as the plain per syscall array; only a
+	 * few hundred entries, once at exit */
+	for(size_t i = 1; i < n; i++) {
+		size_t cur = idx[i];
+		uint64_t ns = stat_at(stats, stride, cur)->ns;
+		size_t j = i;
+
+		for(; j > 0; j--) {
+			if(stat_at(stats, stride, idx[j - 1])->ns >= ns) {
+				break;
+			}
+			idx[j] = idx[j - 1];
+		}
+		idx[j] = cur;
+	}
+}
+/*****************************************************************************/
+static int write_handlers(
+	const struct lua_profile *prof, struct ghost_file *f
+) {
+	size_t n = prof->n_handlers;
+
+	if(n == 0) {
+		return 0;
+	}
+
+	size_t *idx = ghost_malloc(sheap, n * sizeof(*idx));
+
+	if(idx == NULL) {
+		return -1;
+	}
+
+	for(size_t i = 0; i < n; i++) {
+		idx[i] = i;
+	}
+
+	sort_by_time(idx, n, &prof->handlers[0].stat, sizeof(*prof->handlers));
+
+	for(size_t i = 0; i < n; i++) {
+		const struct profile_handler *h = &prof->handlers[idx[i]];
+
+		print_stat(f, h->name, &h->stat);
+	}
+
+	ghost_free(sheap, idx);
+
+	return 0;
+}
+/*****************************************************************************/
+static int write_folded(const struct lua_profile *prof, const char *path)
+{
+	char folded_path[PATH_MAX + sizeof(FOLDED_SUFFIX)];
+
+	ghost_snprintf(
+		folded_path, sizeof(folded_path), "%s%s", path, FOLDED_SUFFIX
+	);
+
+	struct ghost_file *f = ghost_fopen(folded_path, "w");
+
+	if(f == NULL) {
+		return -1;
+	}
+
+	size_t capacity = (prof->stacks == NULL) ?
+		0 : ((size_t)1 << prof->stack_bits);
+
+	for(size_t i = 0; i < capacity; i++) {
+		const struct folded_stack *s = &prof->stacks[i];
+
+		if(s->hash != 0) {
+			ghost_fprintf(
+				f,
+				"%s %llu\n",
+				s->stack,
+				(unsigned long long)s->weight
+			);
+		}
+	}
+
+	return ghost_fclose(f);
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+struct lua_profile *lua_profile_create(void)
+{
+	struct lua_profile *prof = ghost_malloc(sheap, sizeof(*prof));
+
+	if(prof != NULL) {
+		memset(prof, 0, sizeof(*prof));
+	}
+
+	return prof;
+}
+/*****************************************************************************/
+void lua_profile_destroy(struct lua_profile *prof)
+{
+	if(prof == NULL) {
+		return;
+	}
+
+	for(size_t i = 0; i < prof->n_handlers; i++) {
+		ghost_free(sheap, prof->handlers[i].name);
+	}
+
+	size_t capacity = (prof->stacks == NULL) ?
+		0 : ((size_t)1 << prof->stack_bits);
+
+	for(size_t i = 0; i < capacity; i++) {
+		ghost_free(sheap, prof->stacks[i].stack);
+	}
+
+	ghost_free(sheap, prof->handlers);
+	ghost_free(sheap, prof->stacks);
+	ghost_free(sheap, prof);
+}
+/*****************************************************************************/
+int lua_profile_handler(struct lua_profile *prof, const char *name)
+{
+	/* reloading a script registers its handler again under the same
+	 * name, keep adding to what was there */
+	for(size_t i = 0; i < prof->n_handlers; i++) {
+		if(strcmp(prof->handlers[i].name, name) == 0) {
+			return i;
+		}
+	}
+
+	if(prof->n_handlers >= INT_MAX) {
+		return -1;
+	}
+
+	size_t len = strlen(name) + 1;
+	char *copy = ghost_malloc(sheap, len);
+	struct profile_handler *tmp = ghost_realloc(
+		sheap,
+		prof->handlers,
+		(prof->n_handlers + 1) * sizeof(*tmp)
+	);
+
+	if(tmp != NULL) {
+		prof->handlers = tmp;
+	}
+	if((copy == NULL) || (tmp == NULL)) {
+		ghost_free(sheap, copy);
+		return -1;
+	}
+
+	memcpy(copy, name, len);
+
+	struct profile_handler *h = &prof->handlers[prof->n_handlers];
+
+	memset(h, 0, sizeof(*h));
+	h->name = copy;
+
+	return prof->n_handlers++;
+}
+/*****************************************************************************/
+void lua_profile_call(
+	struct lua_profile *prof,
+	int handler,
+	int64_t sysno,
+	uint64_t ns,
+	uint64_t bytes
+) {
+	if((handler >= 0) && ((size_t)handler < prof->n_handlers)) {
+		stat_add(&prof->handlers[handler].stat, ns, bytes);
+	}
+
+	if((sysno >= 0) && (sysno < PROFILE_SYSCALLS)) {
+		stat_add(&prof->syscalls[sysno], ns, bytes);
+	} else {
+		stat_add(&prof->other, ns, bytes);
+	}
+}
+/*****************************************************************************/
+void lua_profile_sample(
+	struct lua_profile *prof, struct lua_State *ls, uint64_t weight
+) {
+	char buf[FOLDED_MAX];
+	lua_Debug ar;
+	size_t pos = 0;
+	int depth = 0;
+
+	while((depth < MAX_DEPTH) && lua_getstack(ls, depth, &ar)) {
+		depth++;
+	}
+
+	/* folded stacks are written root first */
+	for(int level = depth - 1; level >= 0; level--) {
+		if(!lua_getstack(ls, level, &ar)) {
+			continue;
+		} else if(!lua_getinfo(ls, "Sn", &ar)) {
+			continue;
+		}
+
+		pos = append_frame(buf, pos, sizeof(buf), &ar);
+
+		if(pos >= sizeof(buf)) {
+			break;
+		}
+	}
+
+	if(pos == 0) {
+		return;
+	}
+
+	buf[sizeof(buf) - 1] = '\0';
+
+	struct folded_stack *s = find_stack(prof, buf);
+
+	if(s != NULL) {
+		s->weight += weight;
+	}
+}
+/*****************************************************************************/
+int lua_profile_write(const struct lua_profile *prof, const char *path)
+{
+	size_t idx[PROFILE_SYSCALLS];
+	size_t n = 0;
+	char name[32];
+
+	struct ghost_file *f = ghost_fopen(path, "w");
+
+	if(f == NULL) {
+		return -1;
+	}
+
+	ghost_fprintf(f, "%s  %s\n", STAT_HEADER, "handler");
+
+	if(write_handlers(prof, f) != 0) {
+		ghost_fclose(f);
+		return -1;
+	}
+
+	ghost_fprintf(f, "\n%s  %s\n", STAT_HEADER, "event");
+
+	for(size_t i = 0; i < PROFILE_SYSCALLS; i++) {
+		if(prof->syscalls[i].calls != 0) {
+			idx[n++] = i;
+		}
+	}
+
+	sort_by_time(idx, n, prof->syscalls, sizeof(prof->syscalls[0]));
+
+	for(size_t i = 0; i < n; i++) {
+		const struct syscall_desc *desc = syscall_desc_lookup(idx[i]);
+
+		if((desc != NULL) && (desc->name != NULL)) {
+			ghost_snprintf(name, sizeof(name), "%s", desc->name);
+		} else {
+			ghost_snprintf(
+				name, sizeof(name), "syscall_%zu", idx[i]
+			);
+		}
+
+		print_stat(f, name, &prof->syscalls[idx[i]]);
+	}
+
+	if(prof->other.calls != 0) {
+		print_stat(f, "(not a system call)", &prof->other);
+	}
+
+	int ret = ghost_fclose(f);
+
+	if(write_folded(prof, path) != 0) {
+		ret = -1;
+	}
+
+	return ret;
+}
+/*****************************************************************************/
@@ -0,0 +1,56 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef LUA_PROFILE_H
+#define LUA_PROFILE_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct lua_State;
+struct lua_profile;
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+struct lua_profile *lua_profile_create(void);
+void lua_profile_destroy(struct lua_profile *prof);
+/* Returns the id that calls of the handler called name are accounted
+ * under, or -1 if it can't be tracked. */
+int lua_profile_handler(struct lua_profile *prof, const char *name);
+/* Accounts one callback call which took ns nanoseconds and allocated bytes
+ * from the Lua heap. sysno is the system call the event belongs to, or -1
+ * for events that aren't system call stops. */
+void lua_profile_call(
+	struct lua_profile *prof,
+	int handler,
+	int64_t sysno,
+	uint64_t ns,
+	uint64_t bytes
+);
+/* Records the Lua stack of ls as standing for weight VM instructions. */
+void lua_profile_sample(
+	struct lua_profile *prof, struct lua_State *ls, uint64_t weight
+);
+/* Writes the per handler and per system call summary to path and the
+ * sampled stacks, in folded form, to path.folded */
+int lua_profile_write(const struct lua_profile *prof, const char *path);
+/*****************************************************************************/
+#endif /* LUA_PROFILE_H */
@@ -0,0 +1,302 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "lua-shared.h"
+
+#include <safe_syscalls.h>
+#include <lua/lua.h>
+#include <lua/lauxlib.h>
+#include <utl/math-utl.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+enum shared_kind {
+	SHARED_FREE,
+	SHARED_COUNTER,
+	SHARED_HIST
+};
+/*****************************************************************************/
+struct shared_obj {
+	char name[LUA_SHARED_NAME_MAX];
+	enum shared_kind kind;
+
+	/* the counter's value, or the sum of what went into the histogram */
+	int64_t value;
+	uint64_t count;
+	uint64_t buckets[LUA_SHARED_BUCKETS];
+};
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const char LUA_SHARED_COUNTER_F[] = "LT_shared_counter";
+static const char LUA_SHARED_HIST_F[] = "LT_shared_hist";
+
+static const char COUNTER_MT[] = "LT_shared_counter";
+static const char HIST_MT[] = "LT_shared_hist";
+/******************************************************************************
+*                                    DATA                                     *
+******************************************************************************/
+static struct shared_obj objs[LUA_SHARED_MAX];
+/* only held to look up or add a name, see safe_mutex_lock() */
+static volatile uint32_t objs_lock;
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static bool objs_trylock(void)
+{
+	/* a holder that is stopped by the monitor never lets go while the
+	 * monitor waits, so nobody waits for long */
+	for(int i = 0; i < SAFE_SPIN_LIMIT; i++) {
+		if(safe_mutex_trylock(&objs_lock)) {
+			return true;
+		}
+		__builtin_ia32_pause();
+	}
+
+	return false;
+}
+/*****************************************************************************/
+static struct shared_obj *find_or_add(
+	const char *name, enum shared_kind kind, const char **why
+) {
+	struct shared_obj *free_obj = NULL;
+	struct shared_obj *found = NULL;
+
+	if(strlen(name) >= LUA_SHARED_NAME_MAX) {
+		*why = "name too long";
+		return NULL;
+	} else if(!objs_trylock()) {
+		*why = "shared data is busy, try again";
+		return NULL;
+	}
+
+	for(size_t i = 0; i < LUA_SHARED_MAX; i++) {
+		struct shared_obj *obj = objs + i;
+
+		if(obj->kind == SHARED_FREE) {
+			free_obj = (free_obj == NULL) ? obj : free_obj;
+		} else if(strcmp(obj->name, name) == 0) {
+			found = obj;
+			break;
+		}
+	}
+
+	if((found != NULL) && (found->kind != kind)) {
+		*why = "name already used for another kind of object";
+		found = NULL;
+	} else if((found == NULL) && (free_obj == NULL)) {
+		*why = "too many shared objects";
+	} else if(found == NULL) {
+		strcpy(free_obj->name, name);
+		free_obj->kind = kind;
+		found = free_obj;
+	}
+
+	safe_mutex_unlock(&objs_lock);
+
+	return found;
+}
+/*****************************************************************************/
+static int push_obj(lua_State *ls, enum shared_kind kind, const char *mt)
+{
+	const char *name = luaL_checkstring(ls, 1);
+	const char *why = NULL;
+	struct shared_obj *obj = find_or_add(name, kind, &why);
+
+	if(obj == NULL) {
+		lua_pushnil(ls);
+		lua_pushstring(ls, why);
+		return 2;
+	}
+
+	struct shared_obj **ud = lua_newuserdatauv(ls, sizeof(*ud), 0);
+
+	*ud = obj;
+	luaL_setmetatable(ls, mt);
+
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_lt_shared_counter(lua_State *ls)
+{
+	return push_obj(ls, SHARED_COUNTER, COUNTER_MT);
+}
+/*****************************************************************************/
+static int luaf_lt_shared_hist(lua_State *ls)
+{
+	return push_obj(ls, SHARED_HIST, HIST_MT);
+}
+/*****************************************************************************/
+static struct shared_obj *check_obj(lua_State *ls, const char *mt)
+{
+	return *(struct shared_obj**)luaL_checkudata(ls, 1, mt);
+}
+/*****************************************************************************/
+static int luaf_counter_add(lua_State *ls)
+{
+	struct shared_obj *obj = check_obj(ls, COUNTER_MT);
+	lua_Integer n = luaL_optinteger(ls, 2, 1);
+
+	lua_pushinteger(
+		ls, __atomic_add_fetch(&obj->value, n, __ATOMIC_RELAXED)
+	);
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_counter_get(lua_State *ls)
+{
+	struct shared_obj *obj = check_obj(ls, COUNTER_MT);
+
+	lua_pushinteger(ls, __atomic_load_n(&obj->value, __ATOMIC_RELAXED));
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_hist_add(lua_State *ls)
+{
+	struct shared_obj *obj = check_obj(ls, HIST_MT);
+	lua_Integer v = luaL_checkinteger(ls, 2);
+	lua_Integer n = luaL_optinteger(ls, 3, 1);
+	int64_t sum = __atomic_load_n(&obj->value, __ATOMIC_RELAXED);
+	int64_t next;
+
+	luaL_argcheck(ls, n > 0, 3, "must be positive");
+
+	__atomic_add_fetch(
+		obj->buckets + lua_shared_bucket(v), n, __ATOMIC_RELAXED
+	);
+	__atomic_add_fetch(&obj->count, n, __ATOMIC_RELAXED);
+
+	/* the sum stops at the ends of the range rather than wrapping */
+	do {
+		next = sat_add_mul_i64(sum, v, n);
+	} while(!__atomic_compare_exchange_n(
+		&obj->value, &sum, next, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED
+	));
+
+	return 0;
+}
+/*****************************************************************************/
+static int luaf_hist_count(lua_State *ls)
+{
+	struct shared_obj *obj = check_obj(ls, HIST_MT);
+
+	lua_pushinteger(ls, __atomic_load_n(&obj->count, __ATOMIC_RELAXED));
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_hist_sum(lua_State *ls)
+{
+	struct shared_obj *obj = check_obj(ls, HIST_MT);
+
+	lua_pushinteger(ls, __atomic_load_n(&obj->value, __ATOMIC_RELAXED));
+	return 1;
+}
+/*****************************************************************************/
+static int luaf_hist_snapshot(lua_State *ls)
+{
+	struct shared_obj *obj = check_obj(ls, HIST_MT);
+	lua_Integer n = 0;
+
+	/* { {lo, hi, count}, ... } for the buckets in use, lo inclusive
+	 * and hi exclusive */
+	lua_newtable(ls);
+
+	for(unsigned i = 0; i < LUA_SHARED_BUCKETS; i++) {
+		uint64_t *bucket = obj->buckets + i;
+		uint64_t c = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+
+		if(c == 0) {
+			continue;
+		}
+
+		lua_createtable(ls, 3, 0);
+
+		if(i == 0) {
+			lua_pushinteger(ls, INT64_MIN);
+			lua_rawseti(ls, -2, 1);
+			lua_pushinteger(ls, 1);
+		} else {
+			lua_pushinteger(ls, (lua_Integer)1 << (i - 1));
+			lua_rawseti(ls, -2, 1);
+			/* the top bucket runs to the largest integer */
+			lua_pushinteger(
+				ls,
+				(i == LUA_SHARED_BUCKETS - 1) ?
+					INT64_MAX : (lua_Integer)1 << i
+			);
+		}
+
+		lua_rawseti(ls, -2, 2);
+		lua_pushinteger(ls, c);
+		lua_rawseti(ls, -2, 3);
+
+		lua_rawseti(ls, -2, ++n);
+	}
+
+	return 1;
+}
+/*****************************************************************************/
+static void setup_mt(lua_State *ls, const char *mt, const luaL_Reg *methods)
+{
+	luaL_newmetatable(ls, mt);
+	lua_newtable(ls);
+	luaL_setfuncs(ls, methods, 0);
+	lua_setfield(ls, -2, "__index");
+	lua_pop(ls, 1);
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+unsigned lua_shared_bucket(int64_t v)
+{
+	if(v < 1) {
+		return 0;
+	}
+
+	return 64 - __builtin_clzll((uint64_t)v);
+}
+/*****************************************************************************/
+void lua_shared_setup(lua_State *ls)
+{
+	static const luaL_Reg counter_methods[] = {
+		{"add", luaf_counter_add},
+		{"get", luaf_counter_get},
+		{NULL, NULL}
+	};
+	static const luaL_Reg hist_methods[] = {
+		{"add", luaf_hist_add},
+		{"count", luaf_hist_count},
+		{"sum", luaf_hist_sum},
+		{"snapshot", luaf_hist_snapshot},
+		{NULL, NULL}
+	};
+
+	setup_mt(ls, COUNTER_MT, counter_methods);
+	setup_mt(ls, HIST_MT, hist_methods);
+
+	lua_register(ls, LUA_SHARED_COUNTER_F, luaf_lt_shared_counter);
+	lua_register(ls, LUA_SHARED_HIST_F, luaf_lt_shared_hist);
+}
+/*****************************************************************************/
@@ -0,0 +1,45 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef LUA_SHARED_H
+#define LUA_SHARED_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+#define LUA_SHARED_MAX 128
+#define LUA_SHARED_NAME_MAX 32
+/* one for values below 1 and one for each power of two after that */
+#define LUA_SHARED_BUCKETS 64
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+struct lua_State;
+
+/* Registers LT_shared_counter and LT_shared_hist. They hand out named
+ * counters and log2 histograms kept in C memory rather than in any one Lua
+ * state, so every state that asks for the same name gets the same one and
+ * updates to it are atomic. Objects last as long as the trace. */
+void lua_shared_setup(struct lua_State *ls);
+/* the bucket of v in a shared histogram */
+unsigned lua_shared_bucket(int64_t v);
+/*****************************************************************************/
+#endif /* LUA_SHARED_H */
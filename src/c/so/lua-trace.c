@@ -20,26 +20,116 @@
 *                                  INCLUDES                                   *
 ******************************************************************************/
 #include "lua-trace.h"
+#include "lua-cache.h"
+#include "lua-profile.h"
+#include "lua-mem.h"
+#include "lua-shared.h"
+#include "lua-agg.h"
+#include "lua-gc.h"
 #include "lua/lua.h"
 
 
 #include <trace-print-tools.h>
+#include <syscall-table.h>
 #include <trace.h>
+#include <tracee-state-table.h>
+#include <tracee-mem.h>
+#include <tracee-syms.h>
+#include <trace-break.h>
+#include <trace-hook.h>
+#include <trace-watch.h>
+#include <trace-clock.h>
 #include <secret-heap.h>
+#include <safe_syscalls.h>
 #include <assert.h>
 #include <gio/ghost-stdio.h>
 
 #include <lua/lualib.h>
 #include <lua/lauxlib.h>
+#include <utl/math-utl.h>
 
 #include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
 /******************************************************************************
 *                                    TYPES                                    *
 ******************************************************************************/
+/* One of the extra states hooks run in with --lua-states, each loaded with
+ * the entry script and allocating from a heap of its own. Its extra space
+ * points back here, the main state's holds NULL. */
+struct lua_pool_state {
+	lua_State *ls;
+	struct ghost_heap *heap;
+	struct lua_mem_ctx mem;
+	struct lua_gc_ctx gc;
+	/* held while a hook runs in it, see safe_mutex_lock() */
+	volatile uint32_t lock;
+	/* LT_exit() function, LUA_NOREF if none */
+	int exit_ref;
+};
+/*****************************************************************************/
+/* an event that came while a hooked thread had the state */
+struct lua_deferred {
+	struct tracee_state state;
+	/* from the thread's record, an exit's is gone by the time the event
+	 * gets handled */
+	bool has_thread;
+	pid_t proc;
+	int32_t user_ref;
+};
+/*****************************************************************************/
 struct lua_trace_data {
 	lua_State *ls;
 	const char *ent;
+	const char *cache_dir;
 	int lua_cb_ref;
+
+	/* per call limits on the callback, 0 for none */
+	uint32_t budget;
+	uint64_t timeout_ns;
+
+	/* watchdog state for the call in progress */
+	uint32_t hook_step;
+	uint64_t executed;
+	uint64_t deadline;
+	bool overrun;
+
+	/* overruns in total and since the last call that finished in time */
+	uint64_t overruns;
+	unsigned strikes;
+
+	/* bytes ever handed out to the Lua state, frees don't count */
+	uint64_t alloc_bytes;
+
+	/* NULL unless profiling, prof_handler is the id of the callback */
+	const char *prof_path;
+	struct lua_profile *prof;
+	int prof_handler;
+
+	/* thread whose event is being handled, shared with lua-mem.c */
+	struct lua_mem_ctx mem;
+
+	/* events that went by while a hooked thread had the state */
+	uint64_t busy_skips;
+
+	/* exits, breakpoint and watch stops that can't just go by, handled
+	 * in order once the hooked thread lets go */
+	struct lua_deferred *deferred;
+	uint32_t deferred_len;
+	uint32_t deferred_cap;
+
+	/* LT_exit() function of the main state, LUA_NOREF if none */
+	int exit_ref;
+
+	/* states hooks run in instead of ls, none unless --lua-states */
+	struct lua_pool_state *pool;
+	uint32_t pool_size;
+
+	/* --lua-gc, and the collector of ls as LT_gc_config() left it */
+	enum lua_gc_mode gc_mode;
+	uint32_t gc_a;
+	uint32_t gc_b;
+	struct lua_gc_ctx gc;
 };
 /******************************************************************************
 *                                  CONSTANTS                                  *
@@ -48,13 +138,59 @@ const char LUA_TRACE_INIT_F[] = "LT_init";
 const char LUA_READ_CSTR_F[] = "LT_read_cstr";
 const char LUA_FMT_BUFFER_F[] = "LT_fmt_buffer";
 const char LUA_FMT_STR_F[] = "LT_fmt_cstr";
+const char LUA_SYSCALL_INFO_F[] = "LT_syscall_info";
+const char LUA_FMT_SYSCALL_F[] = "LT_fmt_syscall";
+const char LUA_NOW_F[] = "LT_now";
+const char LUA_SAMPLE_F[] = "LT_sample";
+const char LUA_DUTY_F[] = "LT_duty";
+const char LUA_SYM_F[] = "LT_sym";
+const char LUA_ADDR2SYM_F[] = "LT_addr2sym";
+const char LUA_BREAK_F[] = "LT_break";
+const char LUA_HOOK_F[] = "LT_hook";
+const char LUA_WATCH_F[] = "LT_watch";
+const char LUA_EXIT_F[] = "LT_exit";
+
+static const size_t SYSCALL_LINE_SIZE = 2048;
+static const size_t READ_CSTR_MAX = 1 << 20;
+/* VM instructions between looks at the clock when a timeout is set */
+static const uint32_t WATCHDOG_STEP = 1000;
+/* a callback that overruns this many calls in a row is dropped */
+static const unsigned OVERRUN_STRIKES = 3;
+/* VM instructions between stack samples when profiling */
+static const uint32_t PROFILE_STEP = 1000;
+/* most states --lua-states gives hooks */
+static const uint32_t LUA_POOL_MAX = 64;
+
+/* registry field holding the breakpoint functions, keyed by address */
+static const char BREAK_TABLE[] = "LT_breakpoints";
+/* and the one holding the hook functions */
+static const char HOOK_TABLE[] = "LT_hooks";
+/* and the watch functions */
+static const char WATCH_TABLE[] = "LT_watches";
 /******************************************************************************
 *                                    DATA                                     *
 ******************************************************************************/
 static struct lua_trace_data trace_data;
+/* pool state a hooked thread last ran in, no syscall needed to find it */
+static __thread uint32_t pool_hint __attribute__((tls_model("initial-exec")));
 /******************************************************************************
 *                              STATIC FUNCTIONS                               *
 ******************************************************************************/
+static struct lua_pool_state *pool_of(lua_State *ls)
+{
+	return *(struct lua_pool_state**)lua_getextraspace(ls);
+}
+/*****************************************************************************/
+static const struct tracee_record *mem_cur(lua_State *ls)
+{
+	/* pool states only ever run hooks, in our own address space */
+	if(pool_of(ls) != NULL) {
+		return NULL;
+	}
+
+	return trace_data.mem.cur;
+}
+/*****************************************************************************/
 static void arg_num_err(
 	lua_State *ls, char **s, const char *name, int expected, int actual
 ) {
@@ -69,7 +205,10 @@ static void arg_num_err(
 		expected,
 		actual
 	);
+	/* lua_error() does not return to the caller's ghost_free() */
 	lua_pushstring(ls, *s);
+	ghost_free(sheap, *s);
+	*s = NULL;
 	lua_error(ls);
 }
 /*****************************************************************************/
@@ -94,6 +233,8 @@ static void arg_type_err(
 		lua_typename(ls, aindex)
 	);
 	lua_pushstring(ls, *s);
+	ghost_free(sheap, *s);
+	*s = NULL;
 	lua_error(ls);
 }
 /*****************************************************************************/
@@ -108,11 +249,25 @@ static int pop_int(lua_State *ls, int64_t *i)
 	}
 }
 /*****************************************************************************/
+static void push_buffer_repr(
+	lua_State *ls, const char *buf, int64_t len, int64_t print_size
+) {
+	luaL_Buffer b;
+	size_t space = (print_size < 0) ? 1 : (size_t)print_size + 1;
+
+	/* formatted straight into the string under construction, a
+	 * representation that doesn't fit at all comes out empty */
+	char *repr = luaL_buffinitsize(ls, &b, space);
+	ssize_t n = sprint_buffer_len(buf, repr, len, space);
+
+	luaL_pushresultsize(&b, (n < 0) ? 0 : n);
+}
+/*****************************************************************************/
 static int luaf_lt_fmt_cstr(lua_State *ls)
 {
 	int stack_size = lua_gettop(ls);
 	char *err = NULL;
-	char *repr = NULL;
+	void *scratch = NULL;
 
 	int ret = 0;
 
@@ -121,33 +276,35 @@ static int luaf_lt_fmt_cstr(lua_State *ls)
 		goto exit;
 	}
 
-	union {
-		int64_t i;
-		const char *p;
-	} buf_union;
-
-	int64_t buf_size;
+	int64_t addr;
+	size_t buf_size;
 	int64_t print_size;
 
 	if(pop_int(ls, &print_size) != 0) {
 		arg_type_err(ls, &err, LUA_FMT_STR_F, 2, -1, "integer");
 		goto exit;
 	}
-	if(pop_int(ls, &buf_union.i) != 0) {
+	if(pop_int(ls, &addr) != 0) {
 		arg_type_err(ls, &err, LUA_FMT_STR_F, 1, -1, "integer");
 		goto exit;
 	}
 
 	ret = 1;
 
-	buf_size = strlen(buf_union.p);
+	/* sprint_buffer() reads at most one byte past the space it is
+	 * given, anything beyond that only costs time */
+	const char *buf = tracee_mem_view_str(
+		mem_cur(ls), addr, print_size + 2, &scratch, &buf_size
+	);
 
-	repr = ghost_malloc(sheap, print_size + 1);
-	sprint_buffer(buf_union.p, repr, buf_size, print_size + 1);
+	if(buf == NULL) {
+		lua_pushfstring(ls, "%p", (void*)addr);
+		goto exit;
+	}
 
-	lua_pushstring(ls, repr);
+	push_buffer_repr(ls, buf, buf_size, print_size);
 exit:
-	ghost_free(sheap, repr);
+	ghost_free(sheap, scratch);
 	ghost_free(sheap, err);
 	return ret;
 }
@@ -156,7 +313,7 @@ static int luaf_lt_fmt_buffer(lua_State *ls)
 {
 	int stack_size = lua_gettop(ls);
 	char *err = NULL;
-	char *repr = NULL;
+	void *scratch = NULL;
 
 	int ret = 0;
 
@@ -165,11 +322,7 @@ static int luaf_lt_fmt_buffer(lua_State *ls)
 		goto exit;
 	}
 
-	union {
-		int64_t i;
-		const char *p;
-	} buf_union;
-
+	int64_t addr;
 	int64_t buf_size;
 	int64_t print_size;
 
@@ -181,19 +334,29 @@ static int luaf_lt_fmt_buffer(lua_State *ls)
 		arg_type_err(ls, &err, LUA_FMT_BUFFER_F, 2, -1, "integer");
 		goto exit;
 	}
-	if(pop_int(ls, &buf_union.i) != 0) {
+	if(pop_int(ls, &addr) != 0) {
 		arg_type_err(ls, &err, LUA_FMT_BUFFER_F, 1, -1, "integer");
 		goto exit;
 	}
 
 	ret = 1;
 
-	repr = ghost_malloc(sheap, print_size + 1);
-	sprint_buffer(buf_union.p, repr, buf_size, print_size + 1);
+	size_t got;
+	size_t want = (buf_size < 0) ? 0 : min_u64(buf_size, print_size + 2);
+	const char *buf = tracee_mem_view(
+		mem_cur(ls), addr, want, &scratch, &got
+	);
+
+	if((buf == NULL) && (addr != 0)) {
+		lua_pushfstring(ls, "%p", (void*)addr);
+		goto exit;
+	}
 
-	lua_pushstring(ls, repr);
+	int64_t len = (got == want) ? buf_size : (int64_t)got;
+
+	push_buffer_repr(ls, buf, len, print_size);
 exit:
-	ghost_free(sheap, repr);
+	ghost_free(sheap, scratch);
 	ghost_free(sheap, err);
 	return ret;
 }
@@ -202,239 +365,1743 @@ static int luaf_lt_read_cstr(lua_State *ls)
 {
 	int stack_size = lua_gettop(ls);
 	char *err = NULL;
+	void *scratch = NULL;
 	int ret = 0;
 
-	union {
-		int64_t i;
-		const char *str;
-	} u;
-
+	int64_t addr;
+	size_t len;
 
 	if(stack_size != 1) {
 		arg_num_err(ls, &err, LUA_READ_CSTR_F, 1, stack_size);
 		goto exit;
 	}
 
-	if(pop_int(ls, &u.i) != 0) {
+	if(pop_int(ls, &addr) != 0) {
 		arg_type_err(ls, &err, LUA_READ_CSTR_F, 1, -1, "integer");
 		goto exit;
 	}
 
 	ret = 1;
-	lua_pushstring(ls, u.str);
+
+	const char *str = tracee_mem_view_str(
+		mem_cur(ls), addr, READ_CSTR_MAX, &scratch, &len
+	);
+
+	if(str == NULL) {
+		lua_pushnil(ls);
+	} else {
+		lua_pushlstring(ls, str, len);
+	}
 exit:
+	ghost_free(sheap, scratch);
 	ghost_free(sheap, err);
 	return ret;
 }
 /*****************************************************************************/
-static int luaf_lua_trace_init(lua_State *ls)
+static uint64_t get_int_field(lua_State *ls, int tab_idx, const char *field)
+{
+	uint64_t val = 0;
+
+	if(lua_getfield(ls, tab_idx, field) == LUA_TNUMBER) {
+		val = lua_tointeger(ls, -1);
+	}
+	lua_pop(ls, 1);
+
+	return val;
+}
+/*****************************************************************************/
+static void pull_lua_uregs(
+	lua_State *ls, int tab_idx, struct user_regs_struct *uregs
+) {
+	memset(uregs, 0, sizeof(*uregs));
+
+	uregs->orig_rax = get_int_field(ls, tab_idx, "orig_rax");
+	uregs->rax = get_int_field(ls, tab_idx, "rax");
+	uregs->rdi = get_int_field(ls, tab_idx, "rdi");
+	uregs->rsi = get_int_field(ls, tab_idx, "rsi");
+	uregs->rdx = get_int_field(ls, tab_idx, "rdx");
+	uregs->r10 = get_int_field(ls, tab_idx, "r10");
+	uregs->r8 = get_int_field(ls, tab_idx, "r8");
+	uregs->r9 = get_int_field(ls, tab_idx, "r9");
+}
+/*****************************************************************************/
+static int luaf_lt_fmt_syscall(lua_State *ls)
 {
 	int stack_size = lua_gettop(ls);
 	char *err = NULL;
+	char *line = NULL;
 
-	if(stack_size != 1) {
-		arg_num_err(ls, &err, LUA_TRACE_INIT_F, 1, stack_size);
+	int ret = 0;
+
+	if(stack_size != 2) {
+		arg_num_err(ls, &err, LUA_FMT_SYSCALL_F, 2, stack_size);
 		goto exit;
 	}
 
+	int64_t print_size;
+	struct user_regs_struct uregs;
 
-	if(!lua_isfunction(ls, 1)) {
-		arg_type_err(ls, &err, LUA_TRACE_INIT_F, 1, -1, "function");
+	if(pop_int(ls, &print_size) != 0) {
+		arg_type_err(ls, &err, LUA_FMT_SYSCALL_F, 2, -1, "integer");
+		goto exit;
+	}
+	if(!lua_istable(ls, 1)) {
+		arg_type_err(ls, &err, LUA_FMT_SYSCALL_F, 1, 1, "table");
 		goto exit;
 	}
 
-	int method_ref = luaL_ref(ls, LUA_REGISTRYINDEX);
-	trace_data.lua_cb_ref = method_ref;
+	pull_lua_uregs(ls, 1, &uregs);
+
+	ret = 1;
+
+	line = ghost_malloc(sheap, SYSCALL_LINE_SIZE);
+	sprint_syscall(
+		line, SYSCALL_LINE_SIZE, &uregs, mem_cur(ls), print_size
+	);
 
+	lua_pushstring(ls, line);
 exit:
+	ghost_free(sheap, line);
 	ghost_free(sheap, err);
-	return 0;
+	return ret;
 }
 /*****************************************************************************/
-static void define_global_int(struct lua_State *ls, const char *name, int val)
+static int luaf_lt_syscall_info(lua_State *ls)
 {
-	lua_pushinteger(ls, val);
-	lua_setglobal(ls, name);
-}
-/*****************************************************************************/
-static void insert_int64_to_table(
-	struct lua_State *ls, int tab_idx, const char *field, int64_t val
-) {
-	lua_pushinteger(ls, val);
-	lua_setfield(ls, tab_idx, field);
-}
-/*****************************************************************************/
-static void push_lua_uregs(
-	struct lua_State *ls, const struct user_regs_struct *uregs
-) {
+	int stack_size = lua_gettop(ls);
+	char *err = NULL;
+	int64_t no;
+
+	if(stack_size != 1) {
+		arg_num_err(ls, &err, LUA_SYSCALL_INFO_F, 1, stack_size);
+		goto exit;
+	}
+
+	if(pop_int(ls, &no) != 0) {
+		arg_type_err(ls, &err, LUA_SYSCALL_INFO_F, 1, -1, "integer");
+		goto exit;
+	}
+
+	const struct syscall_desc *desc = syscall_desc_lookup(no);
+
+	if(desc == NULL) {
+		lua_pushnil(ls);
+		goto exit;
+	}
+
 	lua_newtable(ls);
-	int i = lua_gettop(ls);
+	int info = lua_gettop(ls);
 
-	insert_int64_to_table(ls, i, "r15", uregs->r15);
-	insert_int64_to_table(ls, i, "r15", uregs->r15);
-	insert_int64_to_table(ls, i, "r14", uregs->r14);
-	insert_int64_to_table(ls, i, "r13", uregs->r13);
-	insert_int64_to_table(ls, i, "r12", uregs->r12);
-	insert_int64_to_table(ls, i, "rbp", uregs->rbp);
-	insert_int64_to_table(ls, i, "rbx", uregs->rbx);
-	insert_int64_to_table(ls, i, "r11", uregs->r11);
-	insert_int64_to_table(ls, i, "r10", uregs->r10);
-	insert_int64_to_table(ls, i, "r9", uregs->r9);
-	insert_int64_to_table(ls, i, "r8", uregs->r8);
-	insert_int64_to_table(ls, i, "rax", uregs->rax);
-	insert_int64_to_table(ls, i, "rcx", uregs->rcx);
-	insert_int64_to_table(ls, i, "rdx", uregs->rdx);
-	insert_int64_to_table(ls, i, "rsi", uregs->rsi);
-	insert_int64_to_table(ls, i, "rdi", uregs->rdi);
-	insert_int64_to_table(ls, i, "orig_rax", uregs->orig_rax);
-	insert_int64_to_table(ls, i, "rip", uregs->rip);
-	insert_int64_to_table(ls, i, "cs", uregs->cs);
-	insert_int64_to_table(ls, i, "eflags", uregs->eflags);
-	insert_int64_to_table(ls, i, "rsp", uregs->rsp);
-	insert_int64_to_table(ls, i, "ss", uregs->ss);
-	insert_int64_to_table(ls, i, "fs_base", uregs->fs_base);
-	insert_int64_to_table(ls, i, "gs_base", uregs->gs_base);
-	insert_int64_to_table(ls, i, "ds", uregs->ds);
-	insert_int64_to_table(ls, i, "es", uregs->es);
-	insert_int64_to_table(ls, i, "fs", uregs->fs);
-	insert_int64_to_table(ls, i, "gs", uregs->gs);
+	lua_pushstring(ls, desc->name);
+	lua_setfield(ls, info, "name");
+	lua_pushstring(ls, syscall_ret_kind_name(desc->ret));
+	lua_setfield(ls, info, "ret");
+
+	lua_newtable(ls);
+	int args = lua_gettop(ls);
+
+	for(int i = 0; i < syscall_desc_nargs(desc); i++) {
+		const struct syscall_arg_desc *arg = &desc->args[i];
+
+		lua_newtable(ls);
+		lua_pushstring(ls, syscall_arg_kind_name(arg->kind));
+		lua_setfield(ls, -2, "kind");
+
+		if(arg->kind == SC_ARG_BUF) {
+			lua_pushinteger(ls, arg->len_arg);
+			lua_setfield(ls, -2, "len_arg");
+		}
+
+		lua_rawseti(ls, args, i + 1);
+	}
+
+	lua_setfield(ls, info, "args");
+exit:
+	ghost_free(sheap, err);
+	return 1;
 }
 /*****************************************************************************/
-static void setup_lua_runtime(const struct lua_trace_data *dat)
+static int luaf_lt_now(lua_State *ls)
 {
-	struct lua_State *ls = dat->ls;
+	int stack_size = lua_gettop(ls);
+	char *err = NULL;
 
-	luaL_openlibs(ls);
-	lua_register(ls, LUA_TRACE_INIT_F, luaf_lua_trace_init);
-	lua_register(ls, LUA_READ_CSTR_F, luaf_lt_read_cstr);
-	lua_register(ls, LUA_FMT_BUFFER_F, luaf_lt_fmt_buffer);
-	lua_register(ls, LUA_FMT_STR_F, luaf_lt_fmt_cstr);
+	if(stack_size != 0) {
+		arg_num_err(ls, &err, LUA_NOW_F, 0, stack_size);
+	}
 
-	define_global_int(ls, "LT_STARTED", STARTED);
-	define_global_int(ls, "LT_EXIT_NORMAL", EXITED_NORMAL);
-	define_global_int(ls, "LT_EXIT_UNEXPECT", EXITED_UNEXPECTED);
-	define_global_int(ls, "LT_SYSCALL_ENTER", SYSCALL_ENTER_STOP);
-	define_global_int(ls, "LT_SYSCALL_EXIT", SYSCALL_EXIT_STOP);
-	define_global_int(ls, "LT_SIG_DELIVER", SIGNAL_DELIVERY_STOP);
-	define_global_int(ls, "LT_GROUP_STOP", GROUP_STOP);
-	define_global_int(ls, "LT_PTRACE_EVENT", PTRACE_EVENT_OCCURED_STOP);
-	define_global_int(ls, "LT_EXEC_OCCURED", PTRACE_EXEC_OCCURED);
+	lua_pushinteger(ls, trace_clock_now());
+
+	ghost_free(sheap, err);
+	return 1;
 }
 /*****************************************************************************/
-static void *alloc_f(void *ud, void *ptr, size_t osize, size_t nsize)
+static int luaf_lt_sample(lua_State *ls)
 {
-	struct ghost_heap *heap = ud;
+	int stack_size = lua_gettop(ls);
+	char *err = NULL;
+	int64_t rate;
 
-	if(nsize == 0) {
-		ghost_free(heap, ptr);
-		return NULL;
-	} else {
-		return ghost_realloc(heap, ptr, nsize);
+	if(stack_size != 1) {
+		arg_num_err(ls, &err, LUA_SAMPLE_F, 1, stack_size);
+		goto exit;
+	}
+
+	if((pop_int(ls, &rate) != 0) || (rate < 0) || (rate > UINT32_MAX)) {
+		arg_type_err(ls, &err, LUA_SAMPLE_F, 1, -1, "unsigned");
+		goto exit;
 	}
+
+	trace_set_sample_rate(rate);
+exit:
+	ghost_free(sheap, err);
+	return 0;
 }
 /*****************************************************************************/
-static void *handler(void *arg, const struct tracee_state *state)
+static int luaf_lt_duty(lua_State *ls)
 {
-	struct lua_trace_data *dat = (struct lua_trace_data*)arg;
-	struct lua_State *ls = dat->ls;
-	const struct user_regs_struct *uregs = &state->data.regs;
+	int stack_size = lua_gettop(ls);
+	char *err = NULL;
+	int64_t on;
+	int64_t period;
 
-	if(dat->lua_cb_ref < 0) {
-		return arg;
+	if(stack_size != 2) {
+		arg_num_err(ls, &err, LUA_DUTY_F, 2, stack_size);
+		goto exit;
+	}
+
+	if((pop_int(ls, &period) != 0) || (period < 0)) {
+		arg_type_err(ls, &err, LUA_DUTY_F, 2, -1, "unsigned");
+		goto exit;
+	}
+	if((pop_int(ls, &on) != 0) || (on < 0)) {
+		arg_type_err(ls, &err, LUA_DUTY_F, 1, -1, "unsigned");
+		goto exit;
 	}
 
+	int ret = trace_set_duty_cycle(
+		on * TRACE_CLOCK_NS_PER_MS, period * TRACE_CLOCK_NS_PER_MS
+	);
 
-	lua_rawgeti(ls, LUA_REGISTRYINDEX, dat->lua_cb_ref);
+	lua_pushboolean(ls, ret == 0);
+exit:
+	ghost_free(sheap, err);
+	return 1;
+}
+/*****************************************************************************/
+static pid_t syms_pid(lua_State *ls)
+{
+	/* threads that share the monitor's address space all resolve
+	 * through its own memory map */
+	return tracee_mem_space(mem_cur(ls));
+}
+/*****************************************************************************/
+static int luaf_lt_sym(lua_State *ls)
+{
+	int stack_size = lua_gettop(ls);
+	char *err = NULL;
+	const char *module = NULL;
+	uint64_t addr;
+	uint64_t size;
 
-	lua_pushinteger(ls, state->status);
-	lua_pushinteger(ls, state->pid);
-	push_lua_uregs(ls, uregs);
+	if((stack_size != 1) && (stack_size != 2)) {
+		arg_num_err(ls, &err, LUA_SYM_F, 2, stack_size);
+		goto exit;
+	}
+
+	if(stack_size == 2) {
+		if(!lua_isstring(ls, 2)) {
+			arg_type_err(ls, &err, LUA_SYM_F, 2, 2, "string");
+			goto exit;
+		}
+		module = lua_tostring(ls, 2);
+	}
+	if(!lua_isstring(ls, 1)) {
+		arg_type_err(ls, &err, LUA_SYM_F, 1, 1, "string");
+		goto exit;
+	}
 
-	int err = lua_pcall(ls, 3, 0, 0);
+	const char *name = lua_tostring(ls, 1);
+	pid_t pid = syms_pid(ls);
 
-	if(err != LUA_OK) {
-		const char *err_msg = lua_tostring(ls, -1);
-		ghost_fprintf(
-			ghost_stderr,
-			"Error in lua callback: %s\n",
-			err_msg
-		);
+	if(tracee_syms_lookup(pid, name, module, &addr, &size) != 0) {
+		lua_pushnil(ls);
+		goto exit;
 	}
 
-	return arg;
+	lua_pushinteger(ls, addr);
+	lua_pushinteger(ls, size);
+	ghost_free(sheap, err);
+	return 2;
+exit:
+	ghost_free(sheap, err);
+	return 1;
 }
 /*****************************************************************************/
-static void *handler_init(void *arg)
+static int luaf_lt_addr2sym(lua_State *ls)
 {
-	int err;
-	const char *err_msg;
+	int stack_size = lua_gettop(ls);
+	char *err = NULL;
+	int64_t addr;
+	struct tracee_sym sym;
 
-	lua_State *ls = lua_newstate(alloc_f, sheap);
-	trace_data.ls = ls;
-	trace_data.lua_cb_ref = -1;
+	if(stack_size != 1) {
+		arg_num_err(ls, &err, LUA_ADDR2SYM_F, 1, stack_size);
+		goto exit;
+	}
 
-	assert(trace_data.ls != NULL);
+	if(pop_int(ls, &addr) != 0) {
+		arg_type_err(ls, &err, LUA_ADDR2SYM_F, 1, -1, "integer");
+		goto exit;
+	}
 
-	setup_lua_runtime(&trace_data);
+	if(tracee_syms_addr2sym(syms_pid(ls), addr, &sym) != 0) {
+		lua_pushnil(ls);
+		goto exit;
+	}
 
+	if(sym.name == NULL) {
+		lua_pushnil(ls);
+	} else {
+		lua_pushstring(ls, sym.name);
+	}
+	lua_pushinteger(ls, sym.offset);
+	lua_pushstring(ls, sym.module);
 
-	err = luaL_loadfile(ls, trace_data.ent);
+	ghost_free(sheap, err);
+	return 3;
+exit:
+	ghost_free(sheap, err);
+	return 1;
+}
+/*****************************************************************************/
+static void set_break_fn(lua_State *ls, uint64_t addr, int fn_idx)
+{
+	lua_getfield(ls, LUA_REGISTRYINDEX, BREAK_TABLE);
+	lua_pushvalue(ls, fn_idx);
+	lua_rawseti(ls, -2, addr);
+	lua_pop(ls, 1);
+}
+/*****************************************************************************/
+static int luaf_lt_break(lua_State *ls)
+{
+	int stack_size = lua_gettop(ls);
+	char *err = NULL;
+	uint64_t addr;
+	uint64_t size;
+	pid_t space = syms_pid(ls);
+
+	if(stack_size != 2) {
+		arg_num_err(ls, &err, LUA_BREAK_F, 2, stack_size);
+		goto exit;
+	}
+
+	if(!lua_isfunction(ls, 2) && !lua_isnil(ls, 2)) {
+		arg_type_err(ls, &err, LUA_BREAK_F, 2, 2, "function or nil");
+		goto exit;
+	}
+
+	if(lua_isinteger(ls, 1)) {
+		addr = lua_tointeger(ls, 1);
+	} else if(lua_type(ls, 1) != LUA_TSTRING) {
+		arg_type_err(ls, &err, LUA_BREAK_F, 1, 1, "integer or string");
+		goto exit;
+	} else if(tracee_syms_lookup(
+		space, lua_tostring(ls, 1), NULL, &addr, &size
+	) != 0) {
+		lua_pushnil(ls);
+		lua_pushstring(ls, "unknown symbol");
+		ghost_free(sheap, err);
+		return 2;
+	}
+
+	/* the main state sets the breakpoints, the pool's copies of the
+	 * script only run hooks */
+	if(pool_of(ls) != NULL) {
+		lua_pushinteger(ls, addr);
+		goto exit;
+	} else if(lua_isnil(ls, 2)) {
+		trace_break_remove(addr);
+	} else if(trace_break_insert(space, addr) != 0) {
+		lua_pushnil(ls);
+		lua_pushstring(ls, "unable to set a breakpoint");
+		ghost_free(sheap, err);
+		return 2;
+	}
+
+	set_break_fn(ls, addr, 2);
+	lua_pushinteger(ls, addr);
+exit:
+	ghost_free(sheap, err);
+	return 1;
+}
+/*****************************************************************************/
+static void set_hook_fn(lua_State *ls, uint64_t addr, int fn_idx)
+{
+	lua_getfield(ls, LUA_REGISTRYINDEX, HOOK_TABLE);
+	lua_pushvalue(ls, fn_idx);
+	lua_rawseti(ls, -2, addr);
+	lua_pop(ls, 1);
+}
+/*****************************************************************************/
+static int luaf_lt_hook(lua_State *ls)
+{
+	int stack_size = lua_gettop(ls);
+	char *err = NULL;
+	const char *why = NULL;
+	uint64_t addr;
+	uint64_t size;
+	pid_t space = syms_pid(ls);
+
+	if(stack_size != 2) {
+		arg_num_err(ls, &err, LUA_HOOK_F, 2, stack_size);
+		goto exit;
+	}
+
+	if(!lua_isfunction(ls, 2) && !lua_isnil(ls, 2)) {
+		arg_type_err(ls, &err, LUA_HOOK_F, 2, 2, "function or nil");
+		goto exit;
+	}
+
+	if(lua_isinteger(ls, 1)) {
+		addr = lua_tointeger(ls, 1);
+	} else if(lua_type(ls, 1) != LUA_TSTRING) {
+		arg_type_err(ls, &err, LUA_HOOK_F, 1, 1, "integer or string");
+		goto exit;
+	} else if(tracee_syms_lookup(
+		space, lua_tostring(ls, 1), NULL, &addr, &size
+	) != 0) {
+		why = "unknown symbol";
+	}
+
+	/* the trampolines live in our address space, a followed child only
+	 * has a copy of them */
+	if((why == NULL) && (space != 0)) {
+		why = "hooks only work in the process we were loaded into";
+	}
+
+	if(why != NULL) {
+		goto fail;
+	}
+
+	/* the main state puts the jmps in, pool states only keep their own
+	 * copy of the functions */
+	bool main_state = (pool_of(ls) == NULL);
+
+	if(main_state && lua_isnil(ls, 2)) {
+		trace_hook_remove(addr);
+	} else if(main_state && (trace_hook_insert(addr, &why) != 0)) {
+		goto fail;
+	}
+
+	set_hook_fn(ls, addr, 2);
+	lua_pushinteger(ls, addr);
+exit:
+	ghost_free(sheap, err);
+	return 1;
+fail:
+	lua_pushnil(ls);
+	lua_pushstring(ls, why);
+	ghost_free(sheap, err);
+	return 2;
+}
+/*****************************************************************************/
+static int parse_watch_kind(const char *s, enum trace_watch_kind *kind)
+{
+	if(strcmp(s, "w") == 0) {
+		*kind = TRACE_WATCH_WRITE;
+	} else if(strcmp(s, "rw") == 0) {
+		*kind = TRACE_WATCH_RW;
+	} else if(strcmp(s, "x") == 0) {
+		*kind = TRACE_WATCH_EXEC;
+	} else {
+		return -1;
+	}
+
+	return 0;
+}
+/*****************************************************************************/
+static void set_watch_fn(lua_State *ls, uint64_t addr, int fn_idx)
+{
+	lua_getfield(ls, LUA_REGISTRYINDEX, WATCH_TABLE);
+	lua_pushvalue(ls, fn_idx);
+	lua_rawseti(ls, -2, addr);
+	lua_pop(ls, 1);
+}
+/*****************************************************************************/
+static int luaf_lt_watch(lua_State *ls)
+{
+	int stack_size = lua_gettop(ls);
+	char *err = NULL;
+	const char *why = NULL;
+	enum trace_watch_kind kind;
+	uint64_t addr;
+	uint64_t size;
+	pid_t space = syms_pid(ls);
+	bool removing = (stack_size == 2) && lua_isnil(ls, 2);
+
+	if((stack_size != 4) && !removing) {
+		arg_num_err(ls, &err, LUA_WATCH_F, 4, stack_size);
+		goto exit;
+	}
+
+	if(lua_isinteger(ls, 1)) {
+		addr = lua_tointeger(ls, 1);
+	} else if(lua_type(ls, 1) != LUA_TSTRING) {
+		arg_type_err(ls, &err, LUA_WATCH_F, 1, 1, "integer or string");
+		goto exit;
+	} else if(tracee_syms_lookup(
+		space, lua_tostring(ls, 1), NULL, &addr, &size
+	) != 0) {
+		why = "unknown symbol";
+		goto fail;
+	}
+
+	if(pool_of(ls) != NULL) {
+		lua_pushinteger(ls, addr);
+		goto exit;
+	} else if(removing) {
+		trace_watch_remove(space, addr);
+		set_watch_fn(ls, addr, 2);
+		lua_pushinteger(ls, addr);
+		goto exit;
+	}
+
+	if(!lua_isinteger(ls, 2)) {
+		arg_type_err(ls, &err, LUA_WATCH_F, 2, 2, "integer");
+		goto exit;
+	} else if(
+		(lua_type(ls, 3) != LUA_TSTRING) ||
+		(parse_watch_kind(lua_tostring(ls, 3), &kind) != 0)
+	) {
+		arg_type_err(
+			ls, &err, LUA_WATCH_F, 3, 3, "\"w\", \"rw\" or \"x\""
+		);
+		goto exit;
+	} else if(!lua_isfunction(ls, 4)) {
+		arg_type_err(ls, &err, LUA_WATCH_F, 4, 4, "function");
+		goto exit;
+	}
+
+	if(trace_watch_insert(
+		space, addr, lua_tointeger(ls, 2), kind, &why
+	) != 0) {
+		goto fail;
+	}
+
+	set_watch_fn(ls, addr, 4);
+	lua_pushinteger(ls, addr);
+exit:
+	ghost_free(sheap, err);
+	return 1;
+fail:
+	lua_pushnil(ls);
+	lua_pushstring(ls, why);
+	ghost_free(sheap, err);
+	return 2;
+}
+/*****************************************************************************/
+static void register_profile_handler(
+	lua_State *ls, struct lua_trace_data *dat
+) {
+	char name[LUA_IDSIZE + 16];
+	lua_Debug ar;
+
+	/* handlers are told apart by where they are defined */
+	lua_pushvalue(ls, -1);
+	lua_getinfo(ls, ">S", &ar);
+
+	ghost_snprintf(
+		name, sizeof(name), "%s:%d", ar.short_src, ar.linedefined
+	);
+
+	dat->prof_handler = lua_profile_handler(dat->prof, name);
+}
+/*****************************************************************************/
+static int luaf_lua_trace_init(lua_State *ls)
+{
+	int stack_size = lua_gettop(ls);
+	char *err = NULL;
+
+	if(stack_size != 1) {
+		arg_num_err(ls, &err, LUA_TRACE_INIT_F, 1, stack_size);
+		goto exit;
+	}
+
+
+	if(!lua_isfunction(ls, 1)) {
+		arg_type_err(ls, &err, LUA_TRACE_INIT_F, 1, -1, "function");
+		goto exit;
+	}
+
+	/* events only ever go to the main state */
+	if(pool_of(ls) != NULL) {
+		goto exit;
+	}
+
+	if(trace_data.prof != NULL) {
+		register_profile_handler(ls, &trace_data);
+	}
+
+	int method_ref = luaL_ref(ls, LUA_REGISTRYINDEX);
+	trace_data.lua_cb_ref = method_ref;
+	trace_data.strikes = 0;
+
+exit:
+	ghost_free(sheap, err);
+	return 0;
+}
+/*****************************************************************************/
+static int luaf_lt_exit(lua_State *ls)
+{
+	int stack_size = lua_gettop(ls);
+	char *err = NULL;
+	struct lua_pool_state *p = pool_of(ls);
+	int *ref = (p != NULL) ? &p->exit_ref : &trace_data.exit_ref;
+
+	if(stack_size != 1) {
+		arg_num_err(ls, &err, LUA_EXIT_F, 1, stack_size);
+		goto exit;
+	}
+
+	if(!lua_isfunction(ls, 1)) {
+		arg_type_err(ls, &err, LUA_EXIT_F, 1, -1, "function");
+		goto exit;
+	}
+
+	luaL_unref(ls, LUA_REGISTRYINDEX, *ref);
+	*ref = luaL_ref(ls, LUA_REGISTRYINDEX);
+exit:
+	ghost_free(sheap, err);
+	return 0;
+}
+/*****************************************************************************/
+static void define_global_int(struct lua_State *ls, const char *name, int val)
+{
+	lua_pushinteger(ls, val);
+	lua_setglobal(ls, name);
+}
+/*****************************************************************************/
+static void insert_int64_to_table(
+	struct lua_State *ls, int tab_idx, const char *field, int64_t val
+) {
+	lua_pushinteger(ls, val);
+	lua_setfield(ls, tab_idx, field);
+}
+/*****************************************************************************/
+static void push_lua_uregs(
+	struct lua_State *ls, const struct user_regs_struct *uregs
+) {
+	lua_newtable(ls);
+	int i = lua_gettop(ls);
+
+	insert_int64_to_table(ls, i, "r15", uregs->r15);
+	insert_int64_to_table(ls, i, "r15", uregs->r15);
+	insert_int64_to_table(ls, i, "r14", uregs->r14);
+	insert_int64_to_table(ls, i, "r13", uregs->r13);
+	insert_int64_to_table(ls, i, "r12", uregs->r12);
+	insert_int64_to_table(ls, i, "rbp", uregs->rbp);
+	insert_int64_to_table(ls, i, "rbx", uregs->rbx);
+	insert_int64_to_table(ls, i, "r11", uregs->r11);
+	insert_int64_to_table(ls, i, "r10", uregs->r10);
+	insert_int64_to_table(ls, i, "r9", uregs->r9);
+	insert_int64_to_table(ls, i, "r8", uregs->r8);
+	insert_int64_to_table(ls, i, "rax", uregs->rax);
+	insert_int64_to_table(ls, i, "rcx", uregs->rcx);
+	insert_int64_to_table(ls, i, "rdx", uregs->rdx);
+	insert_int64_to_table(ls, i, "rsi", uregs->rsi);
+	insert_int64_to_table(ls, i, "rdi", uregs->rdi);
+	insert_int64_to_table(ls, i, "orig_rax", uregs->orig_rax);
+	insert_int64_to_table(ls, i, "rip", uregs->rip);
+	insert_int64_to_table(ls, i, "cs", uregs->cs);
+	insert_int64_to_table(ls, i, "eflags", uregs->eflags);
+	insert_int64_to_table(ls, i, "rsp", uregs->rsp);
+	insert_int64_to_table(ls, i, "ss", uregs->ss);
+	insert_int64_to_table(ls, i, "fs_base", uregs->fs_base);
+	insert_int64_to_table(ls, i, "gs_base", uregs->gs_base);
+	insert_int64_to_table(ls, i, "ds", uregs->ds);
+	insert_int64_to_table(ls, i, "es", uregs->es);
+	insert_int64_to_table(ls, i, "fs", uregs->fs);
+	insert_int64_to_table(ls, i, "gs", uregs->gs);
+}
+/*****************************************************************************/
+static void push_thread_table(
+	struct lua_State *ls, struct tracee_record *rec
+) {
+	if(rec == NULL) {
+		lua_pushnil(ls);
+	} else if(rec->user_ref == 0) {
+		lua_newtable(ls);
+		lua_pushvalue(ls, -1);
+		rec->user_ref = luaL_ref(ls, LUA_REGISTRYINDEX);
+	} else {
+		lua_rawgeti(ls, LUA_REGISTRYINDEX, rec->user_ref);
+	}
+}
+/*****************************************************************************/
+static pid_t thread_proc(const struct tracee_state *state)
+{
+	if(state->thread == NULL) {
+		return state->pid;
+	}
+
+	return state->thread->proc;
+}
+/*****************************************************************************/
+static void release_thread_table(
+	struct lua_State *ls, const struct tracee_state *state
+) {
+	struct tracee_record *rec = state->thread;
+
+	if(rec == NULL) {
+		return;
+	}
+
+	bool gone = (state->status == EXITED_NORMAL) ||
+		(state->status == EXITED_UNEXPECTED);
+
+	/* 0 is no reference, it mustn't go on the free list */
+	if(gone && (rec->user_ref != 0)) {
+		luaL_unref(ls, LUA_REGISTRYINDEX, rec->user_ref);
+		rec->user_ref = 0;
+	}
+}
+/*****************************************************************************/
+static int luaf_locked(lua_State *ls)
+{
+	int n = lua_gettop(ls);
+
+	lua_pushvalue(ls, lua_upvalueindex(1));
+	lua_insert(ls, 1);
+
+	/* an error is caught so that the lock is let go of before it is
+	 * passed on */
+	trace_hook_lock();
+	int err = lua_pcall(ls, n, LUA_MULTRET, 0);
+	trace_hook_unlock();
+
+	if(err != LUA_OK) {
+		return lua_error(ls);
+	}
+
+	/* such as the reader io.lines() hands back */
+	for(int i = 1; i <= lua_gettop(ls); i++) {
+		if(!lua_iscfunction(ls, i)) {
+			continue;
+		} else if(lua_tocfunction(ls, i) == luaf_locked) {
+			continue;
+		}
+
+		lua_pushvalue(ls, i);
+		lua_pushcclosure(ls, luaf_locked, 1);
+		lua_replace(ls, i);
+	}
+
+	return lua_gettop(ls);
+}
+/*****************************************************************************/
+static void lock_fields(lua_State *ls, const char *const *names)
+{
+	for(int i = 0; names[i] != NULL; i++) {
+		lua_getfield(ls, -1, names[i]);
+
+		if(lua_iscfunction(ls, -1)) {
+			lua_pushcclosure(ls, luaf_locked, 1);
+			lua_setfield(ls, -2, names[i]);
+		} else {
+			lua_pop(ls, 1);
+		}
+	}
+}
+/*****************************************************************************/
+static void lock_table(lua_State *ls)
+{
+	lua_pushnil(ls);
+
+	/* only fields that are already there are set, which lua_next()
+	 * allows */
+	while(lua_next(ls, -2) != 0) {
+		if(lua_iscfunction(ls, -1)) {
+			lua_pushvalue(ls, -2);
+			lua_insert(ls, -2);
+			lua_pushcclosure(ls, luaf_locked, 1);
+			lua_rawset(ls, -4);
+		} else {
+			lua_pop(ls, 1);
+		}
+	}
+}
+/*****************************************************************************/
+static void lock_unsafe(lua_State *ls)
+{
+	static const char *const BASE[] = {
+		"print", "warn", "dofile", "loadfile", "require", NULL
+	};
+	static const char *const LIBS[] = {
+		LUA_IOLIBNAME,
+		LUA_OSLIBNAME,
+		LUA_DBLIBNAME,
+		LUA_LOADLIBNAME,
+		NULL
+	};
+
+	/* pool states run hooks on several threads at once, without the
+	 * hook lock. Whatever in them reaches the ghost files, the shared
+	 * heap or the symbol cache takes it for the call. */
+	lua_pushglobaltable(ls);
+	lock_fields(ls, BASE);
+
+	for(int i = 0; LIBS[i] != NULL; i++) {
+		lua_getfield(ls, -1, LIBS[i]);
+		lock_table(ls);
+		lua_pop(ls, 1);
+	}
+
+	lua_pop(ls, 1);
+
+	/* open files, their methods are in __index */
+	luaL_getmetatable(ls, LUA_FILEHANDLE);
+	lock_table(ls);
+	lua_getfield(ls, -1, "__index");
+	lock_table(ls);
+	lua_pop(ls, 2);
+
+	lua_agg_wrap_print(ls, luaf_locked);
+}
+/*****************************************************************************/
+static void register_fn(
+	lua_State *ls, const char *name, lua_CFunction fn, bool locked
+) {
+	lua_pushcfunction(ls, fn);
+
+	if(locked) {
+		lua_pushcclosure(ls, luaf_locked, 1);
+	}
+
+	lua_setglobal(ls, name);
+}
+/*****************************************************************************/
+static void setup_lua_runtime(
+	struct lua_State *ls,
+	struct lua_pool_state *p,
+	struct lua_mem_ctx *mem,
+	struct lua_gc_ctx *gc
+) {
+	static const luaL_Reg TRACE_FNS[] = {
+		{LUA_TRACE_INIT_F, luaf_lua_trace_init},
+		{LUA_READ_CSTR_F, luaf_lt_read_cstr},
+		{LUA_FMT_BUFFER_F, luaf_lt_fmt_buffer},
+		{LUA_FMT_STR_F, luaf_lt_fmt_cstr},
+		{LUA_SYSCALL_INFO_F, luaf_lt_syscall_info},
+		{LUA_FMT_SYSCALL_F, luaf_lt_fmt_syscall},
+		{LUA_NOW_F, luaf_lt_now},
+		{LUA_SAMPLE_F, luaf_lt_sample},
+		{LUA_DUTY_F, luaf_lt_duty},
+		{LUA_SYM_F, luaf_lt_sym},
+		{LUA_ADDR2SYM_F, luaf_lt_addr2sym},
+		{LUA_BREAK_F, luaf_lt_break},
+		{LUA_HOOK_F, luaf_lt_hook},
+		{LUA_WATCH_F, luaf_lt_watch},
+		{LUA_EXIT_F, luaf_lt_exit}
+	};
+	bool locked = (p != NULL);
+
+	*(struct lua_pool_state**)lua_getextraspace(ls) = p;
+
+	/* only the main state is ever run while the monitor is idle */
+	gc->can_idle = (p == NULL);
+	lua_gc_setup(
+		ls, gc, trace_data.gc_mode, trace_data.gc_a, trace_data.gc_b
+	);
+
+	luaL_openlibs(ls);
+
+	/* all of these reach the shared heap, if only for an error */
+	for(size_t i = 0; i < sizeof(TRACE_FNS) / sizeof(*TRACE_FNS); i++) {
+		register_fn(ls, TRACE_FNS[i].name, TRACE_FNS[i].func, locked);
+	}
+
+	lua_mem_setup(ls, mem);
+	lua_shared_setup(ls);
+	lua_agg_setup(ls);
+
+	if(locked) {
+		lock_unsafe(ls);
+	}
+
+	lua_newtable(ls);
+	lua_setfield(ls, LUA_REGISTRYINDEX, BREAK_TABLE);
+	lua_newtable(ls);
+	lua_setfield(ls, LUA_REGISTRYINDEX, HOOK_TABLE);
+	lua_newtable(ls);
+	lua_setfield(ls, LUA_REGISTRYINDEX, WATCH_TABLE);
+
+	define_global_int(ls, "LT_STARTED", STARTED);
+	define_global_int(ls, "LT_EXIT_NORMAL", EXITED_NORMAL);
+	define_global_int(ls, "LT_EXIT_UNEXPECT", EXITED_UNEXPECTED);
+	define_global_int(ls, "LT_SYSCALL_ENTER", SYSCALL_ENTER_STOP);
+	define_global_int(ls, "LT_SYSCALL_EXIT", SYSCALL_EXIT_STOP);
+	define_global_int(ls, "LT_SIG_DELIVER", SIGNAL_DELIVERY_STOP);
+	define_global_int(ls, "LT_GROUP_STOP", GROUP_STOP);
+	define_global_int(ls, "LT_PTRACE_EVENT", PTRACE_EVENT_OCCURED_STOP);
+	define_global_int(ls, "LT_EXEC_OCCURED", PTRACE_EXEC_OCCURED);
+	define_global_int(ls, "LT_BREAKPOINT", BREAKPOINT_STOP);
+	define_global_int(ls, "LT_WATCHPOINT", WATCHPOINT_STOP);
+}
+/*****************************************************************************/
+static void *alloc_f(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	struct ghost_heap *heap = ud;
+
+	/* with no block osize is a type tag rather than a size */
+	size_t old = (ptr == NULL) ? 0 : osize;
+
+	if(nsize > old) {
+		trace_data.alloc_bytes += nsize - old;
+	}
+
+	if(nsize == 0) {
+		ghost_free(heap, ptr);
+		return NULL;
+	} else {
+		return ghost_realloc(heap, ptr, nsize);
+	}
+}
+/*****************************************************************************/
+static void callback_hook(lua_State *ls, lua_Debug *ar)
+{
+	struct lua_trace_data *dat = &trace_data;
+
+	dat->executed += dat->hook_step;
+
+	if(dat->prof != NULL) {
+		lua_profile_sample(dat->prof, ls, dat->hook_step);
+	}
+
+	bool over_budget =
+		(dat->budget != 0) && (dat->executed >= dat->budget);
+	bool late =
+		(dat->deadline != 0) && (trace_clock_now() >= dat->deadline);
+
+	if(over_budget || late) {
+		dat->overrun = true;
+		luaL_error(
+			ls,
+			"callback overran its %s",
+			over_budget ? "instruction budget" : "time limit"
+		);
+	}
+}
+/*****************************************************************************/
+static bool hook_wanted(const struct lua_trace_data *dat)
+{
+	return (dat->budget != 0) || (dat->timeout_ns != 0) ||
+		(dat->prof != NULL);
+}
+/*****************************************************************************/
+static uint32_t step_limit(uint32_t step, uint32_t limit)
+{
+	return ((step == 0) || (step > limit)) ? limit : step;
+}
+/*****************************************************************************/
+static void hook_arm(struct lua_trace_data *dat)
+{
+	if(!hook_wanted(dat)) {
+		return;
+	}
+
+	dat->executed = 0;
+	dat->overrun = false;
+	dat->deadline = 0;
+	dat->hook_step = dat->budget;
+
+	if(dat->timeout_ns != 0) {
+		dat->deadline = trace_clock_now() + dat->timeout_ns;
+		dat->hook_step = step_limit(dat->hook_step, WATCHDOG_STEP);
+	}
+
+	if(dat->prof != NULL) {
+		dat->hook_step = step_limit(dat->hook_step, PROFILE_STEP);
+	}
+
+	lua_sethook(dat->ls, callback_hook, LUA_MASKCOUNT, dat->hook_step);
+}
+/*****************************************************************************/
+static void hook_disarm(struct lua_trace_data *dat, bool strike)
+{
+	if(!hook_wanted(dat)) {
+		return;
+	}
+
+	lua_sethook(dat->ls, NULL, 0, 0);
+
+	if(!dat->overrun) {
+		dat->strikes = 0;
+		return;
+	}
+
+	dat->overruns += 1;
+
+	/* only the LT_init() callback is ever dropped */
+	if(!strike) {
+		return;
+	}
+
+	dat->strikes += 1;
+
+	if(dat->strikes < OVERRUN_STRIKES) {
+		return;
+	}
+
+	/* the target is stopped for as long as the callback runs, one that
+	 * keeps overrunning is costing it more than it is worth */
+	ghost_fprintf(
+		ghost_stderr,
+		(
+			"Lua callback overran %u calls in a row "
+			"(%llu in total), disabling it\n"
+		),
+		dat->strikes,
+		(unsigned long long)dat->overruns
+	);
+
+	luaL_unref(dat->ls, LUA_REGISTRYINDEX, dat->lua_cb_ref);
+	dat->lua_cb_ref = -1;
+}
+/*****************************************************************************/
+static void profile_call(
+	struct lua_trace_data *dat,
+	const struct tracee_state *state,
+	uint64_t ns,
+	uint64_t bytes
+) {
+	int64_t sysno = -1;
+
+	if((state->status == SYSCALL_ENTER_STOP) ||
+		(state->status == SYSCALL_EXIT_STOP)
+	) {
+		sysno = state->data.regs.orig_rax;
+	}
+
+	lua_profile_call(dat->prof, dat->prof_handler, sysno, ns, bytes);
+}
+/*****************************************************************************/
+static int push_stop_fn(lua_State *ls, const char *table, uint64_t addr)
+{
+	lua_getfield(ls, LUA_REGISTRYINDEX, table);
+	lua_rawgeti(ls, -1, addr);
+	lua_remove(ls, -2);
+
+	if(!lua_isfunction(ls, -1)) {
+		lua_pop(ls, 1);
+		return -1;
+	}
+
+	return 0;
+}
+/*****************************************************************************/
+static void push_hook_regs(
+	struct lua_State *ls,
+	const struct trace_hook *hook,
+	const struct trace_hook_frame *frame
+) {
+	lua_createtable(ls, 0, 10);
+	int i = lua_gettop(ls);
+
+	insert_int64_to_table(ls, i, "rdi", frame->rdi);
+	insert_int64_to_table(ls, i, "rsi", frame->rsi);
+	insert_int64_to_table(ls, i, "rdx", frame->rdx);
+	insert_int64_to_table(ls, i, "rcx", frame->rcx);
+	insert_int64_to_table(ls, i, "r8", frame->r8);
+	insert_int64_to_table(ls, i, "r9", frame->r9);
+	insert_int64_to_table(ls, i, "rax", frame->rax);
+	insert_int64_to_table(ls, i, "rsp", (uint64_t)&frame->ret);
+	insert_int64_to_table(ls, i, "rip", hook->addr);
+	insert_int64_to_table(ls, i, "ret", frame->ret);
+}
+/*****************************************************************************/
+static bool run_hook(
+	struct lua_State *ls,
+	struct lua_mem_ctx *mem,
+	struct lua_trace_data *dat,
+	const struct trace_hook *hook,
+	struct trace_hook_frame *frame
+) {
+	bool skip = false;
+
+	lua_getfield(ls, LUA_REGISTRYINDEX, HOOK_TABLE);
+	lua_rawgeti(ls, -1, hook->addr);
+	lua_remove(ls, -2);
+
+	if(!lua_isfunction(ls, -1)) {
+		lua_pop(ls, 1);
+		return false;
+	}
+
+	push_hook_regs(ls, hook, frame);
+	lua_pushinteger(ls, trace_clock_now());
+
+	/* we are running on the target's thread, in its address space */
+	mem->cur = NULL;
+	mem->epoch += 1;
+
+	/* the watchdog only looks after the main state, dat is NULL for
+	 * the pool's */
+	if(dat != NULL) {
+		hook_arm(dat);
+	}
+
+	int err = lua_pcall(ls, 2, 1, 0);
+
+	/* held already unless this is a pool state */
+	if(err != LUA_OK) {
+		trace_hook_lock();
+		ghost_fprintf(
+			ghost_stderr,
+			"Error in lua hook: %s\n",
+			lua_tostring(ls, -1)
+		);
+		trace_hook_unlock();
+	} else if(lua_isinteger(ls, -1)) {
+		frame->rax = lua_tointeger(ls, -1);
+		skip = true;
+	}
+
+	lua_pop(ls, 1);
+
+	if(dat != NULL) {
+		hook_disarm(dat, false);
+	}
+
+	return skip;
+}
+/*****************************************************************************/
+static struct lua_pool_state *pool_take(struct lua_trace_data *dat)
+{
+	uint32_t n = dat->pool_size;
+	uint32_t first = pool_hint % n;
+
+	/* any state that is free, starting with the one the thread had last
+	 * time, or else wait for that one */
+	for(uint32_t i = 0; i < n; i++) {
+		uint32_t at = (first + i) % n;
+
+		if(safe_mutex_trylock(&dat->pool[at].lock)) {
+			pool_hint = at;
+			return dat->pool + at;
+		}
+	}
+
+	safe_mutex_lock(&dat->pool[first].lock);
+
+	return dat->pool + first;
+}
+/*****************************************************************************/
+static bool hook_handler(
+	void *arg, const struct trace_hook *hook, struct trace_hook_frame *frame
+) {
+	struct lua_trace_data *dat = (struct lua_trace_data*)arg;
+	bool skip = false;
+
+	if(dat->pool_size == 0) {
+		return run_hook(dat->ls, &dat->mem, dat, hook, frame);
+	}
+
+	struct lua_pool_state *p = pool_take(dat);
+
+	/* empty if the script failed to load into it */
+	if(p->ls != NULL) {
+		skip = run_hook(p->ls, &p->mem, NULL, hook, frame);
+	}
+
+	safe_mutex_unlock(&p->lock);
+
+	return skip;
+}
+/*****************************************************************************/
+static void handle_event(
+	struct lua_trace_data *dat, const struct tracee_state *state
+) {
+	struct lua_State *ls = dat->ls;
+	const struct user_regs_struct *uregs = &state->data.regs;
+
+	/* whatever was mapped before is gone, symbols included */
+	if(state->status == PTRACE_EXEC_OCCURED) {
+		tracee_syms_invalidate(thread_proc(state));
+	}
+
+	/* breakpoints and watches have functions of their own */
+	bool is_break =
+		(state->status == BREAKPOINT_STOP) ||
+		(state->status == WATCHPOINT_STOP);
+	int missing = 0;
+
+	if(state->status == BREAKPOINT_STOP) {
+		missing = push_stop_fn(ls, BREAK_TABLE, uregs->rip);
+	} else if(state->status == WATCHPOINT_STOP) {
+		missing = push_stop_fn(ls, WATCH_TABLE, state->watch);
+	} else if(dat->lua_cb_ref < 0) {
+		return;
+	} else {
+		lua_rawgeti(ls, LUA_REGISTRYINDEX, dat->lua_cb_ref);
+	}
+
+	if(missing != 0) {
+		return;
+	}
+
+	lua_pushinteger(ls, state->status);
+	lua_pushinteger(ls, state->pid);
+	push_lua_uregs(ls, uregs);
+	lua_pushinteger(ls, state->timestamp);
+	lua_pushinteger(ls, state->duration);
+	push_thread_table(ls, state->thread);
+	lua_pushinteger(ls, thread_proc(state));
+	lua_pushnumber(ls, state->weight);
+
+	uint64_t start = (dat->prof != NULL) ? trace_clock_now() : 0;
+	uint64_t alloc_start = dat->alloc_bytes;
+
+	dat->mem.cur = state->thread;
+	dat->mem.epoch += 1;
+	hook_arm(dat);
+
+	int err = lua_pcall(ls, 8, 0, 0);
+
+	dat->mem.cur = NULL;
+
+	if(dat->prof != NULL) {
+		uint64_t ns = trace_clock_now() - start;
+		profile_call(dat, state, ns, dat->alloc_bytes - alloc_start);
+	}
 
 	if(err != LUA_OK) {
-		if(err == LUA_ERRFILE) {
-			ghost_fprintf(
-				ghost_stderr,
-				"Error opening file: %s\n",
-				trace_data.ent
-			);
+		const char *err_msg = lua_tostring(ls, -1);
+		ghost_fprintf(
+			ghost_stderr,
+			"Error in lua callback: %s\n",
+			err_msg
+		);
+		lua_pop(ls, 1);
+	}
+
+	hook_disarm(dat, !is_break);
+}
+/*****************************************************************************/
+static void dispatch_event(
+	struct lua_trace_data *dat, const struct tracee_state *state
+) {
+	handle_event(dat, state);
+
+	/* even when there was nothing to call */
+	release_thread_table(dat->ls, state);
+}
+/*****************************************************************************/
+static bool is_exit(enum tracee_status status)
+{
+	return (status == EXITED_NORMAL) || (status == EXITED_UNEXPECTED);
+}
+/*****************************************************************************/
+static bool must_defer(enum tracee_status status)
+{
+	return
+		is_exit(status) ||
+		(status == BREAKPOINT_STOP) ||
+		(status == WATCHPOINT_STOP);
+}
+/*****************************************************************************/
+static int defer_event(
+	struct lua_trace_data *dat, const struct tracee_state *state
+) {
+	if(dat->deferred_len == dat->deferred_cap) {
+		uint32_t cap = max_u64(2 * dat->deferred_cap, 8);
+		struct lua_deferred *grown = ghost_realloc(
+			sheap, dat->deferred, cap * sizeof(*grown)
+		);
+
+		if(grown == NULL) {
+			return -1;
+		}
+
+		dat->deferred = grown;
+		dat->deferred_cap = cap;
+	}
+
+	struct lua_deferred *d = dat->deferred + dat->deferred_len;
+
+	d->state = *state;
+	d->state.thread = NULL;
+	d->has_thread = (state->thread != NULL);
+
+	if(d->has_thread) {
+		d->proc = state->thread->proc;
+		d->user_ref = state->thread->user_ref;
+	}
+
+	dat->deferred_len += 1;
+
+	return 0;
+}
+/*****************************************************************************/
+static void run_deferred(struct lua_trace_data *dat)
+{
+	struct tracee_record gone;
+
+	/* with the hook lock held, so nothing is added on the way */
+	for(uint32_t i = 0; i < dat->deferred_len; i++) {
+		struct lua_deferred *d = dat->deferred + i;
+
+		/* the record of a thread that is still around, so that a
+		 * table made for it here is kept for its next event */
+		if(is_exit(d->state.status) && d->has_thread) {
+			memset(&gone, 0, sizeof(gone));
+			gone.tid = d->state.pid;
+			gone.proc = d->proc;
+			gone.user_ref = d->user_ref;
+			d->state.thread = &gone;
 		} else {
-			err_msg = lua_tostring(ls, -1);
-			ghost_fprintf(
-				ghost_stderr,
-				"Error loading lua entry point: %s\n",
-				err_msg
-			);
+			d->state.thread = trace_thread_record(d->state.pid);
 		}
-		abort();
-		return NULL;
+
+		dispatch_event(dat, &d->state);
+	}
+
+	dat->deferred_len = 0;
+}
+/*****************************************************************************/
+static void *handler(void *arg, const struct tracee_state *state)
+{
+	struct lua_trace_data *dat = (struct lua_trace_data*)arg;
+
+	/* a hooked thread has the state, it may well be the one that
+	 * stopped, inside the hook, and it can't go on until we let it. A
+	 * syscall may go by, what can't is kept for later. */
+	if(!trace_hook_trylock()) {
+		if(!must_defer(state->status)) {
+			dat->busy_skips += 1;
+		} else if(defer_event(dat, state) != 0) {
+			dat->busy_skips += 1;
+		} else {
+			trace_request_idle();
+		}
+
+		return arg;
+	}
+
+	run_deferred(dat);
+	dispatch_event(dat, state);
+
+	/* with --lua-gc=idle collection waits until nobody waits on us */
+	if((dat->ls != NULL) && lua_gc_pending(dat->ls, &dat->gc)) {
+		trace_request_idle();
+	}
+
+	trace_hook_unlock();
+
+	return arg;
+}
+/*****************************************************************************/
+static void handler_idle(void *arg)
+{
+	struct lua_trace_data *dat = (struct lua_trace_data*)arg;
+
+	/* a hook has the state, the next event asks again */
+	if(!trace_hook_trylock()) {
+		return;
+	}
+
+	run_deferred(dat);
+
+	if(lua_gc_idle(dat->ls, &dat->gc)) {
+		trace_request_idle();
+	}
+
+	trace_hook_unlock();
+}
+/*****************************************************************************/
+static int run_entry(lua_State *ls, const char *ent, char **msg)
+{
+	int err = luaL_loadfile(ls, ent);
+
+	if(err == LUA_ERRFILE) {
+		ghost_sdprintf(msg, 0, "Error opening file: %s", ent);
+		return -1;
+	} else if(err != LUA_OK) {
+		ghost_sdprintf(
+			msg,
+			0,
+			"Error loading lua entry point: %s",
+			lua_tostring(ls, -1)
+		);
+		return -1;
 	}
 
 	err = lua_pcall(ls, 0, 0, 0);
 
+	/* a script that raises an error is only reported, whatever it
+	 * registered before that stays in place */
 	if(err == LUA_ERRRUN) {
-		err_msg = lua_tostring(ls, -1);
 		ghost_fprintf(
 			ghost_stderr,
 			"Lua runtime error: %s\n",
-			err_msg
+			lua_tostring(ls, -1)
 		);
+		lua_pop(ls, 1);
 	} else if(err != LUA_OK) {
-		err_msg = lua_tostring(ls, -1);
+		ghost_sdprintf(
+			msg,
+			0,
+			"Error running lua entry point: %s",
+			lua_tostring(ls, -1)
+		);
+		return -1;
+	}
+
+	return 0;
+}
+/*****************************************************************************/
+static void *pool_alloc_f(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	/* each state has a heap to itself and nothing is counted, hooks
+	 * run in them on several threads at once */
+	if(nsize == 0) {
+		ghost_free(ud, ptr);
+		return NULL;
+	} else {
+		return ghost_realloc(ud, ptr, nsize);
+	}
+}
+/*****************************************************************************/
+static void pool_create(struct lua_trace_data *dat)
+{
+	size_t size = dat->pool_size * sizeof(*dat->pool);
+
+	if(dat->pool_size == 0) {
+		return;
+	}
+
+	dat->pool = ghost_malloc(sheap, size);
+
+	if(dat->pool != NULL) {
+		memset(dat->pool, 0, size);
+	}
+
+	for(uint32_t i = 0; (dat->pool != NULL) && (i < dat->pool_size); i++) {
+		dat->pool[i].heap = ghost_heap_init();
+		dat->pool[i].exit_ref = LUA_NOREF;
+
+		if(dat->pool[i].heap == NULL) {
+			dat->pool_size = i;
+		}
+	}
+
+	if((dat->pool == NULL) || (dat->pool_size == 0)) {
 		ghost_fprintf(
 			ghost_stderr,
-			"Error running lua entry point: %s\n",
-			err_msg
+			"Unable to set up Lua states for hooks, using one\n"
+		);
+		dat->pool_size = 0;
+	}
+}
+/*****************************************************************************/
+static bool pool_lock_all(struct lua_trace_data *dat)
+{
+	for(uint32_t i = 0; i < dat->pool_size; i++) {
+		struct lua_pool_state *p = dat->pool + i;
+		bool locked = false;
+
+		/* the same as trace_hook_trylock(), a hook in the state may
+		 * be stopped waiting on us */
+		for(int j = 0; !locked && (j < SAFE_SPIN_LIMIT); j++) {
+			locked = safe_mutex_trylock(&p->lock);
+			__builtin_ia32_pause();
+		}
+
+		if(locked) {
+			continue;
+		}
+
+		while(i-- > 0) {
+			safe_mutex_unlock(&dat->pool[i].lock);
+		}
+		return false;
+	}
+
+	return true;
+}
+/*****************************************************************************/
+static void pool_unlock_all(struct lua_trace_data *dat)
+{
+	for(uint32_t i = 0; i < dat->pool_size; i++) {
+		safe_mutex_unlock(&dat->pool[i].lock);
+	}
+}
+/*****************************************************************************/
+static void pool_load(struct lua_trace_data *dat, const char *path)
+{
+	for(uint32_t i = 0; i < dat->pool_size; i++) {
+		struct lua_pool_state *p = dat->pool + i;
+		char *msg = NULL;
+
+		if(p->ls != NULL) {
+			lua_close(p->ls);
+		}
+
+		p->exit_ref = LUA_NOREF;
+		p->ls = lua_newstate(pool_alloc_f, p->heap);
+
+		if(p->ls == NULL) {
+			ghost_fprintf(
+				ghost_stderr, "Unable to create a lua state\n"
+			);
+			continue;
+		}
+
+		setup_lua_runtime(p->ls, p, &p->mem, &p->gc);
+
+		if(run_entry(p->ls, path, &msg) != 0) {
+			ghost_fprintf(ghost_stderr, "%s\n", msg);
+			lua_close(p->ls);
+			p->ls = NULL;
+		}
+
+		ghost_free(sheap, msg);
+	}
+}
+/*****************************************************************************/
+static void run_exit(lua_State *ls, int ref)
+{
+	if((ls == NULL) || (ref == LUA_NOREF)) {
+		return;
+	}
+
+	lua_rawgeti(ls, LUA_REGISTRYINDEX, ref);
+
+	if(lua_pcall(ls, 0, 0, 0) != LUA_OK) {
+		ghost_fprintf(
+			ghost_stderr,
+			"Error in lua exit function: %s\n",
+			lua_tostring(ls, -1)
 		);
+		lua_pop(ls, 1);
+	}
+}
+/*****************************************************************************/
+static void *handler_init(void *arg)
+{
+	char *msg = NULL;
+
+	lua_cache_set_dir(trace_data.cache_dir);
+
+	if(trace_data.prof_path != NULL) {
+		trace_data.prof = lua_profile_create();
+
+		if(trace_data.prof == NULL) {
+			ghost_fprintf(
+				ghost_stderr,
+				"Unable to set up the Lua profile\n"
+			);
+		}
+	}
+
+	lua_State *ls = lua_newstate(alloc_f, sheap);
+	trace_data.ls = ls;
+	trace_data.lua_cb_ref = -1;
+
+	assert(trace_data.ls != NULL);
+
+	pool_create(&trace_data);
+
+	/* hooks the script sets can fire before it is done */
+	trace_hook_set_handler(hook_handler, &trace_data);
+	trace_hook_set_concurrent(trace_data.pool_size != 0);
+	trace_hook_lock();
+	pool_lock_all(&trace_data);
+
+	setup_lua_runtime(ls, NULL, &trace_data.mem, &trace_data.gc);
+
+	if(run_entry(ls, trace_data.ent, &msg) != 0) {
+		ghost_fprintf(ghost_stderr, "%s\n", msg);
 		abort();
 		return NULL;
 	}
 
+	pool_load(&trace_data, trace_data.ent);
+
+	pool_unlock_all(&trace_data);
+	trace_hook_unlock();
+
 	return arg;
 }
+/*****************************************************************************/
+static int handler_load(void *arg, const char *path, char **msg)
+{
+	struct lua_trace_data *dat = (struct lua_trace_data*)arg;
+	lua_State *old_ls = dat->ls;
+	int old_cb_ref = dat->lua_cb_ref;
+	int old_exit_ref = dat->exit_ref;
+	struct lua_gc_ctx old_gc = dat->gc;
+
+	if(!trace_hook_trylock()) {
+		ghost_sdprintf(msg, 0, "A hooked function is busy, try again");
+		return -1;
+	} else if(!pool_lock_all(dat)) {
+		trace_hook_unlock();
+		ghost_sdprintf(msg, 0, "A hooked function is busy, try again");
+		return -1;
+	}
+
+	/* the old script saw them come in */
+	run_deferred(dat);
+
+	/* the old script's breakpoints, hooks and watches would have
+	 * nothing to call, unless the new one fails and it is kept */
+	trace_break_save();
+	trace_hook_save();
+	trace_watch_save();
+	trace_break_clear();
+	trace_hook_clear();
+	trace_watch_clear();
+
+	/* the new script runs in a state of its own, LT_init() from it
+	 * lands in dat so keep the old callback around until it succeeds */
+	dat->ls = lua_newstate(alloc_f, sheap);
+	dat->lua_cb_ref = -1;
+	dat->exit_ref = LUA_NOREF;
+
+	if(dat->ls == NULL) {
+		ghost_sdprintf(msg, 0, "Unable to create a lua state");
+		goto fail;
+	}
+
+	setup_lua_runtime(dat->ls, NULL, &dat->mem, &dat->gc);
+
+	if(run_entry(dat->ls, path, msg) != 0) {
+		lua_close(dat->ls);
+		goto fail;
+	}
+
+	if(old_ls != NULL) {
+		lua_close(old_ls);
+	}
+
+	pool_load(dat, path);
+
+	pool_unlock_all(dat);
+	trace_hook_unlock();
+	return 0;
+fail:
+	/* drops whatever the new script armed before it failed */
+	trace_break_restore();
+	trace_hook_restore();
+	trace_watch_restore();
+	dat->ls = old_ls;
+	dat->lua_cb_ref = old_cb_ref;
+	dat->exit_ref = old_exit_ref;
+	dat->gc = old_gc;
+	pool_unlock_all(dat);
+	trace_hook_unlock();
+	return -1;
+}
+/*****************************************************************************/
+static void handler_fini(void *arg)
+{
+	struct lua_trace_data *dat = (struct lua_trace_data*)arg;
+	bool locked = trace_hook_trylock();
+
+	/* the target goes on without us, calls already in a hook finish */
+	trace_hook_clear();
+
+	if(locked) {
+		run_deferred(dat);
+	}
+
+	/* the pool's exit functions go first, so that they can fold what
+	 * their states kept to themselves into shared objects before the
+	 * main state's looks at the totals. They take the hook lock for
+	 * print() and the like, so are only run if we have it. */
+	for(uint32_t i = 0; locked && (i < dat->pool_size); i++) {
+		struct lua_pool_state *p = dat->pool + i;
+
+		if(safe_mutex_trylock(&p->lock)) {
+			run_exit(p->ls, p->exit_ref);
+			safe_mutex_unlock(&p->lock);
+		}
+	}
+
+	if(locked) {
+		run_exit(dat->ls, dat->exit_ref);
+		trace_hook_unlock();
+	}
+
+	ghost_free(sheap, dat->deferred);
+	dat->deferred = NULL;
+	dat->deferred_len = 0;
+	dat->deferred_cap = 0;
+
+	tracee_syms_clear();
+
+	if(dat->busy_skips != 0) {
+		ghost_fprintf(
+			ghost_stderr,
+			"%llu events were not passed to Lua while hooks ran\n",
+			(unsigned long long)dat->busy_skips
+		);
+	}
+
+	if(dat->prof == NULL) {
+		return;
+	}
+
+	if(lua_profile_write(dat->prof, dat->prof_path) != 0) {
+		ghost_fprintf(
+			ghost_stderr,
+			"Unable to write the Lua profile to %s\n",
+			dat->prof_path
+		);
+	}
+
+	lua_profile_destroy(dat->prof);
+	dat->prof = NULL;
+}
 /******************************************************************************
 *                            FUNCTION DEFINITIONS                             *
 ******************************************************************************/
-struct trace_descriptor lua_trace_descriptor(const char *ent)
+struct trace_descriptor lua_trace_descriptor(const struct prog_opts *opts)
 {
 	struct trace_descriptor descr;
 
 	descr.init = handler_init;
 	descr.handle = handler;
+	descr.load = handler_load;
+	descr.fini = handler_fini;
+	descr.idle = handler_idle;
 	descr.arg = &trace_data;
 
-	trace_data.ent = ent;
+	trace_data.ent = opts->lua_ent;
+	trace_data.cache_dir = opts->lua_cache;
+	trace_data.budget = opts->lua_budget;
+	trace_data.timeout_ns = (uint64_t)opts->lua_timeout_us * 1000;
+	trace_data.overruns = 0;
+	trace_data.strikes = 0;
+	trace_data.alloc_bytes = 0;
+	trace_data.prof_path = opts->lua_profile;
+	trace_data.prof = NULL;
+	trace_data.prof_handler = -1;
 	trace_data.ls = NULL;
 	trace_data.lua_cb_ref = 0;
+	trace_data.mem.cur = NULL;
+	trace_data.mem.epoch = 0;
+	trace_data.busy_skips = 0;
+	trace_data.deferred = NULL;
+	trace_data.deferred_len = 0;
+	trace_data.deferred_cap = 0;
+	trace_data.exit_ref = LUA_NOREF;
+	trace_data.pool = NULL;
+	trace_data.pool_size = min_u64(opts->lua_states, LUA_POOL_MAX);
+	trace_data.gc_mode = opts->lua_gc;
+	trace_data.gc_a = opts->lua_gc_a;
+	trace_data.gc_b = opts->lua_gc_b;
 
 	return descr;
 }
@@ -19,8 +19,12 @@
 #ifndef LUA_TRACE_H
 #define LUA_TRACE_H
 /******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <options.h>
+/******************************************************************************
 *                            FUNCTION DECLARATIONS                            *
 ******************************************************************************/
-struct trace_descriptor lua_trace_descriptor(const char *ent);
+struct trace_descriptor lua_trace_descriptor(const struct prog_opts *opts);
 /*****************************************************************************/
 #endif /* LUA_TRACE_H */
@@ -1229,6 +1229,22 @@ LUA_API int lua_gc (lua_State *L, int what, ...) {
 }
 
 
+/*
+** Copy out the collector's timings, when 'stats' is not NULL, and start
+** them over from 0 if 'reset' is true.
+*/
+LUA_API void lua_gcstats (lua_State *L, lua_GCStats *stats, int reset) {
+  global_State *g;
+  lua_lock(L);
+  g = G(L);
+  if (stats != NULL)
+    *stats = g->gcstats;
+  if (reset)
+    memset(&g->gcstats, 0, sizeof(g->gcstats));
+  lua_unlock(L);
+}
+
+
 
 /*
 ** miscellaneous functions
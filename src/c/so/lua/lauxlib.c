@@ -13,6 +13,7 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <gio/ghost-stdio.h>
+#include <lua-cache.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -715,11 +716,16 @@ typedef struct LoadF {
 
 static const char *getF (lua_State *L, void *ud, size_t *size) {
   LoadF *lf = (LoadF *)ud;
+  const char *view;
   (void)L;  /* not used */
   if (lf->n > 0) {  /* are there pre-read characters to be read? */
     *size = lf->n;  /* return them (chars already in buffer) */
     lf->n = 0;  /* no more pre-read characters */
   }
+  else if ((view = ghost_fview(lf->f, (size_t)-1, size)) != NULL) {
+    /* mapped file: hand the rest of it to the parser as one span */
+    return (*size > 0) ? view : NULL;
+  }
   else {  /* read a block from file */
     /* 'fread' can return > 0 *and* set the EOF flag. If next call to
        'getF' called 'fread', it might still wait for user input.
@@ -777,7 +783,7 @@ static int skipcomment (struct ghost_file *f, int *cp) {
 }
 
 
-LUALIB_API int luaL_loadfilex (lua_State *L, const char *filename,
+static int loadfilex_source (lua_State *L, const char *filename,
                                              const char *mode) {
   LoadF lf;
   int status, readstatus;
@@ -789,7 +795,7 @@ LUALIB_API int luaL_loadfilex (lua_State *L, const char *filename,
   }
   else {
     lua_pushfstring(L, "@%s", filename);
-    lf.f = ghost_fopen(filename, "r");
+    lf.f = ghost_fopen(filename, "rm");
     if (lf.f == NULL) return errfile(L, "open", fnameindex);
   }
   lf.n = 0;
@@ -798,7 +804,7 @@ LUALIB_API int luaL_loadfilex (lua_State *L, const char *filename,
   if (c == LUA_SIGNATURE[0]) {  /* binary file? */
     lf.n = 0;  /* remove possible newline */
     if (filename) {  /* "real" file? */
-      lf.f = ghost_freopen(filename, "rb", lf.f);  /* reopen in binary mode */
+      lf.f = ghost_freopen(filename, "rbm", lf.f);  /* reopen in binary mode */
       if (lf.f == NULL) return errfile(L, "reopen", fnameindex);
       skipcomment(lf.f, &c);  /* re-read initial portion */
     }
@@ -817,6 +823,16 @@ LUALIB_API int luaL_loadfilex (lua_State *L, const char *filename,
 }
 
 
+LUALIB_API int luaL_loadfilex (lua_State *L, const char *filename,
+                                             const char *mode) {
+  /* scripts and required modules come out of the bytecode cache when
+     one is configured, see lua-cache.c */
+  if (filename != NULL && lua_cache_enabled())
+    return lua_cache_loadfile(L, filename, mode, loadfilex_source);
+  return loadfilex_source(L, filename, mode);
+}
+
+
 typedef struct LoadS {
   const char *s;
   size_t size;
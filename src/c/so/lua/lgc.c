@@ -1679,6 +1679,29 @@ static void incstep (lua_State *L, global_State *g) {
   }
 }
 
+/*
+** Account for a step or a full collection that started at 't0'.
+*/
+static void gcstatsadd (global_State *g, unsigned long long t0, int full) {
+  lua_GCStats *s = &g->gcstats;
+  unsigned long long t = luai_gcclock() - t0;
+  unsigned long long v = t;
+  int b = 0;
+  while (v != 0 && b < LUA_GCSTATS_BUCKETS - 1) {  /* b = log2(t) + 1 */
+    v >>= 1;
+    b++;
+  }
+  if (full)
+    s->full++;
+  else
+    s->steps++;
+  s->time += t;
+  if (t > s->maxtime)
+    s->maxtime = t;
+  s->hist[b]++;
+}
+
+
 /*
 ** Performs a basic GC step if collector is running. (If collector is
 ** not running, set a reasonable debt to avoid it being called at
@@ -1689,10 +1712,12 @@ void luaC_step (lua_State *L) {
   if (!gcrunning(g))  /* not running? */
     luaE_setdebt(g, -2000);
   else {
+    unsigned long long t0 = luai_gcclock();
     if(isdecGCmodegen(g))
       genstep(L, g);
     else
       incstep(L, g);
+    gcstatsadd(g, t0, 0);
   }
 }
 
@@ -1724,6 +1749,7 @@ static void fullinc (lua_State *L, global_State *g) {
 */
 void luaC_fullgc (lua_State *L, int isemergency) {
   global_State *g = G(L);
+  unsigned long long t0 = luai_gcclock();
   lua_assert(!g->gcemergency);
   g->gcemergency = isemergency;  /* set flag */
   if (g->gckind == KGC_INC)
@@ -1731,6 +1757,7 @@ void luaC_fullgc (lua_State *L, int isemergency) {
   else
     fullgen(L, g);
   g->gcemergency = 0;
+  gcstatsadd(g, t0, 1);
 }
 
 /* }====================================================== */
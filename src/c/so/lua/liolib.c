@@ -33,7 +33,7 @@
 
 /* accepted extensions to 'mode' in 'fopen' */
 #if !defined(L_MODEEXT)
-#define L_MODEEXT	"b"
+#define L_MODEEXT	"bm"
 #endif
 
 /* Check whether 'mode' matches '[rwa]%+?[L_MODEEXT]*' */
@@ -540,6 +540,11 @@ static int read_line (lua_State *L, struct ghost_file *f, int chop) {
 static void read_all (lua_State *L, struct ghost_file *f) {
   size_t nr;
   luaL_Buffer b;
+  const char *view;
+  if ((view = ghost_fview(f, (size_t)-1, &nr)) != NULL) {  /* mapped? */
+    lua_pushlstring(L, view, nr);  /* copy straight out of the mapping */
+    return;
+  }
   luaL_buffinit(L, &b);
   do {  /* read file in chunks of LUAL_BUFFERSIZE bytes */
     char *p = luaL_prepbuffer(&b);
@@ -554,6 +559,11 @@ static int read_chars (lua_State *L, struct ghost_file *f, size_t n) {
   size_t nr;  /* number of chars actually read */
   char *p;
   luaL_Buffer b;
+  const char *view;
+  if ((view = ghost_fview(f, n, &nr)) != NULL) {  /* mapped? */
+    lua_pushlstring(L, view, nr);
+    return (nr > 0);
+  }
   luaL_buffinit(L, &b);
   p = luaL_prepbuffsize(&b, n);  /* prepare buffer to read whole block */
   nr = ghost_fread(p, sizeof(char), n, f);  /* try to read 'n' chars */
@@ -303,6 +303,14 @@ typedef l_uint32 Instruction;
 #endif
 
 
+/*
+** clock used to time collector steps, see 'lua_gcstats'
+*/
+#if !defined(luai_gcclock)
+#define luai_gcclock()		0
+#endif
+
+
 
 /*
 ** The luai_num* macros define the primitive operations over numbers.
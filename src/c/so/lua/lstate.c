@@ -398,6 +398,7 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->GCdebt = 0;
   g->lastatomic = 0;
   setivalue(&g->nilvalue, 0);  /* to signal that state is not yet built */
+  memset(&g->gcstats, 0, sizeof(g->gcstats));
   setgcparam(g->gcpause, LUAI_GCPAUSE);
   setgcparam(g->gcstepmul, LUAI_GCMUL);
   g->gcstepsize = LUAI_GCSTEPSIZE;
@@ -342,6 +342,23 @@ LUA_API void (lua_warning)  (lua_State *L, const char *msg, int tocont);
 LUA_API int (lua_gc) (lua_State *L, int what, ...);
 
 
+/*
+** time spent in the collector, in the units of 'luai_gcclock'
+*/
+#define LUA_GCSTATS_BUCKETS	64
+
+typedef struct lua_GCStats {
+  unsigned long long steps;  /* collector steps that did work */
+  unsigned long long full;  /* full collections */
+  unsigned long long time;  /* total time of both */
+  unsigned long long maxtime;  /* the longest single one */
+  /* by time, [0] for 0 and [i] for [2^(i-1), 2^i) */
+  unsigned long long hist[LUA_GCSTATS_BUCKETS];
+} lua_GCStats;
+
+LUA_API void (lua_gcstats) (lua_State *L, lua_GCStats *stats, int reset);
+
+
 /*
 ** miscellaneous functions
 */
@@ -783,6 +783,10 @@
 ** without modifying the main part of the file.
 */
 
+/* collector steps are timed in nanoseconds, see lua_gcstats */
+#include <trace-clock.h>
+#define luai_gcclock()		trace_clock_now()
+
 
 
 
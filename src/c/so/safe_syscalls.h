@@ -22,10 +22,20 @@
 *                                  INCLUDES                                   *
 ******************************************************************************/
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/types.h>
+#include <time.h>
+#include <linux/futex.h>
 #include <stdnoreturn.h>
 /******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+/* polls of a futex word before sleeping on it, see safe_await_change() */
+#define SAFE_SPIN_LIMIT 128
+/******************************************************************************
 *                                    TYPES                                    *
 ******************************************************************************/
 union _typ_pun{
@@ -216,6 +226,18 @@ static inline int safe_munmap(void *addr, size_t len)
 	return (int)ret.i64;
 }
 /*****************************************************************************/
+static inline int safe_mprotect(void *addr, size_t len, int prot)
+{
+	union _typ_pun ret;
+	union _typ_pun a0 = {.p = addr};
+	union _typ_pun a1 = {.u64 = len};
+	union _typ_pun a2 = {.i64 = prot};
+
+	ret.i64 = _syscall3(SYS_mprotect, a0.i64, a1.i64, a2.i64);
+
+	return (int)ret.i64;
+}
+/*****************************************************************************/
 static inline int safe_kill(pid_t pid, int sig)
 {
 	union _typ_pun ret;
@@ -232,6 +254,231 @@ static inline pid_t safe_getpid(void)
 	return 	(pid_t)_syscall0(SYS_getpid);
 }
 /*****************************************************************************/
+static inline ssize_t safe_write(int fd, const void *buf, size_t count)
+{
+	union _typ_pun ret;
+	union _typ_pun a0 = {.i64 = fd};
+	union _typ_pun a1 = {.p = (void*)buf};
+	union _typ_pun a2 = {.u64 = count};
+
+	ret.u64 = _syscall3(SYS_write, a0.i64, a1.i64, a2.i64);
+
+	return (ssize_t)ret.i64;
+}
+/*****************************************************************************/
+static inline ssize_t safe_writev(int fd, const struct iovec *iov, int cnt)
+{
+	union _typ_pun ret;
+	union _typ_pun a0 = {.i64 = fd};
+	union _typ_pun a1 = {.p = (void*)iov};
+	union _typ_pun a2 = {.i64 = cnt};
+
+	ret.u64 = _syscall3(SYS_writev, a0.i64, a1.i64, a2.i64);
+
+	return (ssize_t)ret.i64;
+}
+/*****************************************************************************/
+static inline int safe_futex_wait(volatile uint32_t *uaddr, uint32_t val)
+{
+	union _typ_pun ret;
+	union _typ_pun a0 = {.p = (void*)uaddr};
+	union _typ_pun a1 = {.i64 = FUTEX_WAIT};
+	union _typ_pun a2 = {.u64 = val};
+
+	ret.u64 = _syscall4(SYS_futex, a0.i64, a1.i64, a2.i64, 0);
+
+	return (int)ret.i64;
+}
+/*****************************************************************************/
+static inline int safe_futex_wake(volatile uint32_t *uaddr, int count)
+{
+	union _typ_pun ret;
+	union _typ_pun a0 = {.p = (void*)uaddr};
+	union _typ_pun a1 = {.i64 = FUTEX_WAKE};
+	union _typ_pun a2 = {.i64 = count};
+
+	ret.u64 = _syscall3(SYS_futex, a0.i64, a1.i64, a2.i64);
+
+	return (int)ret.i64;
+}
+/*****************************************************************************/
+static inline int safe_futex_wait_timeout(
+	volatile uint32_t *uaddr, uint32_t val, const struct timespec *timeout
+) {
+	union _typ_pun ret;
+	union _typ_pun a0 = {.p = (void*)uaddr};
+	union _typ_pun a1 = {.i64 = FUTEX_WAIT};
+	union _typ_pun a2 = {.u64 = val};
+	union _typ_pun a3 = {.p = (void*)timeout};
+
+	ret.u64 = _syscall4(SYS_futex, a0.i64, a1.i64, a2.i64, a3.i64);
+
+	return (int)ret.i64;
+}
+/*****************************************************************************/
+static inline void safe_await_change(volatile uint32_t *uaddr, uint32_t val)
+{
+	/* the other side of a handshake is usually only moments away, so
+	 * poll for a little while before giving up the CPU */
+	for(int i = 0; i < SAFE_SPIN_LIMIT; i++) {
+		if(__atomic_load_n(uaddr, __ATOMIC_ACQUIRE) != val) {
+			return;
+		}
+		__builtin_ia32_pause();
+	}
+
+	while(__atomic_load_n(uaddr, __ATOMIC_ACQUIRE) == val) {
+		safe_futex_wait(uaddr, val);
+	}
+}
+/*****************************************************************************/
+/* A mutex in a futex word which is 0 when free, 1 when held and 2 when held
+ * with someone waiting; it only needs the word zeroed to start with. */
+static inline void safe_mutex_lock(volatile uint32_t *word)
+{
+	uint32_t c = 0;
+
+	if(__atomic_compare_exchange_n(
+		word, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED
+	)) {
+		return;
+	}
+
+	if(c != 2) {
+		c = __atomic_exchange_n(word, 2, __ATOMIC_ACQUIRE);
+	}
+
+	while(c != 0) {
+		safe_futex_wait(word, 2);
+		c = __atomic_exchange_n(word, 2, __ATOMIC_ACQUIRE);
+	}
+}
+/*****************************************************************************/
+static inline bool safe_mutex_trylock(volatile uint32_t *word)
+{
+	uint32_t c = 0;
+
+	return __atomic_compare_exchange_n(
+		word, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED
+	);
+}
+/*****************************************************************************/
+static inline void safe_mutex_unlock(volatile uint32_t *word)
+{
+	if(__atomic_exchange_n(word, 0, __ATOMIC_RELEASE) == 2) {
+		safe_futex_wake(word, 1);
+	}
+}
+/*****************************************************************************/
+static inline ssize_t safe_read(int fd, void *buf, size_t count)
+{
+	union _typ_pun ret;
+	union _typ_pun a0 = {.i64 = fd};
+	union _typ_pun a1 = {.p = buf};
+	union _typ_pun a2 = {.u64 = count};
+
+	ret.u64 = _syscall3(SYS_read, a0.i64, a1.i64, a2.i64);
+
+	return (ssize_t)ret.i64;
+}
+/*****************************************************************************/
+static inline ssize_t safe_pread(int fd, void *buf, size_t count, off_t off)
+{
+	union _typ_pun ret;
+	union _typ_pun a1 = {.p = buf};
+	union _typ_pun a2 = {.u64 = count};
+	union _typ_pun a3 = {.i64 = off};
+
+	ret.u64 = _syscall4(SYS_pread64, fd, a1.i64, a2.i64, a3.i64);
+
+	return (ssize_t)ret.i64;
+}
+/*****************************************************************************/
+static inline ssize_t safe_pwrite(
+	int fd, const void *buf, size_t count, off_t off
+) {
+	union _typ_pun ret;
+	union _typ_pun a1 = {.p = (void*)buf};
+	union _typ_pun a2 = {.u64 = count};
+	union _typ_pun a3 = {.i64 = off};
+
+	ret.u64 = _syscall4(SYS_pwrite64, fd, a1.i64, a2.i64, a3.i64);
+
+	return (ssize_t)ret.i64;
+}
+/*****************************************************************************/
+static inline int safe_open(const char *path, int flags)
+{
+	union _typ_pun ret;
+	union _typ_pun a1 = {.p = (void*)path};
+
+	ret.u64 = _syscall2(SYS_open, a1.i64, flags);
+
+	return (int)ret.i64;
+}
+/*****************************************************************************/
+static inline int safe_close(int fd)
+{
+	return (int)_syscall1(SYS_close, fd);
+}
+/*****************************************************************************/
+static inline int safe_socket(int domain, int type, int protocol)
+{
+	return (int)_syscall3(SYS_socket, domain, type, protocol);
+}
+/*****************************************************************************/
+static inline int safe_bind(int fd, const void *addr, uint32_t len)
+{
+	union _typ_pun ret;
+	union _typ_pun a1 = {.p = (void*)addr};
+
+	ret.u64 = _syscall3(SYS_bind, fd, a1.i64, len);
+
+	return (int)ret.i64;
+}
+/*****************************************************************************/
+static inline int safe_listen(int fd, int backlog)
+{
+	return (int)_syscall2(SYS_listen, fd, backlog);
+}
+/*****************************************************************************/
+static inline int safe_accept4(int fd, int flags)
+{
+	return (int)_syscall4(SYS_accept4, fd, 0, 0, flags);
+}
+/*****************************************************************************/
+static inline int safe_shutdown(int fd, int how)
+{
+	return (int)_syscall2(SYS_shutdown, fd, how);
+}
+/*****************************************************************************/
+static inline int safe_getsockopt(
+	int fd, int level, int name, void *val, uint32_t *len
+) {
+	union _typ_pun ret;
+	union _typ_pun a3 = {.p = val};
+	union _typ_pun a4 = {.p = len};
+
+	ret.u64 = _syscall5(SYS_getsockopt, fd, level, name, a3.i64, a4.i64);
+
+	return (int)ret.i64;
+}
+/*****************************************************************************/
+static inline int safe_tgkill(pid_t tgid, pid_t tid, int sig)
+{
+	return (int)_syscall3(SYS_tgkill, tgid, tid, sig);
+}
+/*****************************************************************************/
+static inline uint32_t safe_geteuid(void)
+{
+	return (uint32_t)_syscall0(SYS_geteuid);
+}
+/*****************************************************************************/
+static inline pid_t safe_gettid(void)
+{
+	return 	(pid_t)_syscall0(SYS_gettid);
+}
+/*****************************************************************************/
 static inline noreturn void safe_exit(int status)
 {
 	_syscall1(SYS_exit, status);
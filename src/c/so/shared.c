@@ -39,8 +39,18 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <setjmp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
 #include <sys/types.h>
 /******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const char PROC_STATUS_PATH[] = "/proc/self/status";
+static const char TRACER_PID_KEY[] = "\nTracerPid:";
+
+#define STATUS_READ_SIZE 4096
+/******************************************************************************
 *                                    DATA                                     *
 ******************************************************************************/
 static pid_t parent_pid;
@@ -52,6 +62,37 @@ static struct prog_opts cached_opts;
 ******************************************************************************/
 static bool am_ghost_patch(const char *progname);
 /*****************************************************************************/
+static bool already_traced(void)
+{
+	/* avoid stdio, this runs before the target's main */
+	char buf[STATUS_READ_SIZE];
+	ssize_t len = 0;
+	ssize_t count;
+
+	int fd = open(PROC_STATUS_PATH, O_RDONLY | O_CLOEXEC);
+
+	if(fd < 0) {
+		return false;
+	}
+
+	while((len < sizeof(buf) - 1) &&
+		(count = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0
+	) {
+		len += count;
+	}
+
+	close(fd);
+	buf[len] = '\0';
+
+	const char *field = strstr(buf, TRACER_PID_KEY);
+
+	if(field == NULL) {
+		return false;
+	}
+
+	return strtol(field + sizeof(TRACER_PID_KEY) - 1, NULL, 10) != 0;
+}
+/*****************************************************************************/
 static void do_special_setup(void)
 {
 	struct trace_entities ents;
@@ -60,10 +101,17 @@ static void do_special_setup(void)
 	get_options(&cached_opts);
 	ghost_signals_init();
 
+	/* with --follow-exec the monitor that traced us before the exec is
+	 * still attached, starting a second one would trace the new
+	 * monitor instead of the program */
+	if(cached_opts.follow_exec && already_traced()) {
+		return;
+	}
+
 	if(cached_opts.lua_ent == NULL) {
 		descr = pseudo_strace_descriptor();
 	} else {
-		descr = lua_trace_descriptor(cached_opts.lua_ent);
+		descr = lua_trace_descriptor(&cached_opts);
 	}
 
 	if(start_trace(&descr, &ents)) {
@@ -0,0 +1,420 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/* X-macro list of the x86-64 system calls, one line per call:
+ *
+ *     SYSCALL_DEF(number, name, return kind, argument kinds...)
+ *
+ * Numbers and names follow asm/unistd_64.h and argument kinds follow the
+ * kernel's SYSCALL_DEFINE signatures. Numbers are spelled out rather than
+ * taken from SYS_* so the table does not depend on the build host's headers.
+ * There is deliberately no include guard, define SYSCALL_DEF before including.
+ *
+ * `make syscall_defs SYSCALL_SRC=<unistd_64.h or syscall_64.tbl>` runs
+ * scripts/gen-syscall-defs.sh to renumber entries and add the calls of a
+ * newer kernel. The signatures can't be generated, so it leaves them alone
+ * and lists the new calls, which get six raw arguments until filled in.
+ */
+SYSCALL_DEF(0, read, SIZE, A_FD, A_RBUF, A_UINT)
+SYSCALL_DEF(1, write, SIZE, A_FD, A_BUF(2), A_UINT)
+SYSCALL_DEF(2, open, FD, A_CSTR, A_OFLAGS, A_OCT)
+SYSCALL_DEF(3, close, INT, A_FD)
+SYSCALL_DEF(4, stat, INT, A_CSTR, A_PTR)
+SYSCALL_DEF(5, fstat, INT, A_FD, A_PTR)
+SYSCALL_DEF(6, lstat, INT, A_CSTR, A_PTR)
+SYSCALL_DEF(7, poll, INT, A_PTR, A_UINT, A_INT)
+SYSCALL_DEF(8, lseek, INT, A_FD, A_LONG, A_INT)
+SYSCALL_DEF(9, mmap, PTR, A_PTR, A_UINT, A_PROT, A_MAPF, A_FD, A_HEX)
+SYSCALL_DEF(10, mprotect, INT, A_PTR, A_UINT, A_PROT)
+SYSCALL_DEF(11, munmap, INT, A_PTR, A_UINT)
+SYSCALL_DEF(12, brk, PTR, A_PTR)
+SYSCALL_DEF(13, rt_sigaction, INT, A_SIG, A_PTR, A_PTR, A_UINT)
+SYSCALL_DEF(14, rt_sigprocmask, INT, A_INT, A_PTR, A_PTR, A_UINT)
+SYSCALL_DEF(15, rt_sigreturn, NONE)
+SYSCALL_DEF(16, ioctl, INT, A_FD, A_HEX, A_HEX)
+SYSCALL_DEF(17, pread64, SIZE, A_FD, A_RBUF, A_UINT, A_LONG)
+SYSCALL_DEF(18, pwrite64, SIZE, A_FD, A_BUF(2), A_UINT, A_LONG)
+SYSCALL_DEF(19, readv, SIZE, A_FD, A_PTR, A_INT)
+SYSCALL_DEF(20, writev, SIZE, A_FD, A_PTR, A_INT)
+SYSCALL_DEF(21, access, INT, A_CSTR, A_INT)
+SYSCALL_DEF(22, pipe, INT, A_PTR)
+SYSCALL_DEF(23, select, INT, A_INT, A_PTR, A_PTR, A_PTR, A_PTR)
+SYSCALL_DEF(24, sched_yield, INT)
+SYSCALL_DEF(25, mremap, PTR, A_PTR, A_UINT, A_UINT, A_HEX, A_PTR)
+SYSCALL_DEF(26, msync, INT, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(27, mincore, INT, A_PTR, A_UINT, A_PTR)
+SYSCALL_DEF(28, madvise, INT, A_PTR, A_UINT, A_INT)
+SYSCALL_DEF(29, shmget, INT, A_INT, A_UINT, A_HEX)
+SYSCALL_DEF(30, shmat, PTR, A_INT, A_PTR, A_HEX)
+SYSCALL_DEF(31, shmctl, INT, A_INT, A_INT, A_PTR)
+SYSCALL_DEF(32, dup, FD, A_FD)
+SYSCALL_DEF(33, dup2, FD, A_FD, A_FD)
+SYSCALL_DEF(34, pause, INT)
+SYSCALL_DEF(35, nanosleep, INT, A_PTR, A_PTR)
+SYSCALL_DEF(36, getitimer, INT, A_INT, A_PTR)
+SYSCALL_DEF(37, alarm, INT, A_UINT)
+SYSCALL_DEF(38, setitimer, INT, A_INT, A_PTR, A_PTR)
+SYSCALL_DEF(39, getpid, INT)
+SYSCALL_DEF(40, sendfile, SIZE, A_FD, A_FD, A_PTR, A_UINT)
+SYSCALL_DEF(41, socket, FD, A_INT, A_INT, A_INT)
+SYSCALL_DEF(42, connect, INT, A_FD, A_PTR, A_INT)
+SYSCALL_DEF(43, accept, FD, A_FD, A_PTR, A_PTR)
+SYSCALL_DEF(44, sendto, SIZE, A_FD, A_BUF(2), A_UINT, A_HEX, A_PTR, A_INT)
+SYSCALL_DEF(45, recvfrom, SIZE, A_FD, A_RBUF, A_UINT, A_HEX, A_PTR, A_PTR)
+SYSCALL_DEF(46, sendmsg, SIZE, A_FD, A_PTR, A_HEX)
+SYSCALL_DEF(47, recvmsg, SIZE, A_FD, A_PTR, A_HEX)
+SYSCALL_DEF(48, shutdown, INT, A_FD, A_INT)
+SYSCALL_DEF(49, bind, INT, A_FD, A_PTR, A_INT)
+SYSCALL_DEF(50, listen, INT, A_FD, A_INT)
+SYSCALL_DEF(51, getsockname, INT, A_FD, A_PTR, A_PTR)
+SYSCALL_DEF(52, getpeername, INT, A_FD, A_PTR, A_PTR)
+SYSCALL_DEF(53, socketpair, INT, A_INT, A_INT, A_INT, A_PTR)
+SYSCALL_DEF(54, setsockopt, INT, A_FD, A_INT, A_INT, A_PTR, A_INT)
+SYSCALL_DEF(55, getsockopt, INT, A_FD, A_INT, A_INT, A_PTR, A_PTR)
+SYSCALL_DEF(56, clone, INT, A_HEX, A_PTR, A_PTR, A_PTR, A_HEX)
+SYSCALL_DEF(57, fork, INT)
+SYSCALL_DEF(58, vfork, INT)
+SYSCALL_DEF(59, execve, INT, A_CSTR, A_PTR, A_PTR)
+SYSCALL_DEF(60, exit, NONE, A_INT)
+SYSCALL_DEF(61, wait4, INT, A_INT, A_PTR, A_HEX, A_PTR)
+SYSCALL_DEF(62, kill, INT, A_INT, A_SIG)
+SYSCALL_DEF(63, uname, INT, A_PTR)
+SYSCALL_DEF(64, semget, INT, A_INT, A_INT, A_HEX)
+SYSCALL_DEF(65, semop, INT, A_INT, A_PTR, A_UINT)
+SYSCALL_DEF(66, semctl, INT, A_INT, A_INT, A_INT, A_HEX)
+SYSCALL_DEF(67, shmdt, INT, A_PTR)
+SYSCALL_DEF(68, msgget, INT, A_INT, A_HEX)
+SYSCALL_DEF(69, msgsnd, INT, A_INT, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(70, msgrcv, SIZE, A_INT, A_PTR, A_UINT, A_LONG, A_HEX)
+SYSCALL_DEF(71, msgctl, INT, A_INT, A_INT, A_PTR)
+SYSCALL_DEF(72, fcntl, INT, A_FD, A_INT, A_HEX)
+SYSCALL_DEF(73, flock, INT, A_FD, A_INT)
+SYSCALL_DEF(74, fsync, INT, A_FD)
+SYSCALL_DEF(75, fdatasync, INT, A_FD)
+SYSCALL_DEF(76, truncate, INT, A_CSTR, A_LONG)
+SYSCALL_DEF(77, ftruncate, INT, A_FD, A_LONG)
+SYSCALL_DEF(78, getdents, INT, A_FD, A_PTR, A_UINT)
+SYSCALL_DEF(79, getcwd, INT, A_RBUF, A_UINT)
+SYSCALL_DEF(80, chdir, INT, A_CSTR)
+SYSCALL_DEF(81, fchdir, INT, A_FD)
+SYSCALL_DEF(82, rename, INT, A_CSTR, A_CSTR)
+SYSCALL_DEF(83, mkdir, INT, A_CSTR, A_OCT)
+SYSCALL_DEF(84, rmdir, INT, A_CSTR)
+SYSCALL_DEF(85, creat, FD, A_CSTR, A_OCT)
+SYSCALL_DEF(86, link, INT, A_CSTR, A_CSTR)
+SYSCALL_DEF(87, unlink, INT, A_CSTR)
+SYSCALL_DEF(88, symlink, INT, A_CSTR, A_CSTR)
+SYSCALL_DEF(89, readlink, SIZE, A_CSTR, A_RBUF, A_UINT)
+SYSCALL_DEF(90, chmod, INT, A_CSTR, A_OCT)
+SYSCALL_DEF(91, fchmod, INT, A_FD, A_OCT)
+SYSCALL_DEF(92, chown, INT, A_CSTR, A_INT, A_INT)
+SYSCALL_DEF(93, fchown, INT, A_FD, A_INT, A_INT)
+SYSCALL_DEF(94, lchown, INT, A_CSTR, A_INT, A_INT)
+SYSCALL_DEF(95, umask, INT, A_OCT)
+SYSCALL_DEF(96, gettimeofday, INT, A_PTR, A_PTR)
+SYSCALL_DEF(97, getrlimit, INT, A_INT, A_PTR)
+SYSCALL_DEF(98, getrusage, INT, A_INT, A_PTR)
+SYSCALL_DEF(99, sysinfo, INT, A_PTR)
+SYSCALL_DEF(100, times, INT, A_PTR)
+SYSCALL_DEF(101, ptrace, INT, A_INT, A_INT, A_PTR, A_PTR)
+SYSCALL_DEF(102, getuid, INT)
+SYSCALL_DEF(103, syslog, INT, A_INT, A_PTR, A_INT)
+SYSCALL_DEF(104, getgid, INT)
+SYSCALL_DEF(105, setuid, INT, A_INT)
+SYSCALL_DEF(106, setgid, INT, A_INT)
+SYSCALL_DEF(107, geteuid, INT)
+SYSCALL_DEF(108, getegid, INT)
+SYSCALL_DEF(109, setpgid, INT, A_INT, A_INT)
+SYSCALL_DEF(110, getppid, INT)
+SYSCALL_DEF(111, getpgrp, INT)
+SYSCALL_DEF(112, setsid, INT)
+SYSCALL_DEF(113, setreuid, INT, A_INT, A_INT)
+SYSCALL_DEF(114, setregid, INT, A_INT, A_INT)
+SYSCALL_DEF(115, getgroups, INT, A_INT, A_PTR)
+SYSCALL_DEF(116, setgroups, INT, A_INT, A_PTR)
+SYSCALL_DEF(117, setresuid, INT, A_INT, A_INT, A_INT)
+SYSCALL_DEF(118, getresuid, INT, A_PTR, A_PTR, A_PTR)
+SYSCALL_DEF(119, setresgid, INT, A_INT, A_INT, A_INT)
+SYSCALL_DEF(120, getresgid, INT, A_PTR, A_PTR, A_PTR)
+SYSCALL_DEF(121, getpgid, INT, A_INT)
+SYSCALL_DEF(122, setfsuid, INT, A_INT)
+SYSCALL_DEF(123, setfsgid, INT, A_INT)
+SYSCALL_DEF(124, getsid, INT, A_INT)
+SYSCALL_DEF(125, capget, INT, A_PTR, A_PTR)
+SYSCALL_DEF(126, capset, INT, A_PTR, A_PTR)
+SYSCALL_DEF(127, rt_sigpending, INT, A_PTR, A_UINT)
+SYSCALL_DEF(128, rt_sigtimedwait, INT, A_PTR, A_PTR, A_PTR, A_UINT)
+SYSCALL_DEF(129, rt_sigqueueinfo, INT, A_INT, A_SIG, A_PTR)
+SYSCALL_DEF(130, rt_sigsuspend, INT, A_PTR, A_UINT)
+SYSCALL_DEF(131, sigaltstack, INT, A_PTR, A_PTR)
+SYSCALL_DEF(132, utime, INT, A_CSTR, A_PTR)
+SYSCALL_DEF(133, mknod, INT, A_CSTR, A_OCT, A_HEX)
+SYSCALL_DEF(134, uselib, INT, A_CSTR)
+SYSCALL_DEF(135, personality, INT, A_HEX)
+SYSCALL_DEF(136, ustat, INT, A_HEX, A_PTR)
+SYSCALL_DEF(137, statfs, INT, A_CSTR, A_PTR)
+SYSCALL_DEF(138, fstatfs, INT, A_FD, A_PTR)
+SYSCALL_DEF(139, sysfs, INT, A_INT, A_HEX, A_HEX)
+SYSCALL_DEF(140, getpriority, INT, A_INT, A_INT)
+SYSCALL_DEF(141, setpriority, INT, A_INT, A_INT, A_INT)
+SYSCALL_DEF(142, sched_setparam, INT, A_INT, A_PTR)
+SYSCALL_DEF(143, sched_getparam, INT, A_INT, A_PTR)
+SYSCALL_DEF(144, sched_setscheduler, INT, A_INT, A_INT, A_PTR)
+SYSCALL_DEF(145, sched_getscheduler, INT, A_INT)
+SYSCALL_DEF(146, sched_get_priority_max, INT, A_INT)
+SYSCALL_DEF(147, sched_get_priority_min, INT, A_INT)
+SYSCALL_DEF(148, sched_rr_get_interval, INT, A_INT, A_PTR)
+SYSCALL_DEF(149, mlock, INT, A_PTR, A_UINT)
+SYSCALL_DEF(150, munlock, INT, A_PTR, A_UINT)
+SYSCALL_DEF(151, mlockall, INT, A_HEX)
+SYSCALL_DEF(152, munlockall, INT)
+SYSCALL_DEF(153, vhangup, INT)
+SYSCALL_DEF(154, modify_ldt, INT, A_INT, A_PTR, A_UINT)
+SYSCALL_DEF(155, pivot_root, INT, A_CSTR, A_CSTR)
+SYSCALL_DEF(156, _sysctl, INT, A_PTR)
+SYSCALL_DEF(157, prctl, INT, A_INT, A_HEX, A_HEX, A_HEX, A_HEX)
+SYSCALL_DEF(158, arch_prctl, INT, A_HEX, A_HEX)
+SYSCALL_DEF(159, adjtimex, INT, A_PTR)
+SYSCALL_DEF(160, setrlimit, INT, A_INT, A_PTR)
+SYSCALL_DEF(161, chroot, INT, A_CSTR)
+SYSCALL_DEF(162, sync, INT)
+SYSCALL_DEF(163, acct, INT, A_CSTR)
+SYSCALL_DEF(164, settimeofday, INT, A_PTR, A_PTR)
+SYSCALL_DEF(165, mount, INT, A_CSTR, A_CSTR, A_CSTR, A_HEX, A_PTR)
+SYSCALL_DEF(166, umount2, INT, A_CSTR, A_HEX)
+SYSCALL_DEF(167, swapon, INT, A_CSTR, A_HEX)
+SYSCALL_DEF(168, swapoff, INT, A_CSTR)
+SYSCALL_DEF(169, reboot, INT, A_HEX, A_HEX, A_HEX, A_PTR)
+SYSCALL_DEF(170, sethostname, INT, A_BUF(1), A_UINT)
+SYSCALL_DEF(171, setdomainname, INT, A_BUF(1), A_UINT)
+SYSCALL_DEF(172, iopl, INT, A_INT)
+SYSCALL_DEF(173, ioperm, INT, A_HEX, A_UINT, A_INT)
+SYSCALL_DEF(174, create_module, PTR, A_CSTR, A_UINT)
+SYSCALL_DEF(175, init_module, INT, A_PTR, A_UINT, A_CSTR)
+SYSCALL_DEF(176, delete_module, INT, A_CSTR, A_HEX)
+SYSCALL_DEF(177, get_kernel_syms, INT, A_PTR)
+SYSCALL_DEF(178, query_module, INT, A_CSTR, A_INT, A_PTR, A_UINT, A_PTR)
+SYSCALL_DEF(179, quotactl, INT, A_HEX, A_CSTR, A_INT, A_PTR)
+SYSCALL_DEF(180, nfsservctl, INT, A_INT, A_PTR, A_PTR)
+SYSCALL_DEF(181, getpmsg, INT)
+SYSCALL_DEF(182, putpmsg, INT)
+SYSCALL_DEF(183, afs_syscall, INT)
+SYSCALL_DEF(184, tuxcall, INT)
+SYSCALL_DEF(185, security, INT)
+SYSCALL_DEF(186, gettid, INT)
+SYSCALL_DEF(187, readahead, SIZE, A_FD, A_LONG, A_UINT)
+SYSCALL_DEF(188, setxattr, INT, A_CSTR, A_CSTR, A_BUF(3), A_UINT, A_HEX)
+SYSCALL_DEF(189, lsetxattr, INT, A_CSTR, A_CSTR, A_BUF(3), A_UINT, A_HEX)
+SYSCALL_DEF(190, fsetxattr, INT, A_FD, A_CSTR, A_BUF(3), A_UINT, A_HEX)
+SYSCALL_DEF(191, getxattr, SIZE, A_CSTR, A_CSTR, A_RBUF, A_UINT)
+SYSCALL_DEF(192, lgetxattr, SIZE, A_CSTR, A_CSTR, A_RBUF, A_UINT)
+SYSCALL_DEF(193, fgetxattr, SIZE, A_FD, A_CSTR, A_RBUF, A_UINT)
+SYSCALL_DEF(194, listxattr, SIZE, A_CSTR, A_RBUF, A_UINT)
+SYSCALL_DEF(195, llistxattr, SIZE, A_CSTR, A_RBUF, A_UINT)
+SYSCALL_DEF(196, flistxattr, SIZE, A_FD, A_RBUF, A_UINT)
+SYSCALL_DEF(197, removexattr, INT, A_CSTR, A_CSTR)
+SYSCALL_DEF(198, lremovexattr, INT, A_CSTR, A_CSTR)
+SYSCALL_DEF(199, fremovexattr, INT, A_FD, A_CSTR)
+SYSCALL_DEF(200, tkill, INT, A_INT, A_SIG)
+SYSCALL_DEF(201, time, INT, A_PTR)
+SYSCALL_DEF(202, futex, INT, A_PTR, A_INT, A_INT, A_PTR, A_PTR, A_INT)
+SYSCALL_DEF(203, sched_setaffinity, INT, A_INT, A_UINT, A_PTR)
+SYSCALL_DEF(204, sched_getaffinity, INT, A_INT, A_UINT, A_PTR)
+SYSCALL_DEF(205, set_thread_area, INT, A_PTR)
+SYSCALL_DEF(206, io_setup, INT, A_UINT, A_PTR)
+SYSCALL_DEF(207, io_destroy, INT, A_HEX)
+SYSCALL_DEF(208, io_getevents, INT, A_HEX, A_LONG, A_LONG, A_PTR, A_PTR)
+SYSCALL_DEF(209, io_submit, INT, A_HEX, A_LONG, A_PTR)
+SYSCALL_DEF(210, io_cancel, INT, A_HEX, A_PTR, A_PTR)
+SYSCALL_DEF(211, get_thread_area, INT, A_PTR)
+SYSCALL_DEF(212, lookup_dcookie, INT, A_HEX, A_RBUF, A_UINT)
+SYSCALL_DEF(213, epoll_create, FD, A_INT)
+SYSCALL_DEF(214, epoll_ctl_old, INT)
+SYSCALL_DEF(215, epoll_wait_old, INT)
+SYSCALL_DEF(216, remap_file_pages, INT, A_PTR, A_UINT, A_PROT, A_UINT, A_HEX)
+SYSCALL_DEF(217, getdents64, INT, A_FD, A_PTR, A_UINT)
+SYSCALL_DEF(218, set_tid_address, INT, A_PTR)
+SYSCALL_DEF(219, restart_syscall, INT)
+SYSCALL_DEF(220, semtimedop, INT, A_INT, A_PTR, A_UINT, A_PTR)
+SYSCALL_DEF(221, fadvise64, INT, A_FD, A_LONG, A_UINT, A_INT)
+SYSCALL_DEF(222, timer_create, INT, A_INT, A_PTR, A_PTR)
+SYSCALL_DEF(223, timer_settime, INT, A_INT, A_HEX, A_PTR, A_PTR)
+SYSCALL_DEF(224, timer_gettime, INT, A_INT, A_PTR)
+SYSCALL_DEF(225, timer_getoverrun, INT, A_INT)
+SYSCALL_DEF(226, timer_delete, INT, A_INT)
+SYSCALL_DEF(227, clock_settime, INT, A_INT, A_PTR)
+SYSCALL_DEF(228, clock_gettime, INT, A_INT, A_PTR)
+SYSCALL_DEF(229, clock_getres, INT, A_INT, A_PTR)
+SYSCALL_DEF(230, clock_nanosleep, INT, A_INT, A_HEX, A_PTR, A_PTR)
+SYSCALL_DEF(231, exit_group, NONE, A_INT)
+SYSCALL_DEF(232, epoll_wait, INT, A_FD, A_PTR, A_INT, A_INT)
+SYSCALL_DEF(233, epoll_ctl, INT, A_FD, A_INT, A_FD, A_PTR)
+SYSCALL_DEF(234, tgkill, INT, A_INT, A_INT, A_SIG)
+SYSCALL_DEF(235, utimes, INT, A_CSTR, A_PTR)
+SYSCALL_DEF(236, vserver, INT)
+SYSCALL_DEF(237, mbind, INT, A_PTR, A_UINT, A_INT, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(238, set_mempolicy, INT, A_INT, A_PTR, A_UINT)
+SYSCALL_DEF(239, get_mempolicy, INT, A_PTR, A_PTR, A_UINT, A_PTR, A_HEX)
+SYSCALL_DEF(240, mq_open, FD, A_CSTR, A_OFLAGS, A_OCT, A_PTR)
+SYSCALL_DEF(241, mq_unlink, INT, A_CSTR)
+SYSCALL_DEF(242, mq_timedsend, INT, A_FD, A_BUF(2), A_UINT, A_UINT, A_PTR)
+SYSCALL_DEF(243, mq_timedreceive, SIZE, A_FD, A_RBUF, A_UINT, A_PTR, A_PTR)
+SYSCALL_DEF(244, mq_notify, INT, A_FD, A_PTR)
+SYSCALL_DEF(245, mq_getsetattr, INT, A_FD, A_PTR, A_PTR)
+SYSCALL_DEF(246, kexec_load, INT, A_HEX, A_UINT, A_PTR, A_HEX)
+SYSCALL_DEF(247, waitid, INT, A_INT, A_INT, A_PTR, A_HEX, A_PTR)
+SYSCALL_DEF(248, add_key, INT, A_CSTR, A_CSTR, A_BUF(3), A_UINT, A_INT)
+SYSCALL_DEF(249, request_key, INT, A_CSTR, A_CSTR, A_CSTR, A_INT)
+SYSCALL_DEF(250, keyctl, INT, A_INT, A_HEX, A_HEX, A_HEX, A_HEX)
+SYSCALL_DEF(251, ioprio_set, INT, A_INT, A_INT, A_INT)
+SYSCALL_DEF(252, ioprio_get, INT, A_INT, A_INT)
+SYSCALL_DEF(253, inotify_init, FD)
+SYSCALL_DEF(254, inotify_add_watch, INT, A_FD, A_CSTR, A_HEX)
+SYSCALL_DEF(255, inotify_rm_watch, INT, A_FD, A_INT)
+SYSCALL_DEF(256, migrate_pages, INT, A_INT, A_UINT, A_PTR, A_PTR)
+SYSCALL_DEF(257, openat, FD, A_DIRFD, A_CSTR, A_OFLAGS, A_OCT)
+SYSCALL_DEF(258, mkdirat, INT, A_DIRFD, A_CSTR, A_OCT)
+SYSCALL_DEF(259, mknodat, INT, A_DIRFD, A_CSTR, A_OCT, A_HEX)
+SYSCALL_DEF(260, fchownat, INT, A_DIRFD, A_CSTR, A_INT, A_INT, A_HEX)
+SYSCALL_DEF(261, futimesat, INT, A_DIRFD, A_CSTR, A_PTR)
+SYSCALL_DEF(262, newfstatat, INT, A_DIRFD, A_CSTR, A_PTR, A_HEX)
+SYSCALL_DEF(263, unlinkat, INT, A_DIRFD, A_CSTR, A_HEX)
+SYSCALL_DEF(264, renameat, INT, A_DIRFD, A_CSTR, A_DIRFD, A_CSTR)
+SYSCALL_DEF(265, linkat, INT, A_DIRFD, A_CSTR, A_DIRFD, A_CSTR, A_HEX)
+SYSCALL_DEF(266, symlinkat, INT, A_CSTR, A_DIRFD, A_CSTR)
+SYSCALL_DEF(267, readlinkat, SIZE, A_DIRFD, A_CSTR, A_RBUF, A_UINT)
+SYSCALL_DEF(268, fchmodat, INT, A_DIRFD, A_CSTR, A_OCT)
+SYSCALL_DEF(269, faccessat, INT, A_DIRFD, A_CSTR, A_INT)
+SYSCALL_DEF(270, pselect6, INT, A_INT, A_PTR, A_PTR, A_PTR, A_PTR, A_PTR)
+SYSCALL_DEF(271, ppoll, INT, A_PTR, A_UINT, A_PTR, A_PTR, A_UINT)
+SYSCALL_DEF(272, unshare, INT, A_HEX)
+SYSCALL_DEF(273, set_robust_list, INT, A_PTR, A_UINT)
+SYSCALL_DEF(274, get_robust_list, INT, A_INT, A_PTR, A_PTR)
+SYSCALL_DEF(275, splice, SIZE, A_FD, A_PTR, A_FD, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(276, tee, SIZE, A_FD, A_FD, A_UINT, A_HEX)
+SYSCALL_DEF(277, sync_file_range, INT, A_FD, A_LONG, A_LONG, A_HEX)
+SYSCALL_DEF(278, vmsplice, SIZE, A_FD, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(279, move_pages, INT, A_INT, A_UINT, A_PTR, A_PTR, A_PTR, A_HEX)
+SYSCALL_DEF(280, utimensat, INT, A_DIRFD, A_CSTR, A_PTR, A_HEX)
+SYSCALL_DEF(281, epoll_pwait, INT, A_FD, A_PTR, A_INT, A_INT, A_PTR, A_UINT)
+SYSCALL_DEF(282, signalfd, FD, A_FD, A_PTR, A_UINT)
+SYSCALL_DEF(283, timerfd_create, FD, A_INT, A_HEX)
+SYSCALL_DEF(284, eventfd, FD, A_UINT)
+SYSCALL_DEF(285, fallocate, INT, A_FD, A_INT, A_LONG, A_LONG)
+SYSCALL_DEF(286, timerfd_settime, INT, A_FD, A_HEX, A_PTR, A_PTR)
+SYSCALL_DEF(287, timerfd_gettime, INT, A_FD, A_PTR)
+SYSCALL_DEF(288, accept4, FD, A_FD, A_PTR, A_PTR, A_HEX)
+SYSCALL_DEF(289, signalfd4, FD, A_FD, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(290, eventfd2, FD, A_UINT, A_HEX)
+SYSCALL_DEF(291, epoll_create1, FD, A_HEX)
+SYSCALL_DEF(292, dup3, FD, A_FD, A_FD, A_HEX)
+SYSCALL_DEF(293, pipe2, INT, A_PTR, A_HEX)
+SYSCALL_DEF(294, inotify_init1, FD, A_HEX)
+SYSCALL_DEF(295, preadv, SIZE, A_FD, A_PTR, A_INT, A_LONG)
+SYSCALL_DEF(296, pwritev, SIZE, A_FD, A_PTR, A_INT, A_LONG)
+SYSCALL_DEF(297, rt_tgsigqueueinfo, INT, A_INT, A_INT, A_SIG, A_PTR)
+SYSCALL_DEF(298, perf_event_open, FD, A_PTR, A_INT, A_INT, A_FD, A_HEX)
+SYSCALL_DEF(299, recvmmsg, INT, A_FD, A_PTR, A_UINT, A_HEX, A_PTR)
+SYSCALL_DEF(300, fanotify_init, FD, A_HEX, A_HEX)
+SYSCALL_DEF(301, fanotify_mark, INT, A_FD, A_HEX, A_HEX, A_DIRFD, A_CSTR)
+SYSCALL_DEF(302, prlimit64, INT, A_INT, A_INT, A_PTR, A_PTR)
+SYSCALL_DEF(303, name_to_handle_at, INT, A_DIRFD, A_CSTR, A_PTR, A_PTR, A_HEX)
+SYSCALL_DEF(304, open_by_handle_at, FD, A_FD, A_PTR, A_OFLAGS)
+SYSCALL_DEF(305, clock_adjtime, INT, A_INT, A_PTR)
+SYSCALL_DEF(306, syncfs, INT, A_FD)
+SYSCALL_DEF(307, sendmmsg, INT, A_FD, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(308, setns, INT, A_FD, A_HEX)
+SYSCALL_DEF(309, getcpu, INT, A_PTR, A_PTR, A_PTR)
+SYSCALL_DEF(310, process_vm_readv, SIZE,
+	A_INT, A_PTR, A_UINT, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(311, process_vm_writev, SIZE,
+	A_INT, A_PTR, A_UINT, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(312, kcmp, INT, A_INT, A_INT, A_INT, A_HEX, A_HEX)
+SYSCALL_DEF(313, finit_module, INT, A_FD, A_CSTR, A_HEX)
+SYSCALL_DEF(314, sched_setattr, INT, A_INT, A_PTR, A_HEX)
+SYSCALL_DEF(315, sched_getattr, INT, A_INT, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(316, renameat2, INT, A_DIRFD, A_CSTR, A_DIRFD, A_CSTR, A_HEX)
+SYSCALL_DEF(317, seccomp, INT, A_UINT, A_HEX, A_PTR)
+SYSCALL_DEF(318, getrandom, SIZE, A_RBUF, A_UINT, A_HEX)
+SYSCALL_DEF(319, memfd_create, FD, A_CSTR, A_HEX)
+SYSCALL_DEF(320, kexec_file_load, INT, A_FD, A_FD, A_UINT, A_CSTR, A_HEX)
+SYSCALL_DEF(321, bpf, INT, A_INT, A_PTR, A_UINT)
+SYSCALL_DEF(322, execveat, INT, A_DIRFD, A_CSTR, A_PTR, A_PTR, A_HEX)
+SYSCALL_DEF(323, userfaultfd, FD, A_HEX)
+SYSCALL_DEF(324, membarrier, INT, A_INT, A_HEX, A_INT)
+SYSCALL_DEF(325, mlock2, INT, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(326, copy_file_range, SIZE,
+	A_FD, A_PTR, A_FD, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(327, preadv2, SIZE, A_FD, A_PTR, A_INT, A_LONG, A_LONG, A_HEX)
+SYSCALL_DEF(328, pwritev2, SIZE, A_FD, A_PTR, A_INT, A_LONG, A_LONG, A_HEX)
+SYSCALL_DEF(329, pkey_mprotect, INT, A_PTR, A_UINT, A_PROT, A_INT)
+SYSCALL_DEF(330, pkey_alloc, INT, A_HEX, A_HEX)
+SYSCALL_DEF(331, pkey_free, INT, A_INT)
+SYSCALL_DEF(332, statx, INT, A_DIRFD, A_CSTR, A_HEX, A_HEX, A_PTR)
+SYSCALL_DEF(333, io_pgetevents, INT,
+	A_HEX, A_LONG, A_LONG, A_PTR, A_PTR, A_PTR)
+SYSCALL_DEF(334, rseq, INT, A_PTR, A_UINT, A_HEX, A_HEX)
+SYSCALL_DEF(424, pidfd_send_signal, INT, A_FD, A_SIG, A_PTR, A_HEX)
+SYSCALL_DEF(425, io_uring_setup, FD, A_UINT, A_PTR)
+SYSCALL_DEF(426, io_uring_enter, INT,
+	A_FD, A_UINT, A_UINT, A_HEX, A_PTR, A_UINT)
+SYSCALL_DEF(427, io_uring_register, INT, A_FD, A_UINT, A_PTR, A_UINT)
+SYSCALL_DEF(428, open_tree, FD, A_DIRFD, A_CSTR, A_HEX)
+SYSCALL_DEF(429, move_mount, INT, A_DIRFD, A_CSTR, A_DIRFD, A_CSTR, A_HEX)
+SYSCALL_DEF(430, fsopen, FD, A_CSTR, A_HEX)
+SYSCALL_DEF(431, fsconfig, INT, A_FD, A_UINT, A_CSTR, A_PTR, A_INT)
+SYSCALL_DEF(432, fsmount, FD, A_FD, A_HEX, A_HEX)
+SYSCALL_DEF(433, fspick, FD, A_DIRFD, A_CSTR, A_HEX)
+SYSCALL_DEF(434, pidfd_open, FD, A_INT, A_HEX)
+SYSCALL_DEF(435, clone3, INT, A_PTR, A_UINT)
+SYSCALL_DEF(436, close_range, INT, A_UINT, A_UINT, A_HEX)
+SYSCALL_DEF(437, openat2, FD, A_DIRFD, A_CSTR, A_PTR, A_UINT)
+SYSCALL_DEF(438, pidfd_getfd, FD, A_FD, A_FD, A_HEX)
+SYSCALL_DEF(439, faccessat2, INT, A_DIRFD, A_CSTR, A_INT, A_HEX)
+SYSCALL_DEF(440, process_madvise, SIZE, A_FD, A_PTR, A_UINT, A_INT, A_HEX)
+SYSCALL_DEF(441, epoll_pwait2, INT, A_FD, A_PTR, A_INT, A_PTR, A_PTR, A_UINT)
+SYSCALL_DEF(442, mount_setattr, INT, A_DIRFD, A_CSTR, A_HEX, A_PTR, A_UINT)
+SYSCALL_DEF(443, quotactl_fd, INT, A_FD, A_HEX, A_INT, A_PTR)
+SYSCALL_DEF(444, landlock_create_ruleset, FD, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(445, landlock_add_rule, INT, A_FD, A_INT, A_PTR, A_HEX)
+SYSCALL_DEF(446, landlock_restrict_self, INT, A_FD, A_HEX)
+SYSCALL_DEF(447, memfd_secret, FD, A_HEX)
+SYSCALL_DEF(448, process_mrelease, INT, A_FD, A_HEX)
+SYSCALL_DEF(449, futex_waitv, INT, A_PTR, A_UINT, A_HEX, A_PTR, A_INT)
+SYSCALL_DEF(450, set_mempolicy_home_node, INT, A_PTR, A_UINT, A_UINT, A_HEX)
+SYSCALL_DEF(451, cachestat, INT, A_FD, A_PTR, A_PTR, A_HEX)
+SYSCALL_DEF(452, fchmodat2, INT, A_DIRFD, A_CSTR, A_OCT, A_HEX)
+SYSCALL_DEF(453, map_shadow_stack, PTR, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(454, futex_wake, INT, A_PTR, A_HEX, A_INT, A_HEX)
+SYSCALL_DEF(455, futex_wait, INT, A_PTR, A_HEX, A_HEX, A_HEX, A_PTR, A_INT)
+SYSCALL_DEF(456, futex_requeue, INT, A_PTR, A_HEX, A_INT, A_INT)
+SYSCALL_DEF(457, statmount, INT, A_PTR, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(458, listmount, INT, A_PTR, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(459, lsm_get_self_attr, INT, A_UINT, A_PTR, A_PTR, A_HEX)
+SYSCALL_DEF(460, lsm_set_self_attr, INT, A_UINT, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(461, lsm_list_modules, INT, A_PTR, A_PTR, A_HEX)
+SYSCALL_DEF(462, mseal, INT, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(463, setxattrat, INT,
+	A_DIRFD, A_CSTR, A_HEX, A_CSTR, A_PTR, A_UINT)
+SYSCALL_DEF(464, getxattrat, SIZE,
+	A_DIRFD, A_CSTR, A_HEX, A_CSTR, A_PTR, A_UINT)
+SYSCALL_DEF(465, listxattrat, SIZE, A_DIRFD, A_CSTR, A_HEX, A_RBUF, A_UINT)
+SYSCALL_DEF(466, removexattrat, INT, A_DIRFD, A_CSTR, A_HEX, A_CSTR)
+SYSCALL_DEF(467, open_tree_attr, FD, A_DIRFD, A_CSTR, A_HEX, A_PTR, A_UINT)
+SYSCALL_DEF(468, file_getattr, INT, A_DIRFD, A_CSTR, A_PTR, A_UINT, A_HEX)
+SYSCALL_DEF(469, file_setattr, INT, A_DIRFD, A_CSTR, A_PTR, A_UINT, A_HEX)
@@ -0,0 +1,547 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#define _GNU_SOURCE
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "syscall-table.h"
+
+#include <gio/ghost-stdio.h>
+#include <trace-print-tools.h>
+#include <tracee-mem.h>
+#include <secret-heap.h>
+#include <utl/math-utl.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct named_flag {
+	const char *name;
+	uint64_t flag;
+};
+
+struct str_out {
+	char *str;
+	size_t size;
+	size_t len;
+};
+/******************************************************************************
+*                                   MACROS                                    *
+******************************************************************************/
+#define A_INT {SC_ARG_INT, 0}
+#define A_UINT {SC_ARG_UINT, 0}
+#define A_LONG {SC_ARG_LONG, 0}
+#define A_HEX {SC_ARG_HEX, 0}
+#define A_OCT {SC_ARG_OCT, 0}
+#define A_FD {SC_ARG_FD, 0}
+#define A_DIRFD {SC_ARG_DIRFD, 0}
+#define A_PTR {SC_ARG_PTR, 0}
+#define A_CSTR {SC_ARG_CSTR, 0}
+#define A_BUF(n) {SC_ARG_BUF, n}
+#define A_RBUF {SC_ARG_RBUF, 0}
+#define A_OFLAGS {SC_ARG_OFLAGS, 0}
+#define A_PROT {SC_ARG_PROT, 0}
+#define A_MAPF {SC_ARG_MAPF, 0}
+#define A_SIG {SC_ARG_SIG, 0}
+
+#define SYSCALL_DEF(nr, sname, rkind, ...) \
+	[nr] = {.name = #sname, .ret = SC_RET_##rkind, .args = {__VA_ARGS__}},
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+#define ARG_REPR_MAX 512
+
+/* largest value the kernel will return as -errno */
+#define MAX_ERRNO 4095
+
+static const struct syscall_desc SYSCALL_TABLE[] = {
+#include "syscall-defs.h"
+};
+
+#define SYSCALL_TABLE_SIZE (sizeof(SYSCALL_TABLE) / sizeof(SYSCALL_TABLE[0]))
+
+static const char *ARG_KIND_NAMES[] = {
+	[SC_ARG_NONE] = "none",
+	[SC_ARG_INT] = "int",
+	[SC_ARG_UINT] = "uint",
+	[SC_ARG_LONG] = "long",
+	[SC_ARG_HEX] = "hex",
+	[SC_ARG_OCT] = "oct",
+	[SC_ARG_FD] = "fd",
+	[SC_ARG_DIRFD] = "dirfd",
+	[SC_ARG_PTR] = "ptr",
+	[SC_ARG_CSTR] = "cstr",
+	[SC_ARG_BUF] = "buf",
+	[SC_ARG_RBUF] = "rbuf",
+	[SC_ARG_OFLAGS] = "oflags",
+	[SC_ARG_PROT] = "prot",
+	[SC_ARG_MAPF] = "mapflags",
+	[SC_ARG_SIG] = "signal"
+};
+
+static const char *RET_KIND_NAMES[] = {
+	[SC_RET_INT] = "int",
+	[SC_RET_FD] = "fd",
+	[SC_RET_SIZE] = "size",
+	[SC_RET_PTR] = "ptr",
+	[SC_RET_NONE] = "none"
+};
+
+static const struct named_flag MMAP_FLAGS[] = {
+	{"MAP_SHARED", MAP_SHARED},
+	{"MAP_PRIVATE", MAP_PRIVATE},
+	{"MAP_32BIT", MAP_32BIT},
+	{"MAP_ANONYMOUS", MAP_ANONYMOUS},
+	{"MAP_DENYWRITE", MAP_DENYWRITE},
+	{"MAP_EXECUTABLE", MAP_EXECUTABLE},
+	{"MAP_FIXED", MAP_FIXED},
+	{"MAP_GROWSDOWN", MAP_GROWSDOWN},
+	{"MAP_HUGETLB", MAP_HUGETLB},
+	{"MAP_LOCKED", MAP_LOCKED},
+	{"MAP_NONBLOCK", MAP_NONBLOCK},
+	{"MAP_NORESERVE", MAP_NORESERVE},
+	{"MAP_POPULATE", MAP_POPULATE},
+	{"MAP_STACK", MAP_STACK},
+	{NULL}
+};
+
+static const struct named_flag MPROTECT_FLAGS[] = {
+	{"PROT_READ", PROT_READ},
+	{"PROT_WRITE", PROT_WRITE},
+	{"PROT_EXEC", PROT_EXEC},
+	{"PROT_GROWSUP", PROT_GROWSUP},
+	{"PROT_GROWSDOWN", PROT_GROWSDOWN},
+	{NULL}
+};
+
+/* multi-bit flags come before the flags they contain */
+static const struct named_flag OPEN_FLAGS[] = {
+	{"O_CREAT", O_CREAT},
+	{"O_EXCL", O_EXCL},
+	{"O_NOCTTY", O_NOCTTY},
+	{"O_TRUNC", O_TRUNC},
+	{"O_APPEND", O_APPEND},
+	{"O_NONBLOCK", O_NONBLOCK},
+	{"O_SYNC", O_SYNC},
+	{"O_DSYNC", O_DSYNC},
+	{"O_ASYNC", O_ASYNC},
+	{"O_DIRECT", O_DIRECT},
+	/* libc defines O_LARGEFILE as 0 on 64 bit targets */
+	{"O_LARGEFILE", 0100000},
+	{"O_TMPFILE", O_TMPFILE},
+	{"O_DIRECTORY", O_DIRECTORY},
+	{"O_NOFOLLOW", O_NOFOLLOW},
+	{"O_NOATIME", O_NOATIME},
+	{"O_CLOEXEC", O_CLOEXEC},
+	{"O_PATH", O_PATH},
+	{NULL}
+};
+
+static const char *OPEN_ACCMODE_NAMES[] = {
+	[O_RDONLY] = "O_RDONLY",
+	[O_WRONLY] = "O_WRONLY",
+	[O_RDWR] = "O_RDWR",
+	[O_ACCMODE] = "O_ACCMODE"
+};
+
+static const char *SIGNAL_NAMES[] = {
+	[SIGHUP] = "SIGHUP",
+	[SIGINT] = "SIGINT",
+	[SIGQUIT] = "SIGQUIT",
+	[SIGILL] = "SIGILL",
+	[SIGTRAP] = "SIGTRAP",
+	[SIGABRT] = "SIGABRT",
+	[SIGBUS] = "SIGBUS",
+	[SIGFPE] = "SIGFPE",
+	[SIGKILL] = "SIGKILL",
+	[SIGUSR1] = "SIGUSR1",
+	[SIGSEGV] = "SIGSEGV",
+	[SIGUSR2] = "SIGUSR2",
+	[SIGPIPE] = "SIGPIPE",
+	[SIGALRM] = "SIGALRM",
+	[SIGTERM] = "SIGTERM",
+	[SIGSTKFLT] = "SIGSTKFLT",
+	[SIGCHLD] = "SIGCHLD",
+	[SIGCONT] = "SIGCONT",
+	[SIGSTOP] = "SIGSTOP",
+	[SIGTSTP] = "SIGTSTP",
+	[SIGTTIN] = "SIGTTIN",
+	[SIGTTOU] = "SIGTTOU",
+	[SIGURG] = "SIGURG",
+	[SIGXCPU] = "SIGXCPU",
+	[SIGXFSZ] = "SIGXFSZ",
+	[SIGVTALRM] = "SIGVTALRM",
+	[SIGPROF] = "SIGPROF",
+	[SIGWINCH] = "SIGWINCH",
+	[SIGIO] = "SIGIO",
+	[SIGPWR] = "SIGPWR",
+	[SIGSYS] = "SIGSYS"
+};
+
+#define NUM_SIGNAL_NAMES (sizeof(SIGNAL_NAMES) / sizeof(SIGNAL_NAMES[0]))
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static void out_puts(struct str_out *o, const char *s)
+{
+	size_t n = min_u64(strlen(s), o->size - o->len - 1);
+
+	memcpy(o->str + o->len, s, n);
+	o->len += n;
+	o->str[o->len] = '\0';
+}
+/*****************************************************************************/
+static void out_flags(
+	struct str_out *o,
+	const struct named_flag *names,
+	const char *zero,
+	uint64_t flag
+) {
+	char tmp[32];
+	bool first = true;
+
+	if(flag == 0) {
+		out_puts(o, zero);
+		return;
+	}
+
+	for(const struct named_flag *n = names; n->name != NULL; n += 1) {
+		if((n->flag == 0) || ((n->flag & flag) != n->flag)) {
+			continue;
+		}
+
+		if(!first) {
+			out_puts(o, "|");
+		}
+
+		out_puts(o, n->name);
+		flag &= ~n->flag;
+		first = false;
+	}
+
+	if(flag != 0) {
+		ghost_snprintf(
+			tmp, sizeof(tmp), "%s%#lx", first ? "" : "|", flag
+		);
+		out_puts(o, tmp);
+	}
+}
+/*****************************************************************************/
+static void out_open_flags(struct str_out *o, uint64_t flag)
+{
+	out_puts(o, OPEN_ACCMODE_NAMES[flag & O_ACCMODE]);
+
+	if((flag & ~(uint64_t)O_ACCMODE) != 0) {
+		out_puts(o, "|");
+		out_flags(o, OPEN_FLAGS, "", flag & ~(uint64_t)O_ACCMODE);
+	}
+}
+/*****************************************************************************/
+static void out_ptr(struct str_out *o, uint64_t addr)
+{
+	char tmp[32];
+
+	ghost_snprintf(tmp, sizeof(tmp), "%p", (void*)addr);
+	out_puts(o, tmp);
+}
+/*****************************************************************************/
+/* buf is our copy of what the target had at addr, which is printed
+ * instead if there is nothing to show */
+static void out_buffer(
+	struct str_out *o,
+	uint64_t addr,
+	const char *buf,
+	int64_t len,
+	size_t print_size
+) {
+	char repr[ARG_REPR_MAX];
+	size_t rsize = min_u64(print_size + 1, sizeof(repr));
+
+	if(sprint_buffer(buf, repr, len, rsize) == NULL) {
+		out_ptr(o, addr);
+		return;
+	}
+
+	out_puts(o, repr);
+}
+/*****************************************************************************/
+static void out_mem(
+	struct str_out *o,
+	const struct tracee_record *rec,
+	uint64_t addr,
+	int64_t len,
+	size_t print_size
+) {
+	void *scratch;
+	size_t got;
+
+	/* sprint_buffer() never looks more than a byte past what fits in the
+	 * representation, so that is all that has to be fetched */
+	size_t want = (len < 0) ? 0 : min_u64(len, ARG_REPR_MAX + 1);
+	const char *buf = tracee_mem_view(rec, addr, want, &scratch, &got);
+
+	if((buf == NULL) && (addr != 0)) {
+		out_ptr(o, addr);
+	} else {
+		out_buffer(o, addr, buf, (got == want) ? len : got, print_size);
+	}
+
+	ghost_free(sheap, scratch);
+}
+/*****************************************************************************/
+static void out_cstr(
+	struct str_out *o,
+	const struct tracee_record *rec,
+	uint64_t addr,
+	size_t print_size
+) {
+	void *scratch;
+	size_t len;
+
+	/* one past the print size is enough to get a continuation marker on
+	 * long strings */
+	size_t max = min_u64(print_size + 1, ARG_REPR_MAX + 1);
+	const char *s = tracee_mem_view_str(rec, addr, max, &scratch, &len);
+
+	if(s == NULL) {
+		out_ptr(o, addr);
+	} else {
+		out_buffer(o, addr, s, len, print_size);
+	}
+
+	ghost_free(sheap, scratch);
+}
+/*****************************************************************************/
+static void out_arg(
+	struct str_out *o,
+	const struct syscall_arg_desc *arg,
+	int n,
+	const struct user_regs_struct *regs,
+	const struct tracee_record *rec,
+	size_t print_size
+) {
+	char tmp[64];
+	uint64_t v = syscall_arg(n, regs);
+
+	switch(arg->kind) {
+	case SC_ARG_INT:
+	case SC_ARG_FD:
+		ghost_snprintf(tmp, sizeof(tmp), "%d", (int)v);
+		break;
+	case SC_ARG_UINT:
+		ghost_snprintf(tmp, sizeof(tmp), "%lu", v);
+		break;
+	case SC_ARG_LONG:
+		ghost_snprintf(tmp, sizeof(tmp), "%ld", (int64_t)v);
+		break;
+	case SC_ARG_HEX:
+		ghost_snprintf(tmp, sizeof(tmp), "%#lx", v);
+		break;
+	case SC_ARG_OCT:
+		ghost_snprintf(tmp, sizeof(tmp), "%#lo", v);
+		break;
+	case SC_ARG_DIRFD:
+		if((int)v == AT_FDCWD) {
+			out_puts(o, "AT_FDCWD");
+			return;
+		}
+		ghost_snprintf(tmp, sizeof(tmp), "%d", (int)v);
+		break;
+	case SC_ARG_PTR:
+		if(v == 0) {
+			out_puts(o, "NULL");
+			return;
+		}
+		ghost_snprintf(tmp, sizeof(tmp), "%p", (void*)v);
+		break;
+	case SC_ARG_CSTR:
+		if(v == 0) {
+			out_puts(o, "NULL");
+		} else {
+			out_cstr(o, rec, v, print_size);
+		}
+		return;
+	case SC_ARG_BUF:
+		out_mem(
+			o, rec, v, syscall_arg(arg->len_arg, regs), print_size
+		);
+		return;
+	case SC_ARG_RBUF:
+		out_mem(o, rec, v, syscall_retval(regs), print_size);
+		return;
+	case SC_ARG_OFLAGS:
+		out_open_flags(o, v);
+		return;
+	case SC_ARG_PROT:
+		out_flags(o, MPROTECT_FLAGS, "PROT_NONE", v);
+		return;
+	case SC_ARG_MAPF:
+		out_flags(o, MMAP_FLAGS, "0", v);
+		return;
+	case SC_ARG_SIG:
+		if((v < NUM_SIGNAL_NAMES) && (SIGNAL_NAMES[v] != NULL)) {
+			out_puts(o, SIGNAL_NAMES[v]);
+			return;
+		}
+		ghost_snprintf(tmp, sizeof(tmp), "%d", (int)v);
+		break;
+	default:
+		tmp[0] = '\0';
+	}
+
+	out_puts(o, tmp);
+}
+/*****************************************************************************/
+static void out_ret(
+	struct str_out *o,
+	const struct syscall_desc *desc,
+	const struct user_regs_struct *regs
+) {
+	char tmp[64];
+	int64_t ret = syscall_retval(regs);
+
+	if(desc->ret == SC_RET_NONE) {
+		out_puts(o, "?");
+		return;
+	}
+
+	if((desc->ret == SC_RET_PTR) && ((ret > 0) || (ret < -MAX_ERRNO))) {
+		ghost_snprintf(tmp, sizeof(tmp), "%p", (void*)ret);
+	} else {
+		ghost_snprintf(tmp, sizeof(tmp), "%ld", ret);
+	}
+
+	out_puts(o, tmp);
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+const struct syscall_desc *syscall_desc_lookup(uint64_t no)
+{
+	if(no >= SYSCALL_TABLE_SIZE || SYSCALL_TABLE[no].name == NULL) {
+		return NULL;
+	}
+
+	return &SYSCALL_TABLE[no];
+}
+/*****************************************************************************/
+int syscall_desc_nargs(const struct syscall_desc *desc)
+{
+	int n = 0;
+
+	while((n < SYSCALL_MAX_ARGS) && (desc->args[n].kind != SC_ARG_NONE)) {
+		n += 1;
+	}
+
+	return n;
+}
+/*****************************************************************************/
+const char *syscall_arg_kind_name(int kind)
+{
+	if((kind < 0) || (kind >= _SC_ARG_TOP)) {
+		return NULL;
+	}
+
+	return ARG_KIND_NAMES[kind];
+}
+/*****************************************************************************/
+const char *syscall_ret_kind_name(int kind)
+{
+	if((kind < 0) || (kind >= _SC_RET_TOP)) {
+		return NULL;
+	}
+
+	return RET_KIND_NAMES[kind];
+}
+/*****************************************************************************/
+uint64_t syscall_retval(const struct user_regs_struct *regs)
+{
+	return regs->rax;
+}
+/*****************************************************************************/
+uint64_t syscall_arg(int n, const struct user_regs_struct *regs)
+{
+	assert(n < SYSCALL_MAX_ARGS);
+
+	switch(n) {
+	case 0:
+		return regs->rdi;
+	case 1:
+		return regs->rsi;
+	case 2:
+		return regs->rdx;
+	case 3:
+		return regs->r10;
+	case 4:
+		return regs->r8;
+	case 5:
+		return regs->r9;
+	default:
+		return syscall_retval(regs);
+	}
+}
+/*****************************************************************************/
+char *sprint_syscall(
+	char *str,
+	size_t size,
+	const struct user_regs_struct *regs,
+	const struct tracee_record *rec,
+	size_t print_size
+) {
+	struct str_out o = {.str = str, .size = size, .len = 0};
+	const struct syscall_desc *desc = syscall_desc_lookup(regs->orig_rax);
+
+	if(size == 0) {
+		return NULL;
+	}
+
+	if(desc == NULL) {
+		ghost_snprintf(
+			str, size, "syscall(%ld, ...) = %ld",
+			(int64_t)regs->orig_rax,
+			(int64_t)syscall_retval(regs)
+		);
+		return str;
+	}
+
+	str[0] = '\0';
+
+	out_puts(&o, desc->name);
+	out_puts(&o, "(");
+
+	for(int i = 0; i < syscall_desc_nargs(desc); i++) {
+		if(i != 0) {
+			out_puts(&o, ", ");
+		}
+		out_arg(&o, &desc->args[i], i, regs, rec, print_size);
+	}
+
+	out_puts(&o, ") = ");
+	out_ret(&o, desc, regs);
+
+	return str;
+}
+/*****************************************************************************/
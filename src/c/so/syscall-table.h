@@ -0,0 +1,94 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef SYSCALL_TABLE_H
+#define SYSCALL_TABLE_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/user.h>
+
+#include "tracee-state-table.h"
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+#define SYSCALL_MAX_ARGS 6
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+enum syscall_arg_kind {
+	SC_ARG_NONE = 0,
+	SC_ARG_INT,
+	SC_ARG_UINT,
+	SC_ARG_LONG,
+	SC_ARG_HEX,
+	SC_ARG_OCT,
+	SC_ARG_FD,
+	SC_ARG_DIRFD,
+	SC_ARG_PTR,
+	SC_ARG_CSTR,
+	/* input buffer, length is in the argument given by len_arg */
+	SC_ARG_BUF,
+	/* output buffer, length is the return value */
+	SC_ARG_RBUF,
+	SC_ARG_OFLAGS,
+	SC_ARG_PROT,
+	SC_ARG_MAPF,
+	SC_ARG_SIG,
+	_SC_ARG_TOP
+};
+
+enum syscall_ret_kind {
+	SC_RET_INT = 0,
+	SC_RET_FD,
+	SC_RET_SIZE,
+	SC_RET_PTR,
+	SC_RET_NONE,
+	_SC_RET_TOP
+};
+
+struct syscall_arg_desc {
+	uint8_t kind;
+	uint8_t len_arg;
+};
+
+struct syscall_desc {
+	const char *name;
+	uint8_t ret;
+	struct syscall_arg_desc args[SYSCALL_MAX_ARGS];
+};
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+const struct syscall_desc *syscall_desc_lookup(uint64_t no);
+int syscall_desc_nargs(const struct syscall_desc *desc);
+const char *syscall_arg_kind_name(int kind);
+const char *syscall_ret_kind_name(int kind);
+uint64_t syscall_arg(int n, const struct user_regs_struct *regs);
+uint64_t syscall_retval(const struct user_regs_struct *regs);
+char *sprint_syscall(
+	char *str,
+	size_t size,
+	const struct user_regs_struct *regs,
+	const struct tracee_record *rec,
+	size_t print_size
+);
+/*****************************************************************************/
+#endif /* SYSCALL_TABLE_H */
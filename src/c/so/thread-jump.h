@@ -23,6 +23,7 @@
 ******************************************************************************/
 #include "platform.h"
 #include "syscall-utl.h"
+#include "safe_syscalls.h"
 
 #include <stdint.h>
 #include <unistd.h>
@@ -32,7 +33,8 @@
 *                                    TYPES                                    *
 ******************************************************************************/
 struct thread_jump {
-	volatile uint64_t flag;
+	/* a futex word, raised once the registers below are saved */
+	volatile uint32_t flag;
 
 	void *ret_addr;
 	void *rsp;
@@ -57,9 +59,9 @@ int __tj_jump(struct thread_jump *src, struct thread_jump *dst, int set_fs);
 /******************************************************************************
 *                              INLINE FUNCTIONS                               *
 ******************************************************************************/
-static inline void tj_spinwait(struct thread_jump *tj)
+static inline void tj_wait(struct thread_jump *tj)
 {
-	while(tj->flag == 0);
+	safe_await_change(&tj->flag, 0);
 }
 /*****************************************************************************/
 static inline ALWAYS_INLINE void tj_jump(struct thread_jump *tj, int set_fs)
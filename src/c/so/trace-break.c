@@ -0,0 +1,345 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "trace-break.h"
+
+#include "tracee-mem.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const uint8_t INT3 = 0xCC;
+/******************************************************************************
+*                                    DATA                                     *
+******************************************************************************/
+static struct trace_breakpoint breakpoints[TRACE_BREAK_MAX];
+
+/* trace_break_id() of the breakpoint the monitor is stepping itself over,
+ * see trace_break_monitor_trap() */
+static uint16_t monitor_step;
+
+/* the breakpoints trace_break_save() kept */
+static struct trace_breakpoint saved[TRACE_BREAK_MAX];
+static size_t n_saved;
+
+/* a vfork child is running in hold_space, see trace_break_hold() */
+static pid_t hold_space;
+static unsigned hold_count;
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static struct trace_breakpoint *free_slot(void)
+{
+	struct trace_breakpoint *retired = NULL;
+
+	for(size_t i = 0; i < TRACE_BREAK_MAX; i++) {
+		struct trace_breakpoint *bp = breakpoints + i;
+
+		if(!bp->used) {
+			return bp;
+		} else if(!bp->armed && (bp->steppers == 0)) {
+			retired = bp;
+		}
+	}
+
+	/* only reuse removed entries when we must, the longer they stay the
+	 * less likely a late trap is mistaken for a signal */
+	return retired;
+}
+/*****************************************************************************/
+static bool held(const struct trace_breakpoint *bp)
+{
+	return (hold_count != 0) && (bp->space == hold_space);
+}
+/*****************************************************************************/
+static bool patched(const struct trace_breakpoint *bp)
+{
+	return bp->armed && (bp->steppers == 0) && !held(bp);
+}
+/*****************************************************************************/
+static void disarm(struct trace_breakpoint *bp)
+{
+	if(patched(bp)) {
+		tracee_mem_patch(bp->space, bp->addr, &bp->orig, NULL, 1);
+	}
+
+	bp->armed = false;
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+int trace_break_insert(pid_t space, uint64_t addr)
+{
+	struct trace_breakpoint *bp = trace_break_find(addr);
+
+	if((bp != NULL) && bp->armed) {
+		return 0;
+	} else if((bp != NULL) && (bp->steppers != 0)) {
+		/* the int3 goes back in once the steppers are done */
+		bp->armed = true;
+		return 0;
+	}
+
+	if(bp == NULL) {
+		bp = free_slot();
+	}
+
+	if(bp == NULL) {
+		return -1;
+	}
+
+	const uint8_t *byte = &INT3;
+
+	if((hold_count != 0) && (space == hold_space)) {
+		/* armed once the hold is released */
+		byte = NULL;
+	}
+
+	if(tracee_mem_patch(space, addr, byte, &bp->orig, 1) != 0) {
+		return -1;
+	}
+
+	bp->addr = addr;
+	bp->space = space;
+	bp->used = true;
+	bp->armed = true;
+	bp->steppers = 0;
+
+	return 0;
+}
+/*****************************************************************************/
+int trace_break_remove(uint64_t addr)
+{
+	struct trace_breakpoint *bp = trace_break_find(addr);
+
+	if((bp == NULL) || !bp->armed) {
+		return -1;
+	}
+
+	disarm(bp);
+
+	return 0;
+}
+/*****************************************************************************/
+void trace_break_clear(void)
+{
+	for(size_t i = 0; i < TRACE_BREAK_MAX; i++) {
+		if(breakpoints[i].used) {
+			disarm(breakpoints + i);
+		}
+	}
+
+	hold_count = 0;
+}
+/*****************************************************************************/
+void trace_break_save(void)
+{
+	n_saved = 0;
+
+	for(size_t i = 0; i < TRACE_BREAK_MAX; i++) {
+		if(breakpoints[i].used && breakpoints[i].armed) {
+			saved[n_saved++] = breakpoints[i];
+		}
+	}
+}
+/*****************************************************************************/
+void trace_break_restore(void)
+{
+	trace_break_clear();
+
+	/* one whose code has been unmapped since is simply gone */
+	for(size_t i = 0; i < n_saved; i++) {
+		trace_break_insert(saved[i].space, saved[i].addr);
+	}
+
+	n_saved = 0;
+}
+/*****************************************************************************/
+void trace_break_forget(pid_t space)
+{
+	for(size_t i = 0; i < TRACE_BREAK_MAX; i++) {
+		struct trace_breakpoint *bp = breakpoints + i;
+
+		if(!bp->used || (bp->space != space)) {
+			continue;
+		}
+
+		/* the space we share outlives the target's exec, and we run
+		 * code from it, so the original bytes go back in */
+		if(space == 0) {
+			bp->steppers = 0;
+			disarm(bp);
+		}
+
+		memset(bp, 0, sizeof(*bp));
+	}
+
+	if(space == hold_space) {
+		hold_count = 0;
+	}
+}
+/*****************************************************************************/
+void trace_break_scrub(pid_t space, pid_t copy)
+{
+	for(size_t i = 0; i < TRACE_BREAK_MAX; i++) {
+		struct trace_breakpoint *bp = breakpoints + i;
+
+		if(bp->used && (bp->space == space)) {
+			tracee_mem_patch(copy, bp->addr, &bp->orig, NULL, 1);
+		}
+	}
+}
+/*****************************************************************************/
+void trace_break_hold(pid_t space)
+{
+	if((hold_count != 0) && (space != hold_space)) {
+		/* only one space at a time, the other keeps its int3s */
+		return;
+	} else if(hold_count != 0) {
+		hold_count += 1;
+		return;
+	}
+
+	for(size_t i = 0; i < TRACE_BREAK_MAX; i++) {
+		struct trace_breakpoint *bp = breakpoints + i;
+
+		if(bp->used && (bp->space == space) && patched(bp)) {
+			tracee_mem_patch(space, bp->addr, &bp->orig, NULL, 1);
+		}
+	}
+
+	hold_space = space;
+	hold_count = 1;
+}
+/*****************************************************************************/
+void trace_break_release(pid_t space)
+{
+	if((hold_count == 0) || (space != hold_space)) {
+		return;
+	}
+
+	hold_count -= 1;
+
+	if(hold_count != 0) {
+		return;
+	}
+
+	for(size_t i = 0; i < TRACE_BREAK_MAX; i++) {
+		struct trace_breakpoint *bp = breakpoints + i;
+
+		if(bp->used && (bp->space == space) && patched(bp)) {
+			tracee_mem_patch(space, bp->addr, &INT3, NULL, 1);
+		}
+	}
+}
+/*****************************************************************************/
+struct trace_breakpoint *trace_break_find(uint64_t addr)
+{
+	for(size_t i = 0; i < TRACE_BREAK_MAX; i++) {
+		if(breakpoints[i].used && (breakpoints[i].addr == addr)) {
+			return breakpoints + i;
+		}
+	}
+
+	return NULL;
+}
+/*****************************************************************************/
+uint16_t trace_break_id(const struct trace_breakpoint *bp)
+{
+	return (bp - breakpoints) + 1;
+}
+/*****************************************************************************/
+struct trace_breakpoint *trace_break_by_id(uint16_t id)
+{
+	if((id == 0) || (id > TRACE_BREAK_MAX)) {
+		return NULL;
+	}
+
+	return breakpoints + id - 1;
+}
+/*****************************************************************************/
+int trace_break_step_begin(struct trace_breakpoint *bp, pid_t space)
+{
+	if(!bp->armed || (space != bp->space)) {
+		/* a copy left behind in another space, e.g. by a fork we
+		 * didn't get to scrub, goes for good */
+		tracee_mem_patch(space, bp->addr, &bp->orig, NULL, 1);
+		return -1;
+	}
+
+	if((bp->steppers == 0) && !held(bp)) {
+		if(tracee_mem_patch(space, bp->addr, &bp->orig, NULL, 1)) {
+			return -1;
+		}
+	}
+
+	bp->steppers += 1;
+
+	return 0;
+}
+/*****************************************************************************/
+void trace_break_step_end(struct trace_breakpoint *bp, pid_t space)
+{
+	if(bp->steppers == 0) {
+		return;
+	}
+
+	bp->steppers -= 1;
+
+	if(patched(bp)) {
+		tracee_mem_patch(space, bp->addr, &INT3, NULL, 1);
+	}
+}
+/*****************************************************************************/
+bool trace_break_monitor_trap(uint64_t *rip)
+{
+	struct trace_breakpoint *bp = trace_break_find(*rip - 1);
+
+	if((bp == NULL) || (bp->space != 0)) {
+		return false;
+	}
+
+	/* the monitor takes its turn as a stepper, like a thread of the
+	 * shared space, a removed breakpoint just loses its int3 */
+	if(trace_break_step_begin(bp, 0) == 0) {
+		monitor_step = trace_break_id(bp);
+	}
+
+	*rip = bp->addr;
+
+	return true;
+}
+/*****************************************************************************/
+void trace_break_monitor_step_end(void)
+{
+	struct trace_breakpoint *bp = trace_break_by_id(monitor_step);
+
+	if(bp == NULL) {
+		return;
+	}
+
+	monitor_step = 0;
+	trace_break_step_end(bp, 0);
+}
+/*****************************************************************************/
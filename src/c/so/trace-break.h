@@ -0,0 +1,89 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef TRACE_BREAK_H
+#define TRACE_BREAK_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+#define TRACE_BREAK_MAX 256
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+/* An int3 patched over the first byte of an instruction. A thread that hits
+ * it stops with a SIGTRAP one byte past addr; the monitor puts the original
+ * byte back, single steps the thread over it and then re-arms it. */
+struct trace_breakpoint {
+	uint64_t addr;
+	/* address space it was set in, see tracee_mem_space() */
+	pid_t space;
+	uint8_t orig;
+	bool used;
+	/* cleared on removal, the entry is kept so that a trap that was
+	 * already on its way can still be recognised as ours */
+	bool armed;
+	/* threads single stepping over the original instruction, the int3
+	 * only goes back once the last of them is past it */
+	unsigned steppers;
+};
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+int trace_break_insert(pid_t space, uint64_t addr);
+int trace_break_remove(uint64_t addr);
+/* removes every breakpoint, before a detach or a script reload */
+void trace_break_clear(void);
+/* Keeps a list of the armed breakpoints. trace_break_restore() clears every
+ * breakpoint and arms the listed ones again, which puts a failed reload's
+ * changes back the way the old script left them. */
+void trace_break_save(void);
+void trace_break_restore(void);
+/* drops the breakpoints of a space replaced by an exec */
+void trace_break_forget(pid_t space);
+/* Puts the original bytes of space's breakpoints into copy, the space of a
+ * child that forked off with them in. */
+void trace_break_scrub(pid_t space, pid_t copy);
+/* Take the int3s of space out while a vfork child borrows it, and put them
+ * back once it has let go. Holds nest; only one space is held at a time. */
+void trace_break_hold(pid_t space);
+void trace_break_release(pid_t space);
+struct trace_breakpoint *trace_break_find(uint64_t addr);
+/* small, non-zero handles that fit in a tracee_record */
+uint16_t trace_break_id(const struct trace_breakpoint *bp);
+struct trace_breakpoint *trace_break_by_id(uint16_t id);
+/* Start or finish stepping a thread of space over bp's instruction. begin
+ * returns non-zero if the breakpoint is gone and there is nothing to step
+ * over. */
+int trace_break_step_begin(struct trace_breakpoint *bp, pid_t space);
+void trace_break_step_end(struct trace_breakpoint *bp, pid_t space);
+/* For a SIGTRAP raised in the monitor itself, which runs the same code as
+ * the target but isn't traced. Takes the int3 before *rip out and rewinds
+ * *rip onto it, the monitor then single steps itself over the original
+ * instruction with the trap flag and calls trace_break_monitor_step_end()
+ * on the trap that follows, which puts the int3 back. Returns false if the
+ * trap isn't ours. */
+bool trace_break_monitor_trap(uint64_t *rip);
+void trace_break_monitor_step_end(void);
+/*****************************************************************************/
+#endif /* TRACE_BREAK_H */
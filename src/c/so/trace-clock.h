@@ -0,0 +1,46 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef TRACE_CLOCK_H
+#define TRACE_CLOCK_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+#include <time.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+#define TRACE_CLOCK_NS_PER_SEC 1000000000ULL
+#define TRACE_CLOCK_NS_PER_MS 1000000ULL
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+/* Monotonic time in nanoseconds. glibc services CLOCK_MONOTONIC from the
+ * vDSO, so this costs no system call and is cheap enough to take on every
+ * ptrace stop. */
+static inline uint64_t trace_clock_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * TRACE_CLOCK_NS_PER_SEC + ts.tv_nsec;
+}
+/*****************************************************************************/
+#endif /* TRACE_CLOCK_H */
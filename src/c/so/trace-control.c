@@ -0,0 +1,255 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#define _GNU_SOURCE
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "trace-control.h"
+
+#include "fake-pthread.h"
+#include <control.h>
+#include <safe_syscalls.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+enum mailbox_state {
+	MAILBOX_EMPTY,
+	MAILBOX_POSTED,
+	MAILBOX_ANSWERED
+};
+/*****************************************************************************/
+struct trace_control {
+	int fd;
+	pid_t pid;
+	pid_t tid;
+	int signo;
+
+	uint32_t state;
+	uint32_t stop;
+
+	char command[CONTROL_MSG_MAX];
+	char reply[CONTROL_MSG_MAX];
+
+	struct fake_thread thread;
+};
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+/* how long to wait for the monitor before signalling it again, it may have
+ * been just about to enter waitpid() when the first signal came in */
+static const struct timespec KICK_INTERVAL = {0, 50 * 1000 * 1000};
+
+static const char DENIED_REPLY[] = "error: permission denied\n";
+/******************************************************************************
+*                                    DATA                                     *
+******************************************************************************/
+static struct trace_control ctl = {.fd = -1};
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static bool peer_allowed(int fd)
+{
+	struct ucred cred;
+	uint32_t len = sizeof(cred);
+
+	if(safe_getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+		return false;
+	}
+
+	/* a command can load arbitrary Lua into the target */
+	return (cred.uid == 0) || (cred.uid == safe_geteuid());
+}
+/*****************************************************************************/
+static size_t read_command(int fd)
+{
+	size_t len = 0;
+
+	while(len < (CONTROL_MSG_MAX - 1)) {
+		ssize_t n = safe_read(fd, ctl.command + len, 1);
+
+		if(n == -EINTR) {
+			continue;
+		} else if((n <= 0) || (ctl.command[len] == '\n')) {
+			break;
+		}
+
+		len += 1;
+	}
+
+	ctl.command[len] = '\0';
+
+	return len;
+}
+/*****************************************************************************/
+static void write_all(int fd, const char *buf, size_t len)
+{
+	while(len > 0) {
+		ssize_t n = safe_write(fd, buf, len);
+
+		if(n == -EINTR) {
+			continue;
+		} else if(n <= 0) {
+			break;
+		}
+
+		buf += n;
+		len -= n;
+	}
+}
+/*****************************************************************************/
+static void post_command(void)
+{
+	__atomic_store_n(&ctl.state, MAILBOX_POSTED, __ATOMIC_RELEASE);
+
+	while(!__atomic_load_n(&ctl.stop, __ATOMIC_ACQUIRE)) {
+		uint32_t state = __atomic_load_n(&ctl.state, __ATOMIC_ACQUIRE);
+
+		if(state == MAILBOX_ANSWERED) {
+			break;
+		}
+
+		safe_tgkill(ctl.pid, ctl.tid, ctl.signo);
+		safe_futex_wait_timeout(&ctl.state, state, &KICK_INTERVAL);
+	}
+}
+/*****************************************************************************/
+static void serve(int fd)
+{
+	if(!peer_allowed(fd)) {
+		write_all(fd, DENIED_REPLY, sizeof(DENIED_REPLY) - 1);
+		return;
+	}
+
+	if(read_command(fd) == 0) {
+		return;
+	}
+
+	post_command();
+
+	if(__atomic_load_n(&ctl.state, __ATOMIC_ACQUIRE) == MAILBOX_ANSWERED) {
+		write_all(fd, ctl.reply, strnlen(ctl.reply, CONTROL_MSG_MAX));
+	}
+
+	__atomic_store_n(&ctl.state, MAILBOX_EMPTY, __ATOMIC_RELEASE);
+}
+/*****************************************************************************/
+static int control_main(void *arg)
+{
+	while(!__atomic_load_n(&ctl.stop, __ATOMIC_ACQUIRE)) {
+		int fd = safe_accept4(ctl.fd, SOCK_CLOEXEC);
+
+		if((fd == -EINTR) || (fd == -ECONNABORTED)) {
+			continue;
+		} else if(fd < 0) {
+			break;
+		}
+
+		serve(fd);
+		safe_close(fd);
+	}
+
+	return 0;
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+int trace_control_start(pid_t pid, pid_t tid, int signo)
+{
+	struct sockaddr_un addr;
+	socklen_t len = control_sock_addr(&addr, pid);
+
+	ctl.pid = pid;
+	ctl.tid = tid;
+	ctl.signo = signo;
+	ctl.state = MAILBOX_EMPTY;
+	ctl.stop = 0;
+
+	ctl.fd = safe_socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if(ctl.fd < 0) {
+		goto fail_1;
+	}
+	if(safe_bind(ctl.fd, &addr, len) != 0) {
+		goto fail_2;
+	}
+	if(safe_listen(ctl.fd, 4) != 0) {
+		goto fail_2;
+	}
+	if(fake_thread_start(&ctl.thread, control_main, NULL)) {
+		goto fail_2;
+	}
+
+	return 0;
+fail_2:
+	safe_close(ctl.fd);
+fail_1:
+	ctl.fd = -1;
+	return -1;
+}
+/*****************************************************************************/
+const char *trace_control_command(void)
+{
+	if(ctl.fd < 0) {
+		return NULL;
+	}
+
+	if(__atomic_load_n(&ctl.state, __ATOMIC_ACQUIRE) != MAILBOX_POSTED) {
+		return NULL;
+	}
+
+	return ctl.command;
+}
+/*****************************************************************************/
+void trace_control_reply(const char *reply)
+{
+	size_t len = strnlen(reply, CONTROL_MSG_MAX - 1);
+
+	memcpy(ctl.reply, reply, len);
+	ctl.reply[len] = '\0';
+
+	__atomic_store_n(&ctl.state, MAILBOX_ANSWERED, __ATOMIC_RELEASE);
+	safe_futex_wake(&ctl.state, 1);
+}
+/*****************************************************************************/
+void trace_control_stop(void)
+{
+	if(ctl.fd < 0) {
+		return;
+	}
+
+	__atomic_store_n(&ctl.stop, 1, __ATOMIC_RELEASE);
+	safe_futex_wake(&ctl.state, 1);
+
+	/* wakes the thread out of accept() */
+	safe_shutdown(ctl.fd, SHUT_RDWR);
+
+	fake_thread_join(&ctl.thread);
+	safe_close(ctl.fd);
+
+	ctl.fd = -1;
+}
+/*****************************************************************************/
@@ -0,0 +1,37 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef TRACE_CONTROL_H
+#define TRACE_CONTROL_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <sys/types.h>
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+/* Serves the control socket of the monitor with pid. Every command that
+ * comes in is posted for the monitor and thread tid is sent signo until it
+ * picks the command up with trace_control_command() and answers it with
+ * trace_control_reply(). */
+int trace_control_start(pid_t pid, pid_t tid, int signo);
+const char *trace_control_command(void);
+void trace_control_reply(const char *reply);
+void trace_control_stop(void);
+/*****************************************************************************/
+#endif /* TRACE_CONTROL_H */
@@ -0,0 +1,695 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "trace-hook.h"
+
+#include "x86-insn.h"
+#include "tracee-mem.h"
+#include "safe_syscalls.h"
+#include <utl/file-utl.h>
+#include <utl/math-utl.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cpuid.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+#define TRAMP_PAGE_SIZE 4096
+#define TRAMP_SLOT_SIZE 128
+#define TRAMP_PAGES_MAX TRACE_HOOK_MAX
+
+/* jmp rel32, what goes over the function's entry */
+#define ENTRY_JMP_LEN 5
+/* jmp *0(%rip) followed by the absolute address */
+#define ABS_JMP_LEN 14
+/* movabs $hook, %r11 */
+#define LOAD_HOOK_LEN 10
+#define RESUME_OFF (LOAD_HOOK_LEN + ABS_JMP_LEN)
+
+/* CPUID leaf listing the xsave state components and their size */
+#define CPUID_XSAVE_LEAF 0xD
+#define XSAVE_ALIGN 64
+
+/* a patch is at most a trampoline slot, which can straddle two pages */
+#define WRITE_PAGES_MAX 2
+#define MAPS_LINE_MAX 512
+
+#define TLS_INITIAL_EXEC __attribute__((tls_model("initial-exec")))
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct tramp_page {
+	uint8_t *base;
+	size_t used;
+};
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+/* how far apart to try mapping trampolines near the code, and how often */
+static const uint64_t MAP_STRIDE = 1ULL << 24;
+static const int MAP_TRIES = 128;
+/* what a rel32 can reach, less some slack for the instruction itself */
+static const int64_t REL32_REACH = INT32_MAX - TRAMP_PAGE_SIZE;
+/******************************************************************************
+*                                    DATA                                     *
+******************************************************************************/
+static struct trace_hook hooks[TRACE_HOOK_MAX];
+/* addresses of the hooks trace_hook_save() kept */
+static uint64_t saved[TRACE_HOOK_MAX];
+static size_t n_saved;
+static struct tramp_page pages[TRAMP_PAGES_MAX];
+
+static trace_hook_handler handler_fn;
+static void *handler_arg;
+/* handlers run without the lock, see trace_hook_set_concurrent() */
+static bool concurrent;
+
+/* see safe_mutex_lock() */
+static volatile uint32_t lock_word;
+/* how deep the thread is in the lock, the monitor has TLS of its own */
+static __thread unsigned lock_depth TLS_INITIAL_EXEC;
+/* set while the thread is in the handler, apart from the lock so that a
+ * concurrent handler can still take it */
+static __thread bool in_handler TLS_INITIAL_EXEC;
+
+/* bytes __hook_entry sets aside to xsave into, 0 to fall back on fxsave */
+uint64_t __hook_xsave_size __attribute__((visibility("hidden")));
+static bool xsave_probed;
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+/* from hook-entry.S */
+void __hook_entry(void);
+void __hook_return(void);
+/* called by __hook_entry */
+void trace_hook_dispatch(struct trace_hook *hook, struct trace_hook_frame *f);
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static bool map_failed(const void *p)
+{
+	/* the raw syscall hands back -errno rather than MAP_FAILED */
+	return (uintptr_t)p >= (uintptr_t)-TRAMP_PAGE_SIZE;
+}
+/*****************************************************************************/
+static bool in_reach(uint64_t from, uint64_t to)
+{
+	int64_t dist = (int64_t)(to - from);
+
+	return (dist > -REL32_REACH) && (dist < REL32_REACH);
+}
+/*****************************************************************************/
+static void put_u32(uint8_t *dst, uint32_t v)
+{
+	memcpy(dst, &v, sizeof(v));
+}
+/*****************************************************************************/
+static void put_u64(uint8_t *dst, uint64_t v)
+{
+	memcpy(dst, &v, sizeof(v));
+}
+/*****************************************************************************/
+static size_t emit_abs_jmp(uint8_t *dst, uint64_t to)
+{
+	static const uint8_t JMP_RIP[] = {0xFF, 0x25, 0x00, 0x00, 0x00, 0x00};
+
+	memcpy(dst, JMP_RIP, sizeof(JMP_RIP));
+	put_u64(dst + sizeof(JMP_RIP), to);
+
+	return ABS_JMP_LEN;
+}
+/*****************************************************************************/
+static void probe_xsave(void)
+{
+	unsigned a, b, c, d;
+
+	xsave_probed = true;
+
+	if(!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_OSXSAVE)) {
+		return;
+	}
+
+	/* ebx is the size of the components the kernel has turned on, the
+	 * ymm and zmm upper halves among them */
+	__cpuid_count(CPUID_XSAVE_LEAF, 0, a, b, c, d);
+
+	__hook_xsave_size = align_up_unsigned(b, XSAVE_ALIGN);
+}
+/*****************************************************************************/
+static int page_prot(uint64_t page, int *prot)
+{
+	char line_buffer[MAPS_LINE_MAX];
+	int ret = -1;
+	int fd = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+
+	if(fd < 0) {
+		return -1;
+	}
+
+	struct file_utl_reader_state reader;
+	file_utl_reader_init(&reader, fd, line_buffer, sizeof(line_buffer));
+
+	while(file_utl_read_line(&reader) > 0) {
+		char *end = NULL;
+		uint64_t start = strtoull(reader.data, &end, 16);
+		uint64_t stop = strtoull(end + 1, &end, 16);
+		const char *perms = end + 1;
+
+		if((page < start) || (page >= stop)) {
+			continue;
+		}
+
+		*prot = 0;
+		*prot |= (perms[0] == 'r') ? PROT_READ : 0;
+		*prot |= (perms[1] == 'w') ? PROT_WRITE : 0;
+		*prot |= (perms[2] == 'x') ? PROT_EXEC : 0;
+		ret = 0;
+		break;
+	}
+
+	close(fd);
+	return ret;
+}
+/*****************************************************************************/
+static int write_text(uint64_t addr, const void *src, size_t len)
+{
+	uint64_t first = addr & ~(uint64_t)(TRAMP_PAGE_SIZE - 1);
+	uint64_t last = (addr + len - 1) & ~(uint64_t)(TRAMP_PAGE_SIZE - 1);
+	size_t pages = (last - first) / TRAMP_PAGE_SIZE + 1;
+	uint64_t word = addr & ~7ULL;
+	int prot[WRITE_PAGES_MAX];
+
+	if(pages > WRITE_PAGES_MAX) {
+		return -1;
+	}
+
+	/* put back whatever the page had, a JIT's rwx pages included */
+	for(size_t i = 0; i < pages; i++) {
+		if(page_prot(first + i * TRAMP_PAGE_SIZE, prot + i) != 0) {
+			return -1;
+		}
+	}
+
+	/* execute stays on throughout, the page may hold the very code that
+	 * is doing the writing */
+	if(safe_mprotect(
+		(void*)first,
+		pages * TRAMP_PAGE_SIZE,
+		PROT_READ | PROT_WRITE | PROT_EXEC
+	) != 0) {
+		return -1;
+	}
+
+	if(addr + len <= word + 8) {
+		/* a thread running through the entry sees the old bytes or
+		 * the new ones, never half of each */
+		uint64_t *dst = (uint64_t*)word;
+		uint64_t val = __atomic_load_n(dst, __ATOMIC_RELAXED);
+
+		memcpy((uint8_t*)&val + (addr - word), src, len);
+		__atomic_store_n(dst, val, __ATOMIC_RELEASE);
+	} else {
+		/* entries are nearly always aligned, this one can be seen
+		 * half written */
+		memcpy((void*)addr, src, len);
+	}
+
+	for(size_t i = 0; i < pages; i++) {
+		void *page = (void*)(first + i * TRAMP_PAGE_SIZE);
+
+		safe_mprotect(page, TRAMP_PAGE_SIZE, prot[i]);
+	}
+
+	return 0;
+}
+/*****************************************************************************/
+static uint8_t *map_near(uint64_t addr)
+{
+	uint64_t base = addr & ~(uint64_t)(TRAMP_PAGE_SIZE - 1);
+
+	for(int i = 0; i < MAP_TRIES; i++) {
+		/* alternately below and above the code, further each time */
+		uint64_t step = (uint64_t)(i / 2 + 1) * MAP_STRIDE;
+		uint64_t hint = (i & 1) ? base + step : base - step;
+
+		uint8_t *p = safe_mmap(
+			(void*)hint,
+			TRAMP_PAGE_SIZE,
+			PROT_READ | PROT_EXEC,
+			MAP_PRIVATE | MAP_ANONYMOUS,
+			-1,
+			0
+		);
+
+		if(map_failed(p)) {
+			continue;
+		} else if(in_reach((uint64_t)p, addr)) {
+			return p;
+		}
+
+		safe_munmap(p, TRAMP_PAGE_SIZE);
+	}
+
+	return NULL;
+}
+/*****************************************************************************/
+static uint8_t *alloc_slot(uint64_t addr)
+{
+	struct tramp_page *page = NULL;
+
+	for(size_t i = 0; i < TRAMP_PAGES_MAX; i++) {
+		struct tramp_page *p = pages + i;
+		bool room = (p->used + TRAMP_SLOT_SIZE) <= TRAMP_PAGE_SIZE;
+
+		if(p->base == NULL) {
+			page = (page == NULL) ? p : page;
+		} else if(room && in_reach((uint64_t)p->base, addr)) {
+			page = p;
+			break;
+		}
+	}
+
+	if(page == NULL) {
+		return NULL;
+	} else if(page->base == NULL) {
+		page->base = map_near(addr);
+		page->used = 0;
+	}
+
+	if(page->base == NULL) {
+		return NULL;
+	}
+
+	uint8_t *slot = page->base + page->used;
+	page->used += TRAMP_SLOT_SIZE;
+
+	return slot;
+}
+/*****************************************************************************/
+static size_t relocate_rel8(
+	const uint8_t *src,
+	const struct x86_insn *in,
+	uint64_t from,
+	uint8_t *dst,
+	uint64_t to,
+	uint64_t *target
+) {
+	size_t len;
+
+	/* there is no prefix worth keeping on a short branch */
+	if(in->len != 2) {
+		return 0;
+	}
+
+	*target = from + 2 + (int8_t)src[1];
+
+	if((in->opcode & 0xF0) == 0x70) {
+		dst[0] = 0x0F;
+		dst[1] = 0x80 | (in->opcode & 0x0F);
+		len = 6;
+	} else if(in->opcode == 0xEB) {
+		dst[0] = 0xE9;
+		len = 5;
+	} else {
+		/* loop and jrcxz have no long form */
+		return 0;
+	}
+
+	if(!in_reach(to + len, *target)) {
+		return 0;
+	}
+
+	put_u32(dst + len - 4, *target - (to + len));
+
+	return len;
+}
+/*****************************************************************************/
+static size_t relocate(
+	const uint8_t *src,
+	const struct x86_insn *in,
+	uint64_t from,
+	uint8_t *dst,
+	uint64_t to,
+	uint64_t *target
+) {
+	int32_t disp;
+
+	*target = 0;
+
+	if(in->rel_size == 1) {
+		return relocate_rel8(src, in, from, dst, to, target);
+	}
+
+	memcpy(dst, src, in->len);
+
+	if(in->rel_size == 4) {
+		memcpy(&disp, src + in->rel_off, sizeof(disp));
+		*target = from + in->len + disp;
+
+		if(!in_reach(to + in->len, *target)) {
+			return 0;
+		}
+
+		put_u32(dst + in->rel_off, *target - (to + in->len));
+	} else if(in->rip_disp != 0) {
+		memcpy(&disp, src + in->rip_disp, sizeof(disp));
+
+		uint64_t ref = from + in->len + disp;
+
+		if(!in_reach(to + in->len, ref)) {
+			return 0;
+		}
+
+		put_u32(dst + in->rip_disp, ref - (to + in->len));
+	}
+
+	return in->len;
+}
+/*****************************************************************************/
+static int build_tramp(
+	struct trace_hook *hook, const uint8_t *code, size_t avail,
+	const char **why
+) {
+	uint8_t buf[TRAMP_SLOT_SIZE];
+	uint64_t targets[ENTRY_JMP_LEN];
+	size_t ntargets = 0;
+	size_t len = 0;
+	size_t out = RESUME_OFF;
+	uint64_t slot = (uint64_t)hook->tramp;
+
+	buf[0] = 0x49;
+	buf[1] = 0xBB;
+	put_u64(buf + 2, (uint64_t)hook);
+	emit_abs_jmp(buf + LOAD_HOOK_LEN, (uint64_t)__hook_entry);
+
+	while(len < ENTRY_JMP_LEN) {
+		struct x86_insn in;
+
+		if(x86_insn_decode(code + len, avail - len, &in) == 0) {
+			*why = "unknown instruction in the prologue";
+			return -1;
+		} else if((in.map == 0) && (in.opcode == 0xCC)) {
+			*why = "int3 in the prologue, is there a breakpoint?";
+			return -1;
+		}
+
+		size_t n = relocate(
+			code + len,
+			&in,
+			hook->addr + len,
+			buf + out,
+			slot + out,
+			&targets[ntargets]
+		);
+
+		if(n == 0) {
+			*why = "prologue can't be relocated";
+			return -1;
+		}
+
+		ntargets += (targets[ntargets] != 0);
+		len += in.len;
+		out += n;
+
+		if((in.flow == X86_FLOW_END) && (len < ENTRY_JMP_LEN)) {
+			*why = "function is too short to hook";
+			return -1;
+		}
+	}
+
+	/* a branch back into the bytes the jmp replaced can't be followed,
+	 * those from elsewhere in the function can't be seen at all */
+	for(size_t i = 0; i < ntargets; i++) {
+		if((targets[i] > hook->addr) && (targets[i] < hook->addr + len)) {
+			*why = "prologue branches into itself";
+			return -1;
+		}
+	}
+
+	out += emit_abs_jmp(buf + out, hook->addr + len);
+
+	if(write_text(slot, buf, out) != 0) {
+		*why = "unable to write the trampoline";
+		return -1;
+	}
+
+	memcpy(hook->orig, code, len);
+	hook->len = len;
+	hook->resume = hook->tramp + RESUME_OFF;
+
+	return 0;
+}
+/*****************************************************************************/
+static int arm(struct trace_hook *hook, const char **why)
+{
+	uint8_t jmp[ENTRY_JMP_LEN];
+
+	jmp[0] = 0xE9;
+	put_u32(jmp + 1, (uint64_t)hook->tramp - (hook->addr + ENTRY_JMP_LEN));
+
+	hook->armed = true;
+
+	if(write_text(hook->addr, jmp, ENTRY_JMP_LEN) != 0) {
+		hook->armed = false;
+		*why = "unable to patch the function";
+		return -1;
+	}
+
+	return 0;
+}
+/*****************************************************************************/
+static void disarm(struct trace_hook *hook)
+{
+	if(!hook->armed) {
+		return;
+	}
+
+	/* only the jmp was written, the rest is as it always was */
+	write_text(hook->addr, hook->orig, ENTRY_JMP_LEN);
+	hook->armed = false;
+}
+/*****************************************************************************/
+static struct trace_hook *free_hook(void)
+{
+	for(size_t i = 0; i < TRACE_HOOK_MAX; i++) {
+		if(!hooks[i].used) {
+			return hooks + i;
+		}
+	}
+
+	return NULL;
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+void trace_hook_dispatch(struct trace_hook *hook, struct trace_hook_frame *f)
+{
+	f->r11 = (uint64_t)hook->resume;
+
+	/* the handler itself, or a signal handler that interrupted it, ran
+	 * into a hook */
+	if(!hook->armed || in_handler || (lock_depth != 0)) {
+		return;
+	} else if(handler_fn == NULL) {
+		return;
+	}
+
+	/* hooks run into by the handler are passed through either way */
+	in_handler = true;
+
+	if(!concurrent) {
+		trace_hook_lock();
+	}
+
+	/* it may have been removed while we waited */
+	if(hook->armed && handler_fn(handler_arg, hook, f)) {
+		f->r11 = (uint64_t)__hook_return;
+	}
+
+	if(!concurrent) {
+		trace_hook_unlock();
+	}
+
+	in_handler = false;
+}
+/*****************************************************************************/
+void trace_hook_set_handler(trace_hook_handler fn, void *arg)
+{
+	handler_arg = arg;
+	handler_fn = fn;
+}
+/*****************************************************************************/
+void trace_hook_set_concurrent(bool on)
+{
+	concurrent = on;
+}
+/*****************************************************************************/
+int trace_hook_insert(uint64_t addr, const char **why)
+{
+	uint8_t code[TRACE_HOOK_ORIG_MAX];
+	struct trace_hook *hook = trace_hook_find(addr);
+
+	if((hook != NULL) && hook->armed) {
+		return 0;
+	} else if(hook != NULL) {
+		/* the trampoline from last time is still good */
+		return arm(hook, why);
+	}
+
+	hook = free_hook();
+
+	if(hook == NULL) {
+		*why = "too many hooks";
+		return -1;
+	}
+
+	/* before any thread can run into __hook_entry */
+	if(!xsave_probed) {
+		probe_xsave();
+	}
+
+	ssize_t avail = tracee_mem_read_safe(NULL, code, addr, sizeof(code));
+
+	if(avail < ENTRY_JMP_LEN) {
+		*why = "unable to read the function";
+		return -1;
+	}
+
+	hook->addr = addr;
+	hook->armed = false;
+	hook->tramp = alloc_slot(addr);
+
+	if(hook->tramp == NULL) {
+		*why = "no room for a trampoline near the function";
+		return -1;
+	}
+
+	/* a slot that was given up on is simply never used, it is only a
+	 * few bytes */
+	if(build_tramp(hook, code, avail, why) != 0) {
+		return -1;
+	}
+
+	hook->used = true;
+
+	return arm(hook, why);
+}
+/*****************************************************************************/
+int trace_hook_remove(uint64_t addr)
+{
+	struct trace_hook *hook = trace_hook_find(addr);
+
+	if((hook == NULL) || !hook->armed) {
+		return -1;
+	}
+
+	disarm(hook);
+
+	return 0;
+}
+/*****************************************************************************/
+void trace_hook_clear(void)
+{
+	for(size_t i = 0; i < TRACE_HOOK_MAX; i++) {
+		if(hooks[i].used) {
+			disarm(hooks + i);
+		}
+	}
+}
+/*****************************************************************************/
+void trace_hook_save(void)
+{
+	n_saved = 0;
+
+	for(size_t i = 0; i < TRACE_HOOK_MAX; i++) {
+		if(hooks[i].used && hooks[i].armed) {
+			saved[n_saved++] = hooks[i].addr;
+		}
+	}
+}
+/*****************************************************************************/
+void trace_hook_restore(void)
+{
+	const char *why = NULL;
+
+	trace_hook_clear();
+
+	/* each goes back through the trampoline it had */
+	for(size_t i = 0; i < n_saved; i++) {
+		trace_hook_insert(saved[i], &why);
+	}
+
+	n_saved = 0;
+}
+/*****************************************************************************/
+struct trace_hook *trace_hook_find(uint64_t addr)
+{
+	for(size_t i = 0; i < TRACE_HOOK_MAX; i++) {
+		struct trace_hook *hook = hooks + i;
+
+		if(hook->used && (hook->addr == addr)) {
+			return hook;
+		}
+	}
+
+	return NULL;
+}
+/*****************************************************************************/
+void trace_hook_lock(void)
+{
+	if(lock_depth++ == 0) {
+		safe_mutex_lock(&lock_word);
+	}
+}
+/*****************************************************************************/
+bool trace_hook_trylock(void)
+{
+	if(lock_depth != 0) {
+		lock_depth += 1;
+		return true;
+	}
+
+	/* whoever has it may be stopped waiting on the monitor, which is
+	 * what calls this, so only wait for a moment */
+	for(int i = 0; i < SAFE_SPIN_LIMIT; i++) {
+		if(safe_mutex_trylock(&lock_word)) {
+			lock_depth = 1;
+			return true;
+		}
+		__builtin_ia32_pause();
+	}
+
+	return false;
+}
+/*****************************************************************************/
+void trace_hook_unlock(void)
+{
+	if(--lock_depth == 0) {
+		safe_mutex_unlock(&lock_word);
+	}
+}
+/*****************************************************************************/
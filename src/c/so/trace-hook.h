@@ -0,0 +1,110 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef TRACE_HOOK_H
+#define TRACE_HOOK_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+#define TRACE_HOOK_MAX 256
+/* bytes of the original code kept aside, the most a prologue can need */
+#define TRACE_HOOK_ORIG_MAX 32
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+/* A jmp written over the entry of a function in the address space we share
+ * with the target. It leads to a trampoline which calls the handler on the
+ * calling thread, without any ptrace stop, and then runs a relocated copy of
+ * the instructions the jmp replaced before going on with the rest of the
+ * function. Trampolines are never freed, a thread may still be in one long
+ * after its hook was removed. */
+struct trace_hook {
+	uint64_t addr;
+	/* generated code, the relocated prologue starts at resume */
+	uint8_t *tramp;
+	uint8_t *resume;
+	/* bytes the jmp went over, whole instructions */
+	uint8_t orig[TRACE_HOOK_ORIG_MAX];
+	uint8_t len;
+	bool used;
+	/* cleared on removal, calls that already made it into the
+	 * trampoline go straight on to the original code */
+	volatile bool armed;
+};
+
+/* The registers of a call into a hooked function, as __hook_entry pushed
+ * them. The return address is at the top of the caller's stack, so rsp
+ * on entry was &ret. */
+struct trace_hook_frame {
+	uint64_t r15;
+	uint64_t r14;
+	uint64_t r13;
+	uint64_t r12;
+	uint64_t r11;
+	uint64_t r10;
+	uint64_t r9;
+	uint64_t r8;
+	uint64_t rdi;
+	uint64_t rsi;
+	uint64_t rbp;
+	uint64_t rbx;
+	uint64_t rdx;
+	uint64_t rcx;
+	uint64_t rax;
+	uint64_t rflags;
+	uint64_t ret;
+};
+
+/* Runs for each call into an armed hook, on the calling thread and with
+ * the hook lock held unless trace_hook_set_concurrent(). Returning true
+ * skips the function altogether and hands frame->rax back to its caller. */
+typedef bool (*trace_hook_handler)(
+	void *arg, const struct trace_hook *hook, struct trace_hook_frame *frame
+);
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+void trace_hook_set_handler(trace_hook_handler fn, void *arg);
+/* With on the handler is called without the hook lock, so calls on several
+ * threads run at once and the handler guards whatever they share itself,
+ * trace_hook_lock() from within it still takes the lock. Hooks run into
+ * from within the handler are still passed through. */
+void trace_hook_set_concurrent(bool on);
+/* Hooks the function at addr. On failure returns non-zero and points *why
+ * at a static explanation. */
+int trace_hook_insert(uint64_t addr, const char **why);
+int trace_hook_remove(uint64_t addr);
+/* removes every hook, before a script reload or once the trace is over */
+void trace_hook_clear(void);
+/* as trace_break_save() and trace_break_restore(), for hooks */
+void trace_hook_save(void);
+void trace_hook_restore(void);
+struct trace_hook *trace_hook_find(uint64_t addr);
+/* The lock handlers run under, whoever else runs the same Lua state must
+ * hold it as well. Hooks a thread runs into while holding it are passed
+ * straight through, so code run under the lock may call hooked functions. */
+void trace_hook_lock(void);
+bool trace_hook_trylock(void);
+void trace_hook_unlock(void);
+/*****************************************************************************/
+#endif /* TRACE_HOOK_H */
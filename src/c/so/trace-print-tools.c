@@ -21,22 +21,158 @@
 ******************************************************************************/
 #include "trace-print-tools.h"
 
+#include <utl/math-utl.h>
+
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
-#include <ctype.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 /******************************************************************************
 *                                   DEFINES                                   *
 ******************************************************************************/
 #define CHAR_ARR_STRLEN(s) (sizeof(s) - 1)
+/* the AVX2 loop is built whatever -march says, so the tests can check it
+ * against the others on any CPU that has it */
+#define AVX2_FN __attribute__((target("avx2")))
+/******************************************************************************
+*                                    DATA                                     *
+******************************************************************************/
+/* see trace_print_force_vec() */
+static enum trace_print_vec forced_vec = TRACE_PRINT_VEC_BUILT;
 /******************************************************************************
 *                              STATIC FUNCTIONS                               *
 ******************************************************************************/
+static bool is_printable(uint8_t byte)
+{
+	return (byte >= ' ') && (byte <= '~');
+}
+/*****************************************************************************/
+static bool is_plain(uint8_t byte)
+{
+	/* bytes which are copied through as they are */
+	return (is_printable(byte) && (byte != '"') && (byte != '\\')) ||
+		(byte == '\t');
+}
+/*****************************************************************************/
+#if defined(__x86_64__)
+static AVX2_FN size_t plain_run_avx2(const uint8_t *p, size_t len)
+{
+	const __m256i lo = _mm256_set1_epi8(' ' - 1);
+	const __m256i hi = _mm256_set1_epi8('~' + 1);
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i bslash = _mm256_set1_epi8('\\');
+	const __m256i tab = _mm256_set1_epi8('\t');
+
+	size_t i = 0;
+
+	for(; (i + 32) <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+
+		/* signed compares, bytes >= 0x80 are negative and fail the
+		 * lower bound */
+		__m256i ok = _mm256_and_si256(
+			_mm256_cmpgt_epi8(v, lo),
+			_mm256_cmpgt_epi8(hi, v)
+		);
+		__m256i esc = _mm256_or_si256(
+			_mm256_cmpeq_epi8(v, quote),
+			_mm256_cmpeq_epi8(v, bslash)
+		);
+
+		ok = _mm256_andnot_si256(esc, ok);
+		ok = _mm256_or_si256(ok, _mm256_cmpeq_epi8(v, tab));
+
+		uint32_t mask = _mm256_movemask_epi8(ok);
+
+		if(mask != UINT32_MAX) {
+			return i + __builtin_ctz(~mask);
+		}
+	}
+
+	return i;
+}
+#endif
+/*****************************************************************************/
+#if defined(__AVX2__)
+static size_t plain_run_vec(const uint8_t *p, size_t len)
+{
+	return plain_run_avx2(p, len);
+}
+#elif defined(__SSE2__)
+static size_t plain_run_vec(const uint8_t *p, size_t len)
+{
+	const __m128i lo = _mm_set1_epi8(' ' - 1);
+	const __m128i hi = _mm_set1_epi8('~' + 1);
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i bslash = _mm_set1_epi8('\\');
+	const __m128i tab = _mm_set1_epi8('\t');
+
+	size_t i = 0;
+
+	for(; (i + 16) <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+
+		/* signed compares, bytes >= 0x80 are negative and fail the
+		 * lower bound */
+		__m128i ok = _mm_and_si128(
+			_mm_cmpgt_epi8(v, lo),
+			_mm_cmplt_epi8(v, hi)
+		);
+		__m128i esc = _mm_or_si128(
+			_mm_cmpeq_epi8(v, quote),
+			_mm_cmpeq_epi8(v, bslash)
+		);
+
+		ok = _mm_andnot_si128(esc, ok);
+		ok = _mm_or_si128(ok, _mm_cmpeq_epi8(v, tab));
+
+		uint32_t mask = _mm_movemask_epi8(ok);
+
+		if(mask != 0xFFFF) {
+			return i + __builtin_ctz(~mask);
+		}
+	}
+
+	return i;
+}
+#else
+static size_t plain_run_vec(const uint8_t *p, size_t len)
+{
+	return 0;
+}
+#endif
+/*****************************************************************************/
+static size_t plain_run(const uint8_t *p, size_t len)
+{
+	size_t i = 0;
+
+	if(forced_vec == TRACE_PRINT_VEC_BUILT) {
+		i = plain_run_vec(p, len);
+#if defined(__x86_64__)
+	} else if(forced_vec == TRACE_PRINT_VEC_AVX2) {
+		i = plain_run_avx2(p, len);
+#endif
+	}
+
+	/* the vector loop stops short of the tail, or at the first byte
+	 * which needs escaping */
+	while((i < len) && is_plain(p[i])) {
+		i += 1;
+	}
+
+	return i;
+}
+/*****************************************************************************/
 static char octal_char(int val, int n)
 {
 	return ((val >> (3 * n)) & 0x7) + '0';
 }
 /*****************************************************************************/
-static int repr_byte(char *str, char byte, ssize_t *space_size)
+static int repr_byte(char *str, uint8_t byte, ssize_t *space_size)
 {
 	if((byte == '"') || (byte == '\\')) {
 		if(*space_size < 2) {
@@ -74,7 +210,7 @@ static int repr_byte(char *str, char byte, ssize_t *space_size)
 			*space_size -= 2;
 			return 2;
 		}
-	} else if(isprint(byte) || (byte == '\t')) {
+	} else if(is_printable(byte) || (byte == '\t')) {
 		if(*space_size == 0) {
 			return 0;
 		} else {
@@ -104,41 +240,88 @@ char *sprint_buffer(
 	ssize_t buffer_size,
 	ssize_t space_size
 ) {
-	int len = 0;
+	if(sprint_buffer_len(buffer, str, buffer_size, space_size) < 0) {
+		return NULL;
+	}
+
+	return str;
+}
+/*****************************************************************************/
+ssize_t sprint_buffer_len(
+	const char *buffer,
+	char *str,
+	ssize_t buffer_size,
+	ssize_t space_size
+) {
+	ssize_t len = 0;
 	char border = '"';
 	const char continuation[] = "\"...";
+	const char null_repr[] = "<null>";
 
 	if(buffer_size < 0) {
-		return NULL;
+		return -1;
 	}
 	if(buffer == NULL) {
-		strncpy(str, "<null>", space_size);
-		return str;
+		strncpy(str, null_repr, space_size);
+		return min_u64(CHAR_ARR_STRLEN(null_repr), space_size);
 	}
 
 	space_size -= sizeof(border) + CHAR_ARR_STRLEN(continuation) + 1;
 
 	if(space_size < 0) {
-		return NULL;
+		return -1;
 	}
 
 	str[len] = border;
 	len += 1;
 
-	for(size_t i = 0; i < buffer_size; i++) {
+	for(size_t i = 0; i < buffer_size;) {
+		/* no point classifying bytes which could never fit */
+		size_t limit = min_u64(buffer_size - i, space_size + 1);
+		size_t run = plain_run((const uint8_t*)buffer + i, limit);
+		size_t n = min_u64(run, space_size);
+
+		memcpy(str + len, buffer + i, n);
+		len += n;
+		space_size -= n;
+		i += n;
+
+		if(n < run) {
+			memcpy(str + len, continuation, sizeof(continuation));
+			return len + CHAR_ARR_STRLEN(continuation);
+		} else if(i == buffer_size) {
+			break;
+		}
+
 		int s = 0;
-		char c = buffer[i];
 
-		if((s = repr_byte(str + len, c, &space_size)) == 0) {
+		if((s = repr_byte(str + len, buffer[i], &space_size)) == 0) {
 			memcpy(str + len, continuation, sizeof(continuation));
-			return str;
+			return len + CHAR_ARR_STRLEN(continuation);
 		}
 		len += s;
+		i += 1;
 	}
 
 	str[len] = border;
 	str[len + 1] = '\0';
 
-	return str;
+	return len + 1;
+}
+/*****************************************************************************/
+int trace_print_force_vec(enum trace_print_vec vec)
+{
+#if defined(__x86_64__)
+	bool avx2 = __builtin_cpu_supports("avx2");
+#else
+	bool avx2 = false;
+#endif
+
+	if((vec == TRACE_PRINT_VEC_AVX2) && !avx2) {
+		return -1;
+	}
+
+	forced_vec = vec;
+	return 0;
 }
 /*****************************************************************************/
@@ -23,6 +23,16 @@
 ******************************************************************************/
 #include <stdlib.h>
 /******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+enum trace_print_vec {
+	/* whichever vector loop -march allowed, the default */
+	TRACE_PRINT_VEC_BUILT,
+	/* a byte at a time */
+	TRACE_PRINT_VEC_NONE,
+	TRACE_PRINT_VEC_AVX2
+};
+/******************************************************************************
 *                            FUNCTION DECLARATIONS                            *
 ******************************************************************************/
 char *sprint_buffer(
@@ -31,5 +41,17 @@ char *sprint_buffer(
 	ssize_t buffer_size,
 	ssize_t space_size
 );
+/* As sprint_buffer(), but returns the length of the representation written
+ * to space, or -1 where sprint_buffer() returns NULL. */
+ssize_t sprint_buffer_len(
+	const char *buffer,
+	char *space,
+	ssize_t buffer_size,
+	ssize_t space_size
+);
+/* Has sprint_buffer() look for bytes to copy through with vec rather than
+ * what the build picked, for the tests to compare them against each other.
+ * Returns -1, changing nothing, if the CPU can't run it. */
+int trace_print_force_vec(enum trace_print_vec vec);
 /*****************************************************************************/
 #endif /* _TRACE_PRINT_TOOLS_H */
@@ -0,0 +1,139 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "trace-sample.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+static uint32_t next_random(struct trace_sampler *s);
+static void draw_countdown(struct trace_sampler *s);
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static uint32_t next_random(struct trace_sampler *s)
+{
+	/* xorshift32, plenty for spreading samples out */
+	uint32_t x = s->rng;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	s->rng = x;
+
+	return x;
+}
+/*****************************************************************************/
+static void draw_countdown(struct trace_sampler *s)
+{
+	/* a fixed stride would alias with loops that make a multiple of
+	 * rate syscalls per iteration and only ever show the same one, so
+	 * draw the gap uniformly from [1, 2 * rate - 1] which keeps the mean
+	 * at rate */
+	if(s->rate <= 1) {
+		s->countdown = 1;
+	} else {
+		uint32_t span = 2 * s->rate - 1;
+		s->countdown = 1 + next_random(s) % span;
+	}
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+void trace_sampler_init(struct trace_sampler *s, uint64_t seed)
+{
+	s->rate = 1;
+	s->countdown = 1;
+	s->rng = (uint32_t)(seed ^ (seed >> 32)) | 1;
+	s->on = 0;
+	s->period = 0;
+	s->phase_start = 0;
+}
+/*****************************************************************************/
+void trace_sampler_set_rate(struct trace_sampler *s, uint32_t rate)
+{
+	s->rate = (rate == 0) ? 1 : rate;
+	draw_countdown(s);
+}
+/*****************************************************************************/
+int trace_sampler_set_duty(
+	struct trace_sampler *s, uint64_t on, uint64_t period, uint64_t now
+) {
+	if((period != 0) && ((on == 0) || (on > period))) {
+		return -1;
+	}
+
+	/* a window as long as the period is the same as no duty cycle */
+	if(on == period) {
+		period = 0;
+	}
+
+	s->on = on;
+	s->period = period;
+	s->phase_start = now;
+
+	return 0;
+}
+/*****************************************************************************/
+bool trace_sampler_pick(struct trace_sampler *s)
+{
+	if(--s->countdown != 0) {
+		return false;
+	}
+
+	draw_countdown(s);
+
+	return true;
+}
+/*****************************************************************************/
+bool trace_sampler_duty_on(const struct trace_sampler *s)
+{
+	return s->period != 0;
+}
+/*****************************************************************************/
+bool trace_sampler_in_window(const struct trace_sampler *s, uint64_t now)
+{
+	if((s->period == 0) || (now < s->phase_start)) {
+		return true;
+	}
+
+	return (now - s->phase_start) < s->on;
+}
+/*****************************************************************************/
+void trace_sampler_tick(struct trace_sampler *s, uint64_t now)
+{
+	s->phase_start = now;
+}
+/*****************************************************************************/
+double trace_sampler_weight(const struct trace_sampler *s)
+{
+	double weight = s->rate;
+
+	if(s->period != 0) {
+		weight *= (double)s->period / (double)s->on;
+	}
+
+	return weight;
+}
+/*****************************************************************************/
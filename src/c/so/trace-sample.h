@@ -0,0 +1,57 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef TRACE_SAMPLE_H
+#define TRACE_SAMPLE_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+/* Decides which syscalls the trace handler gets to see. Two independent
+ * knobs: a rate, where on average one in rate syscalls is handed over, and
+ * a duty cycle, where the target is only traced for the first on ns of
+ * every period ns and runs untraced for the rest. */
+struct trace_sampler {
+	uint32_t rate;
+	uint32_t countdown;
+	uint32_t rng;
+
+	/* period is 0 while duty cycling is off */
+	uint64_t on;
+	uint64_t period;
+	uint64_t phase_start;
+};
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+void trace_sampler_init(struct trace_sampler *s, uint64_t seed);
+void trace_sampler_set_rate(struct trace_sampler *s, uint32_t rate);
+int trace_sampler_set_duty(
+	struct trace_sampler *s, uint64_t on, uint64_t period, uint64_t now
+);
+bool trace_sampler_pick(struct trace_sampler *s);
+bool trace_sampler_duty_on(const struct trace_sampler *s);
+bool trace_sampler_in_window(const struct trace_sampler *s, uint64_t now);
+void trace_sampler_tick(struct trace_sampler *s, uint64_t now);
+double trace_sampler_weight(const struct trace_sampler *s);
+/*****************************************************************************/
+#endif /* TRACE_SAMPLE_H */
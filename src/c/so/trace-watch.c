@@ -0,0 +1,276 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "trace-watch.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/ptrace.h>
+#include <sys/user.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+#define DR_OFFSET(n) (offsetof(struct user, u_debugreg) + (n) * sizeof(long))
+
+#define DR_STATUS 6
+#define DR_CONTROL 7
+/******************************************************************************
+*                                    DATA                                     *
+******************************************************************************/
+static struct trace_watch watches[TRACE_WATCH_MAX];
+/* what trace_watch_save() kept */
+static struct trace_watch saved[TRACE_WATCH_MAX];
+static uint32_t generation;
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static int poke_dr(pid_t tid, int n, uint64_t val)
+{
+	return ptrace(PTRACE_POKEUSER, tid, DR_OFFSET(n), val) == -1;
+}
+/*****************************************************************************/
+static void bump(void)
+{
+	generation += 1;
+
+	if(generation == 0) {
+		generation = 1;
+	}
+}
+/*****************************************************************************/
+static uint64_t len_bits(uint8_t len)
+{
+	switch(len) {
+	case 2:
+		return 1;
+	case 8:
+		return 2;
+	case 4:
+		return 3;
+	default:
+		return 0;
+	}
+}
+/*****************************************************************************/
+static uint64_t control_bits(int n, const struct trace_watch *w)
+{
+	uint64_t enable = 1ULL << (2 * n);
+	uint64_t rw = (uint64_t)w->kind << (16 + 4 * n);
+	uint64_t len = len_bits(w->len) << (18 + 4 * n);
+
+	return enable | rw | len;
+}
+/*****************************************************************************/
+static struct trace_watch *find(pid_t space, uint64_t addr)
+{
+	for(size_t i = 0; i < TRACE_WATCH_MAX; i++) {
+		struct trace_watch *w = watches + i;
+
+		if(w->used && (w->space == space) && (w->addr == addr)) {
+			return w;
+		}
+	}
+
+	return NULL;
+}
+/*****************************************************************************/
+static struct trace_watch *free_slot(void)
+{
+	for(size_t i = 0; i < TRACE_WATCH_MAX; i++) {
+		if(!watches[i].used) {
+			return watches + i;
+		}
+	}
+
+	return NULL;
+}
+/*****************************************************************************/
+static const char *check_args(
+	uint64_t addr, size_t len, enum trace_watch_kind kind
+) {
+	if((len != 1) && (len != 2) && (len != 4) && (len != 8)) {
+		return "length must be 1, 2, 4 or 8";
+	} else if((addr & (len - 1)) != 0) {
+		return "address must be aligned to the length";
+	} else if((kind == TRACE_WATCH_EXEC) && (len != 1)) {
+		return "an execute watch has a length of 1";
+	}
+
+	return NULL;
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+int trace_watch_insert(
+	pid_t space,
+	uint64_t addr,
+	size_t len,
+	enum trace_watch_kind kind,
+	const char **why
+) {
+	*why = check_args(addr, len, kind);
+
+	if(*why != NULL) {
+		return -1;
+	}
+
+	struct trace_watch *w = find(space, addr);
+
+	if(w == NULL) {
+		w = free_slot();
+	}
+
+	if(w == NULL) {
+		*why = "all four debug registers are in use";
+		return -1;
+	}
+
+	w->addr = addr;
+	w->space = space;
+	w->len = len;
+	w->kind = kind;
+	w->used = true;
+
+	bump();
+
+	return 0;
+}
+/*****************************************************************************/
+int trace_watch_remove(pid_t space, uint64_t addr)
+{
+	struct trace_watch *w = find(space, addr);
+
+	if(w == NULL) {
+		return -1;
+	}
+
+	memset(w, 0, sizeof(*w));
+	bump();
+
+	return 0;
+}
+/*****************************************************************************/
+void trace_watch_clear(void)
+{
+	bool any = false;
+
+	for(size_t i = 0; i < TRACE_WATCH_MAX; i++) {
+		any |= watches[i].used;
+	}
+
+	if(any) {
+		memset(watches, 0, sizeof(watches));
+		bump();
+	}
+}
+/*****************************************************************************/
+void trace_watch_save(void)
+{
+	memcpy(saved, watches, sizeof(saved));
+}
+/*****************************************************************************/
+void trace_watch_restore(void)
+{
+	/* the debug registers are only programmed at each thread's next
+	 * stop, so putting the table back is all it takes */
+	memcpy(watches, saved, sizeof(watches));
+	memset(saved, 0, sizeof(saved));
+	bump();
+}
+/*****************************************************************************/
+void trace_watch_forget(pid_t space)
+{
+	for(size_t i = 0; i < TRACE_WATCH_MAX; i++) {
+		if(watches[i].used && (watches[i].space == space)) {
+			memset(watches + i, 0, sizeof(watches[i]));
+			bump();
+		}
+	}
+}
+/*****************************************************************************/
+uint32_t trace_watch_gen(void)
+{
+	return generation;
+}
+/*****************************************************************************/
+int trace_watch_sync(pid_t tid, pid_t space)
+{
+	uint64_t control = 0;
+
+	/* off first, the kernel checks every address that DR7 enables as
+	 * soon as it is written */
+	if(poke_dr(tid, DR_CONTROL, 0) != 0) {
+		return -1;
+	}
+
+	for(int i = 0; i < TRACE_WATCH_MAX; i++) {
+		const struct trace_watch *w = watches + i;
+
+		if(!w->used || (w->space != space)) {
+			continue;
+		}
+
+		if(poke_dr(tid, i, w->addr) != 0) {
+			return -1;
+		}
+
+		control |= control_bits(i, w);
+	}
+
+	if(control == 0) {
+		return 0;
+	}
+
+	return poke_dr(tid, DR_CONTROL, control);
+}
+/*****************************************************************************/
+void trace_watch_reset(pid_t tid)
+{
+	poke_dr(tid, DR_CONTROL, 0);
+}
+/*****************************************************************************/
+const struct trace_watch *trace_watch_hit(pid_t tid, pid_t space)
+{
+	errno = 0;
+
+	long status = ptrace(PTRACE_PEEKUSER, tid, DR_OFFSET(DR_STATUS), 0);
+
+	if(errno != 0) {
+		return NULL;
+	}
+
+	/* the kernel only ever adds to the bits it reports */
+	poke_dr(tid, DR_STATUS, 0);
+
+	for(int i = 0; i < TRACE_WATCH_MAX; i++) {
+		const struct trace_watch *w = watches + i;
+
+		if((status & (1L << i)) && w->used && (w->space == space)) {
+			return w;
+		}
+	}
+
+	return NULL;
+}
+/*****************************************************************************/
@@ -0,0 +1,88 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef TRACE_WATCH_H
+#define TRACE_WATCH_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/types.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+/* one for each of DR0 to DR3 */
+#define TRACE_WATCH_MAX 4
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+/* the DR7 R/W encodings */
+enum trace_watch_kind {
+	TRACE_WATCH_EXEC = 0,
+	TRACE_WATCH_WRITE = 1,
+	TRACE_WATCH_RW = 3
+};
+
+/* A hardware watchpoint. The debug registers belong to each thread, the
+ * monitor programs them into every thread of space at its next stop after a
+ * change, see trace_watch_gen(). */
+struct trace_watch {
+	uint64_t addr;
+	/* address space it was set in, see tracee_mem_space() */
+	pid_t space;
+	uint8_t len;
+	enum trace_watch_kind kind;
+	bool used;
+};
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+/* Watches len (1, 2, 4 or 8, and addr aligned to it; 1 for EXEC) bytes at
+ * addr. On failure returns non-zero and points *why at a static
+ * explanation. */
+int trace_watch_insert(
+	pid_t space,
+	uint64_t addr,
+	size_t len,
+	enum trace_watch_kind kind,
+	const char **why
+);
+int trace_watch_remove(pid_t space, uint64_t addr);
+/* removes every watch, before a detach or a script reload */
+void trace_watch_clear(void);
+/* as trace_break_save() and trace_break_restore(), for watches */
+void trace_watch_save(void);
+void trace_watch_restore(void);
+/* drops the watches of a space replaced by an exec */
+void trace_watch_forget(pid_t space);
+/* Changes with every insert or removal, a thread last programmed at another
+ * generation is out of date. It starts at 0, which is what a new thread's
+ * record holds, and skips 0 when it wraps. */
+uint32_t trace_watch_gen(void);
+/* Programs the debug registers of tid, which runs in space and must be in a
+ * ptrace stop, with the watches of space. Returns 0 on success. */
+int trace_watch_sync(pid_t tid, pid_t space);
+/* switches every watch of a stopped thread off, before letting go of it */
+void trace_watch_reset(pid_t tid);
+/* After a TRAP_HWBKPT stop of tid, which runs in space, reads and clears its
+ * DR6 and returns the watch that went off, NULL if none of ours did */
+const struct trace_watch *trace_watch_hit(pid_t tid, pid_t space);
+/*****************************************************************************/
+#endif /* TRACE_WATCH_H */
@@ -28,11 +28,18 @@
 #include "misc-macros.h"
 #include "debug-modes.h"
 #include "tracee-state-table.h"
+#include "trace-clock.h"
+#include "trace-sample.h"
+#include "trace-control.h"
+#include "trace-break.h"
+#include "trace-watch.h"
+#include "tracee-mem.h"
 #include "application.h"
 #include "get-options.h"
 #include "secret-heap.h"
 #include <gio/ghost-stdio.h>
 #include <safe_syscalls.h>
+#include <control.h>
 
 #include <stdint.h>
 #include <stdio.h>
@@ -48,6 +55,33 @@
 #include <stdbool.h>
 #include <sys/prctl.h>
 #include <sys/syscall.h>
+#include <time.h>
+#include <dirent.h>
+#include <linux/kcmp.h>
+#include <ucontext.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+#define DUTY_SIGNAL (SIGRTMIN)
+#define CONTROL_SIGNAL (SIGRTMIN + 1)
+
+/* the trap flag, the CPU raises a debug trap after the next instruction */
+#define EFLAGS_TF (1 << 8)
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+enum trace_mode {
+	TRACE_MODE_TRACING,
+	/* still attached, but every thread runs with PTRACE_CONT */
+	TRACE_MODE_PAUSED,
+	/* waiting for the interrupt stops that let us detach each thread */
+	TRACE_MODE_DETACHING,
+	TRACE_MODE_DETACHED
+};
 /******************************************************************************
 *                                  CONSTANTS                                  *
 ******************************************************************************/
@@ -55,6 +89,30 @@ static const int SIGNALS_TO_FORWARD[] = {
 	SIGHUP, SIGINT, SIGQUIT, SIGKILL, SIGPIPE, SIGALRM,
 	SIGUSR1, SIGUSR2, SIGTSTP, SIGTTIN, SIGTTOU
 };
+
+/* forks are traced even when they aren't followed, the children have to be
+ * cleaned of our breakpoints before they are let go */
+static const int TRACE_OPTIONS =
+	PTRACE_O_EXITKILL |
+	PTRACE_O_TRACESYSGOOD |
+	PTRACE_O_TRACEEXEC |
+	PTRACE_O_TRACECLONE |
+	PTRACE_O_TRACEFORK |
+	PTRACE_O_TRACEVFORK |
+	PTRACE_O_TRACEVFORKDONE;
+
+static const char *const MODE_NAMES[] = {
+	[TRACE_MODE_TRACING] = "tracing",
+	[TRACE_MODE_PAUSED] = "paused",
+	[TRACE_MODE_DETACHING] = "detaching",
+	[TRACE_MODE_DETACHED] = "detached"
+};
+
+static const bool FREE_RUNNING_ONLY = true;
+static const bool EVERY_THREAD = false;
+/* the longest wait_any() sleeps before it looks for stopped threads again,
+ * in case a SIGCHLD never comes */
+static const struct timespec WAIT_POLL = {.tv_sec = 1, .tv_nsec = 0};
 /******************************************************************************
 *                                    DATA                                     *
 ******************************************************************************/
@@ -64,20 +122,45 @@ static struct thread_jump tj_thread;
 static volatile pid_t parent_pid;
 static volatile pid_t child_pid;
 
-static volatile int wait_flag;
-
 static struct trace_descriptor descriptor;
 static void *state_tab;
+static struct tracee_record spare_record;
 static struct prog_opts cached_opts;
+
+static struct trace_sampler sampler;
+static timer_t duty_timer;
+static bool duty_timer_made;
+/* set by wait_any() when it takes the duty cycle signal */
+static bool duty_tick;
+
+/* signals that end wait_any(), never let in but taken with sigtimedwait(),
+ * so there is no gap between looking for them and waiting in which one
+ * can come and go unnoticed. wait_sigset adds SIGCHLD, which a thread
+ * stopping or exiting raises. */
+static sigset_t wake_sigset;
+static sigset_t wait_sigset;
+static bool wake_sigs_used;
+
+static enum trace_mode mode;
+/* attached with PTRACE_SEIZE, which is the case after a re-attach */
+static bool seized;
+/* trace_watch_gen() as of the last time every thread was interrupted to
+ * pick up the watches */
+static uint32_t watch_gen_sent;
+/* see trace_request_idle() */
+static bool idle_requested;
 /******************************************************************************
 *                            FUNCTION DECLARATIONS                            *
 ******************************************************************************/
 static int monitor_thread(void* arg);
 static NEVER_INLINE int monitor(pid_t target_pid);
 static void setup_signal_handling(void);
+static void setup_async_output(void);
+static void report_async_drops(void);
 static void signal_forwarder_handler(
 	int signo, siginfo_t *info, void *ucontext
 );
+static void trap_handler(int signo, siginfo_t *info, void *ucontext);
 static int only_wait_for_exit(pid_t target_pid);
 static int start_monitor(void);
 static int trace_target(pid_t target_pid);
@@ -89,6 +172,37 @@ static bool is_event_stop(int status);
 static bool is_signal_stop(int status);
 static int extract_ptrace_event(int status);
 static void modify_syscalls(struct tracee_state *state);
+static void track_syscall(struct tracee_state *state);
+static struct tracee_record *lookup_thread(pid_t tid);
+static void forget_thread(struct tracee_state *state);
+static bool is_spawn_event(int pt_event);
+static void release_spawn(pid_t pid);
+static bool track_spawn(struct tracee_state *state);
+static void track_exec(struct tracee_state *state);
+static int add_wake_signal(int signo);
+static int make_duty_timer(void);
+static int arm_duty_timer(uint64_t period);
+static void interrupt_thread(struct tracee_record *rec, void *arg);
+static void interrupt_free_running(void);
+static void interrupt_for_watches(void);
+static void sync_watches(struct tracee_record *rec);
+static void setup_sampling(void);
+static void setup_control(void);
+static pid_t wait_idle(int *status);
+static pid_t wait_any(int *status);
+static int resume_request(struct tracee_state *state);
+static bool is_interrupt_stop(const struct tracee_state *state, int status);
+static bool handle_watch(struct tracee_state *state);
+static bool handle_trap(struct tracee_state *state);
+static void settle_detach(void);
+static void release_thread(struct tracee_state *state, int sig);
+static int seize_thread(pid_t tid, pid_t proc, bool remote);
+static int attach_process(pid_t pid, const char **why);
+static void start_detach(void);
+static void reset_user_ref(struct tracee_record *rec, void *arg);
+static bool is_command(const char *cmd, size_t len, const char *name);
+static void run_command(const char *cmd, char *reply, size_t size);
+static void serve_control(void);
 /******************************************************************************
 *                              STATIC FUNCTIONS                               *
 ******************************************************************************/
@@ -117,12 +231,759 @@ static void modify_syscalls(struct tracee_state *state)
 	ptrace(PTRACE_SETREGS, state->pid, 0, regs);
 }
 /*****************************************************************************/
+static void track_syscall(struct tracee_state *state)
+{
+	struct tracee_record *rec = state->thread;
+
+	/* both stamps are taken as the monitor reaps the stop, so the
+	 * duration also covers the enter callback and the ptrace round trip,
+	 * much like strace -T */
+	if(state->status == SYSCALL_ENTER_STOP) {
+		rec->enter_nr = state->data.regs.orig_rax;
+		rec->enter_stamp = state->timestamp;
+	} else if(rec->enter_stamp != 0) {
+		state->duration = state->timestamp - rec->enter_stamp;
+	}
+}
+/*****************************************************************************/
+static struct tracee_record *lookup_thread(pid_t tid)
+{
+	struct tracee_record *rec = tracee_state_table_get(state_tab, tid);
+
+	if(rec == NULL) {
+		/* out of memory, keep tracing but without any history for
+		 * this thread */
+		memset(&spare_record, 0, sizeof(spare_record));
+		spare_record.tid = tid;
+		spare_record.status = (uint8_t)-1;
+		rec = &spare_record;
+	}
+
+	if(rec->proc == 0) {
+		rec->proc = tid;
+	}
+
+	return rec;
+}
+/*****************************************************************************/
+static void forget_thread(struct tracee_state *state)
+{
+	struct tracee_record *rec = state->thread;
+
+	/* a thread that dies mid step mustn't keep its breakpoint out */
+	if((rec != NULL) && (rec->bp_step != 0)) {
+		trace_break_step_end(
+			trace_break_by_id(rec->bp_step), tracee_mem_space(rec)
+		);
+	}
+
+	tracee_state_table_remove(state_tab, state->pid);
+	state->thread = NULL;
+}
+/*****************************************************************************/
+static bool is_spawn_event(int pt_event)
+{
+	return
+		(pt_event == PTRACE_EVENT_CLONE) ||
+		(pt_event == PTRACE_EVENT_FORK) ||
+		(pt_event == PTRACE_EVENT_VFORK);
+}
+/*****************************************************************************/
+static void release_spawn(pid_t pid)
+{
+	int status;
+
+	/* it can only be detached from a stop, its first one is on the way
+	 * if it hasn't already happened */
+	while(waitpid(pid, &status, __WALL) == -1) {
+		if(errno != EINTR) {
+			return;
+		}
+	}
+
+	if(WIFSTOPPED(status)) {
+		ptrace(PTRACE_DETACH, pid, 0, 0);
+	}
+}
+/*****************************************************************************/
+static bool track_spawn(struct tracee_state *state)
+{
+	unsigned long msg;
+	int pt_event = state->data.pt_event;
+	pid_t space = tracee_mem_space(state->thread);
+
+	if(ptrace(PTRACE_GETEVENTMSG, state->pid, 0, &msg) == -1) {
+		return true;
+	}
+
+	/* breakpoints stay in the space they were set in, a fork child
+	 * gets a copy of the int3s and a vfork child runs on the real ones
+	 * until its exec */
+	if(pt_event == PTRACE_EVENT_FORK) {
+		trace_break_scrub(space, msg);
+	} else if(pt_event == PTRACE_EVENT_VFORK) {
+		trace_break_hold(space);
+	}
+
+	if((pt_event != PTRACE_EVENT_CLONE) && !cached_opts.follow_fork) {
+		release_spawn(msg);
+		return false;
+	}
+
+	pid_t proc = state->thread->proc;
+	bool remote = state->thread->remote;
+
+	/* adding the child may move the parent's record */
+	struct tracee_record *child = lookup_thread(msg);
+	state->thread = lookup_thread(state->pid);
+
+	if(pt_event == PTRACE_EVENT_CLONE) {
+		child->proc = proc;
+	} else {
+		child->proc = child->tid;
+	}
+
+	/* a vfork child borrows its parent's memory until it execs */
+	if(pt_event == PTRACE_EVENT_FORK) {
+		child->remote = true;
+	} else {
+		child->remote = remote;
+	}
+
+	return true;
+}
+/*****************************************************************************/
+static void track_exec(struct tracee_state *state)
+{
+	unsigned long former;
+
+	/* a non-leader thread that execs takes over the leader's tid, the
+	 * rest of the old thread group is already gone */
+	if(ptrace(PTRACE_GETEVENTMSG, state->pid, 0, &former) == 0) {
+		if(former != state->pid) {
+			tracee_state_table_remove(state_tab, former);
+			state->thread = lookup_thread(state->pid);
+		}
+	}
+
+	/* the new program has an address space of its own, we keep the one
+	 * the target was started in */
+	state->thread->remote = true;
+}
+/*****************************************************************************/
+static int add_wake_signal(int signo)
+{
+	struct sigaction act;
+
+	/* the signal is there to get the monitor out of wait_any() while
+	 * the threads run untraced, or not traced at all */
+	if(!wake_sigs_used) {
+		/* the handlers were copied from the target's, which may
+		 * ignore SIGCHLD and so have it never raised */
+		act.sa_handler = SIG_DFL;
+		act.sa_flags = 0;
+		sigemptyset(&act.sa_mask);
+
+		if(sigaction(SIGCHLD, &act, NULL) != 0) {
+			return -1;
+		}
+
+		sigemptyset(&wake_sigset);
+		sigemptyset(&wait_sigset);
+		sigaddset(&wait_sigset, SIGCHLD);
+	}
+
+	/* never let in, nothing else the monitor does has to cope with
+	 * EINTR */
+	sigaddset(&wake_sigset, signo);
+	sigaddset(&wait_sigset, signo);
+	sigprocmask(SIG_BLOCK, &wait_sigset, NULL);
+	wake_sigs_used = true;
+
+	return 0;
+}
+/*****************************************************************************/
+static int make_duty_timer(void)
+{
+	struct sigevent sev;
+
+	if(add_wake_signal(DUTY_SIGNAL) != 0) {
+		return -1;
+	}
+
+	memset(&sev, 0, sizeof(sev));
+	sev.sigev_notify = SIGEV_THREAD_ID;
+	sev.sigev_signo = DUTY_SIGNAL;
+	sev.sigev_notify_thread_id = safe_gettid();
+
+	if(timer_create(CLOCK_MONOTONIC, &sev, &duty_timer) != 0) {
+		return -1;
+	}
+
+	duty_timer_made = true;
+
+	return 0;
+}
+/*****************************************************************************/
+static int arm_duty_timer(uint64_t period)
+{
+	struct itimerspec its;
+
+	if(!duty_timer_made && (period == 0)) {
+		return 0;
+	} else if(!duty_timer_made && (make_duty_timer() != 0)) {
+		return -1;
+	}
+
+	its.it_value.tv_sec = period / TRACE_CLOCK_NS_PER_SEC;
+	its.it_value.tv_nsec = period % TRACE_CLOCK_NS_PER_SEC;
+	its.it_interval = its.it_value;
+
+	return timer_settime(duty_timer, 0, &its, NULL);
+}
+/*****************************************************************************/
+static void interrupt_thread(struct tracee_record *rec, void *arg)
+{
+	bool free_running_only = *(const bool*)arg;
+	int ret;
+
+	if(rec->interrupted) {
+		return;
+	} else if(free_running_only && !rec->free_running) {
+		return;
+	}
+
+	/* the target attaches itself with PTRACE_TRACEME, which leaves us
+	 * without PTRACE_INTERRUPT until a re-attach; a SIGSTOP that we
+	 * swallow at its signal delivery stop does the same job */
+	if(seized) {
+		ret = ptrace(PTRACE_INTERRUPT, rec->tid, 0, 0);
+	} else {
+		ret = syscall(SYS_tgkill, rec->proc, rec->tid, SIGSTOP);
+	}
+
+	if(ret == 0) {
+		rec->interrupted = true;
+	}
+}
+/*****************************************************************************/
+static void interrupt_free_running(void)
+{
+	if(mode != TRACE_MODE_TRACING) {
+		return;
+	}
+
+	tracee_state_table_foreach(
+		state_tab, interrupt_thread, (void*)&FREE_RUNNING_ONLY
+	);
+}
+/*****************************************************************************/
+static void interrupt_for_watches(void)
+{
+	uint32_t gen = trace_watch_gen();
+
+	if((gen == watch_gen_sent) || (mode != TRACE_MODE_TRACING)) {
+		return;
+	}
+
+	/* the debug registers can only be written while a thread is
+	 * stopped, each one picks the watches up as it is resumed */
+	watch_gen_sent = gen;
+
+	tracee_state_table_foreach(
+		state_tab, interrupt_thread, (void*)&EVERY_THREAD
+	);
+}
+/*****************************************************************************/
+static void sync_watches(struct tracee_record *rec)
+{
+	uint32_t gen = trace_watch_gen();
+
+	if(rec->watch_gen == gen) {
+		return;
+	}
+
+	/* a watch the kernel won't take wouldn't go in on a retry either */
+	trace_watch_sync(rec->tid, tracee_mem_space(rec));
+	rec->watch_gen = gen;
+}
+/*****************************************************************************/
+static void setup_sampling(void)
+{
+	uint64_t now = trace_clock_now();
+
+	trace_sampler_init(&sampler, now ^ safe_getpid());
+	trace_set_sample_rate(cached_opts.sample_rate);
+
+	if(cached_opts.duty_period_ms != 0) {
+		trace_set_duty_cycle(
+			cached_opts.duty_on_ms * TRACE_CLOCK_NS_PER_MS,
+			cached_opts.duty_period_ms * TRACE_CLOCK_NS_PER_MS
+		);
+	}
+}
+/*****************************************************************************/
+static void setup_control(void)
+{
+	if(!cached_opts.control && !cached_opts.idle) {
+		return;
+	}
+
+	if(add_wake_signal(CONTROL_SIGNAL) != 0) {
+		goto fail;
+	}
+
+	if(trace_control_start(parent_pid, safe_gettid(), CONTROL_SIGNAL)) {
+		goto fail;
+	}
+
+	return;
+fail:
+	ghost_fprintf(ghost_stderr, "Unable to open the control socket\n");
+}
+/*****************************************************************************/
+static pid_t wait_idle(int *status)
+{
+	/* anything waiting on us goes first, a stopped thread would
+	 * otherwise wait on the idle work too */
+	while(idle_requested && (descriptor.idle != NULL)) {
+		pid_t pid = waitpid(-1, status, __WALL | WNOHANG);
+
+		if(pid != 0) {
+			return pid;
+		}
+
+		idle_requested = false;
+		descriptor.idle(descriptor.arg);
+	}
+
+	return wait_any(status);
+}
+/*****************************************************************************/
+static pid_t wait_any(int *status)
+{
+	const struct timespec no_wait = {0, 0};
+
+	if(!wake_sigs_used) {
+		return waitpid(-1, status, __WALL);
+	}
+
+	/* a wake signal that is already pending goes first */
+	int sig = sigtimedwait(&wake_sigset, NULL, &no_wait);
+
+	/* a thread that stops after the waitpid() leaves SIGCHLD pending
+	 * for the sigtimedwait(), as does a wake signal. The timeout only
+	 * backs that up. */
+	while(sig < 0) {
+		pid_t pid = waitpid(-1, status, __WALL | WNOHANG);
+
+		if(pid != 0) {
+			return pid;
+		}
+
+		sig = sigtimedwait(&wait_sigset, NULL, &WAIT_POLL);
+		sig = (sig == SIGCHLD) ? -1 : sig;
+	}
+
+	duty_tick = duty_tick || (sig == DUTY_SIGNAL);
+
+	/* a duty cycle tick or a control command, as if it had interrupted
+	 * a blocking waitpid() */
+	errno = EINTR;
+	return -1;
+}
+/*****************************************************************************/
+static int resume_request(struct tracee_state *state)
+{
+	struct tracee_record *rec = state->thread;
+	/* rate sampling never lets go: the gaps between samples are counted
+	 * in syscalls, and a thread under PTRACE_CONT can't be made to count
+	 * them. Skipping by time instead leaves weights off by the ratio of
+	 * traced to untraced syscall cost, a hundredfold for busy loops */
+	bool idle =
+		(mode == TRACE_MODE_PAUSED) ||
+		!trace_sampler_in_window(&sampler, state->timestamp);
+
+	if(rec->bp_step != 0) {
+		return PTRACE_SINGLESTEP;
+	}
+
+	/* only let go between syscalls, a syscall entered under
+	 * PTRACE_SYSCALL still has its exit stop to come */
+	if(idle && !rec->in_syscall) {
+		rec->free_running = true;
+		return PTRACE_CONT;
+	}
+
+	rec->free_running = false;
+	return PTRACE_SYSCALL;
+}
+/*****************************************************************************/
+static bool is_interrupt_stop(const struct tracee_state *state, int status)
+{
+	/* a new thread starts with a SIGSTOP of its own; passing that on
+	 * leaves the whole process job control stopped once we detach */
+	bool first_stop = (state->thread->status == (uint8_t)-1);
+
+	if(!state->thread->interrupted && !first_stop) {
+		return false;
+	}
+
+	if(is_signal_stop(status)) {
+		return WSTOPSIG(status) == SIGSTOP;
+	}
+
+	/* PTRACE_INTERRUPT, or the first stop of a new seized thread */
+	return seized && is_group_stop(status);
+}
+/*****************************************************************************/
+static bool handle_watch(struct tracee_state *state)
+{
+	struct tracee_record *rec = state->thread;
+	const struct trace_watch *watch =
+		trace_watch_hit(state->pid, tracee_mem_space(rec));
+
+	/* the debug registers are only ever ours, a watch removed while its
+	 * trap was on the way is swallowed all the same */
+	if(watch != NULL) {
+		state->status = WATCHPOINT_STOP;
+		state->watch = watch->addr;
+		call_descriptor(state);
+	}
+
+	return true;
+}
+/*****************************************************************************/
+static bool handle_trap(struct tracee_state *state)
+{
+	struct tracee_record *rec = state->thread;
+	struct user_regs_struct *regs = &state->data.regs;
+	pid_t space = tracee_mem_space(rec);
+	struct trace_breakpoint *bp = trace_break_by_id(rec->bp_step);
+	uint64_t addr = regs->rip - 1;
+	siginfo_t si = {0};
+
+	ptrace(PTRACE_GETSIGINFO, state->pid, 0, &si);
+
+	/* single steps report TRAP_TRACE and int3 SI_KERNEL, rip alone
+	 * can't tell them apart after a one byte instruction */
+	bool stepped = (si.si_code == TRAP_TRACE);
+
+	/* a watch set off by the instruction stepped over a breakpoint
+	 * reports as the step and is missed */
+	if((bp == NULL) && (si.si_code == TRAP_HWBKPT)) {
+		return handle_watch(state);
+	}
+
+	if((bp != NULL) && stepped) {
+		/* the step over the original instruction is done */
+		trace_break_step_end(bp, space);
+		rec->bp_step = 0;
+		return true;
+	} else if((bp != NULL) && (addr == bp->addr)) {
+		/* another thread put the int3 back before this one got to
+		 * step, go round again */
+		trace_break_step_end(bp, space);
+	} else if((bp != NULL) || stepped) {
+		return false;
+	} else if((bp = trace_break_find(addr)) == NULL) {
+		return false;
+	} else if(bp->armed && (bp->space == space)) {
+		regs->rip = addr;
+		state->status = BREAKPOINT_STOP;
+		call_descriptor(state);
+	}
+
+	/* execution resumes at the instruction the int3 replaced */
+	regs->rip = addr;
+	ptrace(PTRACE_SETREGS, state->pid, 0, regs);
+
+	rec->bp_step = 0;
+
+	/* an int3 removed while its trap was on the way leaves nothing to
+	 * step over */
+	if(trace_break_step_begin(bp, space) == 0) {
+		rec->bp_step = trace_break_id(bp);
+	}
+
+	return true;
+}
+/*****************************************************************************/
+static void settle_detach(void)
+{
+	if(mode != TRACE_MODE_DETACHING) {
+		return;
+	}
+
+	if(tracee_state_table_count(state_tab) == 0) {
+		mode = TRACE_MODE_DETACHED;
+		seized = false;
+	}
+}
+/*****************************************************************************/
+static void release_thread(struct tracee_state *state, int sig)
+{
+	if(state->thread->watch_gen != 0) {
+		trace_watch_reset(state->pid);
+	}
+
+	ptrace(PTRACE_DETACH, state->pid, 0, sig);
+	forget_thread(state);
+	settle_detach();
+}
+/*****************************************************************************/
+static int seize_thread(pid_t tid, pid_t proc, bool remote)
+{
+	if(ptrace(PTRACE_SEIZE, tid, 0, TRACE_OPTIONS) == -1) {
+		return -1;
+	}
+
+	struct tracee_record *rec = lookup_thread(tid);
+
+	rec->proc = proc;
+	rec->remote = remote;
+
+	/* its first stop is this interrupt, which we swallow */
+	if(ptrace(PTRACE_INTERRUPT, tid, 0, 0) == 0) {
+		rec->interrupted = true;
+	}
+
+	struct tracee_state state = {
+		.status = STARTED,
+		.pid = tid,
+		.thread = rec,
+		.timestamp = trace_clock_now(),
+		.duration = 0,
+		.weight = trace_sampler_weight(&sampler)
+	};
+
+	call_descriptor(&state);
+
+	return 0;
+}
+/*****************************************************************************/
+static int attach_process(pid_t pid, const char **why)
+{
+	char path[64];
+	long cmp = syscall(SYS_kcmp, parent_pid, pid, KCMP_VM, 0, 0);
+	int added;
+
+	/* an exec'd target that wasn't traced at the time has started a
+	 * monitor of its own, we'd only be attaching to that */
+	if(cmp > 0) {
+		*why = "the target has exec'd, use its own control socket";
+		return -1;
+	}
+
+	/* if the kernel can't tell us, assume the worst and read the
+	 * target's memory the slow way */
+	bool remote = (cmp != 0);
+
+	ghost_snprintf(path, sizeof(path), "/proc/%d/task", pid);
+
+	seized = true;
+
+	/* threads may be created while we go, keep scanning until a pass
+	 * turns up nothing new */
+	do {
+		DIR *dir = opendir(path);
+		struct dirent *ent;
+
+		if(dir == NULL) {
+			*why = "unable to list the target's threads";
+			return -1;
+		}
+
+		added = 0;
+
+		while((ent = readdir(dir)) != NULL) {
+			pid_t tid = atoi(ent->d_name);
+
+			if(tid <= 0) {
+				continue;
+			} else if(tracee_state_table_find(state_tab, tid)) {
+				continue;
+			}
+
+			if(seize_thread(tid, pid, remote) == 0) {
+				added += 1;
+			}
+		}
+
+		closedir(dir);
+	} while(added != 0);
+
+	if(tracee_state_table_count(state_tab) == 0) {
+		*why = "unable to attach to the target";
+		return -1;
+	}
+
+	mode = TRACE_MODE_TRACING;
+
+	return 0;
+}
+/*****************************************************************************/
+static void start_detach(void)
+{
+	/* a thread can only be let go of while it is stopped, every one of
+	 * them gets an interrupt and is detached at the resulting stop */
+	mode = TRACE_MODE_DETACHING;
+
+	/* nothing would catch the traps once we are gone */
+	trace_break_clear();
+	trace_watch_clear();
+
+	tracee_state_table_foreach(
+		state_tab, interrupt_thread, (void*)&EVERY_THREAD
+	);
+
+	settle_detach();
+}
+/*****************************************************************************/
+static void reset_user_ref(struct tracee_record *rec, void *arg)
+{
+	rec->user_ref = 0;
+}
+/*****************************************************************************/
+static bool is_command(const char *cmd, size_t len, const char *name)
+{
+	return (strlen(name) == len) && (strncmp(cmd, name, len) == 0);
+}
+/*****************************************************************************/
+static void run_command(const char *cmd, char *reply, size_t size)
+{
+	const char *why = NULL;
+	const char *arg = strchr(cmd, ' ');
+	size_t len = (arg == NULL) ? strlen(cmd) : (size_t)(arg - cmd);
+	char *msg = NULL;
+
+	arg = (arg == NULL) ? "" : arg + 1;
+
+	if(is_command(cmd, len, "status")) {
+		ghost_snprintf(
+			reply,
+			size,
+			"%s threads=%lu sample=%u duty=%lu/%lu\n",
+			MODE_NAMES[mode],
+			(unsigned long)tracee_state_table_count(state_tab),
+			sampler.rate,
+			(unsigned long)(sampler.on / TRACE_CLOCK_NS_PER_MS),
+			(unsigned long)(sampler.period / TRACE_CLOCK_NS_PER_MS)
+		);
+		return;
+	} else if(is_command(cmd, len, "pause")) {
+		if(mode == TRACE_MODE_TRACING) {
+			mode = TRACE_MODE_PAUSED;
+		} else if(mode != TRACE_MODE_PAUSED) {
+			why = "not attached";
+		}
+	} else if(is_command(cmd, len, "resume")) {
+		if(mode == TRACE_MODE_PAUSED) {
+			mode = TRACE_MODE_TRACING;
+			interrupt_free_running();
+		} else if(mode != TRACE_MODE_TRACING) {
+			why = "not attached";
+		}
+	} else if(is_command(cmd, len, "detach")) {
+		if(mode == TRACE_MODE_DETACHED) {
+			why = "already detached";
+		} else {
+			start_detach();
+		}
+	} else if(is_command(cmd, len, "attach")) {
+		if(mode != TRACE_MODE_DETACHED) {
+			why = "still attached";
+		} else {
+			attach_process(child_pid, &why);
+		}
+	} else if(is_command(cmd, len, "load")) {
+		if(descriptor.load == NULL) {
+			why = "the trace handler doesn't take scripts";
+		} else if(descriptor.load(descriptor.arg, arg, &msg) != 0) {
+			why = (msg == NULL) ? "unable to load the script" : msg;
+		} else {
+			/* the thread tables belonged to the old script */
+			tracee_state_table_foreach(
+				state_tab, reset_user_ref, NULL
+			);
+		}
+	} else if(is_command(cmd, len, "sample")) {
+		uint32_t rate;
+		const char *end = parse_u32(arg, &rate);
+
+		if((end == NULL) || (*end != '\0')) {
+			why = "expected a rate";
+		} else {
+			trace_set_sample_rate(rate);
+		}
+	} else if(is_command(cmd, len, "duty")) {
+		uint32_t on = 0;
+		uint32_t period = 0;
+		const char *end = "";
+
+		if(strcmp(arg, "off") != 0) {
+			end = parse_duty(arg, &on, &period);
+		}
+
+		if((end == NULL) || (*end != '\0')) {
+			why = "expected <on>/<period> or off";
+		} else if(trace_set_duty_cycle(
+			(uint64_t)on * TRACE_CLOCK_NS_PER_MS,
+			(uint64_t)period * TRACE_CLOCK_NS_PER_MS
+		)) {
+			why = "unable to start the duty cycle timer";
+		}
+	} else {
+		why = "unknown command";
+	}
+
+	if(why == NULL) {
+		ghost_snprintf(reply, size, "ok\n");
+	} else {
+		ghost_snprintf(reply, size, "error: %s\n", why);
+	}
+
+	ghost_free(sheap, msg);
+}
+/*****************************************************************************/
+static void serve_control(void)
+{
+	char reply[CONTROL_MSG_MAX];
+	const char *cmd = trace_control_command();
+
+	if(cmd == NULL) {
+		return;
+	}
+
+	run_command(cmd, reply, sizeof(reply));
+	trace_control_reply(reply);
+}
+/*****************************************************************************/
 static void signal_forwarder_handler(
 	int signo, siginfo_t *info, void *ucontext
 ) {
 	safe_kill(child_pid, signo);
 }
 /*****************************************************************************/
+static void trap_handler(int signo, siginfo_t *info, void *ucontext)
+{
+	ucontext_t *uc = ucontext;
+	greg_t *regs = uc->uc_mcontext.gregs;
+	uint64_t rip = regs[REG_RIP];
+
+	if(info->si_code == TRAP_TRACE) {
+		/* past the original instruction, the int3 can go back */
+		trace_break_monitor_step_end();
+		regs[REG_EFL] &= ~EFLAGS_TF;
+	} else if(trace_break_monitor_trap(&rip)) {
+		/* the monitor runs library code that the target may have had
+		 * breakpoints put into, it can't be stepped over with ptrace
+		 * like a target thread is so it steps itself */
+		regs[REG_RIP] = rip;
+		regs[REG_EFL] |= EFLAGS_TF;
+	}
+}
+/*****************************************************************************/
 static int monitor_thread(void* arg)
 {
 	child_pid = safe_getpid();
@@ -132,10 +993,12 @@ static int monitor_thread(void* arg)
 
 	application_set_proc_name();
 	setup_signal_handling();
+	setup_async_output();
 
 	int exit_code = monitor(child_pid);
 
 	ghost_stdio_cleanup();
+	report_async_drops();
 
 	safe_exit(exit_code);
 
@@ -153,6 +1016,57 @@ static void setup_signal_handling(void)
 	for(int i = 0; i < ARR_SIZE(SIGNALS_TO_FORWARD); i++) {
 		sigaction(SIGNALS_TO_FORWARD[i], &fwd_action, NULL);
 	}
+
+	struct sigaction trap_action;
+
+	trap_action.sa_sigaction = trap_handler;
+	trap_action.sa_flags = SA_RESTART | SA_SIGINFO;
+	sigemptyset(&trap_action.sa_mask);
+
+	sigaction(SIGTRAP, &trap_action, NULL);
+}
+/*****************************************************************************/
+static void setup_async_output(void)
+{
+	int policy;
+
+	switch(cached_opts.async_out) {
+	case ASYNC_OUT_BLOCK:
+		policy = GHOST_ASYNC_BLOCK;
+		break;
+	case ASYNC_OUT_DROP:
+		policy = GHOST_ASYNC_DROP;
+		break;
+	case ASYNC_OUT_SPILL:
+		policy = GHOST_ASYNC_SPILL;
+		break;
+	default:
+		return;
+	}
+
+	/* the writer threads belong to the monitor, so the target never
+	 * waits on a slow terminal or disk while it is stopped */
+	ghost_fasync(ghost_stdout, policy, GHOST_ASYNC_BUF_SIZE);
+	ghost_fasync(ghost_stderr, policy, GHOST_ASYNC_BUF_SIZE);
+}
+/*****************************************************************************/
+static void report_async_drops(void)
+{
+	size_t out = ghost_fasync_dropped(ghost_stdout);
+	size_t err = ghost_fasync_dropped(ghost_stderr);
+
+	if((out == 0) && (err == 0)) {
+		return;
+	}
+
+	/* the writer threads are stopped by now, so this goes out directly */
+	ghost_fprintf(
+		ghost_stderr,
+		"ghost-patch: output was dropped, %zu bytes of stdout and "
+		"%zu bytes of stderr\n",
+		out, err
+	);
+	ghost_fflush(ghost_stderr);
 }
 /*****************************************************************************/
 static NEVER_INLINE int monitor(pid_t target_pid)
@@ -167,6 +1081,10 @@ static NEVER_INLINE int monitor(pid_t target_pid)
 		exit_status = trace_target(target_pid);
 	}
 
+	if(descriptor.fini != NULL) {
+		descriptor.fini(descriptor.arg);
+	}
+
 	tracee_state_table_destroy(state_tab);
 
 	return exit_status;
@@ -176,8 +1094,6 @@ static int only_wait_for_exit(pid_t target_pid)
 {
 	int status;
 
-	wait_flag = 1;
-
 	while(1) {
 
 		if(waitpid(target_pid, &status, 0) == -1) {
@@ -195,61 +1111,122 @@ static int only_wait_for_exit(pid_t target_pid)
 static int trace_target(pid_t target_pid)
 {
 	int ret = -1;
+	bool target_done = false;
 
 	struct tracee_state state;
 	int status;
 
-	int options =
-		PTRACE_O_EXITKILL |
-		PTRACE_O_TRACESYSGOOD |
-		PTRACE_O_TRACEEXEC |
-		PTRACE_O_TRACECLONE;
-
 	waitpid(target_pid, &status, __WALL);
 
-	ptrace(PTRACE_SEIZE, target_pid, 0, options);
-	ptrace(PTRACE_SETOPTIONS, target_pid, 0, options);
+	setup_sampling();
+	setup_control();
+
+	if(cached_opts.idle) {
+		/* let it run untouched until someone asks for an attach */
+		mode = TRACE_MODE_DETACHED;
+		ptrace(PTRACE_DETACH, target_pid, 0, 0);
+	} else {
+		mode = TRACE_MODE_TRACING;
 
-	state.status = STARTED;
-	state.pid = target_pid;
+		ptrace(PTRACE_SEIZE, target_pid, 0, TRACE_OPTIONS);
+		ptrace(PTRACE_SETOPTIONS, target_pid, 0, TRACE_OPTIONS);
 
-	call_descriptor(&state);
+		state.status = STARTED;
+		state.pid = target_pid;
+		state.thread = lookup_thread(target_pid);
+		state.timestamp = trace_clock_now();
+		state.duration = 0;
+		state.weight = trace_sampler_weight(&sampler);
 
-	wait_flag = 1;
+		call_descriptor(&state);
+	}
 
-	ptrace(PTRACE_SYSCALL, target_pid, 0, 0);
+	if(mode == TRACE_MODE_TRACING) {
+		ptrace(PTRACE_SYSCALL, target_pid, 0, 0);
+	}
 
 	while(1) {
 		int sig = 0;
 
-		if((state.pid = waitpid(-1, &status, __WALL)) == -1) {
+		if(duty_tick) {
+			duty_tick = false;
+			trace_sampler_tick(&sampler, trace_clock_now());
+			interrupt_free_running();
+		}
+
+		serve_control();
+		interrupt_for_watches();
+
+		state.pid = wait_idle(&status);
+		state.timestamp = trace_clock_now();
+		state.duration = 0;
+		state.weight = trace_sampler_weight(&sampler);
+
+		if((state.pid == -1) && (errno == EINTR)) {
+			/* a duty cycle tick or a control command, handled at
+			 * the top of the loop */
+			continue;
+		} else if(
+			(state.pid == -1) && target_done && (errno == ECHILD)
+		) {
+			/* the last of the followed processes has exited */
+			break;
+		} else if(state.pid == -1) {
 			state.status = EXITED_UNEXPECTED;
+			state.thread = NULL;
 			call_descriptor(&state);
 			break;
 		}
 
+		state.thread = lookup_thread(state.pid);
+
 		if(WIFEXITED(status)) {
 			state.status = EXITED_NORMAL;
 			state.data.exit_status = WEXITSTATUS(status);
 			call_descriptor(&state);
 
 			if(state.pid == target_pid) {
-				return state.data.exit_status;
+				ret = state.data.exit_status;
+				target_done = true;
 			}
-		} else if(is_syscall_stop(status)) {
-			uint8_t prev_state = tracee_state_table_retrieve(
-				state_tab, state.pid
-			);
 
-			if(prev_state == SYSCALL_ENTER_STOP) {
+			if(target_done && !cached_opts.follow_fork) {
+				break;
+			}
+
+			/* the thread is gone, there is nothing to resume */
+			forget_thread(&state);
+			settle_detach();
+			continue;
+		}
+
+		if(seized && !is_group_stop(status)) {
+			/* any other trap takes the place of a pending
+			 * PTRACE_INTERRUPT, it won't stop the thread again */
+			state.thread->interrupted = false;
+		}
+
+		if(is_syscall_stop(status)) {
+			if(state.thread->in_syscall) {
 				state.status = SYSCALL_EXIT_STOP;
 			} else {
 				state.status = SYSCALL_ENTER_STOP;
 			}
 
+			state.thread->in_syscall = !state.thread->in_syscall;
+
+			if(state.status == SYSCALL_ENTER_STOP) {
+				state.thread->sampled =
+					trace_sampler_pick(&sampler);
+			}
+
 			if(load_regs(&state) == 0) {
+				track_syscall(&state);
 				modify_syscalls(&state);
-				call_descriptor(&state);
+
+				if(state.thread->sampled) {
+					call_descriptor(&state);
+				}
 			} else {
 				state.status = EXITED_UNEXPECTED;
 				call_descriptor(&state);
@@ -258,6 +1235,13 @@ static int trace_target(pid_t target_pid)
 					break;
 				}
 			}
+		} else if(is_interrupt_stop(&state, status)) {
+			/* our own, from the start of a duty window, a
+			 * detach or a new thread, swallowed whichever way it
+			 * was sent */
+			state.status = is_group_stop(status) ?
+				GROUP_STOP : SIGNAL_DELIVERY_STOP;
+			state.thread->interrupted = false;
 		} else if(is_group_stop(status)) {
 
 			state.status = GROUP_STOP;
@@ -265,17 +1249,49 @@ static int trace_target(pid_t target_pid)
 
 		} else if(is_event_stop(status)) {
 
+			bool report = true;
+
 			state.data.pt_event = extract_ptrace_event(status);
 
+			if(state.thread->free_running) {
+				/* event stops happen inside a syscall, one that
+				 * was entered while we weren't looking */
+				state.thread->in_syscall = true;
+				state.thread->enter_stamp = 0;
+				state.thread->sampled = false;
+			}
+
 			if(state.data.pt_event == PTRACE_EVENT_EXEC) {
 				state.status = PTRACE_EXEC_OCCURED;
-			} else if(state.data.pt_event == PTRACE_EVENT_CLONE) {
+				state.thread->bp_step = 0;
+				trace_break_forget(
+					tracee_mem_space(state.thread)
+				);
+				trace_watch_forget(
+					tracee_mem_space(state.thread)
+				);
+				/* an exec clears the debug registers */
+				state.thread->watch_gen = 0;
+				track_exec(&state);
+			} else if(is_spawn_event(state.data.pt_event)) {
 				state.status = STARTED;
+				report = track_spawn(&state);
+			} else if(
+				state.data.pt_event == PTRACE_EVENT_VFORK_DONE
+			) {
+				/* only asked for to end trace_break_hold() */
+				state.status = PTRACE_EVENT_OCCURED_STOP;
+				report = false;
+				trace_break_release(
+					tracee_mem_space(state.thread)
+				);
 			} else {
 				state.status = PTRACE_EVENT_OCCURED_STOP;
 			}
 
-			call_descriptor(&state);
+			if(report) {
+				call_descriptor(&state);
+			}
 
 		} else if(is_signal_stop(status)) {
 			sig = WSTOPSIG(status);
@@ -285,28 +1301,64 @@ static int trace_target(pid_t target_pid)
 
 			load_regs(&state);
 
-			call_descriptor(&state);
+			if((sig == SIGTRAP) && handle_trap(&state)) {
+				/* ours, the target never gets to see it */
+				sig = 0;
+			} else {
+				call_descriptor(&state);
+			}
 		}
 
-		tracee_state_table_store(state_tab, state.pid, state.status);
+		state.thread->status = state.status;
 
-		if(state.status == PTRACE_EXEC_OCCURED) {
+		bool release =
+			(state.status == PTRACE_EXEC_OCCURED) &&
+			!cached_opts.follow_exec;
+
+		if(mode == TRACE_MODE_DETACHING) {
+			release = !state.thread->interrupted;
+		}
+
+		if(!release) {
+			sync_watches(state.thread);
+		}
+
+		if(release && (mode == TRACE_MODE_DETACHING)) {
+			release_thread(&state, sig);
+		} else if(release) {
 			ptrace(PTRACE_DETACH, state.pid, 0, 0);
+			forget_thread(&state);
+			// Children picked up through fork events can be left
+			// job control stopped once we let go of them, kick
+			// them so the new image actually gets to run.
+			kill(state.pid, SIGCONT);
 			// The next call to waitpid (top of this loop) will
 			// cause this process to exec into the new process.
 			// I have no idea why this works, but this effectivley
 			// allows us to follow the target (but without
 			// carrying over state) so it's a good outcome.
-		} else if(ptrace(PTRACE_SYSCALL, state.pid, 0, sig) == -1) {
+		} else if(
+			ptrace(resume_request(&state), state.pid, 0, sig) == -1
+		) {
 			state.status = EXITED_UNEXPECTED;
 			call_descriptor(&state);
 
 			if(state.pid == target_pid) {
 				break;
 			}
+
+			forget_thread(&state);
 		}
 	}
 
+	if(duty_timer_made) {
+		timer_delete(duty_timer);
+	}
+
+	trace_break_clear();
+	trace_watch_clear();
+	trace_control_stop();
+
 	return ret;
 }
 /*****************************************************************************/
@@ -359,7 +1411,9 @@ static bool is_event_stop(int status)
 		return false;
 	}
 
-	return (signal == SIGTRAP) && !!(0xFF & (status >> 8));
+	/* the event sits above the signal, a plain SIGTRAP (an int3 or a
+	 * kill) has none */
+	return (signal == SIGTRAP) && !!(0xFF & (status >> 16));
 }
 /*****************************************************************************/
 static bool is_signal_stop(int status)
@@ -407,3 +1461,39 @@ int start_trace(
 	return 0;
 }
 /*****************************************************************************/
+void trace_set_sample_rate(uint32_t rate)
+{
+	trace_sampler_set_rate(&sampler, rate);
+}
+/*****************************************************************************/
+void trace_request_idle(void)
+{
+	idle_requested = true;
+}
+/*****************************************************************************/
+struct tracee_record *trace_thread_record(pid_t tid)
+{
+	return tracee_state_table_find(state_tab, tid);
+}
+/*****************************************************************************/
+int trace_set_duty_cycle(uint64_t on_ns, uint64_t period_ns)
+{
+	uint64_t now = trace_clock_now();
+
+	if(trace_sampler_set_duty(&sampler, on_ns, period_ns, now) != 0) {
+		return -1;
+	}
+
+	int ret = arm_duty_timer(sampler.period);
+
+	if(ret != 0) {
+		/* without a timer nothing would ever end the idle phase */
+		trace_sampler_set_duty(&sampler, 0, 0, now);
+	}
+
+	/* the new window starts now, anything running free rejoins it */
+	interrupt_free_running();
+
+	return ret;
+}
+/*****************************************************************************/
@@ -21,8 +21,11 @@
 /******************************************************************************
 *                                  INCLUDES                                   *
 ******************************************************************************/
+#include <stdint.h>
 #include <sys/types.h>
 #include <sys/user.h>
+
+#include "tracee-state-table.h"
 /******************************************************************************
 *                                    TYPES                                    *
 ******************************************************************************/
@@ -35,13 +38,38 @@ enum tracee_status {
 	SIGNAL_DELIVERY_STOP,
 	GROUP_STOP,
 	PTRACE_EVENT_OCCURED_STOP,
-	PTRACE_EXEC_OCCURED
+	PTRACE_EXEC_OCCURED,
+	/* a thread ran into a trace_break_insert() breakpoint, regs.rip is
+	 * its address */
+	BREAKPOINT_STOP,
+	/* a thread set off a trace_watch_insert() watchpoint, see watch */
+	WATCHPOINT_STOP
 };
 /*****************************************************************************/
 struct tracee_state {
 	enum tracee_status status;
 	pid_t pid;
 
+	/* the monitor's record for pid, handlers may use its user_ref slot;
+	 * only valid for the duration of the handler call and NULL when
+	 * waitpid itself failed */
+	struct tracee_record *thread;
+
+	/* monotonic nanoseconds at which the monitor observed the stop */
+	uint64_t timestamp;
+	/* for SYSCALL_EXIT_STOP the nanoseconds since the matching
+	 * SYSCALL_ENTER_STOP of the same thread, otherwise 0 */
+	uint64_t duration;
+
+	/* how many syscalls each one the handler sees stands for, 1 unless
+	 * sampling is on; counts scaled by it estimate the full trace */
+	double weight;
+
+	/* for WATCHPOINT_STOP the address of the watch that went off; a
+	 * data watch stops the thread after the instruction that touched
+	 * it, so regs.rip is already past that one */
+	uint64_t watch;
+
 	union {
 		int exit_status;
 		int signo;
@@ -52,10 +80,23 @@ struct tracee_state {
 /*****************************************************************************/
 typedef void* (*trace_handler)(void *arg, const struct tracee_state *state);
 typedef void* (*trace_handler_init)(void *arg);
+/* replace the handler's script with the one at path, on failure returns
+ * non-zero and may set *msg to a ghost_malloc'd explanation */
+typedef int (*trace_handler_load)(void *arg, const char *path, char **msg);
+/* called once the trace is over, before the monitor exits */
+typedef void (*trace_handler_fini)(void *arg);
+/* does a little of the work put off with trace_request_idle() */
+typedef void (*trace_handler_idle)(void *arg);
 /*****************************************************************************/
 struct trace_descriptor {
 	trace_handler handle;
 	trace_handler_init init;
+	/* NULL for handlers without scripts */
+	trace_handler_load load;
+	/* NULL when there is nothing to finish */
+	trace_handler_fini fini;
+	/* NULL when nothing is ever put off */
+	trace_handler_idle idle;
 	void *arg;
 };
 /*****************************************************************************/
@@ -69,5 +110,15 @@ struct trace_entities {
 int start_trace(
 	const struct trace_descriptor *descr, struct trace_entities *ents
 );
+/* may only be called by the monitor, i.e. from within a trace handler */
+void trace_set_sample_rate(uint32_t rate);
+int trace_set_duty_cycle(uint64_t on_ns, uint64_t period_ns);
+/* Has the descriptor's idle function called once no thread is stopped
+ * waiting on the monitor, before it blocks for the next event. Asking again
+ * from within it keeps it being called for as long as that holds. */
+void trace_request_idle(void);
+/* the monitor's record for tid, NULL once the thread is gone; good until
+ * the handler returns, like tracee_state.thread */
+struct tracee_record *trace_thread_record(pid_t tid);
 /*****************************************************************************/
 #endif /* TRACE_H */
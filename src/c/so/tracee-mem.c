@@ -0,0 +1,314 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#define _GNU_SOURCE
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "tracee-mem.h"
+
+#include "secret-heap.h"
+#include "safe_syscalls.h"
+#include <utl/math-utl.h>
+
+#include <gio/ghost-stdio.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const uint64_t PAGE_SIZE_4K = 4096;
+/* pages checked per process_vm_readv() call by tracee_mem_readable() */
+#define PROBE_BATCH 64
+#define MEM_PATH_MAX 32
+/******************************************************************************
+*                                    DATA                                     *
+******************************************************************************/
+/* /proc/self/mem, kept open since breakpoints write through it on every
+ * hit */
+static int self_mem_fd = -1;
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static pid_t read_pid(const struct tracee_record *rec)
+{
+	if(!tracee_mem_is_local(rec)) {
+		return rec->tid;
+	}
+
+	/* reading our own memory through the kernel turns a bad pointer
+	 * into EFAULT rather than a SIGSEGV in the target. Whoever asks,
+	 * the monitor or a target thread in a hook, names itself, which
+	 * is always allowed where naming the other may not be. Not the
+	 * getpid() we interpose and not cached, a forked child is another
+	 * process. */
+	return safe_getpid();
+}
+/*****************************************************************************/
+static int open_space(pid_t space)
+{
+	char path[MEM_PATH_MAX];
+
+	if((space == 0) && (self_mem_fd >= 0)) {
+		return self_mem_fd;
+	}
+
+	if(space == 0) {
+		ghost_snprintf(path, sizeof(path), "/proc/self/mem");
+	} else {
+		ghost_snprintf(path, sizeof(path), "/proc/%d/mem", space);
+	}
+
+	int fd = safe_open(path, O_RDWR | O_CLOEXEC);
+
+	if(space == 0) {
+		self_mem_fd = fd;
+	}
+
+	return fd;
+}
+/*****************************************************************************/
+static void close_space(pid_t space, int fd)
+{
+	if(space != 0) {
+		safe_close(fd);
+	}
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+bool tracee_mem_is_local(const struct tracee_record *rec)
+{
+	/* with no record we are reading on behalf of the target we were
+	 * injected into, which shares our address space */
+	return (rec == NULL) || !rec->remote;
+}
+/*****************************************************************************/
+ssize_t tracee_mem_read(
+	const struct tracee_record *rec, void *dst, uint64_t addr, size_t len
+) {
+	if(tracee_mem_is_local(rec)) {
+		memcpy(dst, (const void*)addr, len);
+		return len;
+	}
+
+	struct iovec local = {.iov_base = dst, .iov_len = len};
+	struct iovec remote = {.iov_base = (void*)addr, .iov_len = len};
+
+	return process_vm_readv(rec->tid, &local, 1, &remote, 1, 0);
+}
+/*****************************************************************************/
+const void *tracee_mem_view(
+	const struct tracee_record *rec,
+	uint64_t addr,
+	size_t len,
+	void **scratch,
+	size_t *got
+) {
+	/* memory we share is used in place, anything else is copied into a
+	 * scratch buffer which the caller releases with ghost_free() */
+	*scratch = NULL;
+
+	if(tracee_mem_is_local(rec)) {
+		*got = len;
+		return (const void*)addr;
+	}
+
+	*scratch = ghost_malloc(sheap, max_u64(len, 1));
+
+	if(*scratch == NULL) {
+		return NULL;
+	}
+
+	ssize_t n = tracee_mem_read(rec, *scratch, addr, len);
+
+	if(n < 0) {
+		*got = 0;
+		return NULL;
+	}
+
+	*got = n;
+
+	return *scratch;
+}
+/*****************************************************************************/
+const char *tracee_mem_view_str(
+	const struct tracee_record *rec,
+	uint64_t addr,
+	size_t max,
+	void **scratch,
+	size_t *len
+) {
+	*scratch = NULL;
+
+	if(tracee_mem_is_local(rec)) {
+		*len = strnlen((const char*)addr, max);
+		return (const char*)addr;
+	}
+
+	size_t cap = min_u64(max, PAGE_SIZE_4K);
+	char *buf = ghost_malloc(sheap, cap + 1);
+	size_t off = 0;
+	bool readable = false;
+
+	if(buf == NULL) {
+		return NULL;
+	}
+
+	*scratch = buf;
+
+	/* go a page at a time so that a string ending just before an
+	 * unmapped page can still be read, and so that a generous max only
+	 * costs memory when the string really is that long */
+	while(off < max) {
+		uint64_t at = addr + off;
+		size_t chunk = PAGE_SIZE_4K - (at & (PAGE_SIZE_4K - 1));
+		chunk = min_u64(chunk, max - off);
+
+		if(off + chunk > cap) {
+			size_t new_cap = max_u64(cap * 2, off + chunk);
+			new_cap = min_u64(max, new_cap);
+			char *tmp = ghost_realloc(sheap, buf, new_cap + 1);
+
+			if(tmp == NULL) {
+				break;
+			}
+
+			buf = tmp;
+			cap = new_cap;
+			*scratch = buf;
+		}
+
+		ssize_t n = tracee_mem_read(rec, buf + off, at, chunk);
+
+		if(n <= 0) {
+			break;
+		}
+
+		readable = true;
+
+		const char *nul = memchr(buf + off, '\0', n);
+
+		if(nul != NULL) {
+			off = nul - buf;
+			break;
+		}
+
+		off += n;
+	}
+
+	if(!readable && (max != 0)) {
+		/* nothing at addr could be read */
+		return NULL;
+	}
+
+	buf[off] = '\0';
+	*len = off;
+
+	return buf;
+}
+/*****************************************************************************/
+ssize_t tracee_mem_read_safe(
+	const struct tracee_record *rec, void *dst, uint64_t addr, size_t len
+) {
+	struct iovec local = {.iov_base = dst, .iov_len = len};
+	struct iovec remote = {.iov_base = (void*)addr, .iov_len = len};
+
+	return process_vm_readv(read_pid(rec), &local, 1, &remote, 1, 0);
+}
+/*****************************************************************************/
+bool tracee_mem_readable(
+	const struct tracee_record *rec, uint64_t addr, size_t len
+) {
+	struct iovec remote[PROBE_BATCH];
+	uint8_t probe[PROBE_BATCH];
+	struct iovec local = {.iov_base = probe, .iov_len = sizeof(probe)};
+
+	if(len == 0) {
+		return true;
+	} else if((addr + len) < addr) {
+		return false;
+	}
+
+	uint64_t page = addr & ~(PAGE_SIZE_4K - 1);
+	uint64_t end = addr + len;
+
+	/* one byte from every page is enough, and a single call can check
+	 * a whole batch of them */
+	while(page < end) {
+		int n = 0;
+
+		for(; (n < PROBE_BATCH) && (page < end); n++) {
+			uint64_t at = max_u64(page, addr);
+
+			remote[n].iov_base = (void*)at;
+			remote[n].iov_len = 1;
+			page += PAGE_SIZE_4K;
+		}
+
+		ssize_t got = process_vm_readv(
+			read_pid(rec), &local, 1, remote, n, 0
+		);
+
+		if(got != n) {
+			return false;
+		}
+	}
+
+	return true;
+}
+/*****************************************************************************/
+pid_t tracee_mem_space(const struct tracee_record *rec)
+{
+	return tracee_mem_is_local(rec) ? 0 : rec->proc;
+}
+/*****************************************************************************/
+int tracee_mem_patch(
+	pid_t space, uint64_t addr, const void *src, void *old, size_t len
+) {
+	int ret = -1;
+	int fd = open_space(space);
+
+	if(fd < 0) {
+		return -1;
+	}
+
+	/* writes through /proc/<pid>/mem go past the page protections, the
+	 * same way PTRACE_POKETEXT does, so text can be patched in place;
+	 * raw syscalls, the monitor's SIGTRAP handler gets here and libc
+	 * may itself have breakpoints in it */
+	if(old != NULL) {
+		if(safe_pread(fd, old, len, addr) != (ssize_t)len) {
+			goto exit;
+		}
+	}
+
+	if((src != NULL) && (safe_pwrite(fd, src, len, addr) != (ssize_t)len)) {
+		goto exit;
+	}
+
+	ret = 0;
+exit:
+	close_space(space, fd);
+	return ret;
+}
+/*****************************************************************************/
@@ -0,0 +1,68 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef TRACEE_MEM_H
+#define TRACEE_MEM_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "tracee-state-table.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+bool tracee_mem_is_local(const struct tracee_record *rec);
+ssize_t tracee_mem_read(
+	const struct tracee_record *rec, void *dst, uint64_t addr, size_t len
+);
+/* Like tracee_mem_read() but never faults, memory we share with the target
+ * is read through the kernel as well. */
+ssize_t tracee_mem_read_safe(
+	const struct tracee_record *rec, void *dst, uint64_t addr, size_t len
+);
+/* Whether every byte from addr to addr + len can be read right now */
+bool tracee_mem_readable(
+	const struct tracee_record *rec, uint64_t addr, size_t len
+);
+/* The address space rec runs in, 0 for the one we share with the target
+ * and otherwise the process id */
+pid_t tracee_mem_space(const struct tracee_record *rec);
+/* Writes len bytes from src to addr in space, even to read only text, after
+ * saving what was there to old. Either may be NULL. Returns 0 on success. */
+int tracee_mem_patch(
+	pid_t space, uint64_t addr, const void *src, void *old, size_t len
+);
+const void *tracee_mem_view(
+	const struct tracee_record *rec,
+	uint64_t addr,
+	size_t len,
+	void **scratch,
+	size_t *got
+);
+const char *tracee_mem_view_str(
+	const struct tracee_record *rec,
+	uint64_t addr,
+	size_t max,
+	void **scratch,
+	size_t *len
+);
+/*****************************************************************************/
+#endif /* TRACEE_MEM_H */
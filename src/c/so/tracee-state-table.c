@@ -23,136 +23,252 @@
 #include "tracee-state-table.h"
 
 #include "secret-heap.h"
-#include <gio/ghost-stdio.h>
+#include <safe_syscalls.h>
 
 #include <stdint.h>
-#include <fcntl.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <unistd.h>
-#include <errno.h>
-#include <stdlib.h>
-#include <limits.h>
+#include <stdbool.h>
 #include <string.h>
-#include <stdio.h>
+#include <sys/mman.h>
 /******************************************************************************
-*                                   MACROS                                    *
+*                                    TYPES                                    *
 ******************************************************************************/
-#define TABLE(t) ((uint8_t*)t)
+/* Open addressing with linear probing, keyed by tid. A tid of 0 marks an
+ * empty slot and removal shifts the following run back rather than leaving
+ * tombstones, so probe lengths only depend on the live thread count. */
+struct tracee_state_table {
+	struct tracee_record *slots;
+	size_t capacity;
+	size_t count;
+	unsigned bits;
+};
 /******************************************************************************
 *                                  CONSTANTS                                  *
 ******************************************************************************/
-const size_t READ_BUFFER_SIZE = 32;
-/******************************************************************************
-*                                    DATA                                     *
-******************************************************************************/
-static int max_threads;
+/* one page worth of records */
+static const unsigned MIN_BITS = 7;
+
+static const uint32_t FIB_HASH_MUL = 2654435769u;
 /******************************************************************************
 *                            FUNCTION DECLARATIONS                            *
 ******************************************************************************/
-static int compute_max_threads(void);
+static size_t slot_of(const struct tracee_state_table *tab, pid_t tid);
+static struct tracee_record *alloc_slots(size_t capacity);
+static void free_slots(struct tracee_record *slots, size_t capacity);
+static int resize(struct tracee_state_table *tab, unsigned bits);
+static bool in_run(size_t home, size_t from, size_t to);
 /******************************************************************************
 *                              STATIC FUNCTIONS                               *
 ******************************************************************************/
-static int compute_max_threads(void)
+static size_t slot_of(const struct tracee_state_table *tab, pid_t tid)
+{
+	/* tids are handed out sequentially, the multiplicative hash spreads
+	 * neighbouring ids across the table */
+	return ((uint32_t)tid * FIB_HASH_MUL) >> (32 - tab->bits);
+}
+/*****************************************************************************/
+static struct tracee_record *alloc_slots(size_t capacity)
 {
-	/* avoid using stdio when we are inside the memory space of another
-	process */
+	/* mapped rather than taken from the secret heap so that the records
+	 * are page, and so cache line, aligned */
+	void *slots = safe_mmap(
+		NULL,
+		capacity * sizeof(struct tracee_record),
+		PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS,
+		-1,
+		0
+	);
 
-	int fd = open("/proc/sys/kernel/pid_max", O_RDONLY);
-	char str[READ_BUFFER_SIZE];
-	char *endptr = NULL;
-	int ret = -1;
-	unsigned long converted = 0;
+	return slots == MAP_FAILED ? NULL : slots;
+}
+/*****************************************************************************/
+static void free_slots(struct tracee_record *slots, size_t capacity)
+{
+	safe_munmap(slots, capacity * sizeof(struct tracee_record));
+}
+/*****************************************************************************/
+static int resize(struct tracee_state_table *tab, unsigned bits)
+{
+	struct tracee_record *old = tab->slots;
+	size_t old_capacity = tab->capacity;
 
-	ssize_t len = 0;
-	ssize_t count = 0;
+	struct tracee_record *slots = alloc_slots((size_t)1 << bits);
 
-	if(fd < 0) {
-		goto exit;
+	if(slots == NULL) {
+		return -1;
 	}
 
-	while((count = read(fd, str + len, READ_BUFFER_SIZE - len)) != 0) {
-		if(count == -1) {
-			goto exit;
-		}
+	tab->slots = slots;
+	tab->capacity = (size_t)1 << bits;
+	tab->bits = bits;
 
-		len += count;
-	}
+	size_t mask = tab->capacity - 1;
 
-	if(len == READ_BUFFER_SIZE) {
-		errno = ENOMEM;
-		goto exit;
-	}
-
-	str[len - 1] = '\0';
+	for(size_t i = 0; i < old_capacity; i++) {
+		if(old[i].tid == 0) {
+			continue;
+		}
 
-	errno = 0;
+		size_t j = slot_of(tab, old[i].tid);
 
-	converted = strtoul(str, &endptr, 10);
+		while(slots[j].tid != 0) {
+			j = (j + 1) & mask;
+		}
 
-	if(errno != 0) {
-		goto exit;
-	}
-	if(endptr != (str + len - 1)) {
-		errno = EINVAL;
-		goto exit;
-	}
-	if(converted > INT_MAX) {
-		errno = EINVAL;
-		goto exit;
+		slots[j] = old[i];
 	}
 
-	ret = (int)converted;
+	free_slots(old, old_capacity);
 
-exit:
-	if(fd >= 0) {
-		close(fd);
+	return 0;
+}
+/*****************************************************************************/
+static bool in_run(size_t home, size_t from, size_t to)
+{
+	/* is home in the cyclic interval (from, to] */
+	if(from <= to) {
+		return (home > from) && (home <= to);
+	} else {
+		return (home > from) || (home <= to);
 	}
-	return ret;
 }
 /******************************************************************************
 *                            FUNCTION DEFINITIONS                             *
 ******************************************************************************/
-uint8_t tracee_state_table_retrieve(const void *t, pid_t id)
+struct tracee_record *tracee_state_table_find(const void *t, pid_t tid)
 {
-	return TABLE(t)[id];
+	const struct tracee_state_table *tab = t;
+	size_t mask = tab->capacity - 1;
+
+	if(tid <= 0) {
+		return NULL;
+	}
+
+	for(size_t i = slot_of(tab, tid); ; i = (i + 1) & mask) {
+		if(tab->slots[i].tid == tid) {
+			return &tab->slots[i];
+		} else if(tab->slots[i].tid == 0) {
+			return NULL;
+		}
+	}
 }
 /*****************************************************************************/
-int tracee_state_table_store(void *t, pid_t id, uint8_t state)
+struct tracee_record *tracee_state_table_get(void *t, pid_t tid)
 {
-	if(id > max_threads) {
-		return -1;
-	} else {
-		TABLE(t)[id] = state;
-		return 0;
+	struct tracee_state_table *tab = t;
+	struct tracee_record *rec = tracee_state_table_find(tab, tid);
+
+	if((rec != NULL) || (tid <= 0)) {
+		return rec;
+	}
+
+	/* keep the load at or under one half */
+	if((tab->count + 1) * 2 > tab->capacity) {
+		if(resize(tab, tab->bits + 1) != 0) {
+			return NULL;
+		}
+	}
+
+	size_t mask = tab->capacity - 1;
+	size_t i = slot_of(tab, tid);
+
+	while(tab->slots[i].tid != 0) {
+		i = (i + 1) & mask;
 	}
+
+	rec = &tab->slots[i];
+
+	memset(rec, 0, sizeof(*rec));
+	rec->tid = tid;
+	rec->status = (uint8_t)-1;
+
+	tab->count += 1;
+
+	return rec;
 }
 /*****************************************************************************/
-void tracee_state_table_destroy(void *table)
+void tracee_state_table_remove(void *t, pid_t tid)
 {
-	ghost_free(sheap, table);
+	struct tracee_state_table *tab = t;
+	struct tracee_record *rec = tracee_state_table_find(tab, tid);
+
+	if(rec == NULL) {
+		return;
+	}
+
+	size_t mask = tab->capacity - 1;
+	size_t hole = rec - tab->slots;
+
+	for(size_t i = (hole + 1) & mask; tab->slots[i].tid != 0; ) {
+		size_t home = slot_of(tab, tab->slots[i].tid);
+
+		/* an entry may only move back if the hole is still on the
+		 * path from its home slot */
+		if(!in_run(home, hole, i)) {
+			tab->slots[hole] = tab->slots[i];
+			hole = i;
+		}
+
+		i = (i + 1) & mask;
+	}
+
+	memset(&tab->slots[hole], 0, sizeof(tab->slots[hole]));
+	tab->count -= 1;
+
+	/* give memory back once a burst of threads has gone away, failing to
+	 * shrink is harmless */
+	if((tab->bits > MIN_BITS) && (tab->count * 8 < tab->capacity)) {
+		resize(tab, tab->bits - 1);
+	}
 }
 /*****************************************************************************/
-void *tracee_state_table_init(void)
+size_t tracee_state_table_count(const void *t)
 {
-	void *ret = NULL;
+	const struct tracee_state_table *tab = t;
 
-	if(max_threads == 0) {
-		max_threads = compute_max_threads();
+	return tab->count;
+}
+/*****************************************************************************/
+void tracee_state_table_foreach(
+	void *t, void (*fn)(struct tracee_record *rec, void *arg), void *arg
+) {
+	struct tracee_state_table *tab = t;
 
-		if(max_threads < 0) {
-			return NULL;
+	for(size_t i = 0; i < tab->capacity; i++) {
+		if(tab->slots[i].tid != 0) {
+			fn(&tab->slots[i], arg);
 		}
 	}
+}
+/*****************************************************************************/
+void tracee_state_table_destroy(void *table)
+{
+	struct tracee_state_table *tab = table;
 
+	free_slots(tab->slots, tab->capacity);
+	ghost_free(sheap, tab);
+}
+/*****************************************************************************/
+void *tracee_state_table_init(void)
+{
 	/* avoid calling malloc when we are operating within the memory
 	space of another process */
-	ret = ghost_malloc(sheap, max_threads);
+	struct tracee_state_table *ret = ghost_malloc(sheap, sizeof(*ret));
 
-	if(ret != NULL) {
-		memset(ret, -1, max_threads);
+	if(ret == NULL) {
+		return NULL;
 	}
+
+	ret->bits = MIN_BITS;
+	ret->capacity = (size_t)1 << MIN_BITS;
+	ret->count = 0;
+	ret->slots = alloc_slots(ret->capacity);
+
+	if(ret->slots == NULL) {
+		ghost_free(sheap, ret);
+		return NULL;
+	}
+
 	return ret;
 }
 /*****************************************************************************/
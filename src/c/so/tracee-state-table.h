@@ -22,13 +22,65 @@
 *                                  INCLUDES                                   *
 ******************************************************************************/
 #include <stdint.h>
+#include <stdbool.h>
 #include <sys/types.h>
 /******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+/* Everything the monitor remembers about one traced thread. Records are kept
+ * inline in the table and two of them share a cache line, so a lookup costs
+ * one line. A record pointer is only valid until the next call that inserts
+ * or removes a record. */
+struct tracee_record {
+	pid_t tid;
+	/* the process, i.e. thread group, that the thread belongs to */
+	pid_t proc;
+
+	/* slot owned by the trace handler, e.g. a Lua registry reference to
+	 * a per-thread table; 0 while unused */
+	int32_t user_ref;
+
+	/* syscall number and time of the last SYSCALL_ENTER_STOP */
+	int32_t enter_nr;
+	uint64_t enter_stamp;
+
+	uint8_t status;
+	/* set from a syscall enter stop until the matching exit stop, event
+	 * stops in between (clone, fork, exec) leave it alone */
+	bool in_syscall : 1;
+	/* the thread doesn't share the monitor's address space (a forked
+	 * child, or anything after an exec) so its memory can't simply be
+	 * dereferenced */
+	bool remote : 1;
+
+	/* the current syscall was picked by the sampler, so its exit stop
+	 * is handed to the trace handler as well */
+	bool sampled : 1;
+	/* resumed with PTRACE_CONT for the idle part of a duty cycle */
+	bool free_running : 1;
+	/* we sent a SIGSTOP (or a PTRACE_INTERRUPT once seized) to bring it
+	 * back under PTRACE_SYSCALL or to detach it, the stop is ours and
+	 * must not reach the target */
+	bool interrupted : 1;
+	/* trace_break_id() of the breakpoint whose instruction the thread
+	 * is being single stepped over, 0 if none */
+	uint16_t bp_step;
+	/* trace_watch_gen() when its debug registers were last programmed,
+	 * 0 if they never were */
+	uint32_t watch_gen;
+} __attribute__((aligned(32)));
+/******************************************************************************
 *                            FUNCTION DECLARATIONS                            *
 ******************************************************************************/
-uint8_t tracee_state_table_retrieve(const void *table, pid_t id);
-int tracee_state_table_store(void *table, pid_t id, uint8_t state);
+struct tracee_record *tracee_state_table_find(const void *table, pid_t tid);
+struct tracee_record *tracee_state_table_get(void *table, pid_t tid);
+void tracee_state_table_remove(void *table, pid_t tid);
+size_t tracee_state_table_count(const void *table);
+/* fn must not insert or remove records */
+void tracee_state_table_foreach(
+	void *table, void (*fn)(struct tracee_record *rec, void *arg), void *arg
+);
 void tracee_state_table_destroy(void *table);
 void *tracee_state_table_init(void);
 /*****************************************************************************/
-#endif /* TRACEE_STATE_TABLE_H */
\ No newline at end of file
+#endif /* TRACEE_STATE_TABLE_H */
@@ -0,0 +1,489 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "tracee-syms.h"
+
+#include "elf-syms.h"
+#include "secret-heap.h"
+#include "trace-clock.h"
+#include <gio/ghost-stdio.h>
+#include <utl/file-utl.h>
+#include <utl/math-utl.h>
+#include <utl/str-utl.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+#define PROC_CACHE_SIZE 8
+#define MAPS_PATH_MAX 64
+#define MAPS_LINE_MAX (PATH_MAX + 128)
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct module {
+	uint64_t start;
+	uint64_t end;
+	/* start of the mapping of file offset 0, 0 if there is none */
+	uint64_t map0;
+	/* the furthest end of this module and every one before it, a module
+	 * mapped in a hole of another one doesn't hide the rest of it */
+	uint64_t reach;
+	char *path;
+
+	/* opened on first use, open_failed stops us retrying */
+	struct elf_syms *es;
+	bool open_failed;
+};
+/*****************************************************************************/
+struct proc_syms {
+	pid_t pid;
+	bool valid;
+	uint64_t built;
+	uint64_t last_use;
+
+	/* sorted by start once built, the ranges of modules that were
+	 * mapped into each other's holes overlap */
+	struct module *mods;
+	size_t n_mods;
+	size_t cap_mods;
+};
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+/* misses rebuild the index, but no more often than this */
+static const uint64_t REBUILD_INTERVAL = TRACE_CLOCK_NS_PER_SEC;
+static const size_t MODULES_INITIAL = 32;
+/******************************************************************************
+*                                    DATA                                     *
+******************************************************************************/
+static struct proc_syms proc_cache[PROC_CACHE_SIZE];
+static uint64_t use_clock;
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+static void proc_release(struct proc_syms *ps);
+static struct module *find_module(struct proc_syms *ps, const char *path);
+static struct module *add_module(struct proc_syms *ps, const char *path);
+static int parse_line(struct proc_syms *ps, const char *line, size_t len);
+static void sort_modules(struct proc_syms *ps);
+static int proc_build(struct proc_syms *ps);
+static struct proc_syms *proc_get(pid_t pid);
+static bool proc_stale(const struct proc_syms *ps);
+static struct module *module_at(struct proc_syms *ps, uint64_t addr);
+static struct elf_syms *module_elf(struct module *mod);
+static uint64_t module_bias(const struct module *mod);
+static int lookup_in(
+	struct proc_syms *ps,
+	const char *name,
+	const char *module,
+	uint64_t *addr,
+	uint64_t *size
+);
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static void proc_release(struct proc_syms *ps)
+{
+	for(size_t i = 0; i < ps->n_mods; i++) {
+		elf_syms_close(ps->mods[i].es);
+		ghost_free(sheap, ps->mods[i].path);
+	}
+
+	ghost_free(sheap, ps->mods);
+
+	ps->mods = NULL;
+	ps->n_mods = 0;
+	ps->cap_mods = 0;
+	ps->valid = false;
+}
+/*****************************************************************************/
+static struct module *find_module(struct proc_syms *ps, const char *path)
+{
+	/* the mappings of one file are almost always next to each other */
+	for(size_t i = ps->n_mods; i > 0; i--) {
+		if(strcmp(ps->mods[i - 1].path, path) == 0) {
+			return ps->mods + i - 1;
+		}
+	}
+
+	return NULL;
+}
+/*****************************************************************************/
+static struct module *add_module(struct proc_syms *ps, const char *path)
+{
+	if(ps->n_mods == ps->cap_mods) {
+		size_t cap = (ps->cap_mods == 0) ?
+			MODULES_INITIAL : (2 * ps->cap_mods);
+		void *tmp = ghost_realloc(
+			sheap, ps->mods, cap * sizeof(*ps->mods)
+		);
+
+		if(tmp == NULL) {
+			return NULL;
+		}
+
+		ps->mods = tmp;
+		ps->cap_mods = cap;
+	}
+
+	size_t len = strlen(path);
+	struct module *mod = ps->mods + ps->n_mods;
+
+	memset(mod, 0, sizeof(*mod));
+	mod->path = ghost_malloc(sheap, len + 1);
+
+	if(mod->path == NULL) {
+		return NULL;
+	}
+
+	memcpy(mod->path, path, len + 1);
+	ps->n_mods += 1;
+
+	return mod;
+}
+/*****************************************************************************/
+static int parse_line(struct proc_syms *ps, const char *line, size_t len)
+{
+	const char *saveptr = NULL;
+	char path[PATH_MAX];
+
+	if((len != 0) && (line[len - 1] == '\n')) {
+		len -= 1;
+	}
+
+	struct lstring addr = str_utl_tok_and_sqz(line, len, ' ', &saveptr);
+	struct lstring perms = str_utl_tok_and_sqz(line, len, ' ', &saveptr);
+	struct lstring offset = str_utl_tok_and_sqz(line, len, ' ', &saveptr);
+	struct lstring dev = str_utl_tok_and_sqz(line, len, ' ', &saveptr);
+	struct lstring inode = str_utl_tok_and_sqz(line, len, ' ', &saveptr);
+	struct lstring name = str_utl_tok_and_sqz(line, len, ' ', &saveptr);
+
+	(void)perms;
+	(void)dev;
+	(void)inode;
+
+	/* anonymous memory, the heap, the stack and [vdso] have no file to
+	 * take symbols from */
+	if((name.len == 0) || (name.str[0] != '/')) {
+		return 0;
+	} else if((addr.len == 0) || (offset.len == 0)) {
+		return -1;
+	}
+
+	/* the path runs to the end of the line, spaces and all */
+	size_t path_len = (line + len) - name.str;
+
+	if(path_len >= sizeof(path)) {
+		return 0;
+	}
+
+	memcpy(path, name.str, path_len);
+	path[path_len] = '\0';
+
+	char *end = NULL;
+	uint64_t start = strtoull(addr.str, &end, 16);
+	uint64_t stop = strtoull(end + 1, NULL, 16);
+	uint64_t off = strtoull(offset.str, NULL, 16);
+
+	struct module *mod = find_module(ps, path);
+
+	if(mod == NULL) {
+		if((mod = add_module(ps, path)) == NULL) {
+			return -1;
+		}
+		mod->start = start;
+		mod->end = stop;
+	}
+
+	if(start < mod->start) {
+		mod->start = start;
+	}
+	if(stop > mod->end) {
+		mod->end = stop;
+	}
+	if((off == 0) && (mod->map0 == 0)) {
+		mod->map0 = start;
+	}
+
+	return 0;
+}
+/*****************************************************************************/
+static void sort_modules(struct proc_syms *ps)
+{
+	/* merging the mappings of each file leaves the list almost in
+	 * order already, and it is short */
+	for(size_t i = 1; i < ps->n_mods; i++) {
+		struct module mod = ps->mods[i];
+		size_t j = i;
+
+		for(; (j > 0) && (ps->mods[j - 1].start > mod.start); j--) {
+			ps->mods[j] = ps->mods[j - 1];
+		}
+
+		ps->mods[j] = mod;
+	}
+
+	for(size_t i = 0; i < ps->n_mods; i++) {
+		uint64_t prev = (i == 0) ? 0 : ps->mods[i - 1].reach;
+
+		ps->mods[i].reach = max_u64(prev, ps->mods[i].end);
+	}
+}
+/*****************************************************************************/
+static int proc_build(struct proc_syms *ps)
+{
+	char maps[MAPS_PATH_MAX];
+	char line_buffer[MAPS_LINE_MAX];
+	int ret = -1;
+
+	proc_release(ps);
+
+	if(ps->pid == 0) {
+		ghost_snprintf(maps, sizeof(maps), "/proc/self/maps");
+	} else {
+		ghost_snprintf(maps, sizeof(maps), "/proc/%d/maps", ps->pid);
+	}
+
+	int fd = open(maps, O_RDONLY | O_CLOEXEC);
+
+	if(fd < 0) {
+		return -1;
+	}
+
+	struct file_utl_reader_state reader;
+	file_utl_reader_init(&reader, fd, line_buffer, sizeof(line_buffer));
+
+	int r;
+	while((r = file_utl_read_line(&reader)) > 0) {
+		if(parse_line(ps, reader.data, reader.len) != 0) {
+			goto exit;
+		}
+	}
+
+	if(r != FILE_UTL_READER_EOF) {
+		goto exit;
+	}
+
+	sort_modules(ps);
+	ps->valid = true;
+	ps->built = trace_clock_now();
+	ret = 0;
+exit:
+	close(fd);
+	return ret;
+}
+/*****************************************************************************/
+static struct proc_syms *proc_get(pid_t pid)
+{
+	struct proc_syms *ps = NULL;
+
+	for(size_t i = 0; i < PROC_CACHE_SIZE; i++) {
+		struct proc_syms *cand = proc_cache + i;
+
+		if(cand->valid && (cand->pid == pid)) {
+			ps = cand;
+			break;
+		} else if((ps == NULL) || (cand->last_use < ps->last_use)) {
+			ps = cand;
+		}
+	}
+
+	ps->last_use = ++use_clock;
+
+	if(ps->valid && (ps->pid == pid)) {
+		return ps;
+	}
+
+	ps->pid = pid;
+
+	if(proc_build(ps) != 0) {
+		proc_release(ps);
+		return NULL;
+	}
+
+	return ps;
+}
+/*****************************************************************************/
+static bool proc_stale(const struct proc_syms *ps)
+{
+	return (trace_clock_now() - ps->built) >= REBUILD_INTERVAL;
+}
+/*****************************************************************************/
+static struct module *module_at(struct proc_syms *ps, uint64_t addr)
+{
+	size_t lo = 0;
+	size_t hi = ps->n_mods;
+
+	while(lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if(ps->mods[mid].start <= addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	/* the innermost module that holds addr, starting from the last one
+	 * to start at or before it */
+	for(; (lo > 0) && (addr < ps->mods[lo - 1].reach); lo--) {
+		if(addr < ps->mods[lo - 1].end) {
+			return ps->mods + lo - 1;
+		}
+	}
+
+	return NULL;
+}
+/*****************************************************************************/
+static struct elf_syms *module_elf(struct module *mod)
+{
+	if((mod->es == NULL) && !mod->open_failed) {
+		mod->es = elf_syms_open(mod->path);
+		mod->open_failed = (mod->es == NULL);
+	}
+
+	return mod->es;
+}
+/*****************************************************************************/
+static uint64_t module_bias(const struct module *mod)
+{
+	uint64_t map0 = (mod->map0 == 0) ? mod->start : mod->map0;
+
+	return map0 - mod->es->vaddr_base;
+}
+/*****************************************************************************/
+static int lookup_in(
+	struct proc_syms *ps,
+	const char *name,
+	const char *module,
+	uint64_t *addr,
+	uint64_t *size
+) {
+	struct elf_sym sym;
+
+	for(size_t i = 0; i < ps->n_mods; i++) {
+		struct module *mod = ps->mods + i;
+
+		if((module != NULL) && (strstr(mod->path, module) == NULL)) {
+			continue;
+		} else if(module_elf(mod) == NULL) {
+			continue;
+		} else if(elf_syms_by_name(mod->es, name, &sym) != 0) {
+			continue;
+		}
+
+		*addr = sym.value + module_bias(mod);
+		*size = sym.size;
+		return 0;
+	}
+
+	return -1;
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+int tracee_syms_addr2sym(pid_t pid, uint64_t addr, struct tracee_sym *sym)
+{
+	struct proc_syms *ps = proc_get(pid);
+
+	if(ps == NULL) {
+		return -1;
+	}
+
+	struct module *mod = module_at(ps, addr);
+
+	/* something may have been loaded since the index was built */
+	if((mod == NULL) && proc_stale(ps)) {
+		if(proc_build(ps) != 0) {
+			return -1;
+		}
+		mod = module_at(ps, addr);
+	}
+
+	if(mod == NULL) {
+		return -1;
+	}
+
+	sym->name = NULL;
+	sym->module = mod->path;
+	sym->offset = addr - mod->start;
+
+	if(module_elf(mod) == NULL) {
+		return 0;
+	}
+
+	uint64_t bias = module_bias(mod);
+	const struct elf_sym *es = elf_syms_by_value(mod->es, addr - bias);
+
+	if(es == NULL) {
+		sym->offset = addr - bias;
+	} else {
+		sym->name = es->name;
+		sym->offset = addr - bias - es->value;
+	}
+
+	return 0;
+}
+/*****************************************************************************/
+int tracee_syms_lookup(
+	pid_t pid,
+	const char *name,
+	const char *module,
+	uint64_t *addr,
+	uint64_t *size
+) {
+	struct proc_syms *ps = proc_get(pid);
+
+	if(ps == NULL) {
+		return -1;
+	}
+
+	if(lookup_in(ps, name, module, addr, size) == 0) {
+		return 0;
+	} else if(!proc_stale(ps) || (proc_build(ps) != 0)) {
+		return -1;
+	}
+
+	return lookup_in(ps, name, module, addr, size);
+}
+/*****************************************************************************/
+void tracee_syms_invalidate(pid_t pid)
+{
+	for(size_t i = 0; i < PROC_CACHE_SIZE; i++) {
+		if(proc_cache[i].valid && (proc_cache[i].pid == pid)) {
+			proc_release(proc_cache + i);
+		}
+	}
+}
+/*****************************************************************************/
+void tracee_syms_clear(void)
+{
+	for(size_t i = 0; i < PROC_CACHE_SIZE; i++) {
+		proc_release(proc_cache + i);
+	}
+}
+/*****************************************************************************/
@@ -0,0 +1,57 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef TRACEE_SYMS_H
+#define TRACEE_SYMS_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+#include <sys/types.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct tracee_sym {
+	/* NULL when the address is in a module but not in any symbol */
+	const char *name;
+	/* from the symbol, or from the module's load address without one */
+	uint64_t offset;
+	const char *module;
+};
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+/* Symbol indexes are built per process from its memory map and the ELF
+ * files of the modules in it. pid 0 stands for the address space that the
+ * monitor shares with the target. Returns 0 if addr is in a module. */
+int tracee_syms_addr2sym(pid_t pid, uint64_t addr, struct tracee_sym *sym);
+/* Looks up the runtime address of a symbol, in the first module whose path
+ * contains module, or in any module when that is NULL. Returns 0 on
+ * success. */
+int tracee_syms_lookup(
+	pid_t pid,
+	const char *name,
+	const char *module,
+	uint64_t *addr,
+	uint64_t *size
+);
+/* Drops the index of a process whose memory map was replaced, i.e. on exec */
+void tracee_syms_invalidate(pid_t pid);
+void tracee_syms_clear(void);
+/*****************************************************************************/
+#endif /* TRACEE_SYMS_H */
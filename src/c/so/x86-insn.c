@@ -0,0 +1,380 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "x86-insn.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+/******************************************************************************
+*                                   DEFINES                                   *
+******************************************************************************/
+/* opcode table flags */
+#define OP_MODRM  0x0001
+#define OP_IMM8   0x0002
+#define OP_IMM16  0x0004
+/* 32 bits, or 16 with an operand size prefix */
+#define OP_IMMZ   0x0008
+/* 64 bits with REX.W, otherwise like OP_IMMZ */
+#define OP_IMMV   0x0010
+/* an absolute address, 64 bits or 32 with an address size prefix */
+#define OP_MOFFS  0x0020
+#define OP_REL8   0x0040
+#define OP_REL32  0x0080
+/* group 3, only test (/0 and /1) takes an immediate */
+#define OP_GRP3   0x0100
+#define OP_BRANCH 0x0200
+#define OP_END    0x0400
+#define OP_CALL   0x0800
+#define OP_BAD    0x1000
+
+#define M  OP_MODRM
+#define I8 OP_IMM8
+#define IZ OP_IMMZ
+#define X  OP_BAD
+
+#define ALU_ROW M, M, M, M, I8, IZ
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const uint16_t ONE_BYTE[256] = {
+	[0x00] = ALU_ROW, X, X,
+	[0x08] = ALU_ROW, X, 0,
+	[0x10] = ALU_ROW, X, X,
+	[0x18] = ALU_ROW, X, X,
+	[0x20] = ALU_ROW, 0, X,
+	[0x28] = ALU_ROW, 0, X,
+	[0x30] = ALU_ROW, 0, X,
+	[0x38] = ALU_ROW, 0, X,
+	[0x60] = X, X, X, M, 0, 0, 0, 0, IZ, M | IZ, I8, M | I8,
+	[0x70 ... 0x7F] = OP_REL8 | OP_BRANCH,
+	[0x80] = M | I8, M | IZ, X, M | I8,
+	[0x84 ... 0x8F] = M,
+	[0x9A] = X,
+	[0xA0 ... 0xA3] = OP_MOFFS,
+	[0xA8] = I8, IZ,
+	[0xB0 ... 0xB7] = I8,
+	[0xB8 ... 0xBF] = OP_IMMV,
+	[0xC0] = M | I8, M | I8, OP_IMM16 | OP_END, OP_END, X, X,
+	[0xC6] = M | I8, M | IZ, OP_IMM16 | I8, 0, OP_IMM16 | OP_END, OP_END,
+	[0xCC] = 0, I8, X, OP_END,
+	[0xD0 ... 0xD3] = M,
+	[0xD4 ... 0xD6] = X,
+	[0xD8 ... 0xDF] = M,
+	[0xE0 ... 0xE3] = OP_REL8 | OP_BRANCH,
+	[0xE4 ... 0xE7] = I8,
+	[0xE8] = OP_REL32 | OP_CALL, OP_REL32 | OP_END, X, OP_REL8 | OP_END,
+	[0xF4] = OP_END,
+	[0xF6] = M | OP_GRP3, M | OP_GRP3,
+	[0xFE] = M, M
+};
+
+static const uint16_t TWO_BYTE[256] = {
+	[0x00 ... 0x03] = M,
+	[0x04] = X,
+	[0x0A] = X, OP_END, X, M, 0, X,
+	[0x10 ... 0x23] = M,
+	[0x24 ... 0x27] = X,
+	[0x28 ... 0x2F] = M,
+	[0x39] = X,
+	[0x3B ... 0x3F] = X,
+	[0x40 ... 0x6F] = M,
+	[0x70 ... 0x73] = M | I8,
+	[0x74 ... 0x76] = M,
+	[0x78 ... 0x7F] = M,
+	[0x80 ... 0x8F] = OP_REL32 | OP_BRANCH,
+	[0x90 ... 0x9F] = M,
+	[0xA3] = M, M | I8, M, X, X,
+	[0xAB] = M, M | I8, M, M, M,
+	[0xB0 ... 0xB9] = M,
+	[0xBA] = M | I8,
+	[0xBB ... 0xC1] = M,
+	[0xC2] = M | I8, M, M | I8, M | I8, M | I8, M,
+	[0xD0 ... 0xFF] = M
+};
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static bool is_legacy_prefix(uint8_t b)
+{
+	switch(b) {
+	case 0x26: case 0x2E: case 0x36: case 0x3E:
+	case 0x64: case 0x65: case 0x66: case 0x67:
+	case 0xF0: case 0xF2: case 0xF3:
+		return true;
+	default:
+		return false;
+	}
+}
+/*****************************************************************************/
+static bool vex_imm8(uint8_t map, uint8_t op)
+{
+	if(map == 3) {
+		return true;
+	}
+
+	return (map == 1) && (TWO_BYTE[op] & OP_IMM8);
+}
+/*****************************************************************************/
+static size_t modrm_len(
+	const uint8_t *code, size_t pos, size_t avail, struct x86_insn *in
+) {
+	if(pos >= avail) {
+		return 0;
+	}
+
+	uint8_t modrm = code[pos];
+	uint8_t mod = modrm >> 6;
+	uint8_t rm = modrm & 7;
+	size_t len = 1;
+	size_t disp = 0;
+
+	if(mod == 3) {
+		return len;
+	}
+
+	if(rm == 4) {
+		if(pos + 1 >= avail) {
+			return 0;
+		}
+
+		len += 1;
+
+		if((mod == 0) && ((code[pos + 1] & 7) == 5)) {
+			disp = 4;
+		}
+	} else if((mod == 0) && (rm == 5)) {
+		in->rip_disp = pos + len;
+		disp = 4;
+	}
+
+	if(mod == 1) {
+		disp = 1;
+	} else if(mod == 2) {
+		disp = 4;
+	}
+
+	return len + disp;
+}
+/*****************************************************************************/
+static enum x86_flow flow_of(uint16_t flags)
+{
+	if(flags & OP_END) {
+		return X86_FLOW_END;
+	} else if(flags & OP_CALL) {
+		return X86_FLOW_CALL;
+	} else if(flags & OP_BRANCH) {
+		return X86_FLOW_BRANCH;
+	}
+
+	return X86_FLOW_NEXT;
+}
+/*****************************************************************************/
+static size_t decode_vex(
+	const uint8_t *code, size_t pos, size_t avail, struct x86_insn *in
+) {
+	uint8_t map;
+
+	/* in 64 bit mode these are always VEX (C4, C5) or EVEX (62) */
+	if(code[pos] == 0xC5) {
+		map = 1;
+		pos += 2;
+	} else if(code[pos] == 0xC4) {
+		if(pos + 1 >= avail) {
+			return 0;
+		}
+		map = code[pos + 1] & 0x1F;
+		pos += 3;
+	} else {
+		if(pos + 1 >= avail) {
+			return 0;
+		}
+		map = code[pos + 1] & 0x03;
+		pos += 4;
+	}
+
+	if((map < 1) || (map > 3) || (pos >= avail)) {
+		return 0;
+	}
+
+	in->opcode = code[pos];
+	in->map = 0x0F;
+	pos += 1;
+
+	size_t mlen = modrm_len(code, pos, avail, in);
+
+	if(mlen == 0) {
+		return 0;
+	}
+
+	pos += mlen;
+
+	if(vex_imm8(map, in->opcode)) {
+		pos += 1;
+	}
+
+	return pos;
+}
+/*****************************************************************************/
+static size_t imm_len(uint16_t flags, bool opsize, bool addrsize, bool rex_w)
+{
+	size_t len = 0;
+
+	if(flags & OP_IMM8) {
+		len += 1;
+	}
+	if(flags & OP_IMM16) {
+		len += 2;
+	}
+	if(flags & OP_IMMZ) {
+		len += opsize ? 2 : 4;
+	}
+	if(flags & OP_IMMV) {
+		len += rex_w ? 8 : (opsize ? 2 : 4);
+	}
+	if(flags & OP_MOFFS) {
+		len += addrsize ? 4 : 8;
+	}
+
+	return len;
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+size_t x86_insn_decode(const uint8_t *code, size_t avail, struct x86_insn *in)
+{
+	size_t pos = 0;
+	bool opsize = false;
+	bool addrsize = false;
+	bool rex_w = false;
+
+	in->len = 0;
+	in->opcode = 0;
+	in->map = 0;
+	in->flow = X86_FLOW_NEXT;
+	in->rip_disp = 0;
+	in->rel_off = 0;
+	in->rel_size = 0;
+
+	for(; (pos < avail) && is_legacy_prefix(code[pos]); pos++) {
+		opsize |= (code[pos] == 0x66);
+		addrsize |= (code[pos] == 0x67);
+	}
+
+	if((pos < avail) && ((code[pos] & 0xF0) == 0x40)) {
+		rex_w = (code[pos] & 0x08) != 0;
+		pos += 1;
+	}
+
+	if(pos >= avail) {
+		return 0;
+	}
+
+	uint8_t b = code[pos];
+
+	if((b == 0xC4) || (b == 0xC5) || (b == 0x62)) {
+		pos = decode_vex(code, pos, avail, in);
+		goto done;
+	}
+
+	uint16_t flags;
+
+	if(b != 0x0F) {
+		in->opcode = b;
+		flags = ONE_BYTE[b];
+		pos += 1;
+	} else if(pos + 1 >= avail) {
+		return 0;
+	} else if(code[pos + 1] == 0x38) {
+		pos += 3;
+		in->opcode = code[pos - 1];
+		flags = OP_MODRM;
+	} else if(code[pos + 1] == 0x3A) {
+		pos += 3;
+		in->opcode = code[pos - 1];
+		flags = OP_MODRM | OP_IMM8;
+	} else {
+		in->map = 0x0F;
+		in->opcode = code[pos + 1];
+		flags = TWO_BYTE[in->opcode];
+		pos += 2;
+	}
+
+	if(flags & OP_BAD) {
+		return 0;
+	}
+
+	/* a 16 bit near branch is nothing any compiler emits */
+	if((flags & (OP_REL8 | OP_REL32)) && opsize) {
+		return 0;
+	}
+
+	in->flow = flow_of(flags);
+
+	if(flags & OP_MODRM) {
+		if(pos >= avail) {
+			return 0;
+		}
+
+		uint8_t reg = (code[pos] >> 3) & 7;
+
+		if((flags & OP_GRP3) && (reg < 2)) {
+			flags |= (in->opcode == 0xF6) ? OP_IMM8 : OP_IMMZ;
+		}
+
+		/* FF /2 and /3 are indirect calls, /4 and /5 jumps */
+		if((in->map == 0) && (in->opcode == 0xFF)) {
+			if((reg == 2) || (reg == 3)) {
+				in->flow = X86_FLOW_CALL;
+			} else if((reg == 4) || (reg == 5)) {
+				in->flow = X86_FLOW_END;
+			}
+		}
+
+		size_t mlen = modrm_len(code, pos, avail, in);
+
+		if(mlen == 0) {
+			return 0;
+		}
+
+		pos += mlen;
+	}
+
+	if(flags & OP_REL8) {
+		in->rel_off = pos;
+		in->rel_size = 1;
+		pos += 1;
+	} else if(flags & OP_REL32) {
+		in->rel_off = pos;
+		in->rel_size = 4;
+		pos += 4;
+	}
+
+	pos += imm_len(flags, opsize, addrsize, rex_w);
+done:
+	if((pos == 0) || (pos > avail) || (pos > 15)) {
+		return 0;
+	}
+
+	in->len = pos;
+
+	return pos;
+}
+/*****************************************************************************/
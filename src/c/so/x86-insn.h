@@ -0,0 +1,60 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#ifndef X86_INSN_H
+#define X86_INSN_H
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+enum x86_flow {
+	/* execution carries on with the next instruction */
+	X86_FLOW_NEXT,
+	/* it may carry on elsewhere: jcc, loop, jrcxz */
+	X86_FLOW_BRANCH,
+	/* it never carries on with the next one: jmp, ret, ud2 and the like */
+	X86_FLOW_END,
+	X86_FLOW_CALL
+};
+
+/* Just enough of a decoded x86-64 instruction to move it somewhere else */
+struct x86_insn {
+	uint8_t len;
+	uint8_t opcode;
+	/* 0F for the two byte map, otherwise 0 */
+	uint8_t map;
+	enum x86_flow flow;
+
+	/* offset of a rip relative disp32 operand, 0 if there is none */
+	uint8_t rip_disp;
+	/* offset and size (1 or 4) of a relative branch target, 0 if none */
+	uint8_t rel_off;
+	uint8_t rel_size;
+};
+/******************************************************************************
+*                            FUNCTION DECLARATIONS                            *
+******************************************************************************/
+/* Decodes the instruction at code, of which avail bytes may be read. Returns
+ * its length, or 0 if it is invalid, truncated or not understood. */
+size_t x86_insn_decode(const uint8_t *code, size_t avail, struct x86_insn *in);
+/*****************************************************************************/
+#endif /* X86_INSN_H */
@@ -35,10 +35,11 @@ static const struct option GETOPT_OPTIONS[] = {
 	{"help", no_argument, NULL, 'h'},
 	{"test", required_argument, NULL, 't'},
 	{"ls", no_argument, NULL, 'l'},
+	{"bench", no_argument, NULL, 'b'},
 	{NULL, 0, 0, 0}
 };
 
-static const char OPT_STRING[] = "+hlt:";
+static const char OPT_STRING[] = "+hlbt:";
 
 static const char HELP_TEXT[] =
 	"Run ghost-patch unit tests"
@@ -47,11 +48,22 @@ static const char HELP_TEXT[] =
 	"-h,  --help     Display this help text\n"
 	"--test=<NAME>   Run the given named test only. If not given then\n"
 	"                all tests are run\n"
-	"-l, --ls        List all namd tests and exit\n";
+	"-l, --ls        List all namd tests and exit\n"
+	"-b, --bench     Print timings of the injection handshake instead\n"
+	"                of running tests\n";
 
 static const char* NAMED_TEST[] = {
 	"stdio",
-	"malloc"
+	"malloc",
+	"circ",
+	"print",
+	"tracee",
+	"sample",
+	"inject",
+	"hook",
+	"agg",
+	"gc",
+	"lua"
 };
 
 #define NUM_TESTS (sizeof(NAMED_TEST) / sizeof(NAMED_TEST[0]))
@@ -79,6 +91,33 @@ static void run_test(int idx)
 	case 1:
 		PUNIT_RUN_SUITE(test_suite_ghost_malloc);
 		break;
+	case 2:
+		PUNIT_RUN_SUITE(test_suite_circ_buffer);
+		break;
+	case 3:
+		PUNIT_RUN_SUITE(test_suite_trace_print);
+		break;
+	case 4:
+		PUNIT_RUN_SUITE(test_suite_tracee_table);
+		break;
+	case 5:
+		PUNIT_RUN_SUITE(test_suite_trace_sample);
+		break;
+	case 6:
+		PUNIT_RUN_SUITE(test_suite_fake_pthread);
+		break;
+	case 7:
+		PUNIT_RUN_SUITE(test_suite_trace_hook);
+		break;
+	case 8:
+		PUNIT_RUN_SUITE(test_suite_lua_agg);
+		break;
+	case 9:
+		PUNIT_RUN_SUITE(test_suite_lua_gc);
+		break;
+	case 10:
+		PUNIT_RUN_SUITE(test_suite_lua_trace);
+		break;
 	default:
 		fprintf(stderr, "Error: no such text number %d\n", idx);
 	}
@@ -138,6 +177,9 @@ int main(int argc, char **argv)
 		case 'l':
 			print_named_tests();
 			return 0;
+		case 'b':
+			bench_fake_pthread();
+			return 0;
 		default:
 			return -1;
 		}
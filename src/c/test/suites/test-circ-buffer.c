@@ -0,0 +1,243 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <circ_mirror.h>
+#include <circ_spsc.h>
+
+#include <picounit/picounit.h>
+#include <utl/math-utl.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const unsigned SPSC_PRODUCER_SEED = 1436779411;
+static const unsigned SPSC_CONSUMER_SEED = 2203315962;
+
+#define SPSC_STRESS_BYTES (32 * 1024 * 1024)
+#define SPSC_MAX_CHUNK 1500
+#define SPSC_PUBLISH_BATCH 4
+/******************************************************************************
+*                                   HELPERS                                   *
+******************************************************************************/
+static uint8_t stream_byte(uint64_t i)
+{
+	return (i * 7 + (i >> 12)) & 0xFF;
+}
+/*****************************************************************************/
+static void *spsc_producer(void *arg)
+{
+	struct circ_spsc *cb = arg;
+	unsigned seed = SPSC_PRODUCER_SEED;
+	uint8_t chunk[SPSC_MAX_CHUNK];
+	uint64_t sent = 0;
+	int batch = 0;
+
+	while(sent < SPSC_STRESS_BYTES) {
+		size_t len = 1 + rand_r(&seed) % SPSC_MAX_CHUNK;
+		len = min_u64(len, SPSC_STRESS_BYTES - sent);
+
+		if(rand_r(&seed) & 1) {
+			/* zero copy: fill the reserved span in place */
+			uint8_t *span;
+
+			while((span = circ_spsc_reserve(cb, len)) == NULL) {
+				circ_spsc_publish(cb);
+				sched_yield();
+			}
+
+			for(size_t i = 0; i < len; i++) {
+				span[i] = stream_byte(sent + i);
+			}
+
+			circ_spsc_commit(cb, len);
+		} else {
+			for(size_t i = 0; i < len; i++) {
+				chunk[i] = stream_byte(sent + i);
+			}
+
+			size_t done = 0;
+
+			while(done < len) {
+				done += circ_spsc_write(
+					cb, chunk + done, len - done
+				);
+
+				if(done < len) {
+					circ_spsc_publish(cb);
+					sched_yield();
+				}
+			}
+		}
+
+		sent += len;
+
+		if(++batch == SPSC_PUBLISH_BATCH) {
+			circ_spsc_publish(cb);
+			batch = 0;
+		}
+	}
+
+	circ_spsc_publish(cb);
+
+	return NULL;
+}
+/*****************************************************************************/
+static uint64_t spsc_consume_all(struct circ_spsc *cb)
+{
+	unsigned seed = SPSC_CONSUMER_SEED;
+	uint8_t chunk[SPSC_MAX_CHUNK];
+	uint64_t recv = 0;
+
+	while(recv < SPSC_STRESS_BYTES) {
+		size_t len;
+		const uint8_t *src;
+
+		if(rand_r(&seed) & 1) {
+			src = circ_spsc_peek(cb, &len);
+			len = min_u64(len, 1 + rand_r(&seed) % SPSC_MAX_CHUNK);
+		} else {
+			len = 1 + rand_r(&seed) % SPSC_MAX_CHUNK;
+			len = circ_spsc_read(cb, chunk, len);
+			src = chunk;
+		}
+
+		if(len == 0) {
+			sched_yield();
+			continue;
+		}
+
+		for(size_t i = 0; i < len; i++) {
+			if(src[i] != stream_byte(recv + i)) {
+				return recv + i;
+			}
+		}
+
+		if(src != chunk) {
+			circ_spsc_consume(cb, len);
+		}
+
+		recv += len;
+	}
+
+	return recv;
+}
+/******************************************************************************
+*                                    TESTS                                    *
+******************************************************************************/
+static bool test_mirror_aliases(void)
+{
+	struct circ_mirror cb;
+
+	PUNIT_ASSERT(circ_mirror_init(&cb, 1) == 0);
+	PUNIT_ASSERT(cb.size == getpagesize());
+
+	cb.buf[0] = 'a';
+	PUNIT_ASSERT(cb.buf[cb.size] == 'a');
+
+	cb.buf[2 * cb.size - 1] = 'z';
+	PUNIT_ASSERT(cb.buf[cb.size - 1] == 'z');
+
+	PUNIT_ASSERT(circ_mirror_destroy(&cb) == 0);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_mirror_wrap(void)
+{
+	struct circ_mirror cb;
+	uint8_t src[3000];
+	uint8_t dst[3000];
+
+	for(size_t i = 0; i < sizeof(src); i++) {
+		src[i] = i & 0xFF;
+	}
+
+	PUNIT_ASSERT(circ_mirror_init(&cb, 4096) == 0);
+
+	/* walk the counters around the ring several times so that writes
+	 * and reads straddle the wrap point */
+	for(int i = 0; i < 16; i++) {
+		PUNIT_ASSERT(circ_mirror_write(&cb, src, sizeof(src)) == 3000);
+		PUNIT_ASSERT(circ_mirror_used(&cb) == 3000);
+		PUNIT_ASSERT(circ_mirror_get(&cb, 2999) == (2999 & 0xFF));
+		PUNIT_ASSERT(circ_mirror_get(&cb, 3000) == -1);
+
+		memset(dst, 0, sizeof(dst));
+		PUNIT_ASSERT(circ_mirror_read(&cb, dst, sizeof(dst)) == 3000);
+		PUNIT_ASSERT(memcmp(src, dst, sizeof(src)) == 0);
+	}
+
+	PUNIT_ASSERT(circ_mirror_write(&cb, src, sizeof(src)) == 3000);
+	PUNIT_ASSERT(circ_mirror_write(&cb, src, sizeof(src)) == 1096);
+	PUNIT_ASSERT(circ_mirror_capacity(&cb) == 0);
+	PUNIT_ASSERT(circ_mirror_prepend(&cb, 'x') == -1);
+
+	PUNIT_ASSERT(circ_mirror_pop(&cb) == 0);
+	PUNIT_ASSERT(circ_mirror_prepend(&cb, 'x') == 0);
+	PUNIT_ASSERT(circ_mirror_pop(&cb) == 'x');
+
+	circ_mirror_clear(&cb);
+	PUNIT_ASSERT(circ_mirror_used(&cb) == 0);
+	PUNIT_ASSERT(circ_mirror_pop(&cb) == -1);
+
+	PUNIT_ASSERT(circ_mirror_destroy(&cb) == 0);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_spsc_stress(void)
+{
+	struct circ_spsc cb;
+	pthread_t producer;
+
+	PUNIT_ASSERT(circ_spsc_init(&cb, 4096) == 0);
+	PUNIT_ASSERT(circ_spsc_reserve(&cb, cb.size + 1) == NULL);
+
+	PUNIT_ASSERT(pthread_create(&producer, NULL, spsc_producer, &cb) == 0);
+
+	uint64_t recv = spsc_consume_all(&cb);
+
+	PUNIT_ASSERT(pthread_join(producer, NULL) == 0);
+	PUNIT_ASSERT(recv == SPSC_STRESS_BYTES);
+
+	size_t len;
+	circ_spsc_peek(&cb, &len);
+	PUNIT_ASSERT(len == 0);
+
+	PUNIT_ASSERT(circ_spsc_destroy(&cb) == 0);
+
+	return true;
+}
+/*****************************************************************************/
+void test_suite_circ_buffer(void)
+{
+	PUNIT_RUN_TEST(test_mirror_aliases);
+	PUNIT_RUN_TEST(test_mirror_wrap);
+	PUNIT_RUN_TEST(test_spsc_stress);
+}
+/*****************************************************************************/
@@ -0,0 +1,235 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+#define _GNU_SOURCE
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <fake-pthread.h>
+#include <safe_syscalls.h>
+#include <trace-clock.h>
+
+#include <picounit/picounit.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct inject_run {
+	uint64_t start;
+	uint64_t returned;
+	uint64_t entered;
+	pid_t pid;
+	uint32_t done;
+};
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+#define INJECT_RUNS 32
+/* injections timed by bench_fake_pthread() */
+#define BENCH_RUNS 2000
+
+/* far longer than any handshake takes, even with every party to it on one
+ * CPU, but short enough that a lost wakeup fails rather than hangs */
+static const uint64_t INJECT_DEADLINE = TRACE_CLOCK_NS_PER_SEC;
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static int inject_target(void *arg)
+{
+	struct inject_run *run = arg;
+
+	/* this is the injected process, it shares our memory but not much
+	 * else, so stick to the safe syscalls */
+	run->entered = trace_clock_now();
+	run->pid = safe_getpid();
+
+	__atomic_store_n(&run->done, 1, __ATOMIC_RELEASE);
+	safe_futex_wake(&run->done, 1);
+
+	safe_exit(0);
+	return 0;
+}
+/*****************************************************************************/
+static bool await_done(struct inject_run *run)
+{
+	uint64_t deadline = run->start + INJECT_DEADLINE;
+	uint64_t now;
+
+	while(__atomic_load_n(&run->done, __ATOMIC_ACQUIRE) == 0) {
+		if((now = trace_clock_now()) >= deadline) {
+			return false;
+		}
+
+		struct timespec left = {
+			.tv_sec = (deadline - now) / TRACE_CLOCK_NS_PER_SEC,
+			.tv_nsec = (deadline - now) % TRACE_CLOCK_NS_PER_SEC
+		};
+
+		safe_futex_wait_timeout(&run->done, 0, &left);
+	}
+
+	return true;
+}
+/*****************************************************************************/
+static bool inject_once(struct inject_run *run)
+{
+	int status;
+
+	run->done = 0;
+	run->pid = 0;
+	run->start = trace_clock_now();
+
+	PUNIT_ASSERT(fake_pthread(inject_target, run) == 0);
+	run->returned = trace_clock_now();
+
+	/* the injected process ran and woke us, in good time */
+	PUNIT_ASSERT(await_done(run));
+	PUNIT_ASSERT((run->pid != 0) && (run->pid != getpid()));
+	PUNIT_ASSERT(run->entered >= run->start);
+	PUNIT_ASSERT(run->returned - run->start < INJECT_DEADLINE);
+
+	PUNIT_ASSERT(waitpid(run->pid, &status, __WALL) == run->pid);
+	PUNIT_ASSERT(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+
+	return true;
+}
+/*****************************************************************************/
+static bool inject_runs(void)
+{
+	struct inject_run run;
+
+	for(int i = 0; i < INJECT_RUNS; i++) {
+		PUNIT_ASSERT(inject_once(&run));
+	}
+
+	return true;
+}
+/*****************************************************************************/
+static bool pin_one_cpu(cpu_set_t *old_set)
+{
+	cpu_set_t one_cpu;
+
+	/* every party to the handshake on a single CPU is the worst case for
+	 * spinning, a spinner burns its whole time slice while the thread it
+	 * waits for can't run */
+	if(sched_getaffinity(0, sizeof(*old_set), old_set) != 0) {
+		return false;
+	}
+
+	CPU_ZERO(&one_cpu);
+	CPU_SET(sched_getcpu(), &one_cpu);
+
+	return sched_setaffinity(0, sizeof(one_cpu), &one_cpu) == 0;
+}
+/*****************************************************************************/
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+
+	return (x > y) - (x < y);
+}
+/*****************************************************************************/
+static void bench_report(const char *what, uint64_t *ns, size_t n)
+{
+	uint64_t sum = 0;
+
+	qsort(ns, n, sizeof(*ns), cmp_u64);
+
+	for(size_t i = 0; i < n; i++) {
+		sum += ns[i];
+	}
+
+	printf(
+		"%-28s mean %8llu ns  p50 %8llu ns  p99 %8llu ns\n",
+		what,
+		(unsigned long long)(sum / n),
+		(unsigned long long)ns[n / 2],
+		(unsigned long long)ns[(n * 99) / 100]
+	);
+}
+/*****************************************************************************/
+static void bench_runs(const char *where)
+{
+	static uint64_t entered[BENCH_RUNS];
+	static uint64_t returned[BENCH_RUNS];
+	struct inject_run run;
+	char what[64];
+
+	for(int i = 0; i < BENCH_RUNS; i++) {
+		if(!inject_once(&run)) {
+			printf("%s: injection %d failed\n", where, i);
+			return;
+		}
+
+		entered[i] = run.entered - run.start;
+		returned[i] = run.returned - run.start;
+	}
+
+	snprintf(what, sizeof(what), "%s, target running", where);
+	bench_report(what, entered, BENCH_RUNS);
+	snprintf(what, sizeof(what), "%s, fake_pthread()", where);
+	bench_report(what, returned, BENCH_RUNS);
+}
+/******************************************************************************
+*                                    TESTS                                    *
+******************************************************************************/
+static bool test_inject_handshake(void)
+{
+	cpu_set_t old_set;
+	bool ret;
+
+	PUNIT_ASSERT(inject_runs());
+	PUNIT_ASSERT(pin_one_cpu(&old_set));
+
+	ret = inject_runs();
+
+	sched_setaffinity(0, sizeof(old_set), &old_set);
+
+	return ret;
+}
+/*****************************************************************************/
+void test_suite_fake_pthread(void)
+{
+	PUNIT_RUN_TEST(test_inject_handshake);
+}
+/*****************************************************************************/
+void bench_fake_pthread(void)
+{
+	cpu_set_t old_set;
+
+	printf("injection latency over %d runs\n", BENCH_RUNS);
+	bench_runs("free");
+
+	if(!pin_one_cpu(&old_set)) {
+		printf("unable to pin to one CPU\n");
+		return;
+	}
+
+	bench_runs("one CPU");
+	sched_setaffinity(0, sizeof(old_set), &old_set);
+}
+/*****************************************************************************/
@@ -24,8 +24,12 @@
 #include <picounit/picounit.h>
 #include <secret-heap.h>
 
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
 /******************************************************************************
 *                                    TESTS                                    *
 ******************************************************************************/
@@ -113,6 +117,9 @@ static bool test_unsigned_int_fmt(void)
 	ghost_snprintf(test_str, size, "%#o", 12);
 	PUNIT_ASSERT(strcmp(test_str, "014") == 0);
 
+	ghost_snprintf(test_str, size, "%u %#x %#o", 0, 0, 0);
+	PUNIT_ASSERT(strcmp(test_str, "0 0 0") == 0);
+
 	ghost_snprintf(test_str, size, "%x", 0xdeadbeefu);
 	PUNIT_ASSERT(strcmp(test_str, "deadbeef") == 0);
 
@@ -168,6 +175,137 @@ static bool test_signed_int_fmt(void)
 	PUNIT_ASSERT(strcmp(test_str, "10 ") == 0);
 
 
+	return true;
+}
+/*****************************************************************************/
+static bool test_mmap_read(void)
+{
+	char path[] = "/tmp/ghost-patch-test-XXXXXX";
+	const char contents[] = "#!comment\nline one\nline two\n";
+	char buf[64];
+	size_t len;
+
+	int fd = mkstemp(path);
+	PUNIT_ASSERT(fd >= 0);
+	PUNIT_ASSERT(write(fd, contents, strlen(contents)) == strlen(contents));
+	close(fd);
+
+	struct ghost_file *f = ghost_fopen(path, "rm");
+	unlink(path);
+	PUNIT_ASSERT(f != NULL);
+
+	PUNIT_ASSERT(ghost_fgetc(f) == '#');
+	PUNIT_ASSERT(ghost_ungetc('#', f) == 0);
+	/* pushed back bytes must be read before a view can be taken */
+	PUNIT_ASSERT(ghost_fview(f, 1, &len) == NULL);
+
+	PUNIT_ASSERT(ghost_fgets(buf, sizeof(buf), f) != NULL);
+	PUNIT_ASSERT(strcmp(buf, "#!comment\n") == 0);
+
+	PUNIT_ASSERT(ghost_fread(buf, 1, 4, f) == 4);
+	PUNIT_ASSERT(memcmp(buf, "line", 4) == 0);
+	PUNIT_ASSERT(ghost_ftell(f) == 14);
+
+	const char *view = ghost_fview(f, 4, &len);
+	PUNIT_ASSERT(view != NULL && len == 4);
+	PUNIT_ASSERT(memcmp(view, " one", 4) == 0);
+
+	view = ghost_fview(f, (size_t)-1, &len);
+	PUNIT_ASSERT(len == 10 && memcmp(view, "\nline two\n", 10) == 0);
+	PUNIT_ASSERT(ghost_fgetc(f) == GHOST_EOF);
+	PUNIT_ASSERT(ghost_feof(f));
+
+	PUNIT_ASSERT(ghost_fseek(f, -4, GHOST_SEEK_END) == 0);
+	PUNIT_ASSERT(ghost_fread(buf, 1, sizeof(buf), f) == 4);
+	PUNIT_ASSERT(memcmp(buf, "two\n", 4) == 0);
+
+	/* more bytes pushed back than make up whole items */
+	PUNIT_ASSERT(ghost_fseek(f, -5, GHOST_SEEK_END) == 0);
+	PUNIT_ASSERT(ghost_fread(buf, 1, 5, f) == 5);
+	for(int i = 4; i >= 0; i--) {
+		PUNIT_ASSERT(ghost_ungetc(buf[i], f) == 0);
+	}
+	memset(buf, 0, sizeof(buf));
+	PUNIT_ASSERT(ghost_fread(buf, 4, 2, f) == 1);
+	PUNIT_ASSERT(memcmp(buf, " two", 4) == 0);
+	PUNIT_ASSERT(ghost_fgetc(f) == '\n');
+	PUNIT_ASSERT(ghost_fgetc(f) == GHOST_EOF);
+
+	PUNIT_ASSERT(ghost_fclose(f) == 0);
+
+	/* write modes can't be mapped */
+	PUNIT_ASSERT(ghost_fopen(path, "wm") == NULL);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_large_write(void)
+{
+	char path[] = "/tmp/ghost-patch-test-XXXXXX";
+	static uint8_t src[3 * GHOST_IO_BUF_SIZE + 77];
+	static uint8_t dst[sizeof(src)];
+
+	for(size_t i = 0; i < sizeof(src); i++) {
+		src[i] = (uint8_t)(i * 31 + (i >> 8));
+	}
+
+	int fd = mkstemp(path);
+	PUNIT_ASSERT(fd >= 0);
+	close(fd);
+
+	struct ghost_file *f = ghost_fopen(path, "w");
+	PUNIT_ASSERT(f != NULL);
+
+	/* leave the write pointer mid buffer so that the big write both
+	 * wraps and runs into the read pointer */
+	PUNIT_ASSERT(ghost_fwrite(src, 1, 5, f) == 5);
+	PUNIT_ASSERT(ghost_fflush(f) == 0);
+	PUNIT_ASSERT(
+		ghost_fwrite(src + 5, 1, sizeof(src) - 5, f) ==
+		sizeof(src) - 5
+	);
+	PUNIT_ASSERT(ghost_fclose(f) == 0);
+
+	fd = open(path, O_RDONLY);
+	unlink(path);
+	PUNIT_ASSERT(fd >= 0);
+	PUNIT_ASSERT(read(fd, dst, sizeof(dst)) == sizeof(dst));
+	close(fd);
+
+	PUNIT_ASSERT(memcmp(src, dst, sizeof(src)) == 0);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_async_drop(void)
+{
+	int fds[2];
+	size_t page = getpagesize();
+	static uint8_t big[1 << 16];
+	char buf[16];
+
+	PUNIT_ASSERT(pipe(fds) == 0);
+
+	struct ghost_file *f = ghost_fdopen(fds[1], "w");
+	PUNIT_ASSERT(f != NULL);
+	PUNIT_ASSERT(ghost_setvbuf(f, NULL, GHOST_IONBF, 0) == 0);
+	PUNIT_ASSERT(ghost_fasync(f, GHOST_ASYNC_DROP, page) == 0);
+
+	/* a write larger than the whole ring can never fit */
+	memset(big, 'x', 2 * page);
+	PUNIT_ASSERT(ghost_fwrite(big, 1, 2 * page, f) == 2 * page);
+	PUNIT_ASSERT(ghost_fwrite("ok\n", 1, 3, f) == 3);
+	PUNIT_ASSERT(ghost_fasync_dropped(f) == 2 * page);
+
+	/* the count outlives the writer thread */
+	PUNIT_ASSERT(ghost_fasync(f, GHOST_ASYNC_OFF, 0) == 0);
+	PUNIT_ASSERT(ghost_fasync_dropped(f) == 2 * page);
+
+	PUNIT_ASSERT(ghost_fclose(f) == 0);
+	PUNIT_ASSERT(read(fds[0], buf, sizeof(buf)) == 3);
+	PUNIT_ASSERT(memcmp(buf, "ok\n", 3) == 0);
+	close(fds[0]);
+
 	return true;
 }
 /*****************************************************************************/
@@ -181,5 +319,8 @@ void test_suite_ghost_stdio(void)
 	PUNIT_RUN_TEST(test_char_fmt);
 	PUNIT_RUN_TEST(test_str_fmt);
 	PUNIT_RUN_TEST(test_double_fmt);
+	PUNIT_RUN_TEST(test_mmap_read);
+	PUNIT_RUN_TEST(test_large_write);
+	PUNIT_RUN_TEST(test_async_drop);
 }
 /*****************************************************************************/
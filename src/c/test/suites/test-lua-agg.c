@@ -0,0 +1,143 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <lua-agg.h>
+#include <lua/lua.h>
+#include <lua/lauxlib.h>
+#include <suites/test-lua-utl.h>
+
+#include <picounit/picounit.h>
+
+#include <stdbool.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const char COUNTER_SCRIPT[] =
+	"local c = LT_counter(2)\n"
+	"assert(c:add('a') == 1)\n"
+	"assert(c:add('a', 4) == 5)\n"
+	"assert(c:add(7) == 1)\n"
+	"assert(c:add('b', 3) == nil)\n"
+	"assert(c:get('a') == 5 and c:get(7) == 1 and c:get('b') == 0)\n"
+	"assert(c:dropped() == 3)\n"
+	"local snap = c:snapshot()\n"
+	"assert(snap.a == 5 and snap[7] == 1 and snap.b == nil)\n"
+	"c:clear()\n"
+	"assert(c:get('a') == 0 and c:dropped() == 0)\n"
+	"assert(c:add('b') == 1)\n"
+	/* keys past the limit are refused, not cut short */
+	"assert(c:add(string.rep('x', 54)) == 1)\n"
+	"assert(not pcall(c.add, c, string.rep('x', 55)))\n"
+	"assert(not pcall(c.get, c, string.rep('x', 100)))\n"
+	"assert(not pcall(c.add, c, 1.5))\n";
+
+static const char TOPK_SCRIPT[] =
+	"local t = LT_topk(32)\n"
+	"for i = 1, 10000 do\n"
+	"	t:add(i)\n"
+	"	if i % 10 == 0 then t:add('hot', 2) end\n"
+	"	if i % 25 == 0 then t:add('warm') end\n"
+	"end\n"
+	"local snap = t:snapshot()\n"
+	"assert(#snap == 32)\n"
+	"assert(snap[1][1] == 'hot' and snap[1][2] >= 2000)\n"
+	"assert(snap[2][1] == 'warm' and snap[2][2] >= 400)\n"
+	"for i = 2, #snap do\n"
+	"	assert(snap[i - 1][2] >= snap[i][2])\n"
+	"	assert(snap[i][3] <= snap[i][2])\n"
+	"end\n"
+	"local n, err = t:get('hot')\n"
+	"assert(n == snap[1][2] and err == snap[1][3])\n"
+	"assert(n - err <= 2000)\n"
+	"t:clear()\n"
+	"assert(#t:snapshot() == 0 and t:get('hot') == 0)\n"
+	"assert(not pcall(t.add, t, 'a', 0))\n";
+
+static const char HIST_SCRIPT[] =
+	"local h = LT_hist('linear', 0, 100, 10)\n"
+	"for _, v in ipairs({-5, 5, 9, 95, 100, 1000}) do h:add(v) end\n"
+	"assert(h:count() == 6 and h:sum() == 1204)\n"
+	"local snap = h:snapshot()\n"
+	"assert(#snap == 4)\n"
+	"assert(snap[1][1] == math.mininteger and snap[1][2] == 0)\n"
+	"assert(snap[1][3] == 1)\n"
+	"assert(snap[2][1] == 0 and snap[2][2] == 10 and snap[2][3] == 2)\n"
+	"assert(snap[3][1] == 90 and snap[3][2] == 100 and snap[3][3] == 1)\n"
+	"assert(snap[4][1] == 100 and snap[4][2] == math.maxinteger)\n"
+	"assert(snap[4][3] == 2)\n"
+	"local l = LT_hist()\n"
+	"l:add(0) l:add(1) l:add(3, 2)\n"
+	"snap = l:snapshot()\n"
+	"assert(#snap == 3 and snap[1][2] == 1 and snap[2][1] == 1)\n"
+	"assert(snap[3][1] == 2 and snap[3][2] == 4 and snap[3][3] == 2)\n"
+	"l:clear()\n"
+	"assert(l:count() == 0 and #l:snapshot() == 0)\n"
+	/* the sum stops at the ends of the range */
+	"assert(not pcall(l.add, l, 1, 0) and not pcall(l.add, l, 1, -1))\n"
+	"l:add(math.maxinteger, 3)\n"
+	"assert(l:sum() == math.maxinteger and l:count() == 3)\n"
+	"l:add(math.mininteger) l:add(-1)\n"
+	"assert(l:sum() == -2)\n"
+	"assert(not pcall(LT_hist, 'linear', 0, 1 << 40, 1))\n"
+	"assert(not pcall(LT_hist, 'linear', 10, 0, 1))\n";
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static bool run_script(const char *script)
+{
+	lua_State *ls = test_lua_state();
+	bool ok;
+
+	lua_agg_setup(ls);
+
+	ok = luaL_dostring(ls, script) == LUA_OK;
+	lua_close(ls);
+
+	return ok;
+}
+/******************************************************************************
+*                                    TESTS                                    *
+******************************************************************************/
+static bool test_agg_counter(void)
+{
+	PUNIT_ASSERT(run_script(COUNTER_SCRIPT));
+	return true;
+}
+/*****************************************************************************/
+static bool test_agg_topk(void)
+{
+	PUNIT_ASSERT(run_script(TOPK_SCRIPT));
+	return true;
+}
+/*****************************************************************************/
+static bool test_agg_hist(void)
+{
+	PUNIT_ASSERT(run_script(HIST_SCRIPT));
+	return true;
+}
+/*****************************************************************************/
+void test_suite_lua_agg(void)
+{
+	PUNIT_RUN_TEST(test_agg_counter);
+	PUNIT_RUN_TEST(test_agg_topk);
+	PUNIT_RUN_TEST(test_agg_hist);
+}
+/*****************************************************************************/
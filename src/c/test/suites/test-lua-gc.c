@@ -0,0 +1,149 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <lua-gc.h>
+#include <options.h>
+#include <lua/lua.h>
+#include <lua/lauxlib.h>
+#include <suites/test-lua-utl.h>
+
+#include <picounit/picounit.h>
+
+#include <stdbool.h>
+#include <string.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+/* garbage, a few MB of it */
+static const char CHURN_SCRIPT[] =
+	"for i = 1, 20000 do local t = {i, tostring(i)} end\n";
+
+static const char CONFIG_SCRIPT[] =
+	"assert(LT_gc_config('gen', 20, 100) == 'idle')\n"
+	"assert(LT_gc_stats().mode == 'gen')\n"
+	"assert(not pcall(LT_gc_config, 'fast'))\n"
+	"assert(not pcall(LT_gc_config, 'inc', 5000))\n"
+	"collectgarbage()\n"
+	"local s = LT_gc_stats(true)\n"
+	"assert(s.full == 1 and s.ns >= s.max_ns and #s.hist >= 1)\n"
+	"assert(LT_gc_stats().full == 0)\n";
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static lua_State *new_state(struct lua_gc_ctx *ctx, enum lua_gc_mode mode)
+{
+	lua_State *ls = test_lua_state();
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->can_idle = true;
+	lua_gc_setup(ls, ctx, mode, 0, 0);
+
+	return ls;
+}
+/******************************************************************************
+*                                    TESTS                                    *
+******************************************************************************/
+static bool test_gc_parse(void)
+{
+	enum lua_gc_mode mode;
+	uint32_t a;
+	uint32_t b;
+	const char *end;
+
+	end = parse_lua_gc("gen", &mode, &a, &b);
+	PUNIT_ASSERT((end != NULL) && (*end == '\0'));
+	PUNIT_ASSERT((mode == LUA_GC_GEN) && (a == 0) && (b == 0));
+
+	end = parse_lua_gc("idle,150,300;", &mode, &a, &b);
+	PUNIT_ASSERT((end != NULL) && (*end == ';'));
+	PUNIT_ASSERT((mode == LUA_GC_IDLE) && (a == 150) && (b == 300));
+
+	end = parse_lua_gc("inc,200", &mode, &a, &b);
+	PUNIT_ASSERT((end != NULL) && (mode == LUA_GC_INC) && (a == 200));
+
+	PUNIT_ASSERT(parse_lua_gc("incremental", &mode, &a, &b) == NULL);
+	PUNIT_ASSERT(parse_lua_gc("inc,", &mode, &a, &b) == NULL);
+	PUNIT_ASSERT(parse_lua_gc("inc,2000", &mode, &a, &b) == NULL);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_gc_idle(void)
+{
+	struct lua_gc_ctx ctx;
+	lua_State *ls = new_state(&ctx, LUA_GC_IDLE);
+	lua_GCStats stats;
+	bool pending;
+	int kb;
+
+	lua_gcstats(ls, NULL, true);
+
+	/* nothing is collected as the garbage piles up */
+	PUNIT_ASSERT(luaL_dostring(ls, CHURN_SCRIPT) == LUA_OK);
+	lua_gcstats(ls, &stats, false);
+	PUNIT_ASSERT(stats.steps == 0);
+
+	/* it is all left for the idle steps, though past twice the limit
+	 * the first of them is run straight away */
+	kb = lua_gc(ls, LUA_GCCOUNT);
+	pending = lua_gc_pending(ls, &ctx);
+
+	while(pending) {
+		pending = lua_gc_idle(ls, &ctx);
+	}
+
+	lua_gcstats(ls, &stats, false);
+	PUNIT_ASSERT(stats.steps > 0);
+	PUNIT_ASSERT(stats.time >= stats.maxtime);
+	PUNIT_ASSERT(lua_gc(ls, LUA_GCCOUNT) < kb);
+	PUNIT_ASSERT(!lua_gc_pending(ls, &ctx));
+
+	lua_close(ls);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_gc_config(void)
+{
+	struct lua_gc_ctx ctx;
+	lua_State *ls = new_state(&ctx, LUA_GC_IDLE);
+
+	PUNIT_ASSERT(luaL_dostring(ls, CONFIG_SCRIPT) == LUA_OK);
+	PUNIT_ASSERT(ctx.mode == LUA_GC_GEN);
+	PUNIT_ASSERT(!lua_gc_pending(ls, &ctx));
+
+	/* states that are never idle get an incremental collector */
+	ctx.can_idle = false;
+	PUNIT_ASSERT(luaL_dostring(ls, "LT_gc_config('idle')") == LUA_OK);
+	PUNIT_ASSERT(ctx.mode == LUA_GC_INC);
+
+	lua_close(ls);
+
+	return true;
+}
+/*****************************************************************************/
+void test_suite_lua_gc(void)
+{
+	PUNIT_RUN_TEST(test_gc_parse);
+	PUNIT_RUN_TEST(test_gc_idle);
+	PUNIT_RUN_TEST(test_gc_config);
+}
+/*****************************************************************************/
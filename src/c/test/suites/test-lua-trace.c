@@ -0,0 +1,282 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <lua-trace.h>
+#include <trace.h>
+#include <trace-hook.h>
+#include <options.h>
+#include <platform.h>
+#include <secret-heap.h>
+#include <gio/ghost-stdio.h>
+
+#include <picounit/picounit.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+/* each hook prints and looks the hooked function up, answering the call
+ * with its address. The failed call must let go of the lock. */
+static const char HOOK_SCRIPT[] =
+	"local calls = LT_shared_counter('test_calls')\n"
+	"LT_hook('lua_trace_test_target', function(regs, t)\n"
+	"	print('hooked', regs.rdi)\n"
+	"	assert(not pcall(LT_sym))\n"
+	"	local addr = LT_sym('lua_trace_test_target')\n"
+	"	calls:add(1)\n"
+	"	return addr\n"
+	"end)\n";
+
+/* prints the exits it is given */
+static const char EXIT_SCRIPT[] =
+	"LT_init(function(ev, pid, regs, ts, dur, t)\n"
+	"	t.seen = (t.seen or 0) + 1\n"
+	"	print(ev, pid, t.seen)\n"
+	"end)\n";
+
+#define NUM_THREADS 4
+static const unsigned CALLS_PER_THREAD = 200;
+/* long enough for a thread that is not held up to be through its calls */
+static const useconds_t HOLD_US = 50000;
+/******************************************************************************
+*                                    DATA                                     *
+******************************************************************************/
+static unsigned returned;
+/* handshake with the thread that holds the hook lock */
+static volatile bool lock_held;
+static volatile bool lock_release;
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+/* not static, the script finds it by name */
+NEVER_INLINE uint64_t lua_trace_test_target(uint64_t a)
+{
+	/* keeps the prologue long enough to put a jmp over at any -O */
+	volatile uint64_t acc = a;
+
+	acc += 1;
+
+	return acc;
+}
+/*****************************************************************************/
+static uint64_t (*volatile call_target)(uint64_t) = lua_trace_test_target;
+/*****************************************************************************/
+static void *call_hooked(void *arg)
+{
+	uintptr_t wrong = 0;
+
+	for(unsigned i = 0; i < CALLS_PER_THREAD; i++) {
+		if(call_target(i) != (uint64_t)lua_trace_test_target) {
+			wrong += 1;
+		}
+		__atomic_add_fetch(&returned, 1, __ATOMIC_RELAXED);
+	}
+
+	return (void*)wrong;
+}
+/*****************************************************************************/
+static void *hold_lock(void *arg)
+{
+	trace_hook_lock();
+	lock_held = true;
+
+	while(!lock_release) {
+		usleep(1000);
+	}
+
+	trace_hook_unlock();
+
+	return arg;
+}
+/*****************************************************************************/
+static int write_script(char *path, const char *script)
+{
+	int fd = mkstemp(path);
+
+	if(fd < 0) {
+		return -1;
+	}
+
+	ssize_t len = write(fd, script, strlen(script));
+
+	close(fd);
+
+	return (len == (ssize_t)strlen(script)) ? 0 : -1;
+}
+/******************************************************************************
+*                                    TESTS                                    *
+******************************************************************************/
+static bool test_pool_hooks(void)
+{
+	char path[] = "/tmp/ghost-patch-test-XXXXXX";
+	struct ghost_file *out = ghost_stdout;
+	pthread_t threads[NUM_THREADS];
+	struct prog_opts opts;
+	bool held = true;
+	bool right = true;
+
+	int fd = mkstemp(path);
+	PUNIT_ASSERT(fd >= 0);
+	PUNIT_ASSERT(
+		write(fd, HOOK_SCRIPT, strlen(HOOK_SCRIPT))
+		== strlen(HOOK_SCRIPT)
+	);
+	close(fd);
+
+	memset(&opts, 0, sizeof(opts));
+	opts.lua_ent = path;
+	opts.lua_states = NUM_THREADS;
+
+	struct trace_descriptor descr = lua_trace_descriptor(&opts);
+
+	ghost_stdout = ghost_fopen("/dev/null", "w");
+	PUNIT_ASSERT(ghost_stdout != NULL);
+	PUNIT_ASSERT(descr.init(descr.arg) != NULL);
+	unlink(path);
+
+	/* the hooks run in the pool states at once, but print() and
+	 * LT_sym() in them wait for the hook lock as the monitor holds
+	 * it */
+	returned = 0;
+	trace_hook_lock();
+
+	for(int i = 0; i < NUM_THREADS; i++) {
+		pthread_create(threads + i, NULL, call_hooked, NULL);
+	}
+
+	usleep(HOLD_US);
+	held = (__atomic_load_n(&returned, __ATOMIC_RELAXED) == 0);
+	trace_hook_unlock();
+
+	for(int i = 0; i < NUM_THREADS; i++) {
+		void *wrong = NULL;
+
+		pthread_join(threads[i], &wrong);
+		right = right && (wrong == NULL);
+	}
+
+	descr.fini(descr.arg);
+	trace_hook_set_concurrent(false);
+	trace_hook_set_handler(NULL, NULL);
+	ghost_fclose(ghost_stdout);
+	ghost_stdout = out;
+
+	PUNIT_ASSERT(held);
+	PUNIT_ASSERT(right);
+	PUNIT_ASSERT(returned == NUM_THREADS * CALLS_PER_THREAD);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_busy_exit(void)
+{
+	char path[] = "/tmp/ghost-patch-test-XXXXXX";
+	char out_path[] = "/tmp/ghost-patch-test-XXXXXX";
+	struct ghost_file *out = ghost_stdout;
+	struct ghost_file *err = ghost_stderr;
+	struct tracee_record rec;
+	struct tracee_state state;
+	struct prog_opts opts;
+	pthread_t holder;
+	char want[64];
+	char buf[256];
+
+	PUNIT_ASSERT(write_script(path, EXIT_SCRIPT) == 0);
+	PUNIT_ASSERT(write_script(out_path, "") == 0);
+
+	memset(&opts, 0, sizeof(opts));
+	opts.lua_ent = path;
+
+	struct trace_descriptor descr = lua_trace_descriptor(&opts);
+
+	/* fini reports the skipped syscall */
+	ghost_stdout = ghost_fopen(out_path, "w");
+	ghost_stderr = ghost_fopen("/dev/null", "w");
+	PUNIT_ASSERT(ghost_stdout != NULL);
+	PUNIT_ASSERT(ghost_stderr != NULL);
+	PUNIT_ASSERT(descr.init(descr.arg) != NULL);
+	unlink(path);
+
+	memset(&rec, 0, sizeof(rec));
+	memset(&state, 0, sizeof(state));
+	rec.tid = 4242;
+	rec.proc = 4242;
+	state.pid = 4242;
+	state.thread = &rec;
+
+	/* as if a hook had the state, the syscall goes by but the exit is
+	 * kept until the lock comes free */
+	lock_held = false;
+	lock_release = false;
+	pthread_create(&holder, NULL, hold_lock, NULL);
+
+	while(!lock_held) {
+		usleep(1000);
+	}
+
+	state.status = SYSCALL_ENTER_STOP;
+	descr.arg = descr.handle(descr.arg, &state);
+	state.status = EXITED_NORMAL;
+	descr.arg = descr.handle(descr.arg, &state);
+
+	/* the monitor forgets the thread right after */
+	memset(&rec, 0xff, sizeof(rec));
+
+	lock_release = true;
+	pthread_join(holder, NULL);
+	descr.idle(descr.arg);
+	descr.fini(descr.arg);
+	trace_hook_set_handler(NULL, NULL);
+	ghost_fclose(ghost_stdout);
+	ghost_fclose(ghost_stderr);
+	ghost_stdout = out;
+	ghost_stderr = err;
+
+	int fd = open(out_path, O_RDONLY);
+	ssize_t len = (fd < 0) ? -1 : read(fd, buf, sizeof(buf) - 1);
+
+	close(fd);
+	unlink(out_path);
+
+	PUNIT_ASSERT(len > 0);
+	buf[len] = '\0';
+
+	/* once, and with a table of its own */
+	snprintf(want, sizeof(want), "%d\t4242\t1\n", EXITED_NORMAL);
+	PUNIT_ASSERT(strcmp(buf, want) == 0);
+
+	return true;
+}
+/*****************************************************************************/
+void test_suite_lua_trace(void)
+{
+	secret_heap_init();
+
+	PUNIT_RUN_TEST(test_pool_hooks);
+	PUNIT_RUN_TEST(test_busy_exit);
+}
+/*****************************************************************************/
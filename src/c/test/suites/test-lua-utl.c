@@ -0,0 +1,61 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include "test-lua-utl.h"
+
+#include <secret-heap.h>
+#include <lua/lua.h>
+#include <lua/lualib.h>
+#include <lua/lauxlib.h>
+
+#include <stdlib.h>
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static void *test_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
+{
+	if(nsize == 0) {
+		free(ptr);
+		return NULL;
+	}
+
+	return realloc(ptr, nsize);
+}
+/******************************************************************************
+*                            FUNCTION DEFINITIONS                             *
+******************************************************************************/
+lua_State *test_lua_state(void)
+{
+	lua_State *ls;
+
+	/* lua formats numbers and errors through ghost stdio */
+	secret_heap_init();
+
+	ls = lua_newstate(test_alloc, NULL);
+
+	luaL_requiref(ls, LUA_GNAME, luaopen_base, 1);
+	luaL_requiref(ls, LUA_STRLIBNAME, luaopen_string, 1);
+	luaL_requiref(ls, LUA_MATHLIBNAME, luaopen_math, 1);
+	lua_settop(ls, 0);
+
+	return ls;
+}
+/*****************************************************************************/
@@ -21,7 +21,18 @@
 /******************************************************************************
 *                            FUNCTION DECLARATIONS                            *
 ******************************************************************************/
+void test_suite_circ_buffer(void);
 void test_suite_ghost_malloc(void);
 void test_suite_ghost_stdio(void);
+void test_suite_trace_print(void);
+void test_suite_tracee_table(void);
+void test_suite_trace_sample(void);
+void test_suite_fake_pthread(void);
+void test_suite_trace_hook(void);
+void test_suite_lua_agg(void);
+void test_suite_lua_gc(void);
+void test_suite_lua_trace(void);
+/* timings, only run when asked for as they pass or fail nothing */
+void bench_fake_pthread(void);
 /*****************************************************************************/
 #endif /* TEST_SUITES_H */
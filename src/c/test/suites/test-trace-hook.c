@@ -0,0 +1,409 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <trace-hook.h>
+#include <x86-insn.h>
+#include <platform.h>
+
+#include <picounit/picounit.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+/******************************************************************************
+*                                    TYPES                                    *
+******************************************************************************/
+struct decode_case {
+	uint8_t code[16];
+	size_t avail;
+	size_t len;
+	enum x86_flow flow;
+	uint8_t rip_disp;
+	uint8_t rel_size;
+};
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const struct decode_case DECODE_CASES[] = {
+	/* push %rbp */
+	{{0x55}, 1, 1, X86_FLOW_NEXT, 0, 0},
+	/* endbr64 */
+	{{0xF3, 0x0F, 0x1E, 0xFA}, 4, 4, X86_FLOW_NEXT, 0, 0},
+	/* sub $0x10, %rsp */
+	{{0x48, 0x83, 0xEC, 0x10}, 4, 4, X86_FLOW_NEXT, 0, 0},
+	/* lea 0x10(%rip), %rax */
+	{{0x48, 0x8D, 0x05, 0x10, 0, 0, 0}, 7, 7, X86_FLOW_NEXT, 3, 0},
+	/* movabs $imm64, %rax */
+	{{0x48, 0xB8, 1, 2, 3, 4, 5, 6, 7, 8}, 10, 10, X86_FLOW_NEXT, 0, 0},
+	/* testb $1, (%rax) */
+	{{0xF6, 0x00, 0x01}, 3, 3, X86_FLOW_NEXT, 0, 0},
+	/* mov %eax, 0x8(%rsp) */
+	{{0x89, 0x44, 0x24, 0x08}, 4, 4, X86_FLOW_NEXT, 0, 0},
+	/* vmovdqu (%rdi), %ymm0 */
+	{{0xC5, 0xFE, 0x6F, 0x07}, 4, 4, X86_FLOW_NEXT, 0, 0},
+	/* call rel32 */
+	{{0xE8, 0, 0, 0, 0}, 5, 5, X86_FLOW_CALL, 0, 4},
+	/* jne rel8 */
+	{{0x75, 0x05}, 2, 2, X86_FLOW_BRANCH, 0, 1},
+	/* je rel32 */
+	{{0x0F, 0x84, 0, 0, 0, 0}, 6, 6, X86_FLOW_BRANCH, 0, 4},
+	/* jmp *0x10(%rip) */
+	{{0xFF, 0x25, 0x10, 0, 0, 0}, 6, 6, X86_FLOW_END, 2, 0},
+	/* ret */
+	{{0xC3}, 1, 1, X86_FLOW_END, 0, 0},
+	/* truncated lea */
+	{{0x48, 0x8D, 0x05, 0x10}, 4, 0, X86_FLOW_NEXT, 0, 0},
+	/* push %es, invalid in 64 bit mode */
+	{{0x06}, 1, 0, X86_FLOW_NEXT, 0, 0}
+};
+
+#define NUM_DECODE_CASES (sizeof(DECODE_CASES) / sizeof(DECODE_CASES[0]))
+
+/* the handler answers calls with this first argument itself */
+static const uint64_t OVERRIDE_ARG = 42;
+static const uint64_t OVERRIDE_RET = 7;
+
+/* put in the upper half of ymm0 across a hooked call */
+static const uint64_t YMM_MARK = 0x5a5a0123456789a5ULL;
+static const uint64_t PAGE_SIZE = 4096;
+/******************************************************************************
+*                                    DATA                                     *
+******************************************************************************/
+static unsigned handler_calls;
+static uint64_t nested_ret;
+/******************************************************************************
+*                              STATIC FUNCTIONS                               *
+******************************************************************************/
+static NEVER_INLINE uint64_t hook_target(uint64_t a, uint64_t b)
+{
+	/* keeps the prologue long enough to put a jmp over at any -O */
+	volatile uint64_t acc = a;
+
+	acc += b;
+
+	return acc;
+}
+/*****************************************************************************/
+/* called through this so the calls aren't folded away */
+static uint64_t (*volatile call_target)(uint64_t, uint64_t) = hook_target;
+/*****************************************************************************/
+static bool test_handler(
+	void *arg, const struct trace_hook *hook, struct trace_hook_frame *frame
+) {
+	handler_calls += 1;
+
+	/* hooks are passed straight through for the thread holding the
+	 * lock */
+	nested_ret = call_target(frame->rdi, 1);
+
+	if(frame->rdi != OVERRIDE_ARG) {
+		return false;
+	}
+
+	frame->rax = OVERRIDE_RET;
+	return true;
+}
+/*****************************************************************************/
+static void *call_override(void *arg)
+{
+	return (void*)call_target(OVERRIDE_ARG, 2);
+}
+/*****************************************************************************/
+static NEVER_INLINE uint64_t ymm_target(uint64_t a, uint64_t b)
+{
+	volatile uint64_t acc = a;
+	uint64_t hi;
+
+	acc += b;
+
+	__asm__ volatile(
+		"vextractf128 $1, %%ymm0, %%xmm1\n\t"
+		"vmovq %%xmm1, %0"
+		: "=r"(hi)
+		:
+		: "xmm1"
+	);
+
+	return hi;
+}
+/*****************************************************************************/
+static uint64_t (*volatile ymm_call)(uint64_t, uint64_t) = ymm_target;
+/*****************************************************************************/
+static uint64_t call_with_ymm0(uint64_t mark)
+{
+	uint64_t fn = (uint64_t)ymm_call;
+	uint64_t ret;
+
+	/* the compiler can't be trusted to leave ymm0 alone between setting
+	 * it and the call, so both happen here, clear of the red zone */
+	__asm__ volatile(
+		"mov %%rsp, %%rbx\n\t"
+		"sub $128, %%rsp\n\t"
+		"and $-32, %%rsp\n\t"
+		"vmovq %[mark], %%xmm0\n\t"
+		"vinsertf128 $1, %%xmm0, %%ymm0, %%ymm0\n\t"
+		"xor %%edi, %%edi\n\t"
+		"xor %%esi, %%esi\n\t"
+		"call *%[fn]\n\t"
+		"mov %%rbx, %%rsp"
+		: "=a"(ret)
+		: [mark]"r"(mark), [fn]"r"(fn)
+		: "rbx", "rcx", "rdx", "rsi", "rdi", "r8", "r9", "r10", "r11",
+		"xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6",
+		"xmm7", "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13",
+		"xmm14", "xmm15", "memory", "cc"
+	);
+
+	return ret;
+}
+/*****************************************************************************/
+static bool ymm_handler(
+	void *arg, const struct trace_hook *hook, struct trace_hook_frame *frame
+) {
+	handler_calls += 1;
+
+	/* what any libc string function built for AVX does on its way out */
+	__asm__ volatile("vzeroupper");
+
+	return false;
+}
+/*****************************************************************************/
+static bool page_is_rwx(uint64_t page)
+{
+	char line[512];
+	bool rwx = false;
+	FILE *maps = fopen("/proc/self/maps", "r");
+
+	if(maps == NULL) {
+		return false;
+	}
+
+	while(fgets(line, sizeof(line), maps) != NULL) {
+		unsigned long long start, stop;
+		char perms[5];
+
+		if(sscanf(line, "%llx-%llx %4s", &start, &stop, perms) != 3) {
+			continue;
+		} else if((page >= start) && (page < stop)) {
+			rwx = (strncmp(perms, "rwx", 3) == 0);
+			break;
+		}
+	}
+
+	fclose(maps);
+	return rwx;
+}
+/******************************************************************************
+*                                    TESTS                                    *
+******************************************************************************/
+static bool test_x86_decode(void)
+{
+	for(size_t i = 0; i < NUM_DECODE_CASES; i++) {
+		const struct decode_case *c = DECODE_CASES + i;
+		struct x86_insn in;
+
+		PUNIT_ASSERT(x86_insn_decode(c->code, c->avail, &in) == c->len);
+
+		if(c->len == 0) {
+			continue;
+		}
+
+		PUNIT_ASSERT(in.len == c->len);
+		PUNIT_ASSERT(in.flow == c->flow);
+		PUNIT_ASSERT(in.rip_disp == c->rip_disp);
+		PUNIT_ASSERT(in.rel_size == c->rel_size);
+	}
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_hook_call(void)
+{
+	const char *why = NULL;
+	uint64_t addr = (uint64_t)hook_target;
+
+	trace_hook_set_handler(test_handler, NULL);
+	handler_calls = 0;
+
+	PUNIT_ASSERT(call_target(1, 2) == 3);
+
+	PUNIT_ASSERT(trace_hook_insert(addr, &why) == 0);
+	PUNIT_ASSERT(trace_hook_find(addr) != NULL);
+
+	/* the original still runs after the handler */
+	PUNIT_ASSERT(call_target(1, 2) == 3);
+	PUNIT_ASSERT(handler_calls == 1);
+	PUNIT_ASSERT(nested_ret == 2);
+
+	PUNIT_ASSERT(call_target(OVERRIDE_ARG, 2) == OVERRIDE_RET);
+	PUNIT_ASSERT(handler_calls == 2);
+	PUNIT_ASSERT(nested_ret == OVERRIDE_ARG + 1);
+
+	/* nothing runs while the lock is held */
+	trace_hook_lock();
+	PUNIT_ASSERT(call_target(OVERRIDE_ARG, 2) == OVERRIDE_ARG + 2);
+	PUNIT_ASSERT(trace_hook_trylock());
+	trace_hook_unlock();
+	trace_hook_unlock();
+	PUNIT_ASSERT(handler_calls == 2);
+
+	PUNIT_ASSERT(trace_hook_remove(addr) == 0);
+	PUNIT_ASSERT(trace_hook_remove(addr) != 0);
+	PUNIT_ASSERT(call_target(OVERRIDE_ARG, 2) == OVERRIDE_ARG + 2);
+	PUNIT_ASSERT(handler_calls == 2);
+
+	/* and back again, through the same trampoline */
+	PUNIT_ASSERT(trace_hook_insert(addr, &why) == 0);
+	PUNIT_ASSERT(call_target(OVERRIDE_ARG, 2) == OVERRIDE_RET);
+	PUNIT_ASSERT(handler_calls == 3);
+
+	trace_hook_clear();
+	PUNIT_ASSERT(call_target(OVERRIDE_ARG, 2) == OVERRIDE_ARG + 2);
+	PUNIT_ASSERT(handler_calls == 3);
+
+	trace_hook_set_handler(NULL, NULL);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_hook_restore(void)
+{
+	const char *why = NULL;
+	uint64_t addr = (uint64_t)hook_target;
+
+	trace_hook_set_handler(test_handler, NULL);
+	handler_calls = 0;
+
+	/* what a failed script reload does to the old script's hooks */
+	PUNIT_ASSERT(trace_hook_insert(addr, &why) == 0);
+	trace_hook_save();
+	trace_hook_clear();
+	PUNIT_ASSERT(call_target(OVERRIDE_ARG, 2) == OVERRIDE_ARG + 2);
+
+	trace_hook_restore();
+	PUNIT_ASSERT(call_target(OVERRIDE_ARG, 2) == OVERRIDE_RET);
+	PUNIT_ASSERT(handler_calls == 1);
+
+	/* and to the hooks the failed script put in */
+	trace_hook_clear();
+	trace_hook_save();
+	PUNIT_ASSERT(trace_hook_insert(addr, &why) == 0);
+	trace_hook_restore();
+	PUNIT_ASSERT(call_target(OVERRIDE_ARG, 2) == OVERRIDE_ARG + 2);
+	PUNIT_ASSERT(handler_calls == 1);
+
+	trace_hook_set_handler(NULL, NULL);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_hook_concurrent(void)
+{
+	const char *why = NULL;
+	uint64_t addr = (uint64_t)hook_target;
+	pthread_t thread;
+	void *ret = NULL;
+
+	trace_hook_set_handler(test_handler, NULL);
+	trace_hook_set_concurrent(true);
+	handler_calls = 0;
+
+	PUNIT_ASSERT(trace_hook_insert(addr, &why) == 0);
+
+	/* the handler runs on another thread while this one holds the
+	 * lock, it would wait for it otherwise */
+	trace_hook_lock();
+	PUNIT_ASSERT(pthread_create(&thread, NULL, call_override, NULL) == 0);
+	PUNIT_ASSERT(pthread_join(thread, &ret) == 0);
+	trace_hook_unlock();
+
+	PUNIT_ASSERT((uint64_t)ret == OVERRIDE_RET);
+	PUNIT_ASSERT(handler_calls == 1);
+	PUNIT_ASSERT(nested_ret == OVERRIDE_ARG + 1);
+
+	trace_hook_clear();
+	trace_hook_set_concurrent(false);
+	trace_hook_set_handler(NULL, NULL);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_hook_ymm(void)
+{
+	const char *why = NULL;
+	uint64_t addr = (uint64_t)ymm_target;
+
+	if(!__builtin_cpu_supports("avx")) {
+		return true;
+	}
+
+	PUNIT_ASSERT(call_with_ymm0(YMM_MARK) == YMM_MARK);
+
+	trace_hook_set_handler(ymm_handler, NULL);
+	handler_calls = 0;
+
+	PUNIT_ASSERT(trace_hook_insert(addr, &why) == 0);
+	PUNIT_ASSERT(call_with_ymm0(YMM_MARK) == YMM_MARK);
+	PUNIT_ASSERT(handler_calls == 1);
+
+	trace_hook_clear();
+	trace_hook_set_handler(NULL, NULL);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_hook_page_prot(void)
+{
+	const char *why = NULL;
+	uint64_t addr = (uint64_t)hook_target;
+	uint64_t page = addr & ~(PAGE_SIZE - 1);
+	int rwx = PROT_READ | PROT_WRITE | PROT_EXEC;
+
+	/* code a JIT writes to stays writable once it has been hooked */
+	if(mprotect((void*)page, PAGE_SIZE, rwx) != 0) {
+		return true;
+	}
+
+	PUNIT_ASSERT(trace_hook_insert(addr, &why) == 0);
+	PUNIT_ASSERT(page_is_rwx(page));
+	PUNIT_ASSERT(trace_hook_remove(addr) == 0);
+	PUNIT_ASSERT(page_is_rwx(page));
+
+	trace_hook_clear();
+	PUNIT_ASSERT(mprotect((void*)page, PAGE_SIZE, rwx & ~PROT_WRITE) == 0);
+	PUNIT_ASSERT(!page_is_rwx(page));
+
+	return true;
+}
+/*****************************************************************************/
+void test_suite_trace_hook(void)
+{
+	PUNIT_RUN_TEST(test_x86_decode);
+	PUNIT_RUN_TEST(test_hook_call);
+	PUNIT_RUN_TEST(test_hook_restore);
+	PUNIT_RUN_TEST(test_hook_concurrent);
+	PUNIT_RUN_TEST(test_hook_ymm);
+	PUNIT_RUN_TEST(test_hook_page_prot);
+}
+/*****************************************************************************/
@@ -0,0 +1,203 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <trace-print-tools.h>
+
+#include <picounit/picounit.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const unsigned TEST_RNG_SEED = 3141592653;
+
+#define RANDOM_BUFFERS 2000
+#define MAX_BUFFER 300
+#define MAX_SPACE 400
+/******************************************************************************
+*                                   HELPERS                                   *
+******************************************************************************/
+/* straightforward byte at a time version of sprint_buffer() */
+static char *ref_sprint_buffer(
+	const uint8_t *buf, char *str, ssize_t n, ssize_t space
+) {
+	char *p = str;
+
+	space -= 6;
+
+	if(space < 0) {
+		return NULL;
+	}
+
+	*p++ = '"';
+
+	for(ssize_t i = 0; i < n; i++) {
+		char tmp[5];
+		uint8_t c = buf[i];
+
+		if(c == '"' || c == '\\') {
+			sprintf(tmp, "\\%c", c);
+		} else if(c == '\n') {
+			strcpy(tmp, "\\n");
+		} else if(c == '\b') {
+			strcpy(tmp, "\\b");
+		} else if(c == '\r') {
+			strcpy(tmp, "\\r");
+		} else if((c >= ' ' && c <= '~') || c == '\t') {
+			sprintf(tmp, "%c", c);
+		} else {
+			sprintf(tmp, "\\%03o", c);
+		}
+
+		ssize_t len = strlen(tmp);
+
+		if(len > space) {
+			strcpy(p, "\"...");
+			return str;
+		}
+
+		memcpy(p, tmp, len);
+		p += len;
+		space -= len;
+	}
+
+	strcpy(p, "\"");
+
+	return str;
+}
+/*****************************************************************************/
+static void random_buffer(uint8_t *buf, size_t n, unsigned *seed)
+{
+	/* mostly text with the odd byte that needs escaping, so that both
+	 * the bulk copy and the escape paths get exercised */
+	for(size_t i = 0; i < n; i++) {
+		int r = rand_r(seed) % 64;
+
+		if(r == 0) {
+			buf[i] = rand_r(seed) & 0xFF;
+		} else if(r == 1) {
+			buf[i] = "\"\\\n\t"[rand_r(seed) % 4];
+		} else {
+			buf[i] = ' ' + rand_r(seed) % 95;
+		}
+	}
+}
+/******************************************************************************
+*                                    TESTS                                    *
+******************************************************************************/
+static bool test_sprint_fixed(void)
+{
+	char str[128];
+	const char text[] = "0123456789abcdefghijklmnopqrstuvwxyz\tABC";
+
+	PUNIT_ASSERT(sprint_buffer(text, str, 40, sizeof(str)) != NULL);
+	PUNIT_ASSERT(strcmp(
+		str, "\"0123456789abcdefghijklmnopqrstuvwxyz\tABC\""
+	) == 0);
+
+	PUNIT_ASSERT(sprint_buffer("a\"b\\c\n\x01\xff", str, 8, sizeof(str)));
+	PUNIT_ASSERT(strcmp(str, "\"a\\\"b\\\\c\\n\\001\\377\"") == 0);
+
+	PUNIT_ASSERT(sprint_buffer(text, str, 40, 16) != NULL);
+	PUNIT_ASSERT(strcmp(str, "\"0123456789\"...") == 0);
+
+	PUNIT_ASSERT(sprint_buffer_len(text, str, 40, 16) == 15);
+	PUNIT_ASSERT(sprint_buffer_len(NULL, str, 0, sizeof(str)) == 6);
+	PUNIT_ASSERT(sprint_buffer_len(text, str, 40, 5) < 0);
+
+	PUNIT_ASSERT(sprint_buffer(text, str, 40, 5) == NULL);
+	PUNIT_ASSERT(sprint_buffer(text, str, -1, sizeof(str)) == NULL);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_sprint_random(void)
+{
+	unsigned seed = TEST_RNG_SEED;
+	uint8_t buf[MAX_BUFFER];
+	char got[MAX_SPACE];
+	char expect[MAX_SPACE];
+
+	for(int i = 0; i < RANDOM_BUFFERS; i++) {
+		size_t n = rand_r(&seed) % MAX_BUFFER;
+		size_t space = 6 + rand_r(&seed) % (MAX_SPACE - 6);
+
+		random_buffer(buf, n, &seed);
+
+		ref_sprint_buffer(buf, expect, n, space);
+		ssize_t len = sprint_buffer_len((const char*)buf, got, n, space);
+
+		PUNIT_ASSERT(strcmp(got, expect) == 0);
+		PUNIT_ASSERT(len == (ssize_t)strlen(expect));
+	}
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_sprint_avx2(void)
+{
+	unsigned seed = TEST_RNG_SEED;
+	uint8_t buf[MAX_BUFFER];
+	char got[MAX_SPACE];
+	char expect[MAX_SPACE];
+
+	/* the tests are built without -march, so the AVX2 loop is only run
+	 * when asked for */
+	if(trace_print_force_vec(TRACE_PRINT_VEC_AVX2) != 0) {
+		printf("(no AVX2, skipped) ");
+		return true;
+	}
+
+	for(int i = 0; i < RANDOM_BUFFERS; i++) {
+		size_t n = rand_r(&seed) % MAX_BUFFER;
+		size_t space = 6 + rand_r(&seed) % (MAX_SPACE - 6);
+
+		random_buffer(buf, n, &seed);
+
+		trace_print_force_vec(TRACE_PRINT_VEC_NONE);
+		ssize_t want = sprint_buffer_len(
+			(const char*)buf, expect, n, space
+		);
+		trace_print_force_vec(TRACE_PRINT_VEC_AVX2);
+		ssize_t len = sprint_buffer_len(
+			(const char*)buf, got, n, space
+		);
+
+		PUNIT_ASSERT(len == want);
+		PUNIT_ASSERT(memcmp(got, expect, want + 1) == 0);
+	}
+
+	trace_print_force_vec(TRACE_PRINT_VEC_BUILT);
+
+	return true;
+}
+/*****************************************************************************/
+void test_suite_trace_print(void)
+{
+	PUNIT_RUN_TEST(test_sprint_fixed);
+	PUNIT_RUN_TEST(test_sprint_random);
+	PUNIT_RUN_TEST(test_sprint_avx2);
+}
+/*****************************************************************************/
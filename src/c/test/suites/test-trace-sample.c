@@ -0,0 +1,126 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <trace-sample.h>
+
+#include <picounit/picounit.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const uint64_t SAMPLE_SEED = 0x9e3779b97f4a7c15ULL;
+
+#define PICKS 1000000
+#define PICK_RATE 16
+/******************************************************************************
+*                                    TESTS                                    *
+******************************************************************************/
+static bool test_sample_rate(void)
+{
+	struct trace_sampler s;
+	int picked = 0;
+	int longest = 0;
+	int gap = 0;
+
+	trace_sampler_init(&s, SAMPLE_SEED);
+
+	/* the default is to see everything */
+	for(int i = 0; i < 100; i++) {
+		PUNIT_ASSERT(trace_sampler_pick(&s));
+	}
+	PUNIT_ASSERT(trace_sampler_weight(&s) == 1.0);
+
+	trace_sampler_set_rate(&s, PICK_RATE);
+	PUNIT_ASSERT(trace_sampler_weight(&s) == PICK_RATE);
+
+	for(int i = 0; i < PICKS; i++) {
+		gap += 1;
+
+		if(trace_sampler_pick(&s)) {
+			picked += 1;
+			longest = (gap > longest) ? gap : longest;
+			gap = 0;
+		}
+	}
+
+	/* within a couple of percent of one in PICK_RATE, and gaps never
+	 * longer than twice the rate */
+	int expected = PICKS / PICK_RATE;
+
+	PUNIT_ASSERT(picked > expected - expected / 50);
+	PUNIT_ASSERT(picked < expected + expected / 50);
+	PUNIT_ASSERT(longest <= 2 * PICK_RATE - 1);
+
+	trace_sampler_set_rate(&s, 0);
+	PUNIT_ASSERT(trace_sampler_pick(&s));
+	PUNIT_ASSERT(trace_sampler_pick(&s));
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_sample_duty(void)
+{
+	struct trace_sampler s;
+
+	trace_sampler_init(&s, SAMPLE_SEED);
+
+	PUNIT_ASSERT(!trace_sampler_duty_on(&s));
+	PUNIT_ASSERT(trace_sampler_in_window(&s, 12345));
+
+	PUNIT_ASSERT(trace_sampler_set_duty(&s, 0, 100, 0) != 0);
+	PUNIT_ASSERT(trace_sampler_set_duty(&s, 101, 100, 0) != 0);
+	PUNIT_ASSERT(!trace_sampler_duty_on(&s));
+
+	/* a full window is no duty cycle at all */
+	PUNIT_ASSERT(trace_sampler_set_duty(&s, 100, 100, 0) == 0);
+	PUNIT_ASSERT(!trace_sampler_duty_on(&s));
+
+	PUNIT_ASSERT(trace_sampler_set_duty(&s, 10, 100, 1000) == 0);
+	PUNIT_ASSERT(trace_sampler_duty_on(&s));
+	PUNIT_ASSERT(trace_sampler_weight(&s) == 10.0);
+
+	PUNIT_ASSERT(trace_sampler_in_window(&s, 1000));
+	PUNIT_ASSERT(trace_sampler_in_window(&s, 1009));
+	PUNIT_ASSERT(!trace_sampler_in_window(&s, 1010));
+	PUNIT_ASSERT(!trace_sampler_in_window(&s, 1099));
+
+	trace_sampler_tick(&s, 1100);
+	PUNIT_ASSERT(trace_sampler_in_window(&s, 1105));
+	PUNIT_ASSERT(!trace_sampler_in_window(&s, 1110));
+
+	trace_sampler_set_rate(&s, 4);
+	PUNIT_ASSERT(trace_sampler_weight(&s) == 40.0);
+
+	PUNIT_ASSERT(trace_sampler_set_duty(&s, 0, 0, 0) == 0);
+	PUNIT_ASSERT(!trace_sampler_duty_on(&s));
+	PUNIT_ASSERT(trace_sampler_in_window(&s, 1110));
+
+	return true;
+}
+/*****************************************************************************/
+void test_suite_trace_sample(void)
+{
+	PUNIT_RUN_TEST(test_sample_rate);
+	PUNIT_RUN_TEST(test_sample_duty);
+}
+/*****************************************************************************/
@@ -0,0 +1,161 @@
+/******************************************************************************
+* Copyright (C) 2023  Billy Kozak                                             *
+*                                                                             *
+* This file is part of the ghost-patch program                                *
+*                                                                             *
+* This program is free software: you can redistribute it and/or modify        *
+* it under the terms of the GNU Lesser General Public License as published by *
+* the Free Software Foundation, either version 3 of the License, or           *
+* (at your option) any later version.                                         *
+*                                                                             *
+* This program is distributed in the hope that it will be useful,             *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of              *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the               *
+* GNU Lesser General Public License for more details.                         *
+*                                                                             *
+* You should have received a copy of the GNU Lesser General Public License    *
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.       *
+******************************************************************************/
+/******************************************************************************
+*                                  INCLUDES                                   *
+******************************************************************************/
+#include <tracee-state-table.h>
+#include <secret-heap.h>
+
+#include <picounit/picounit.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+/******************************************************************************
+*                                  CONSTANTS                                  *
+******************************************************************************/
+static const unsigned RANDOM_SEED = 3105882347;
+
+#define RANDOM_TID_SPACE 4096
+#define RANDOM_OPS 200000
+#define SEQ_THREADS 5000
+/******************************************************************************
+*                                    TESTS                                    *
+******************************************************************************/
+static bool test_table_sequential(void)
+{
+	void *tab = tracee_state_table_init();
+
+	PUNIT_ASSERT(tab != NULL);
+	PUNIT_ASSERT(tracee_state_table_find(tab, 1) == NULL);
+	PUNIT_ASSERT(tracee_state_table_get(tab, 0) == NULL);
+
+	for(pid_t tid = 1; tid <= SEQ_THREADS; tid++) {
+		struct tracee_record *rec = tracee_state_table_get(tab, tid);
+
+		PUNIT_ASSERT(rec != NULL);
+		PUNIT_ASSERT(((uintptr_t)rec % sizeof(*rec)) == 0);
+		PUNIT_ASSERT(rec->tid == tid);
+		PUNIT_ASSERT(rec->status == (uint8_t)-1);
+		PUNIT_ASSERT(rec->user_ref == 0);
+
+		rec->enter_nr = tid;
+	}
+
+	PUNIT_ASSERT(tracee_state_table_count(tab) == SEQ_THREADS);
+
+	/* a second get must return the existing record */
+	PUNIT_ASSERT(tracee_state_table_get(tab, 77)->enter_nr == 77);
+	PUNIT_ASSERT(tracee_state_table_count(tab) == SEQ_THREADS);
+
+	for(pid_t tid = 1; tid <= SEQ_THREADS; tid += 2) {
+		tracee_state_table_remove(tab, tid);
+	}
+
+	for(pid_t tid = 1; tid <= SEQ_THREADS; tid++) {
+		struct tracee_record *rec = tracee_state_table_find(tab, tid);
+
+		if(tid & 1) {
+			PUNIT_ASSERT(rec == NULL);
+		} else {
+			PUNIT_ASSERT(rec != NULL);
+			PUNIT_ASSERT(rec->enter_nr == tid);
+		}
+	}
+
+	for(pid_t tid = 2; tid <= SEQ_THREADS; tid += 2) {
+		tracee_state_table_remove(tab, tid);
+	}
+
+	PUNIT_ASSERT(tracee_state_table_count(tab) == 0);
+	PUNIT_ASSERT(tracee_state_table_find(tab, 2) == NULL);
+
+	tracee_state_table_destroy(tab);
+
+	return true;
+}
+/*****************************************************************************/
+static bool test_table_random(void)
+{
+	/* interleave inserts and removals and compare against a flat array,
+	 * this exercises the backward shift on runs that wrap the table */
+	static int64_t shadow[RANDOM_TID_SPACE];
+	unsigned seed = RANDOM_SEED;
+	size_t live = 0;
+
+	void *tab = tracee_state_table_init();
+
+	PUNIT_ASSERT(tab != NULL);
+	memset(shadow, 0, sizeof(shadow));
+
+	for(int i = 0; i < RANDOM_OPS; i++) {
+		pid_t tid = 1 + rand_r(&seed) % (RANDOM_TID_SPACE - 1);
+
+		if(rand_r(&seed) % 3 == 0) {
+			tracee_state_table_remove(tab, tid);
+
+			if(shadow[tid] != 0) {
+				live -= 1;
+			}
+			shadow[tid] = 0;
+		} else {
+			struct tracee_record *rec;
+			rec = tracee_state_table_get(tab, tid);
+
+			PUNIT_ASSERT(rec != NULL);
+
+			if(shadow[tid] == 0) {
+				PUNIT_ASSERT(rec->enter_nr == 0);
+				live += 1;
+			} else {
+				PUNIT_ASSERT(rec->enter_nr == shadow[tid]);
+			}
+
+			shadow[tid] = i + 1;
+			rec->enter_nr = i + 1;
+		}
+	}
+
+	PUNIT_ASSERT(tracee_state_table_count(tab) == live);
+
+	for(pid_t tid = 1; tid < RANDOM_TID_SPACE; tid++) {
+		struct tracee_record *rec = tracee_state_table_find(tab, tid);
+
+		if(shadow[tid] == 0) {
+			PUNIT_ASSERT(rec == NULL);
+		} else {
+			PUNIT_ASSERT(rec != NULL);
+			PUNIT_ASSERT(rec->enter_nr == shadow[tid]);
+		}
+	}
+
+	tracee_state_table_destroy(tab);
+
+	return true;
+}
+/*****************************************************************************/
+void test_suite_tracee_table(void)
+{
+	secret_heap_init();
+
+	PUNIT_RUN_TEST(test_table_sequential);
+	PUNIT_RUN_TEST(test_table_random);
+}
+/*****************************************************************************/